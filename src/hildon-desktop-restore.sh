@@ -46,4 +46,9 @@ if [ -d $HOME/.cache/launch ]; then
         rm -rf $HOME/.cache/launch/*
 fi
 
+# remove pre-dithered backgrounds
+if [ -d $HOME/.cache/backgrounds ]; then
+        rm -rf $HOME/.cache/backgrounds/*
+fi
+
 kill `pidof hildon-home`
@@ -0,0 +1,189 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "hd-background-cache.h"
+
+#include <glib/gstdio.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define HD_BACKGROUND_CACHE_DIR        "%s/.cache/backgrounds"
+#define HD_BACKGROUND_CACHE_FILE       HD_BACKGROUND_CACHE_DIR "/background-%u.565"
+#define HD_BACKGROUND_CACHE_FILE_PORTRAIT \
+        HD_BACKGROUND_CACHE_DIR "/background_portrait-%u.565"
+
+/* "HDBG" */
+#define HD_BACKGROUND_CACHE_MAGIC      0x47424448
+/* Bump this whenever the file format or the dithering changes. */
+#define HD_BACKGROUND_CACHE_VERSION    1
+
+/* The header is followed by width*height RGB565 pixels, without padding. */
+typedef struct
+{
+  guint32 magic;
+  guint32 version;
+  guint64 source_mtime;
+  guint64 source_size;
+  guint32 width, height;
+  guint32 portrait;
+  guint32 reserved;
+} HdBackgroundCacheHeader;
+
+static gchar *
+cache_file_name (guint id, gboolean portrait)
+{
+  return g_strdup_printf (portrait ? HD_BACKGROUND_CACHE_FILE_PORTRAIT
+                                   : HD_BACKGROUND_CACHE_FILE,
+                          g_get_home_dir (), id + 1);
+}
+
+HdBackgroundCacheImage *
+hd_background_cache_load (const struct stat *source_stat,
+                          guint id, gboolean portrait)
+{
+  const HdBackgroundCacheHeader *header;
+  HdBackgroundCacheImage *image;
+  struct stat cache_stat;
+  gpointer map;
+  gchar *fname;
+  int fd;
+
+  fname = cache_file_name (id, portrait);
+  fd = g_open (fname, O_RDONLY, 0);
+  g_free (fname);
+  if (fd < 0)
+    return NULL;
+
+  if (fstat (fd, &cache_stat) != 0
+      || cache_stat.st_size < sizeof (*header))
+    {
+      close (fd);
+      return NULL;
+    }
+
+  map = mmap (NULL, cache_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  header = map;
+  if (header->magic != HD_BACKGROUND_CACHE_MAGIC
+      || header->version != HD_BACKGROUND_CACHE_VERSION
+      || header->source_mtime != (guint64)source_stat->st_mtime
+      || header->source_size != (guint64)source_stat->st_size
+      || header->portrait != (portrait != FALSE)
+      || cache_stat.st_size != sizeof (*header)
+                               + (gsize)header->width * header->height * 2)
+    {
+      g_debug ("%s: stale cache for view %u", __FUNCTION__, id + 1);
+      munmap (map, cache_stat.st_size);
+      return NULL;
+    }
+
+  image = g_new (HdBackgroundCacheImage, 1);
+  image->pixels = (const guint16 *)(header + 1);
+  image->width = header->width;
+  image->height = header->height;
+  image->map = map;
+  image->map_size = cache_stat.st_size;
+
+  return image;
+}
+
+void
+hd_background_cache_image_free (HdBackgroundCacheImage *image)
+{
+  munmap (image->map, image->map_size);
+  g_free (image);
+}
+
+gboolean
+hd_background_cache_save (const struct stat *source_stat,
+                          guint id, gboolean portrait,
+                          const guint16 *pixels, gint width, gint height)
+{
+  HdBackgroundCacheHeader header;
+  gchar *dir, *fname, *tmpname;
+  gboolean ok = FALSE;
+  int fd;
+
+  dir = g_strdup_printf (HD_BACKGROUND_CACHE_DIR, g_get_home_dir ());
+  if (g_mkdir_with_parents (dir, 0755) != 0)
+    {
+      g_warning ("%s: couldn't create %s: %s", __FUNCTION__,
+                 dir, g_strerror (errno));
+      g_free (dir);
+      return FALSE;
+    }
+  g_free (dir);
+
+  memset (&header, 0, sizeof (header));
+  header.magic = HD_BACKGROUND_CACHE_MAGIC;
+  header.version = HD_BACKGROUND_CACHE_VERSION;
+  header.source_mtime = source_stat->st_mtime;
+  header.source_size = source_stat->st_size;
+  header.width = width;
+  header.height = height;
+  header.portrait = portrait != FALSE;
+
+  /* Write a temporary file and rename it over the old one, so that
+   * nobody can ever map a half-written cache. */
+  fname = cache_file_name (id, portrait);
+  tmpname = g_strconcat (fname, ".XXXXXX", NULL);
+  if ((fd = g_mkstemp (tmpname)) < 0)
+    goto out;
+
+  if (write (fd, &header, sizeof (header)) == sizeof (header)
+      && write (fd, pixels, (gsize)width * height * 2)
+         == (gssize)width * height * 2)
+    ok = TRUE;
+  if (close (fd) != 0)
+    ok = FALSE;
+
+  if (ok && g_rename (tmpname, fname) != 0)
+    ok = FALSE;
+  if (!ok)
+    {
+      g_warning ("%s: couldn't write %s: %s", __FUNCTION__,
+                 fname, g_strerror (errno));
+      g_unlink (tmpname);
+    }
+
+out:
+  g_free (tmpname);
+  g_free (fname);
+  return ok;
+}
+
+void
+hd_background_cache_invalidate (guint id, gboolean portrait)
+{
+  gchar *fname = cache_file_name (id, portrait);
+
+  if (g_unlink (fname) != 0 && errno != ENOENT)
+    g_warning ("%s: couldn't remove %s: %s", __FUNCTION__,
+               fname, g_strerror (errno));
+  g_free (fname);
+}
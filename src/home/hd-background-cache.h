@@ -0,0 +1,69 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_BACKGROUND_CACHE_H__
+#define __HD_BACKGROUND_CACHE_H__
+
+#include <glib.h>
+#include <sys/stat.h>
+
+G_BEGIN_DECLS
+
+/* On-disk cache of wallpapers already dithered to RGB565, so that we
+ * don't need to decode the PNGs in ~/.backgrounds on every startup.
+ * The cached pixels are mmap()ed and can be given to clutter as they are.
+ * Entries are only valid while their source file has the same size and
+ * modification time. */
+
+typedef struct _HdBackgroundCacheImage HdBackgroundCacheImage;
+
+struct _HdBackgroundCacheImage
+{
+  const guint16 *pixels;
+  gint           width, height;
+
+  /*< private >*/
+  gpointer       map;
+  gsize          map_size;
+};
+
+/* Returns the cached image of view @id or NULL if there's none or it
+ * doesn't belong to the source file @source_stat is of.  Release it with
+ * hd_background_cache_image_free(). */
+HdBackgroundCacheImage *hd_background_cache_load (const struct stat *source_stat,
+                                                  guint id,
+                                                  gboolean portrait);
+void hd_background_cache_image_free (HdBackgroundCacheImage *image);
+
+/* Stores the dithered @pixels of the source file @source_stat is of.
+ * Take @source_stat before decoding the source, so that a change during
+ * decoding can't make stale pixels look valid.  Safe to call from any
+ * thread. */
+gboolean hd_background_cache_save (const struct stat *source_stat,
+                                   guint id,
+                                   gboolean portrait,
+                                   const guint16 *pixels,
+                                   gint width, gint height);
+
+/* Removes the cached image of view @id, eg. because its source changed. */
+void hd_background_cache_invalidate (guint id, gboolean portrait);
+
+G_END_DECLS
+
+#endif
@@ -29,15 +29,35 @@
 
 #include "hd-clutter-cache.h"
 #include "hd-render-manager.h"
+#include "hd-transition.h"
+
+/* One cached texture.  @link is our node in the LRU queue, so that moving
+ * an entry to the front on a hit doesn't need a list walk. */
+typedef struct
+{
+  gchar        *path;
+  ClutterActor *texture;
+  gsize         bytes;
+  GList        *link;
+} HdClutterCacheEntry;
 
 struct _HdClutterCachePrivate
 {
+  /* resolved path -> HdClutterCacheEntry, owns the entries */
+  GHashTable *index;
+  /* Most recently used entries first. */
+  GQueue      lru;
 
+  gsize       bytes, budget;
+  guint       hits, misses, evictions;
 };
 
 /* ------------------------------------------------------------------------- */
 
-G_DEFINE_TYPE (HdClutterCache, hd_clutter_cache, CLUTTER_TYPE_GROUP);
+G_DEFINE_TYPE_WITH_CODE (HdClutterCache,
+                         hd_clutter_cache,
+                         CLUTTER_TYPE_GROUP,
+                         G_ADD_PRIVATE (HdClutterCache));
 #define HD_CLUTTER_CACHE_GET_PRIVATE(obj) \
                 (hd_clutter_cache_get_instance_private (obj))
 
@@ -48,14 +68,32 @@ static HdClutterCache *the_clutter_cache = 0;
 #define HD_CLUTTER_CACHE_THEME_PATH "/etc/hildon/theme/images/"
 #define HD_CLUTTER_CACHE_FALLBACK_THEME_PATH "/usr/share/themes/default/images/"
 
+/* Default size of the cache in kilobytes, can be overridden with
+ * [clutter_cache] budget_kb in transitions.ini. */
+#define HD_CLUTTER_CACHE_DEFAULT_BUDGET_KB 4096
+
 /* ------------------------------------------------------------------------- */
 
+static void
+hd_clutter_cache_entry_free (HdClutterCacheEntry *entry)
+{
+  g_free (entry->path);
+  g_slice_free (HdClutterCacheEntry, entry);
+}
+
 static void
 hd_clutter_cache_init (HdClutterCache *cache)
 {
   ClutterStage *stage;
- /* HdClutterCachePrivate *priv = cache->priv =
-    HD_CLUTTER_CACHE_GET_PRIVATE(cache);*/
+  HdClutterCachePrivate *priv = cache->priv =
+    HD_CLUTTER_CACHE_GET_PRIVATE(cache);
+
+  priv->index = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                     (GDestroyNotify)hd_clutter_cache_entry_free);
+  g_queue_init (&priv->lru);
+  priv->budget = 1024 * (gsize)MAX (0,
+        hd_transition_get_int ("clutter_cache", "budget_kb",
+                               HD_CLUTTER_CACHE_DEFAULT_BUDGET_KB));
 
   clutter_actor_hide(CLUTTER_ACTOR(cache));
   clutter_actor_set_name(CLUTTER_ACTOR(cache), "HdClutterCache");
@@ -71,6 +109,16 @@ hd_clutter_cache_init (HdClutterCache *cache)
 static void
 hd_clutter_cache_dispose (GObject *obj)
 {
+  HdClutterCachePrivate *priv = HD_CLUTTER_CACHE (obj)->priv;
+
+  if (priv->index)
+    {
+      g_queue_clear (&priv->lru);
+      g_hash_table_destroy (priv->index);
+      priv->index = NULL;
+      priv->bytes = 0;
+    }
+
   G_OBJECT_CLASS (hd_clutter_cache_parent_class)->dispose (obj);
 }
 
@@ -90,12 +138,97 @@ static HdClutterCache *hd_get_clutter_cache()
   return the_clutter_cache;
 }
 
+static gsize
+hd_clutter_cache_texture_bytes (ClutterActor *texture)
+{
+  gint width, height;
+
+  clutter_texture_get_base_size (CLUTTER_TEXTURE (texture), &width, &height);
+  return (gsize)width * height * 4;
+}
+
+/* Drop least recently used textures until we're within budget.  Only
+ * textures that nobody references but our group (ie. no clone or
+ * sub-texture of it is alive) can go; the rest is skipped.  The most
+ * recent one is always kept, since it's what we're about to return. */
+static void
+hd_clutter_cache_evict (HdClutterCache *cache)
+{
+  HdClutterCachePrivate *priv = cache->priv;
+  GList *li, *prev;
+
+  for (li = priv->lru.tail; li && li != priv->lru.head
+       && priv->bytes > priv->budget; li = prev)
+    {
+      HdClutterCacheEntry *entry = li->data;
+
+      prev = li->prev;
+      if (G_OBJECT (entry->texture)->ref_count > 1)
+        continue;
+
+      g_debug ("%s: evicting %s (%" G_GSIZE_FORMAT " bytes)", __FUNCTION__,
+               entry->path, entry->bytes);
+      priv->bytes -= entry->bytes;
+      priv->evictions++;
+      g_queue_delete_link (&priv->lru, li);
+      clutter_container_remove_actor (CLUTTER_CONTAINER (cache),
+                                      entry->texture);
+      g_hash_table_remove (priv->index, entry->path);
+    }
+}
+
+static ClutterActor *
+hd_clutter_cache_lookup (HdClutterCache *cache, const char *path)
+{
+  HdClutterCachePrivate *priv = cache->priv;
+  HdClutterCacheEntry *entry;
+
+  if (!(entry = g_hash_table_lookup (priv->index, path)))
+    return NULL;
+
+  /* Move it to the front of the LRU. */
+  if (entry->link != priv->lru.head)
+    {
+      g_queue_unlink (&priv->lru, entry->link);
+      g_queue_push_head_link (&priv->lru, entry->link);
+    }
+  priv->hits++;
+  return entry->texture;
+}
+
+static ClutterActor *
+hd_clutter_cache_load (HdClutterCache *cache, const char *path)
+{
+  HdClutterCachePrivate *priv = cache->priv;
+  HdClutterCacheEntry *entry;
+  ClutterActor *texture;
+
+  if (!(texture = clutter_texture_new_from_file(path, 0)))
+    return NULL;
+
+  clutter_actor_set_name(texture, path);
+  clutter_container_add_actor(CLUTTER_CONTAINER(cache), texture);
+
+  entry = g_slice_new (HdClutterCacheEntry);
+  entry->path = g_strdup (path);
+  entry->texture = texture;
+  entry->bytes = hd_clutter_cache_texture_bytes (texture);
+  g_queue_push_head (&priv->lru, entry);
+  entry->link = priv->lru.head;
+  g_hash_table_insert (priv->index, entry->path, entry);
+
+  priv->bytes += entry->bytes;
+  if (priv->bytes > priv->budget)
+    hd_clutter_cache_evict (cache);
+
+  return texture;
+}
+
 static ClutterActor *
 hd_clutter_cache_get_real_texture(const char *filename, gboolean from_theme)
 {
   HdClutterCache *cache = hd_get_clutter_cache();
-  gint i;
-  ClutterActor *texture, *actor;
+  ClutterActor *texture;
   const char *filename_real = filename;
   char *filename_alloc = 0;
 
@@ -113,62 +246,34 @@ hd_clutter_cache_get_real_texture(const char *filename, gboolean from_theme)
 	      HD_CLUTTER_CACHE_FALLBACK_THEME_PATH :
 	      HD_CLUTTER_CACHE_THEME_PATH;
 
-      filename_alloc = g_malloc(strlen(theme_path) + strlen(filename) + 1);
-      if (!filename_alloc)
-        return 0;
-      strcpy(filename_alloc, theme_path);
-      strcat(filename_alloc, filename);
+      filename_alloc = g_strconcat(theme_path, filename, NULL);
       filename_real = filename_alloc;
     }
 
-  for (i = 0, actor = clutter_group_get_nth_child(CLUTTER_GROUP(cache), 0);
-       actor; actor = clutter_group_get_nth_child(CLUTTER_GROUP(cache), ++i))
-    {
-      const char *name = clutter_actor_get_name(actor);
-      if (name && g_str_equal(name, filename_real))
-        {
-          if (filename_alloc)
-	    g_free(filename_alloc);
-          return actor;
-        }
-    }
-
-  texture = clutter_texture_new_from_file(filename_real, 0);
-  if (!texture)
+  if ((texture = hd_clutter_cache_lookup(cache, filename_real)))
     {
-      if (filename_alloc)
-        g_free(filename_alloc);
-
-      /*
-       * If this was the fallback theme path we can not anything else,
-       * othwerwise we still can try to load from the fallback path.
-       */
-      if (mb_wm_theme_is_broken())
-        return 0;
-
-      filename_alloc = g_malloc (strlen(HD_CLUTTER_CACHE_FALLBACK_THEME_PATH) +
-                                 strlen(filename) + 1);
-      if (!filename_alloc)
-        return 0;
-
-      strcpy(filename_alloc, HD_CLUTTER_CACHE_FALLBACK_THEME_PATH);
-      strcat(filename_alloc, filename);
-      filename_real = filename_alloc;
-
-      texture = clutter_texture_new_from_file(filename_real, 0);
-      if (!texture)
-        {
-          if (filename_alloc)
-            g_free(filename_alloc);
-          return 0;
-        }
+      g_free(filename_alloc);
+      return texture;
     }
 
-  clutter_actor_set_name(texture, filename_real);
-  clutter_container_add_actor(CLUTTER_CONTAINER(cache), texture);
+  cache->priv->misses++;
+  texture = hd_clutter_cache_load(cache, filename_real);
+  g_free(filename_alloc);
+  if (texture)
+    return texture;
+
+  /*
+   * If this was the fallback theme path we can not anything else,
+   * othwerwise we still can try to load from the fallback path.
+   */
+  if (mb_wm_theme_is_broken())
+    return 0;
 
-  if (filename_alloc)
-    g_free(filename_alloc);
+  filename_alloc = g_strconcat(HD_CLUTTER_CACHE_FALLBACK_THEME_PATH,
+                               filename, NULL);
+  if (!(texture = hd_clutter_cache_lookup(cache, filename_alloc)))
+    texture = hd_clutter_cache_load(cache, filename_alloc);
+  g_free(filename_alloc);
 
   return texture;
 }
@@ -374,28 +479,38 @@ hd_clutter_cache_get_sub_texture_for_area(const char *filename,
   return CLUTTER_ACTOR(group);
 }
 
-static void
-reload_texture_cb (ClutterActor *child,
-                   gpointer      data)
-{
-  gchar *filename;
-  if (!CLUTTER_IS_TEXTURE(child))
+void hd_clutter_cache_theme_changed(void) {
+  HdClutterCachePrivate *priv;
+  GList *li;
+
+  /* If there is no clutter cache yet then we definitely
+   * don't care about reloading stuff */
+  if (!the_clutter_cache)
     return;
 
-  /* filename is set in the child's name. clutter_texture_set_from_file sets
-   * the anme to this string, but the string is from the actor in the first
-   * place and it just breaks... */
-  filename = g_strdup(clutter_actor_get_name(child));
-  clutter_texture_set_from_file(CLUTTER_TEXTURE(child), filename, 0);
-  g_free(filename);
+  /* The new images may have different sizes, so recount the bytes. */
+  priv = the_clutter_cache->priv;
+  for (li = priv->lru.head; li; li = li->next)
+    {
+      HdClutterCacheEntry *entry = li->data;
+
+      clutter_texture_set_from_file(CLUTTER_TEXTURE(entry->texture),
+                                    entry->path, 0);
+      priv->bytes -= entry->bytes;
+      entry->bytes = hd_clutter_cache_texture_bytes (entry->texture);
+      priv->bytes += entry->bytes;
+    }
 }
 
-void hd_clutter_cache_theme_changed(void) {
-  /* If there is no clutter cache yet then we definitely
-   * don't care about reloading stuff */
+void hd_clutter_cache_dump_debug_info(void) {
+  HdClutterCachePrivate *priv;
+
   if (!the_clutter_cache)
     return;
 
-  clutter_container_foreach (CLUTTER_CONTAINER(the_clutter_cache),
-                             reload_texture_cb, 0);
+  priv = the_clutter_cache->priv;
+  g_debug ("clutter cache: %u textures, %" G_GSIZE_FORMAT "/%"
+           G_GSIZE_FORMAT " bytes, %u hits, %u misses, %u evictions",
+           g_hash_table_size (priv->index), priv->bytes, priv->budget,
+           priv->hits, priv->misses, priv->evictions);
 }
@@ -55,6 +55,11 @@ GType hd_clutter_cache_get_type (void) G_GNUC_CONST;
 void
 hd_clutter_cache_theme_changed(void);
 
+/* Logs the number of cached textures, their size and the
+ * hit/miss/eviction counters. */
+void
+hd_clutter_cache_dump_debug_info(void);
+
 /* Create a clutter clone texture from a texture in our cache.
  * This is created specially and is not owned by the cache.
  * If from_theme is true, the filename will be appended to the current
@@ -29,6 +29,7 @@
 #include "hd-comp-mgr.h"
 #include "hd-render-manager.h"
 #include "hd-transition.h"
+#include "hd-background-cache.h"
 
 #include <glib/gstdio.h>
 
@@ -148,6 +149,9 @@ backgrounds_dir_changed (GFileMonitor        *monitor,
 
           id = atoi (basename + 11) - 1; /* id is from 0..MAX_HOME_VIEWS - 1 */
 
+          if (id < MAX_HOME_VIEWS)
+            hd_background_cache_invalidate (id, FALSE);
+
           if (id < MAX_HOME_VIEWS && priv->active_views[id])
             {
               g_debug ("%s. Reload background %s for view %u.", __FUNCTION__,
@@ -163,6 +167,9 @@ backgrounds_dir_changed (GFileMonitor        *monitor,
 
           id = atoi (basename + 20) - 1; /* id is from 0..MAX_HOME_VIEWS - 1 */
 
+          if (id < MAX_HOME_VIEWS)
+            hd_background_cache_invalidate (id, TRUE);
+
           if (id < MAX_HOME_VIEWS && priv->active_views[id])
             {
               g_debug ("%s. Reload background %s for view %u.", __FUNCTION__,
@@ -35,6 +35,8 @@
 #include "hd-render-manager.h"
 #include "hd-clutter-cache.h"
 #include "hd-transition.h"
+#include "hd-dither.h"
+#include "hd-background-cache.h"
 
 #include "hildon-desktop.h"
 #include "../tidy/tidy-sub-texture.h"
@@ -65,8 +67,6 @@
 /* Maximal pixel movement for a tap (before it is a move) */
 #define MAX_TAP_DISTANCE 20
 
-#define HD_HOME_VIEW_PARALLAX_AMOUNT (hd_transition_get_double("home", "parallax", 1.3))
-
 enum
 {
   PROP_COMP_MGR = 1,
@@ -76,6 +76,8 @@ enum
   PROP_CONTAINER
 };
 
+typedef struct _HdHomeViewBackgroundLoad HdHomeViewBackgroundLoad;
+
 struct _HdHomeViewPrivate
 {
   MBWMCompMgrClutter       *comp_mgr;
@@ -111,7 +113,8 @@ struct _HdHomeViewPrivate
 
   guint                     id;
 
-  guint load_background_source;
+  /* The background being decoded in a worker thread, if any. */
+  HdHomeViewBackgroundLoad *active_load;
 
   GConfClient *gconf_client;
 
@@ -150,6 +153,8 @@ hd_home_view_allocation_changed (HdHomeView    *home_view,
 
 static void snap_widget_to_grid (ClutterActor *widget);
 
+static void background_load_cancel (HdHomeViewBackgroundLoad *load);
+
 typedef struct _HdHomeViewAppletData HdHomeViewAppletData;
 
 struct _HdHomeViewAppletData
@@ -437,9 +442,9 @@ hd_home_view_dispose (GObject *object)
   HdHomeView         *self           = HD_HOME_VIEW (object);
   HdHomeViewPrivate  *priv	     = self->priv;
 
-  /* Remove idle/timeout handlers */
-  if (priv->load_background_source)
-    priv->load_background_source = (g_source_remove (priv->load_background_source), 0);
+  /* Forget the pending background, the worker will clean up after itself */
+  if (priv->active_load)
+    priv->active_load = (background_load_cancel (priv->active_load), NULL);
 
   if (priv->gconf_client)
     priv->gconf_client = (g_object_unref (priv->gconf_client), NULL);
@@ -556,180 +561,224 @@ set_background_common (HdHomeView *hview, ClutterActor *new_bg)
     
 }
 
-static gboolean
-load_background_idle (gpointer data)
+/* A background image decoded and dithered by a worker thread.
+ * The result is handed back to the main thread in an idle callback,
+ * which uploads it unless the load has been cancelled in the meantime
+ * (because a newer request for the same view came in). */
+struct _HdHomeViewBackgroundLoad
 {
-  HdHomeView *self = HD_HOME_VIEW (data);
-  HdHomeViewPrivate *priv = self->priv;
-  gchar *cached_background_image_file;
-  ClutterActor *new_bg = 0;
-  GError *error = NULL;
-  GError *error_portrait = NULL;
-  int i;
-  int max_value;
+  HdHomeView *view;
+  guint       id;
+  gint        n_images;
+  gint        priority;
 
-  if (g_source_is_destroyed (g_main_current_source ()))
-    return FALSE;
+  struct
+  {
+    /* Either the dithered RGB565 @pixels, the same @cached from an earlier
+     * run or a @pvr file to be loaded by clutter in the main thread.
+     * If all are NULL, @error says why. */
+    gushort  *pixels;
+    HdBackgroundCacheImage *cached;
+    gint      width, height;
+    gchar    *pvr;
+    gchar    *file;
+    GError   *error;
+  } images[2];
+
+  /* accessed by both threads */
+  volatile gboolean cancelled;
+};
 
-  if(hd_home_is_portrait_wallpaper_enabled (priv->home))
-    max_value = 2;
-  else
-    max_value = 1;
+static void
+background_load_free (HdHomeViewBackgroundLoad *load)
+{
+  gint i;
 
-  for(i = 0; i < max_value; i++){
-    if(!i)
-      {
-        cached_background_image_file = g_strdup_printf (CACHED_BACKGROUND_IMAGE_FILE_PNG,
-                                                        g_get_home_dir (),
-                                                        priv->id + 1);
-        priv->is_portrait = FALSE;
-      }
-    else
-      {
-        cached_background_image_file = g_strdup_printf (CACHED_BACKGROUND_IMAGE_FILE_PNG_PORTRAIT,
-                                                        g_get_home_dir (),
-                                                        priv->id + 1);
-        priv->is_portrait = TRUE;
-      }
+  for (i = 0; i < G_N_ELEMENTS (load->images); i++)
+    {
+      g_free (load->images[i].pixels);
+      if (load->images[i].cached)
+        hd_background_cache_image_free (load->images[i].cached);
+      g_free (load->images[i].pvr);
+      g_free (load->images[i].file);
+      if (load->images[i].error)
+        g_error_free (load->images[i].error);
+    }
+  g_object_unref (load->view);
+  g_free (load);
+}
 
-    if (!g_file_test (cached_background_image_file,
-                      G_FILE_TEST_EXISTS))
-      {
-        g_free (cached_background_image_file);
-        if(!i) 
-          {
-            cached_background_image_file = g_strdup_printf (CACHED_BACKGROUND_IMAGE_FILE_PVR,
-                                                            g_get_home_dir (),
-                                                            priv->id + 1);
-
-            new_bg = clutter_texture_new_from_file (cached_background_image_file,
-                                                      &error);
-          }
-        else 
-          {
-            cached_background_image_file = g_strdup_printf (CACHED_BACKGROUND_IMAGE_FILE_PVR_PORTRAIT,
-                                                            g_get_home_dir (),
-                                                            priv->id + 1);
-
-            new_bg = clutter_texture_new_from_file (cached_background_image_file,
-                                                    &error_portrait);
-          }
-      }
-    else
-      {
-        GdkPixbuf        *pixbuf;
-
-        /* Load image directly. We actually want to dither it on the fly to
-         * 16 bit, and clutter doesn't do this for us so we implement a very
-         * quick dither here. */
-        if(!i) 
-          pixbuf = gdk_pixbuf_new_from_file (cached_background_image_file, &error);
-        else
-          pixbuf = gdk_pixbuf_new_from_file (cached_background_image_file, &error_portrait);
-          
-        if (pixbuf != NULL)
-          {
-            gint              width;
-            gint              height;
-            gint              rowstride;
-            gint              n_channels;
-            guchar           *pixels;
-            gushort          *out_pixels, *out;
-            guint             lfsr = 1;
-            gint x,y;
-
-            /* Get pixbuf properties */
-            width           = gdk_pixbuf_get_width (pixbuf);
-            height          = gdk_pixbuf_get_height (pixbuf);
-            rowstride       = gdk_pixbuf_get_rowstride (pixbuf);
-            n_channels      = gdk_pixbuf_get_n_channels (pixbuf);
-            pixels          = gdk_pixbuf_get_pixels (pixbuf);
-
-            if (gdk_pixbuf_get_bits_per_sample (pixbuf)==8 &&
-                (n_channels==3 || n_channels==4))
-              {
-                out_pixels = g_malloc(width*height*2);
-                out = out_pixels;
-                for (y=0;y<height;y++) {
-                  for (x=0;x<width;x++) {
-                    /* http://en.wikipedia.org/wiki/Linear_feedback_shift_register */
-                    lfsr = (lfsr >> 1) ^ (unsigned int)((0 - (lfsr & 1u)) & 0xd0000001u);
-  
-                    /* dither 565 - by adding random noise and then truncating
-                     * (r>>8)*0xFF makes sure our bottom 8 bits are 0xFF if we
-                     * overflow.
-                     */
-                    guint r,g,b;
-                    r = pixels[0] + (lfsr&7);
-                    r |= (r>>8)*0xFF;
-                    g = pixels[1] + ((lfsr>>3)&3);
-                    g |= (g>>8)*0xFF;
-                    b = pixels[2] + ((lfsr>>5)&7);
-                    b |= (b>>8)*0xFF;
-                    *out = ((r<<8)&0xF800) |
-                           ((g<<3)&0x07E0) |
-                           ((b>>3)&0x001F);
-
-                    pixels += n_channels;
-                    out++;
-                  }
-                  pixels += rowstride - width*n_channels;
-                }
-                new_bg = clutter_texture_new();
-
-                if(!i) 
-                  {
-                    clutter_texture_set_from_rgb_data(CLUTTER_TEXTURE(new_bg),
-                          (guchar*)out_pixels, FALSE,
-                          width, height, width*2, 2, CLUTTER_TEXTURE_FLAG_16_BIT, &error);
-                  }
-                else 
-                  {
-                    clutter_texture_set_from_rgb_data(CLUTTER_TEXTURE(new_bg),
-                          (guchar*)out_pixels, FALSE,
-                          width, height, width*2, 2, CLUTTER_TEXTURE_FLAG_16_BIT, &error_portrait);
-                  }
-
-                g_free(out_pixels);
-              }
-            g_object_unref (pixbuf);
-          }
-      }
+static void
+background_load_cancel (HdHomeViewBackgroundLoad *load)
+{
+  /* Freed in background_load_done_idle() by the main thread. */
+  load->cancelled = TRUE;
+}
 
-    if(!i) 
-      {
-        if (!new_bg)
-          {
-            g_warning ("Error loading cached background image %s. %s",
-                       cached_background_image_file,
-                       error?error->message:"");
-            if (error)
-              g_error_free (error);
-          }
-      }
-    else
-      {
-        if (!new_bg)
-          {
-            g_warning ("Error loading cached portrait background image %s. %s",
-                       cached_background_image_file,
-                       error_portrait?error_portrait->message:"");
-            if (error_portrait)
-              g_error_free (error_portrait);
-          }
-      }
-  
-    g_free (cached_background_image_file);
+/* Rows to dither between checks for cancellation. */
+#define DITHER_BAND_HEIGHT 32
 
-    set_background_common (self, new_bg);  
-    priv->load_background_source = 0;
-  }
+/* Dither 8-bit RGB(A) @pixbuf to RGB565. */
+static gushort *
+dither_pixbuf (GdkPixbuf *pixbuf, const volatile gboolean *cancelled)
+{
+  gint              width;
+  gint              height;
+  gint              rowstride;
+  gint              n_channels;
+  guchar           *pixels;
+  gushort          *out_pixels;
+  gint y;
+
+  /* Get pixbuf properties */
+  width           = gdk_pixbuf_get_width (pixbuf);
+  height          = gdk_pixbuf_get_height (pixbuf);
+  rowstride       = gdk_pixbuf_get_rowstride (pixbuf);
+  n_channels      = gdk_pixbuf_get_n_channels (pixbuf);
+  pixels          = gdk_pixbuf_get_pixels (pixbuf);
+
+  if (gdk_pixbuf_get_bits_per_sample (pixbuf)!=8 ||
+      (n_channels!=3 && n_channels!=4))
+    return NULL;
+
+  out_pixels = g_malloc(width*height*2);
+  for (y = 0; y < height; y += DITHER_BAND_HEIGHT)
+    {
+      /* Don't waste time on a background nobody will see. */
+      if (*cancelled)
+        {
+          g_free (out_pixels);
+          return NULL;
+        }
+
+      hd_dither_rgb565_full (HD_DITHER_BEST,
+                             pixels + y * rowstride, rowstride, n_channels,
+                             out_pixels + y * width, width * 2,
+                             width, MIN (DITHER_BAND_HEIGHT, height - y), y);
+    }
+
+  return out_pixels;
+}
+
+static gboolean
+background_load_done_idle (gpointer data)
+{
+  HdHomeViewBackgroundLoad *load = data;
+  HdHomeView *self = load->view;
+  HdHomeViewPrivate *priv = self->priv;
+  gint i;
+
+  if (load->cancelled || priv->active_load != load)
+    goto out;
+  priv->active_load = NULL;
+
+  for (i = 0; i < load->n_images; i++)
+    {
+      ClutterActor *new_bg = NULL;
+      GError *error = load->images[i].error;
+
+      load->images[i].error = NULL;
+      priv->is_portrait = i > 0;
+      if (load->images[i].cached)
+        {
+          /* Straight from the mapped cache file. */
+          new_bg = clutter_texture_new();
+          clutter_texture_set_from_rgb_data(CLUTTER_TEXTURE(new_bg),
+                (const guchar*)load->images[i].cached->pixels, FALSE,
+                load->images[i].cached->width, load->images[i].cached->height,
+                load->images[i].cached->width*2, 2,
+                CLUTTER_TEXTURE_FLAG_16_BIT, &error);
+        }
+      else if (load->images[i].pixels)
+        {
+          /* We actually want to dither it on the fly to 16 bit, and clutter
+           * doesn't do this for us, that's what the worker thread did. */
+          new_bg = clutter_texture_new();
+          clutter_texture_set_from_rgb_data(CLUTTER_TEXTURE(new_bg),
+                (guchar*)load->images[i].pixels, FALSE,
+                load->images[i].width, load->images[i].height,
+                load->images[i].width*2, 2, CLUTTER_TEXTURE_FLAG_16_BIT,
+                &error);
+        }
+      else if (load->images[i].pvr)
+        /* PVR textures are uploaded as they are. */
+        new_bg = clutter_texture_new_from_file (load->images[i].pvr, &error);
+
+      if (!new_bg)
+        g_warning ("Error loading cached %sbackground image %s. %s",
+                   i ? "portrait " : "", load->images[i].file,
+                   error?error->message:"");
+      if (error)
+        g_error_free (error);
+
+      set_background_common (self, new_bg);
+    }
 
   priv->is_portrait = FALSE;
 
+out:
+  background_load_free (load);
   return FALSE;
 }
 
+/* Decodes and dithers the PNG backgrounds of a view, or finds out which
+ * PVR file to load if there is no PNG.  Dithered backgrounds are cached
+ * on disk, and taken from there if the PNG hasn't changed since.
+ * Runs in a separate thread. */
+static gpointer
+background_load_thread_func (gpointer data)
+{
+  HdHomeViewBackgroundLoad *load = data;
+  gint i;
+
+  for (i = 0; i < load->n_images && !load->cancelled; i++)
+    {
+      GdkPixbuf *pixbuf;
+      struct stat source_stat;
+
+      load->images[i].file = g_strdup_printf (i
+                              ? CACHED_BACKGROUND_IMAGE_FILE_PNG_PORTRAIT
+                              : CACHED_BACKGROUND_IMAGE_FILE_PNG,
+                              g_get_home_dir (), load->id + 1);
+      if (g_stat (load->images[i].file, &source_stat) != 0)
+        {
+          g_free (load->images[i].file);
+          load->images[i].file = g_strdup_printf (i
+                              ? CACHED_BACKGROUND_IMAGE_FILE_PVR_PORTRAIT
+                              : CACHED_BACKGROUND_IMAGE_FILE_PVR,
+                              g_get_home_dir (), load->id + 1);
+          load->images[i].pvr = g_strdup (load->images[i].file);
+          continue;
+        }
+
+      load->images[i].cached = hd_background_cache_load (&source_stat,
+                                                         load->id, i > 0);
+      if (load->images[i].cached)
+        continue;
+
+      /* Load image directly and dither it to 16 bit here. */
+      pixbuf = gdk_pixbuf_new_from_file (load->images[i].file,
+                                         &load->images[i].error);
+      if (pixbuf != NULL)
+        {
+          load->images[i].width  = gdk_pixbuf_get_width (pixbuf);
+          load->images[i].height = gdk_pixbuf_get_height (pixbuf);
+          load->images[i].pixels = dither_pixbuf (pixbuf, &load->cancelled);
+          g_object_unref (pixbuf);
+        }
+
+      if (load->images[i].pixels && !load->cancelled)
+        hd_background_cache_save (&source_stat, load->id, i > 0,
+                                  load->images[i].pixels,
+                                  load->images[i].width,
+                                  load->images[i].height);
+    }
+
+  clutter_threads_add_idle_full (load->priority, background_load_done_idle,
+                                 load, NULL);
+  return NULL;
+}
+
 /* Use Window as background, mostly copied from above.
  * 1) client != NULL means setting live-bg for this view.
  * 2) client == NULL means unsetting the live-bg for this view. */
@@ -742,12 +791,12 @@ hd_home_view_set_live_bg (HdHomeView *view,
   ClutterActor *new_bg = 0;
   MBWMCompMgrClutterClient *cclient;
 
-  if (priv->load_background_source && !above_applets)
+  if (priv->active_load && !above_applets)
     {
       /* cancel ongoing background loading job unless we have transparent
        * live background */
-      g_source_remove (priv->load_background_source);
-      priv->load_background_source = 0;
+      background_load_cancel (priv->active_load);
+      priv->active_load = NULL;
     }
 
   if (client) 
@@ -798,19 +847,33 @@ void
 hd_home_view_load_background (HdHomeView *view)
 {
   HdHomeViewPrivate *priv;
-  gint priority = G_PRIORITY_DEFAULT_IDLE;
+  HdHomeViewBackgroundLoad *load;
   g_return_if_fail (HD_IS_HOME_VIEW (view));
 
   priv = view->priv;
 
+  /* The file monitor can tell us about the same wallpaper several times,
+   * only the latest request is worth finishing. */
+  if (priv->active_load)
+    background_load_cancel (priv->active_load);
+
+  load = g_new0 (HdHomeViewBackgroundLoad, 1);
+  load->view = g_object_ref (view);
+  load->id = priv->id;
+  load->n_images = hd_home_is_portrait_wallpaper_enabled (priv->home) ? 2 : 1;
+
   /* Check current home view and increase priority if this is the current one */
   if (hd_home_view_container_get_current_view (priv->view_container) == priv->id)
-    priority = G_PRIORITY_HIGH_IDLE;
+    load->priority = G_PRIORITY_HIGH_IDLE;
+  else
+    load->priority = G_PRIORITY_DEFAULT_IDLE;
 
-  priv->load_background_source = g_idle_add_full (priority,
-                                                  load_background_idle,
-                                                  view,
-                                                  NULL);
+  priv->active_load = load;
+  if (hd_disable_threads ())
+    background_load_thread_func (load);
+  else
+    g_thread_unref (g_thread_new ("hd-background", background_load_thread_func,
+                                  load));
 }
 
 static void
@@ -1800,8 +1863,15 @@ hd_home_view_allocation_changed (HdHomeView    *view,
                                GParamSpec *pspec,
                                gpointer    user_data)
 {
+  static HdTransitionParam *parallax;
   HdHomeViewPrivate *priv = view->priv;
   ClutterGeometry geom;
+  gdouble amount;
+
+  /* Called every frame of a pan. */
+  if (G_UNLIKELY (!parallax))
+    parallax = hd_transition_param_lookup ("home", "parallax");
+  amount = hd_transition_param_get_double (parallax, 1.3);
 
   /* We need to update the position of the applets container,
    * as it is not a child of ours. Rather than just setting
@@ -1817,13 +1887,13 @@ hd_home_view_allocation_changed (HdHomeView    *view,
     {
       if (geom.y > -HD_COMP_MGR_LANDSCAPE_WIDTH && geom.y < 0)
         {
-          geom.y = (int)(geom.y * HD_HOME_VIEW_PARALLAX_AMOUNT);
+          geom.y = (int)(geom.y * amount);
           if (geom.y < -HD_COMP_MGR_LANDSCAPE_WIDTH)
             geom.y = -HD_COMP_MGR_LANDSCAPE_WIDTH;
         }
       if (geom.y < HD_COMP_MGR_LANDSCAPE_WIDTH && geom.y > 0)
         {
-          geom.y = (int)(geom.y * HD_HOME_VIEW_PARALLAX_AMOUNT);
+          geom.y = (int)(geom.y * amount);
           if (geom.y > HD_COMP_MGR_LANDSCAPE_WIDTH)
             geom.y = HD_COMP_MGR_LANDSCAPE_WIDTH;
         }
@@ -1832,13 +1902,13 @@ hd_home_view_allocation_changed (HdHomeView    *view,
     {
       if (geom.x > -HD_COMP_MGR_LANDSCAPE_WIDTH && geom.x < 0)
         {
-          geom.x = (int)(geom.x * HD_HOME_VIEW_PARALLAX_AMOUNT);
+          geom.x = (int)(geom.x * amount);
           if (geom.x < -HD_COMP_MGR_LANDSCAPE_WIDTH)
             geom.x = -HD_COMP_MGR_LANDSCAPE_WIDTH;
         }
       if (geom.x < HD_COMP_MGR_LANDSCAPE_WIDTH && geom.x > 0)
         {
-          geom.x = (int)(geom.x * HD_HOME_VIEW_PARALLAX_AMOUNT);
+          geom.x = (int)(geom.x * amount);
           if (geom.x > HD_COMP_MGR_LANDSCAPE_WIDTH)
             geom.x = HD_COMP_MGR_LANDSCAPE_WIDTH;
         }
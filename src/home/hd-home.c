@@ -41,6 +41,7 @@
 #include "hd-wm.h"
 #include "hd-launcher-app.h"
 #include "hd-dbus.h"
+#include "hd-frame-stats.h"
 #include "hd-title-bar.h"
 
 #include <clutter/clutter.h>
@@ -2817,3 +2818,23 @@ hd_home_is_desktop_in_portrait_mode (void)
 	return STATE_IS_PORTRAIT (hd_render_manager_get_state ());
 }
 
+gchar *
+hd_home_get_frame_stats (HdHome *home)
+{
+  return hd_frame_stats_report ();
+}
+
+gboolean
+hd_home_reset_frame_stats (HdHome *home, GError **error)
+{
+  hd_frame_stats_reset ();
+  return TRUE;
+}
+
+gboolean
+hd_home_set_frame_stats_overlay (HdHome *home, gboolean show, GError **error)
+{
+  hd_frame_stats_set_overlay (show);
+  return TRUE;
+}
+
@@ -113,6 +113,12 @@ gboolean hd_home_is_portrait_wallpaper_enabled (HdHome *home);
 
 gboolean hd_home_is_desktop_in_portrait_mode (void);
 
+/* D-Bus front of hd-frame-stats. */
+gchar *hd_home_get_frame_stats (HdHome *home);
+gboolean hd_home_reset_frame_stats (HdHome *home, GError **error);
+gboolean hd_home_set_frame_stats_overlay (HdHome *home, gboolean show,
+                                          GError **error);
+
 extern gboolean in_alt_tab;
 
 G_END_DECLS
@@ -0,0 +1,131 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "hd-occlusion.h"
+
+/* Half-open box, [x1, x2) x [y1, y2).  Easier to cut than a geometry
+ * with unsigned width and height. */
+typedef struct
+{
+  gint x1, y1, x2, y2;
+} Box;
+
+static inline void
+box_from_geometry (Box *box, const ClutterGeometry *geo)
+{
+  box->x1 = geo->x;
+  box->y1 = geo->y;
+  box->x2 = geo->x + (gint)geo->width;
+  box->y2 = geo->y + (gint)geo->height;
+}
+
+static inline void
+push_box (GArray *boxes, gint x1, gint y1, gint x2, gint y2)
+{
+  Box box = { x1, y1, x2, y2 };
+
+  if (x1 < x2 && y1 < y2)
+    g_array_append_val (boxes, box);
+}
+
+void
+hd_occlusion_init (HdOcclusion *occ)
+{
+  occ->uncovered = g_array_sized_new (FALSE, FALSE, sizeof (Box), 32);
+  occ->scratch   = g_array_sized_new (FALSE, FALSE, sizeof (Box), 32);
+}
+
+void
+hd_occlusion_free (HdOcclusion *occ)
+{
+  g_array_free (occ->uncovered, TRUE);
+  g_array_free (occ->scratch, TRUE);
+  occ->uncovered = occ->scratch = NULL;
+}
+
+void
+hd_occlusion_reset (HdOcclusion *occ, guint width, guint height)
+{
+  g_array_set_size (occ->uncovered, 0);
+  push_box (occ->uncovered, 0, 0, width, height);
+}
+
+guint
+hd_occlusion_visible_area (HdOcclusion *occ, const ClutterGeometry *rect)
+{
+  Box r;
+  guint i, area;
+
+  /* The uncovered boxes are disjoint, so we can just add up how much
+   * of @rect each of them contains. */
+  box_from_geometry (&r, rect);
+  for (i = area = 0; i < occ->uncovered->len; i++)
+    {
+      const Box *u = &g_array_index (occ->uncovered, Box, i);
+      gint x1, y1, x2, y2;
+
+      x1 = MAX (r.x1, u->x1);
+      x2 = MIN (r.x2, u->x2);
+      y1 = MAX (r.y1, u->y1);
+      y2 = MIN (r.y2, u->y2);
+      if (x1 < x2 && y1 < y2)
+        area += (x2 - x1) * (y2 - y1);
+    }
+
+  return area;
+}
+
+void
+hd_occlusion_add_blocker (HdOcclusion *occ, const ClutterGeometry *rect)
+{
+  GArray *tmp;
+  Box b;
+  guint i;
+
+  box_from_geometry (&b, rect);
+  if (b.x1 >= b.x2 || b.y1 >= b.y2)
+    return;
+
+  /* Cut every uncovered box which overlaps @b into the at most four
+   * pieces around it: full-width bands above and below, and the parts
+   * left and right of it in between. */
+  g_array_set_size (occ->scratch, 0);
+  for (i = 0; i < occ->uncovered->len; i++)
+    {
+      const Box *u = &g_array_index (occ->uncovered, Box, i);
+      gint y1, y2;
+
+      if (u->x2 <= b.x1 || b.x2 <= u->x1 || u->y2 <= b.y1 || b.y2 <= u->y1)
+        {
+          g_array_append_val (occ->scratch, *u);
+          continue;
+        }
+
+      y1 = MAX (u->y1, b.y1);
+      y2 = MIN (u->y2, b.y2);
+      push_box (occ->scratch, u->x1, u->y1, u->x2, y1);
+      push_box (occ->scratch, u->x1, y1, b.x1, y2);
+      push_box (occ->scratch, b.x2, y1, u->x2, y2);
+      push_box (occ->scratch, u->x1, y2, u->x2, u->y2);
+    }
+
+  tmp = occ->uncovered;
+  occ->uncovered = occ->scratch;
+  occ->scratch = tmp;
+}
@@ -0,0 +1,67 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_OCCLUSION_H__
+#define __HD_OCCLUSION_H__
+
+#include <glib.h>
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Front-to-back occlusion culling.  HdOcclusion keeps the part of the
+ * screen which is not covered by anything yet, as a set of disjoint
+ * rectangles.  Walk the actors from the top, ask whether each is visible
+ * and if it is opaque, add it as a blocker; it's subtracted from the
+ * uncovered area, in any X and Y overlap.
+ *
+ * The rectangle arrays are kept between passes, so a pass doesn't
+ * allocate anything once they have grown large enough.
+ */
+typedef struct _HdOcclusion HdOcclusion;
+
+struct _HdOcclusion
+{
+  /*< private >*/
+  GArray *uncovered, *scratch;
+};
+
+void hd_occlusion_init (HdOcclusion *occ);
+void hd_occlusion_free (HdOcclusion *occ);
+
+/* Start a new pass with all of @width x @height uncovered. */
+void hd_occlusion_reset (HdOcclusion *occ, guint width, guint height);
+
+/* Returns how many pixels of @rect are not covered by any blocker yet,
+ * 0 if it's completely hidden. */
+guint hd_occlusion_visible_area (HdOcclusion *occ,
+                                 const ClutterGeometry *rect);
+#define hd_occlusion_is_visible(occ, rect) \
+  (hd_occlusion_visible_area (occ, rect) > 0)
+
+void hd_occlusion_add_blocker (HdOcclusion *occ,
+                               const ClutterGeometry *rect);
+
+/* Whether the whole screen is covered. */
+#define hd_occlusion_is_covered(occ) ((occ)->uncovered->len == 0)
+
+G_END_DECLS
+
+#endif
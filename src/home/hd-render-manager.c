@@ -46,7 +46,10 @@
 #include "hd-app.h"
 #include "hd-dialog.h"
 #include "hd-app-menu.h"
+#include "hd-occlusion.h"
+#include "hd-damage.h"
 
+#include <cogl/cogl.h>
 #include <matchbox/core/mb-wm.h>
 #include <matchbox/theme-engines/mb-wm-theme.h>
 
@@ -228,6 +231,19 @@ struct _HdRenderManagerPrivate {
   GdkRegion           *current_input_viewport;
   GdkRegion           *new_input_viewport;
   guint                input_viewport_callback;
+
+  /* What set_visibilities() found to be uncovered so far.  Kept here
+   * so that its buffers are reused from pass to pass. */
+  HdOcclusion          occlusion;
+  /* Pixels of actors hidden by the last set_visibilities(), and
+   * the sum of it over all passes. */
+  guint                culled_pixels;
+  guint64              culled_pixels_total;
+
+  /* The stage's scissor box while a frame is painted rectangle by
+   * rectangle, to be put back when it's done. */
+  gboolean             split_frame;
+  GLint                frame_scissor[4];
 };
 
 /* ------------------------------------------------------------------------- */
@@ -270,9 +286,6 @@ hd_render_manager_sync_clutter_before(void);
 static void
 hd_render_manager_sync_clutter_after(void);
 
-static const char *
-hd_render_manager_state_str(HDRMStateEnum state);
-
 static void
 hd_render_manager_get_property (GObject    *object,
                                 guint       property_id,
@@ -436,6 +449,7 @@ hd_render_manager_finalize (GObject *gobject)
   g_object_unref(priv->home);
   g_object_unref(priv->task_nav);
   g_object_unref(priv->title_bar);
+  hd_occlusion_free (&priv->occlusion);
   G_OBJECT_CLASS (hd_render_manager_parent_class)->finalize (gobject);
 }
 
@@ -452,6 +466,67 @@ hd_render_manager_dispose (GObject *gobject)
 }
 
 
+/* If the stage is only redrawing the damaged box and the damage is a
+ * few rectangles far apart, paint them one by one instead of the whole
+ * box.  The stage clears its scissor box before painting its children,
+ * so all but the last rectangle are cleared and painted here, and the
+ * stage is left to paint the last one with the scissor narrowed to it.
+ * The rest of the box is left alone in the back buffer. */
+static void
+hd_render_manager_stage_paint (ClutterActor *stage, HdRenderManager *self)
+{
+  HdRenderManagerPrivate *priv = self->priv;
+  const GdkRectangle *rects;
+  GdkRectangle box;
+  ClutterColor color;
+  GList *children, *l;
+  guint n_rects, i, stage_height;
+
+  priv->split_frame = FALSE;
+  if (!hd_damage_get_frame_rects (&rects, &n_rects, &box)
+      || !glIsEnabled (GL_SCISSOR_TEST))
+    return;
+
+  /* Make sure it's our damage the stage is redrawing and not
+   * something it has merged with other redraws. */
+  stage_height = clutter_actor_get_height (stage);
+  glGetIntegerv (GL_SCISSOR_BOX, priv->frame_scissor);
+  if (priv->frame_scissor[0] != box.x
+      || priv->frame_scissor[2] != box.width
+      || priv->frame_scissor[1] != (GLint)stage_height - box.y - box.height
+      || priv->frame_scissor[3] != box.height)
+    return;
+
+  clutter_stage_get_color (CLUTTER_STAGE (stage), &color);
+  children = clutter_container_get_children (CLUTTER_CONTAINER (stage));
+  for (i = 0; i < n_rects; i++)
+    {
+      glScissor (rects[i].x, stage_height - rects[i].y - rects[i].height,
+                 rects[i].width, rects[i].height);
+      if (i == n_rects - 1)
+        break;
+
+      cogl_paint_init (&color);
+      for (l = children; l; l = l->next)
+        if (CLUTTER_ACTOR_IS_VISIBLE (l->data))
+          clutter_actor_paint (l->data);
+    }
+  g_list_free (children);
+  priv->split_frame = TRUE;
+}
+
+static void
+hd_render_manager_stage_painted (ClutterActor *stage, HdRenderManager *self)
+{
+  HdRenderManagerPrivate *priv = self->priv;
+
+  if (priv->split_frame)
+    glScissor (priv->frame_scissor[0], priv->frame_scissor[1],
+               priv->frame_scissor[2], priv->frame_scissor[3]);
+  hd_damage_frame_rects_painted (priv->split_frame);
+  priv->split_frame = FALSE;
+}
+
 static void
 hd_render_manager_class_init (HdRenderManagerClass *klass)
 {
@@ -493,6 +568,7 @@ hd_render_manager_init (HdRenderManager *self)
 
   self->priv = priv = HD_RENDER_MANAGER_GET_PRIVATE (self);
   clutter_actor_set_name(CLUTTER_ACTOR(self), "HdRenderManager");
+  hd_occlusion_init (&priv->occlusion);
   g_signal_connect_swapped(stage, "notify::allocation",
                            G_CALLBACK(stage_allocation_changed), self);
   /* Add a callback we can use to capture events when we need to block
@@ -501,6 +577,11 @@ hd_render_manager_init (HdRenderManager *self)
                     "captured-event",
                     G_CALLBACK (hd_render_manager_captured_event_cb),
                     self);
+  /* Paint damage split into rectangles. */
+  g_signal_connect (stage, "paint",
+                    G_CALLBACK (hd_render_manager_stage_paint), self);
+  g_signal_connect_after (stage, "paint",
+                          G_CALLBACK (hd_render_manager_stage_painted), self);
 
   priv->state = HDRM_STATE_UNDEFINED;
   priv->previous_state = HDRM_STATE_UNDEFINED;
@@ -1935,7 +2016,7 @@ inline HDRMStateEnum hd_render_manager_get_previous_state()
   return render_manager->priv->previous_state;
 }
 
-static const char *hd_render_manager_state_str(HDRMStateEnum state)
+const char *hd_render_manager_state_str(HDRMStateEnum state)
 {
   GTypeClass *state_class = g_type_class_ref (HD_TYPE_RENDER_MANAGER_STATE);
   GEnumValue *state_value = g_enum_get_value (
@@ -2572,131 +2653,39 @@ void hd_render_manager_set_launcher_subview(gboolean subview)
         ~HDRM_ZOOM_FOR_LAUNCHER_SUBMENU);
 }
 
-/* Work out if rect is visible after being clipped to avoid every
- * rect in blockers */
+/* Work out if rect is visible after being clipped to the screen
+ * and taking the blockers added so far into account. */
 static gboolean
-hd_render_manager_is_visible(GList *blockers,
-                             ClutterGeometry rect)
+hd_render_manager_is_visible(ClutterGeometry rect)
 {
   HdRenderManagerPrivate *priv = render_manager->priv;
 
   if (STATE_IS_NON_COMP (priv->state) || !hd_render_manager_clip_geo(&rect))
     return FALSE;
 
-  /* clip for every block */
-  for (; blockers; blockers = blockers->next)
-    {
-      ClutterGeometry blocker = *(ClutterGeometry*)blockers->data;
-      gint rect_b, blocker_b;
-
-      VISIBILITY ("RECT %dx%d%+d%+d BLOCKER %dx%d%+d%+d",
-                  MBWM_GEOMETRY(&rect), MBWM_GEOMETRY(&blocker));
+  return hd_occlusion_is_visible (&priv->occlusion, &rect);
+}
 
-      /*
-       * If rect does not fit inside blocker in the X axis...
-       * Beware that ClutterGeometry.x and .y are signed, while .width
-       * and .height are unsigned and the type propagation rules of C
-       * makes sure we'll have trouble because the result is unsigned.
-       * It's only significant, though when you compare signeds and
-       * unsigneds.
-       */
-      if (!(blocker.x <= rect.x &&
-            rect.x+(gint)rect.width <= blocker.x+(gint)blocker.width))
-        continue;
-
-      /* Because most windows will go edge->edge, just do a very simplistic
-       * clipping in the Y direction */
-      rect_b    = rect.y + rect.height;
-      blocker_b = blocker.y + blocker.height;
-
-      if (rect.y < blocker.y)
-        { /* top of rect is above blocker */
-          if (rect_b < blocker.y)
-            /* rect is above blocker */
-            continue;
-          if (rect_b < blocker_b)
-            /* rect is half above blocker, clip the rest */
-            rect.height -= rect_b - blocker.y;
-          else
-            { /* rect is split into two pieces by blocker */
-              rect.height = blocker.y - rect.y;
-              if (hd_render_manager_is_visible(blockers, rect))
-                /* upper half is visible */
-                return TRUE;
-
-              /* continue with the lower half */
-              rect.y = blocker_b;
-              rect.height = rect_b - blocker_b;
-            }
-        }
-      else if (rect.y < blocker_b)
-        { /* top of rect is inside blocker */
-          if (rect_b < blocker_b)
-            /* rect is confined in blocker */
-            return FALSE;
-          else
-            { /* rect is half below blocker, clip the rest */
-              rect.height -= blocker_b - rect.y;
-              rect.y       = blocker_b;
-            }
-        }
-      else
-        /* rect is completely below blocker */;
+void
+hd_render_manager_dump_debug_info (void)
+{
+  HdRenderManagerPrivate *priv;
 
-      if (blocker.x <= rect.x &&
-          rect.x+rect.width <= blocker.x+blocker.width)
-        {
-          if (blocker.y <= rect.y &&
-              rect.y+rect.height <= blocker.y+blocker.height)
-            {
-              /* If rect fits inside blocker in the Y axis,
-               * it is def. not visible */
-              return FALSE;
-            }
-          else if (rect.y < blocker.y)
-            {
-              /* safety - if the blocker sits in the middle of us
-               * it makes 2 rects, so don't use it */
-              if (blocker.y+blocker.height >= rect.y+rect.height)
-                /* rect out the bottom, clip to the blocker */
-                rect.height = blocker.y - rect.y;
-            }
-          else
-            { /* rect must be out the top, clip to the blocker */
-              rect.height = (rect.y + rect.height) -
-                            (blocker.y + blocker.height);
-              rect.y = blocker.y + blocker.height;
-            }
-        }
-    }
+  if (!render_manager)
+    return;
 
-  return TRUE;
+  priv = render_manager->priv;
+  g_debug ("render manager: culled %u pixels in the last pass, "
+           "%" G_GUINT64_FORMAT " in total; %u rectangles uncovered",
+           priv->culled_pixels, priv->culled_pixels_total,
+           priv->occlusion.uncovered ? priv->occlusion.uncovered->len : 0);
 }
 
 static
 MBWindowManagerClient*
 hd_render_manager_get_wm_client_from_actor(ClutterActor *actor)
 {
-  MBWindowManager *wm;
-  MBWindowManagerClient *c;
-
-  /* first off, try and get the client from the data set in the actor */
-  MBWMCompMgrClient *cc = g_object_get_data (G_OBJECT (actor),
-                                             "HD-MBWMCompMgrClutterClient");
-  if (cc && cc->wm_client)
-    return cc->wm_client;
-
-  /*Or search... */
-  wm = MB_WM_COMP_MGR(render_manager->priv->comp_mgr)->wm;
-  /* Order and choose which window actors will be visible */
-  for (c = wm->stack_bottom; c; c = c->stacked_above)
-    if (c->cm_client) {
-      ClutterActor *cactor = mb_wm_comp_mgr_clutter_client_get_actor(
-                               MB_WM_COMP_MGR_CLUTTER_CLIENT(c->cm_client));
-      if (actor == cactor)
-        return c;
-    }
-  return 0;
+  return hd_comp_mgr_client_from_actor (actor);
 }
 
 static
@@ -2747,7 +2736,7 @@ gboolean hd_render_manager_actor_opaque(ClutterActor *actor)
 static
 void hd_render_manager_append_geo_cb(ClutterActor *actor, gpointer data)
 {
-  GList **list = (GList**)data;
+  HdOcclusion *occlusion = data;
   if (hd_render_manager_actor_opaque(actor))
     {
       ClutterGeometry geo;
@@ -2766,7 +2755,7 @@ void hd_render_manager_append_geo_cb(ClutterActor *actor, gpointer data)
       hd_render_manager_get_geo_for_current_screen(actor, &geo);
       if (!hd_render_manager_clip_geo (&geo))
         return;
-      *list = g_list_prepend(*list, g_memdup(&geo, sizeof(geo)));
+      hd_occlusion_add_blocker (occlusion, &geo);
       VISIBILITY ("BLOCKER %dx%d%+d%+d", MBWM_GEOMETRY(&geo));
     }
 }
@@ -2774,12 +2763,7 @@ void hd_render_manager_append_geo_cb(ClutterActor *actor, gpointer data)
 void hd_render_manager_set_visibilities()
 { VISIBILITY ("SET VISIBILITIES");
   HdRenderManagerPrivate *priv;
-  GList *blockers = 0;
-  GList *it;
   gint i, n_elements;
-  ClutterGeometry fullscreen_geo = {0, 0,
-          hd_comp_mgr_get_current_screen_width (),
-          hd_comp_mgr_get_current_screen_height ()};
   MBWindowManager *wm;
   gboolean has_fullscreen;
   MBWindowManagerClient *c;
@@ -2793,13 +2777,19 @@ void hd_render_manager_set_visibilities()
       return;
     }
 
+  /* Start over with the whole screen uncovered. */
+  hd_occlusion_reset (&priv->occlusion,
+                      hd_comp_mgr_get_current_screen_width (),
+                      hd_comp_mgr_get_current_screen_height ());
+  priv->culled_pixels = 0;
+
   /* first append all the top elements... */
   clutter_container_foreach(CLUTTER_CONTAINER(priv->app_top),
                             hd_render_manager_append_geo_cb,
-                            (gpointer)&blockers);
+                            &priv->occlusion);
   /* Now check to see if the whole screen is covered, and if so
    * don't bother rendering blurring */
-  if (hd_render_manager_is_visible(blockers, fullscreen_geo))
+  if (!hd_occlusion_is_covered (&priv->occlusion))
     {
       clutter_actor_show(CLUTTER_ACTOR(priv->home_blur));
     }
@@ -2826,7 +2816,7 @@ void hd_render_manager_set_visibilities()
           hd_render_manager_get_geo_for_current_screen(child, &geo);
           /*TEST clutter_actor_set_opacity(child, 63);*/
           VISIBILITY ("IS %p (%dx%d%+d%+d) VISIBLE?", child, MBWM_GEOMETRY(&geo));
-          if (hd_render_manager_is_visible(blockers, geo))
+          if (hd_render_manager_is_visible(geo))
             {
               VISIBILITY ("IS");
               clutter_actor_show(child);
@@ -2834,7 +2824,7 @@ void hd_render_manager_set_visibilities()
               /* Add the geometry to our list of blockers and go to next... */
               if (hd_render_manager_actor_opaque(child))
                 {
-                  blockers = g_list_prepend(blockers, g_memdup(&geo, sizeof(geo)));
+                  hd_occlusion_add_blocker (&priv->occlusion, &geo);
                   VISIBILITY ("MORE BLOCKER %dx%d%+d%+d", MBWM_GEOMETRY(&geo));
                 }
             }
@@ -2844,6 +2834,9 @@ void hd_render_manager_set_visibilities()
               if (!hd_transition_actor_will_go_away(child))
                 {
                   VISIBILITY ("ISNT");
+                  if (CLUTTER_ACTOR_IS_VISIBLE (child)
+                      && hd_render_manager_clip_geo (&geo))
+                    priv->culled_pixels += geo.width * geo.height;
                   clutter_actor_hide(child);
                 }
               else
@@ -2856,15 +2849,8 @@ void hd_render_manager_set_visibilities()
    * and make an error here, but there are actually many cases where this is
    * valid. See NB#117092 */
 
-  /* now free blockers */
-  it = g_list_first(blockers);
-  while (it)
-    {
-      g_free(it->data);
-      it = it->next;
-    }
-  g_list_free(blockers);
-  blockers = 0;
+  priv->culled_pixels_total += priv->culled_pixels;
+  VISIBILITY ("CULLED %u PIXELS", priv->culled_pixels);
 
   /* Do we have a fullscreen client totally filling the screen? */
   /* This is voodo.  Please insert a comment here that explains
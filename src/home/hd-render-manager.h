@@ -249,6 +249,7 @@ void hd_render_manager_set_state_unportrait (void);
 void hd_render_manager_switch_to_composited_state (void);
 gboolean hd_render_manager_is_changing_state(void);
 const char *hd_render_manager_get_state_str(void);
+const char *hd_render_manager_state_str(HDRMStateEnum state);
 gboolean hd_render_manager_in_transition(void);
 gboolean hd_render_manager_is_client_visible(MBWindowManagerClient *c);
 void hd_render_manager_set_launcher_subview(gboolean subview);
@@ -302,6 +303,7 @@ gboolean hd_render_manager_allow_dbus_launch_transition(void);
 gboolean hd_render_manager_actor_is_visible(ClutterActor *actor);
 
 void hd_render_manager_set_visibilities(void);
+void hd_render_manager_dump_debug_info(void);
 
 void hd_render_manager_update_blur_state(void);
 void hd_render_manager_pause_blur_animation(void);
@@ -988,16 +988,5 @@ hd_switcher_group_background_clicked (HdSwitcher   *switcher,
 static MBWindowManagerClient *
 actor_to_client_window (ClutterActor *clutter_window)
 {
-  const MBWMCompMgrClient *cmgrc;
-  MBWMClientWindow *window;
-
-  cmgrc = g_object_get_data (G_OBJECT (clutter_window),
-                             "HD-MBWMCompMgrClutterClient");
-
-  if (!cmgrc || !cmgrc->wm_client || !cmgrc->wm_client->window)
-    return NULL;
-
-  window = cmgrc->wm_client->window;
-
-  return mb_wm_managed_client_from_xwindow (window->wm, window->xwindow);
+  return hd_comp_mgr_client_from_actor (clutter_window);
 }
@@ -3074,17 +3074,15 @@ static gboolean tnote_matches_thumb (const TNote * tnote,
 static MBWMClientWindow *
 actor_to_client_window (ClutterActor * win, const HdCompMgrClient **hcmgrcp)
 {
-  const MBWMCompMgrClient *cmgrc;
+  MBWindowManagerClient *c;
 
-  cmgrc = g_object_get_data (G_OBJECT (win),
-                             "HD-MBWMCompMgrClutterClient");
-
-  if (!cmgrc || !cmgrc->wm_client || !cmgrc->wm_client->window)
+  c = hd_comp_mgr_client_from_actor (win);
+  if (!c || !c->cm_client || !c->window)
     return NULL;
 
   if (hcmgrcp)
-    *hcmgrcp = HD_COMP_MGR_CLIENT (cmgrc);
-  return cmgrc->wm_client->window;
+    *hcmgrcp = HD_COMP_MGR_CLIENT (c->cm_client);
+  return c->window;
 }
 
 static void
@@ -4618,10 +4616,8 @@ hd_task_navigator_update_orientation(gboolean portrait)
 static gboolean
 hd_task_navigator_app_portrait_capable(Thumbnail * thumb)
 {
-  MBWindowManagerClient *c = mb_wm_managed_client_from_xwindow(
-    thumb->win->wm,
-    thumb->win->xwindow
-    );
+  MBWindowManagerClient *c =
+    hd_comp_mgr_client_from_xwindow (thumb->win->xwindow);
 
   if (!c)
     return FALSE;
@@ -4709,8 +4705,7 @@ hd_task_navigator_update_win_orientation (Window xwindow, gboolean portrait)
 
       layout_thumbs (thumb->thwin);
       mb_wm_client_geometry_mark_dirty (
-                  mb_wm_managed_client_from_xwindow (thumb->win->wm,
-                                                     thumb->win->xwindow));
+                  hd_comp_mgr_client_from_xwindow (thumb->win->xwindow));
     }
 }
 
@@ -37,6 +37,7 @@
 #include "hd-gtk-utils.h"
 #include "hd-gtk-style.h"
 #include "hd-transition.h"
+#include "hd-frame-scheduler.h"
 #include "hd-util.h"
 #include "hd-task-navigator.h"
 
@@ -175,8 +176,9 @@ struct _HdTitleBarPrivate
   ClutterLabel          *title;
   /* The title to be used when in HDRM_STATE_LOADING */
   gchar                 *loading_title;
-  /* Pulsing animation for switcher */
-  ClutterTimeline       *switcher_timeline;
+  /* Pulsing animation for switcher, on the frame scheduler */
+  guint                  switcher_pulse_id;
+  gint64                 switcher_pulse_start;
   /* progress indicator */
   ClutterTimeline       *progress_timeline;
   ClutterActor          *progress_texture;
@@ -212,9 +214,8 @@ static void
 hd_title_bar_add_left_signals(HdTitleBar *bar, ClutterActor *actor);
 static void
 hd_title_bar_add_right_signals(HdTitleBar *bar, ClutterActor *actor);
-static void
-on_switcher_timeline_new_frame(ClutterTimeline *timeline,
-                               gint frame_num, HdTitleBar *bar);
+static gboolean
+hd_title_bar_switcher_pulse_frame(gpointer data);
 static void
 hd_title_bar_set_full_width(HdTitleBar *bar, gboolean full_size);
 static void hd_title_bar_set_button_positions(HdTitleBar *bar);
@@ -375,13 +376,6 @@ hd_title_bar_init (HdTitleBar *bar)
   /* Make sure the 'foreground' is in the right place */
   clutter_actor_raise_top(CLUTTER_ACTOR(priv->foreground));
 
-  /* Create timeline animation */
-  priv->switcher_timeline =
-    clutter_timeline_new_for_duration(HD_TITLE_BAR_SWITCHER_PULSE_DURATION
-                                      * HD_TITLE_BAR_SWITCHER_PULSE_NPULSES);
-  g_signal_connect (priv->switcher_timeline, "new-frame",
-                        G_CALLBACK (on_switcher_timeline_new_frame), bar);
-
   /* Create progress indicator */
   {
     ClutterGeometry progress_geo =
@@ -461,6 +455,11 @@ hd_title_bar_dispose (GObject *obj)
     }
   if (priv->progress_timeline)
     clutter_timeline_stop(priv->progress_timeline);
+  if (priv->switcher_pulse_id)
+    {
+      hd_frame_scheduler_remove(priv->switcher_pulse_id);
+      priv->switcher_pulse_id = 0;
+    }
   for (i=0;i<BTN_COUNT;i++)
     if (priv->buttons[i])
       {
@@ -1313,23 +1312,29 @@ hd_title_bar_set_switcher_pulse(HdTitleBar *bar, gboolean pulse)
 
   if (!pulse)
     { /* Stop animation and unhilight the tasks button. */
-      clutter_timeline_stop(priv->switcher_timeline);
+      if (priv->switcher_pulse_id)
+        {
+          hd_frame_scheduler_remove(priv->switcher_pulse_id);
+          priv->switcher_pulse_id = 0;
+        }
       clutter_actor_set_opacity(priv->buttons[BTN_SWITCHER_HIGHLIGHT], 0);
       priv->state &= ~HDTB_VIS_BTN_SWITCHER_HIGHLIGHT;
     }
-  else if (!clutter_timeline_is_playing(priv->switcher_timeline))
+  else if (!priv->switcher_pulse_id)
     { /* Be sure not to start overlapping animations. */
+      priv->switcher_pulse_start = hd_frame_scheduler_get_time();
       if (priv->state & HDTB_VIS_BTN_SWITCHER_HIGHLIGHT)
         /* Continue the previous animation and skip the first
          * breathe-in pulse. */
-        clutter_timeline_advance(priv->switcher_timeline,
-            clutter_timeline_get_n_frames(priv->switcher_timeline)
-            / HD_TITLE_BAR_SWITCHER_PULSE_NPULSES);
+        priv->switcher_pulse_start -=
+          HD_TITLE_BAR_SWITCHER_PULSE_DURATION * 1000;
       else
         /* Make sure set_state() leaves is highlighted. */
         priv->state |= HDTB_VIS_BTN_SWITCHER_HIGHLIGHT;
 
-      clutter_timeline_start(priv->switcher_timeline);
+      priv->switcher_pulse_id = hd_frame_scheduler_add(0,
+                                    hd_title_bar_switcher_pulse_frame,
+                                    bar, NULL);
     }
 }
 
@@ -1375,23 +1380,32 @@ static void hd_title_bar_set_button_positions(HdTitleBar *bar)
 
 extern gboolean hd_dbus_display_is_off;
 
-static void
-on_switcher_timeline_new_frame(ClutterTimeline *timeline,
-                               gint frame_num, HdTitleBar *bar)
+static gboolean
+hd_title_bar_switcher_pulse_frame(gpointer data)
 {
+  HdTitleBar *bar = data;
   HdTitleBarPrivate *priv;
-  float amt;
+  float progress, amt;
   gint opacity;
 
   if (!HD_IS_TITLE_BAR(bar))
-    return;
+    return FALSE;
   priv = bar->priv;
 
+  progress = (hd_frame_scheduler_get_time() - priv->switcher_pulse_start)
+    / (HD_TITLE_BAR_SWITCHER_PULSE_DURATION
+       * HD_TITLE_BAR_SWITCHER_PULSE_NPULSES * 1000.0f);
+  if (progress >= 1)
+    { /* The last frame, which leaves the button breathe held. */
+      progress = 1;
+      priv->switcher_pulse_id = 0;
+    }
+
   if (hd_dbus_display_is_off)
     {
       /* skip the animation */
       clutter_actor_set_opacity(priv->buttons[BTN_SWITCHER_HIGHLIGHT], 255);
-      return;
+      return priv->switcher_pulse_id != 0;
     }
 
   /* Only get this to fire a redraw if it is visible... fixes bug 113278.
@@ -1399,8 +1413,7 @@ on_switcher_timeline_new_frame(ClutterTimeline *timeline,
       hd_util_partial_redraw_if_possible...) */
   clutter_actor_set_allow_redraw(CLUTTER_ACTOR(bar), FALSE);
 
-  amt =  (float)clutter_timeline_get_progress(timeline)
-              * HD_TITLE_BAR_SWITCHER_PULSE_NPULSES / 2;
+  amt = progress * HD_TITLE_BAR_SWITCHER_PULSE_NPULSES / 2;
   if (priv->state & HDTB_VIS_BTN_SWITCHER)
     {
       opacity = (gint)((1-cos(amt*2*3.141592))*127);
@@ -1409,6 +1422,8 @@ on_switcher_timeline_new_frame(ClutterTimeline *timeline,
 
   hd_util_partial_redraw_if_possible(priv->buttons[BTN_SWITCHER_HIGHLIGHT], 0);
   clutter_actor_set_allow_redraw(CLUTTER_ACTOR(bar), TRUE);
+
+  return priv->switcher_pulse_id != 0;
 }
 
 /* Realign all right-aligned buttons when the screen size changes. */
@@ -49,6 +49,9 @@
 #include "home/hd-render-manager.h"
 #include "home/hd-home-view-container.h"
 #include "hd-transition.h"
+#include "hd-pressure.h"
+#include "hd-app-predictor.h"
+#include "hd-proc-mem.h"
 #include "hd-wm.h"
 #include "hd-orientation-lock.h"
 
@@ -119,6 +122,19 @@ struct _HdAppMgrPrivate
   size_t notify_high_pages;
   size_t nr_decay_pages;
 
+  /* Memory pressure from the kernel, for systems without the lowmem
+   * signals. */
+  HdPressure *pressure;
+
+  /* Which apps the user is likely to open next, to order the queues. */
+  HdAppPredictor *predictor;
+
+  /* The memory of the hibernatable apps, pid -> HdProcMem, read in a
+   * thread, and when it was. */
+  GHashTable *mem_sample;
+  gint64 mem_sample_time;
+  gboolean mem_sampling;
+
   /* Memory status and prestarting flags.*/
   gboolean bg_killing:1;
   gboolean lowmem:1;
@@ -167,6 +183,8 @@ G_DEFINE_TYPE_WITH_CODE (HdAppMgr,
 
 #define LOADAVG_MAX               (1.0)
 #define STATE_CHECK_INTERVAL      (1)
+/* How old the memory of the apps may be to choose what to hibernate. */
+#define MEM_SAMPLE_AGE            (2 * STATE_CHECK_INTERVAL * G_USEC_PER_SEC)
 #define LOADING_TIMEOUT           (10)
 #define INIT_DONE_TIMEOUT         (5)
 
@@ -232,6 +250,16 @@ static void hd_app_mgr_dispose (GObject *gobject);
 
 static void hd_app_mgr_populate_tree_finished (HdLauncherTree *tree,
                                                gpointer data);
+static void hd_app_mgr_tree_item_added   (HdLauncherTree *tree,
+                                          HdLauncherItem *item,
+                                          gpointer data);
+static void hd_app_mgr_tree_item_removed (HdLauncherTree *tree,
+                                          HdLauncherItem *item,
+                                          gpointer data);
+static void hd_app_mgr_tree_item_changed (HdLauncherTree *tree,
+                                          HdLauncherItem *item,
+                                          HdLauncherItem *old_item,
+                                          gpointer data);
 
 HdAppMgrLaunchResult hd_app_mgr_start     (HdRunningApp *app);
 HdAppMgrLaunchResult hd_app_mgr_relaunch  (HdRunningApp *app);
@@ -261,6 +289,7 @@ static void
 hd_app_mgr_setup_launch (size_t high_pages,
                          size_t nr_decay_pages,
                          size_t *launch_required_pages);
+static HdPressure *hd_app_mgr_pressure_new (HdAppMgr *self);
 static gboolean hd_app_mgr_can_launch   (HdLauncherApp *launcher);
 static gboolean hd_app_mgr_can_prestart (HdLauncherApp *launcher);
 static void     hd_app_mgr_hdrm_state_change (gpointer hdrm,
@@ -418,6 +447,15 @@ hd_app_mgr_init (HdAppMgr *self)
   g_signal_connect (priv->tree, "finished",
                     G_CALLBACK (hd_app_mgr_populate_tree_finished),
                     self);
+  g_signal_connect (priv->tree, "item-added",
+                    G_CALLBACK (hd_app_mgr_tree_item_added),
+                    self);
+  g_signal_connect (priv->tree, "item-removed",
+                    G_CALLBACK (hd_app_mgr_tree_item_removed),
+                    self);
+  g_signal_connect (priv->tree, "item-changed",
+                    G_CALLBACK (hd_app_mgr_tree_item_changed),
+                    self);
   hd_launcher_tree_populate (priv->tree);
 
   /* NOTE: Can we assume this when we start up? */
@@ -492,6 +530,14 @@ hd_app_mgr_init (HdAppMgr *self)
   hd_app_mgr_setup_launch (priv->notify_high_pages,
                            priv->nr_decay_pages,
                            &priv->launch_required_pages);
+  priv->pressure = hd_app_mgr_pressure_new (self);
+
+  gchar *history = g_build_filename (g_get_user_cache_dir (), "hildon-desktop",
+                                     "launch-history", NULL);
+  priv->predictor = hd_app_predictor_new (history);
+  g_free (history);
+  priv->mem_sample = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL, g_free);
 
   /* Start dbus signal tracking. */
   DBusGConnection *connection;
@@ -618,6 +664,7 @@ hd_app_mgr_stop ()
   if (!the_app_mgr)
     return;
 
+  hd_app_predictor_save (HD_APP_MGR_GET_PRIVATE (the_app_mgr)->predictor);
   hd_app_mgr_kill_all_prestarted ();
 }
 
@@ -663,6 +710,24 @@ hd_app_mgr_dispose (GObject *gobject)
       priv->gconf_client = NULL;
     }
 
+  if (priv->pressure)
+    {
+      hd_pressure_free (priv->pressure);
+      priv->pressure = NULL;
+    }
+
+  if (priv->predictor)
+    {
+      hd_app_predictor_free (priv->predictor);
+      priv->predictor = NULL;
+    }
+
+  if (priv->mem_sample)
+    {
+      g_hash_table_destroy (priv->mem_sample);
+      priv->mem_sample = NULL;
+    }
+
   G_OBJECT_CLASS (hd_app_mgr_parent_class)->dispose (gobject);
 }
 
@@ -683,6 +748,19 @@ _hd_app_mgr_compare_app_priority (gconstpointer a,
   if (!b_launcher)
     return 1;
 
+  /* The apps likely to be opened next go first, so they are prestarted
+   * first and hibernated last. */
+  if (user_data)
+    {
+      gdouble a_score = hd_app_predictor_score (user_data,
+                              hd_launcher_item_get_id (HD_LAUNCHER_ITEM (a_launcher)));
+      gdouble b_score = hd_app_predictor_score (user_data,
+                              hd_launcher_item_get_id (HD_LAUNCHER_ITEM (b_launcher)));
+
+      if (a_score != b_score)
+        return a_score > b_score ? -1 : 1;
+    }
+
   gint a_priority = hd_launcher_app_get_priority (a_launcher);
   gint b_priority = hd_launcher_app_get_priority (b_launcher);
 
@@ -705,7 +783,7 @@ hd_app_mgr_add_to_queue (HdAppMgrQueue queue, HdRunningApp *app)
   g_queue_insert_sorted (priv->queues[queue],
                          g_object_ref (app),
                          _hd_app_mgr_compare_app_priority,
-                         NULL);
+                         priv->predictor);
 }
 
 static void
@@ -738,7 +816,7 @@ hd_app_mgr_move_queue (HdAppMgrQueue queue_from,
       g_queue_insert_sorted (priv->queues[queue_to],
                              app,
                              _hd_app_mgr_compare_app_priority,
-                             NULL);
+                             priv->predictor);
 
     }
   else
@@ -766,7 +844,10 @@ void hd_app_mgr_hibernatable (HdRunningApp *app, gboolean hibernatable)
       hibernatable ? "really" : "not");
 
   if (hibernatable)
-    hd_app_mgr_add_to_queue (QUEUE_HIBERNATABLE, app);
+    {
+      hd_running_app_set_last_shown (app, time (NULL));
+      hd_app_mgr_add_to_queue (QUEUE_HIBERNATABLE, app);
+    }
   else
     hd_app_mgr_remove_from_queue (QUEUE_HIBERNATABLE, app);
 
@@ -845,25 +926,39 @@ hd_app_mgr_timeout_backoff_factor ()
 static gdouble
 hd_app_mgr_system_load_average (void)
 {
-  int fd = open ("/proc/loadavg", O_RDONLY);
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
 
-  if (fd >= 0)
-    {
-      char buffer[32];
-      int size = read (fd, buffer, sizeof(buffer) -1);
+  return hd_pressure_get_load_average (priv->pressure);
+}
 
-      close (fd);
-      if (size > 0)
-        {
-          gdouble load;
-          buffer[size] = 0;
-          load = g_ascii_strtod(buffer, NULL);
+/* Tells the predictor @app was opened from @state and reorders the queues
+ * for the new predictions. */
+static void
+hd_app_mgr_predictor_record (HdRunningApp *app, HdRunningAppState state)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+  HdLauncherApp *launcher = hd_running_app_get_launcher_app (app);
+  HdAppPredictorLaunch launch;
 
-          return load;
-        }
-    }
+  if (!launcher)
+    return;
 
-  return -1.0;
+  if (state == HD_APP_STATE_PRESTARTED)
+    launch = HD_APP_PREDICTOR_WARM;
+  else if (state == HD_APP_STATE_SHOWN)
+    launch = HD_APP_PREDICTOR_RUNNING;
+  else
+    launch = HD_APP_PREDICTOR_COLD;
+  hd_app_predictor_record (priv->predictor,
+                           hd_launcher_item_get_id (HD_LAUNCHER_ITEM (launcher)),
+                           launch);
+
+  g_queue_sort (priv->queues[QUEUE_PRESTARTABLE],
+                _hd_app_mgr_compare_app_priority, priv->predictor);
+  g_queue_sort (priv->queues[QUEUE_PRESTARTED],
+                _hd_app_mgr_compare_app_priority, priv->predictor);
+  g_queue_sort (priv->queues[QUEUE_HIBERNATABLE],
+                _hd_app_mgr_compare_app_priority, priv->predictor);
 }
 
 /* This function either:
@@ -908,6 +1003,9 @@ hd_app_mgr_activate (HdRunningApp *app)
   switch (result)
   {
     case LAUNCH_OK:
+      /* A tap while it's still loading isn't another launch. */
+      if (state != HD_APP_STATE_LOADING && state != HD_APP_STATE_WAKING)
+        hd_app_mgr_predictor_record (app, state);
       if (timer)
           {
             /* Start a loading timer. */
@@ -1179,82 +1277,146 @@ hd_app_mgr_app_stop_hibernation (HdRunningApp *app)
   hd_app_mgr_app_closed (app);
 }
 
+/* Make @app run @new instead of its current launcher, which has changed
+ * or (if @new is NULL) gone. */
+static void
+hd_app_mgr_rebind_app (HdRunningApp *app, HdLauncherApp *new)
+{
+  HdLauncherApp *old = hd_running_app_get_launcher_app (app);
+
+  hd_running_app_set_launcher_app (app, new);
+  if (old && !new)
+    {
+      /* The .desktop file no longer exists, but the app could be running. */
+      HdRunningAppState state = hd_running_app_get_state (app);
+      if (state == HD_APP_STATE_PRESTARTED)
+        /* Kill it, as it shouldn't be prestarted. */
+        hd_app_mgr_kill (app);
+      else if (state == HD_APP_STATE_INACTIVE)
+        /* What's it doing here? */
+        hd_app_mgr_app_closed (app);
+    }
+  if (old && new)
+    {
+      /* If the old was prestarted and the new one isn't, kill it. */
+      if (hd_running_app_get_state (app) == HD_APP_STATE_PRESTARTED &&
+          hd_launcher_app_get_prestart_mode (new) == HD_APP_PRESTART_NONE)
+        hd_app_mgr_kill (app);
+    }
+}
+
+/* Rebind the running apps of @old to @new. */
+static void
+hd_app_mgr_rebind_apps (HdAppMgrPrivate *priv,
+                        HdLauncherApp *old, HdLauncherApp *new)
+{
+  /* Copy it as rebinding may take apps out of it. */
+  GList *apps = g_list_copy (priv->running_apps), *l;
+
+  for (l = apps; l; l = l->next)
+    if (hd_running_app_get_launcher_app (l->data) == old)
+      hd_app_mgr_rebind_app (l->data, new);
+
+  g_list_free (apps);
+}
+
+/* Queue @launcher for prestarting if it wants to be and it isn't yet. */
+static void
+hd_app_mgr_add_prestart_always (HdAppMgrPrivate *priv,
+                                HdLauncherItem *item)
+{
+  HdLauncherApp *launcher;
+  HdRunningApp *app;
+
+  if (hd_launcher_item_get_item_type (item) != HD_APPLICATION_LAUNCHER)
+    return;
+
+  launcher = HD_LAUNCHER_APP (item);
+  if (priv->prestart_mode == PRESTART_NEVER ||
+      hd_launcher_app_get_prestart_mode(launcher) != HD_APP_PRESTART_ALWAYS)
+    return;
+
+  /* Look if we already have a running app for it. */
+  if (g_list_find_custom (priv->running_apps, launcher,
+                          (GCompareFunc)_hd_app_mgr_compare_app_launcher))
+    /* We dealt with it before. */
+    return;
+
+  /* Create a new running app for it. */
+  app = hd_running_app_new (launcher);
+  priv->running_apps = g_list_prepend (priv->running_apps, app);
+  hd_app_mgr_prestartable (app, TRUE);
+}
+
 static void
 hd_app_mgr_populate_tree_finished (HdLauncherTree *tree, gpointer data)
 {
   HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (HD_APP_MGR (data));
-  /* We need to copy thess lists because we'll be modifying them. */
+  /* We need to copy this list because we'll be modifying it. */
   GList *apps = g_list_copy (priv->running_apps);
-  GList *items = g_list_copy (hd_launcher_tree_get_items (tree));
-  GList *apps_to_free = apps;
-  GList *items_to_free = items;
+  GList *l;
 
   /* First, traverse the already running apps to see if their HdLauncherApp
    * info has changed.
    */
-  for (; apps; apps = apps->next)
+  for (l = apps; l; l = l->next)
     {
-      HdRunningApp *app = apps->data;
-      HdLauncherApp *old, *new;
-      old = hd_running_app_get_launcher_app (app);
-      if (!old)
+      HdRunningApp *app = l->data;
+
+      if (!hd_running_app_get_launcher_app (app))
         /* TODO? Try to recognize newly installed but already running apps? */
         continue;
 
-      new = HD_LAUNCHER_APP (hd_launcher_tree_find_item (tree,
-                                 hd_running_app_get_id (app)));
-      hd_running_app_set_launcher_app (app, new);
-      if (old && !new)
-        {
-          /* The .desktop file no longer exists, but the app could be running. */
-          HdRunningAppState state = hd_running_app_get_state (app);
-          if (state == HD_APP_STATE_PRESTARTED)
-            /* Kill it, as it shouldn't be prestarted. */
-            hd_app_mgr_kill (app);
-          else if (state == HD_APP_STATE_INACTIVE)
-            /* What's it doing here? */
-            hd_app_mgr_app_closed (app);
-        }
-      if (old && new)
-        {
-          /* If the old was prestarted and the new one isn't, kill it. */
-          if (hd_running_app_get_state (app) == HD_APP_STATE_PRESTARTED &&
-              hd_launcher_app_get_prestart_mode (new) == HD_APP_PRESTART_NONE)
-            hd_app_mgr_kill (app);
-        }
+      hd_app_mgr_rebind_app (app,
+                HD_LAUNCHER_APP (hd_launcher_tree_find_item (tree,
+                                     hd_running_app_get_id (app))));
     }
 
-  g_list_free (apps_to_free);
+  g_list_free (apps);
 
   /* Now we need to look if we have new prestarted apps. */
-  for (; items; items = items->next)
-    {
-      HdLauncherApp *launcher;
-      GList *link = NULL;
+  for (l = hd_launcher_tree_get_items (tree); l; l = l->next)
+    hd_app_mgr_add_prestart_always (priv, l->data);
 
-      if (hd_launcher_item_get_item_type (HD_LAUNCHER_ITEM (items->data)) !=
-                                          HD_APPLICATION_LAUNCHER)
-        continue;
+  hd_app_mgr_state_check ();
+}
 
-      launcher = HD_LAUNCHER_APP (items->data);
-      if (priv->prestart_mode == PRESTART_NEVER ||
-          hd_launcher_app_get_prestart_mode(launcher) != HD_APP_PRESTART_ALWAYS)
-        continue;
+/* After "finished", only the apps of the items which have changed need
+ * to be looked at. */
+static void
+hd_app_mgr_tree_item_added (HdLauncherTree *tree, HdLauncherItem *item,
+                            gpointer data)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (HD_APP_MGR (data));
 
-      /* Look if we already have a running app for it. */
-      link = g_list_find_custom (priv->running_apps, launcher,
-                                 (GCompareFunc)_hd_app_mgr_compare_app_launcher);
-      if (link)
-        /* We dealt with it before. */
-        continue;
+  hd_app_mgr_add_prestart_always (priv, item);
+  hd_app_mgr_state_check ();
+}
 
-      /* Create a new running app for it. */
-      HdRunningApp *app = hd_running_app_new (launcher);
-      priv->running_apps = g_list_prepend (priv->running_apps, app);
-      hd_app_mgr_prestartable (app, TRUE);
-    }
+static void
+hd_app_mgr_tree_item_removed (HdLauncherTree *tree, HdLauncherItem *item,
+                              gpointer data)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (HD_APP_MGR (data));
+
+  if (hd_launcher_item_get_item_type (item) != HD_APPLICATION_LAUNCHER)
+    return;
+
+  hd_app_mgr_rebind_apps (priv, HD_LAUNCHER_APP (item), NULL);
+  hd_app_mgr_state_check ();
+}
+
+static void
+hd_app_mgr_tree_item_changed (HdLauncherTree *tree, HdLauncherItem *item,
+                              HdLauncherItem *old_item, gpointer data)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (HD_APP_MGR (data));
 
-  g_list_free (items_to_free);
+  if (hd_launcher_item_get_item_type (old_item) == HD_APPLICATION_LAUNCHER)
+    hd_app_mgr_rebind_apps (priv, HD_LAUNCHER_APP (old_item),
+                hd_launcher_item_get_item_type (item) == HD_APPLICATION_LAUNCHER
+                  ? HD_LAUNCHER_APP (item) : NULL);
+  hd_app_mgr_add_prestart_always (priv, item);
   hd_app_mgr_state_check ();
 }
 
@@ -1518,16 +1680,84 @@ hd_app_mgr_read_lowmem (const gchar *filename)
 }
 
 /*
- * Returns whether the load average is too high
+ * Returns whether the cpu is idle enough
  * to preload applications.
  */
 static gboolean
 hd_app_mgr_check_loadavg (void)
 {
-  gdouble load = hd_app_mgr_system_load_average ();
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+
+  return !hd_pressure_cpu_is_busy (priv->pressure);
+}
+
+static void
+hd_app_mgr_pressure_changed (HdPressure *pressure,
+                             HdPressureLevel level,
+                             gpointer data)
+{
+  /* Not while hd_app_mgr_get() is still making us. */
+  if (!the_app_mgr)
+    return;
 
-  return (load >= 0.0 &&
-	  load <= LOADAVG_MAX);
+  if (level > HD_PRESSURE_NONE)
+    hd_launcher_trim_memory ();
+  hd_app_mgr_state_check ();
+}
+
+static HdPressure *
+hd_app_mgr_pressure_new (HdAppMgr *self)
+{
+  HdPressureConfig config;
+  gchar *source;
+
+  hd_pressure_config_init (&config);
+
+  source = hd_transition_get_string ("memory_pressure", "source", "auto");
+  if (!g_strcmp0 (source, "psi"))
+    config.source = HD_PRESSURE_SOURCE_PSI;
+  else if (!g_strcmp0 (source, "cgroup"))
+    config.source = HD_PRESSURE_SOURCE_CGROUP;
+  else if (!g_strcmp0 (source, "lowmem"))
+    config.source = HD_PRESSURE_SOURCE_LOWMEM;
+  else if (!g_strcmp0 (source, "none"))
+    config.source = HD_PRESSURE_SOURCE_NONE;
+  g_free (source);
+
+  config.low_on = hd_transition_get_double ("memory_pressure", "low_on",
+                                            config.low_on);
+  config.low_off = hd_transition_get_double ("memory_pressure", "low_off",
+                                             config.low_off);
+  config.critical_on = hd_transition_get_double ("memory_pressure",
+                                                 "critical_on",
+                                                 config.critical_on);
+  config.critical_off = hd_transition_get_double ("memory_pressure",
+                                                  "critical_off",
+                                                  config.critical_off);
+  config.cpu_busy = hd_transition_get_double ("memory_pressure", "cpu_busy",
+                                              config.cpu_busy);
+  config.cgroup_quiet = hd_transition_get_int ("memory_pressure",
+                                               "cgroup_quiet",
+                                               config.cgroup_quiet);
+  config.load_max = LOADAVG_MAX;
+
+  return hd_pressure_new (NULL, &config, hd_app_mgr_pressure_changed, self);
+}
+
+/* Whether we're out of memory, by the lowmem signals or the kernel. */
+static gboolean
+hd_app_mgr_is_lowmem (HdAppMgrPrivate *priv)
+{
+  return priv->lowmem
+    || hd_pressure_get_level (priv->pressure) >= HD_PRESSURE_CRITICAL;
+}
+
+/* Whether we're running low and background apps should go. */
+static gboolean
+hd_app_mgr_is_bg_killing (HdAppMgrPrivate *priv)
+{
+  return priv->bg_killing
+    || hd_pressure_get_level (priv->pressure) >= HD_PRESSURE_LOW;
 }
 
 static HdAppMgrPrestartMode
@@ -1590,7 +1820,7 @@ hd_app_mgr_can_launch (HdLauncherApp *launcher)
   if (launcher && hd_launcher_app_get_ignore_lowmem (launcher))
     return TRUE;
 
-  return !priv->lowmem;
+  return !hd_app_mgr_is_lowmem (priv);
 }
 
 static gboolean hd_app_mgr_can_prestart (HdLauncherApp *launcher)
@@ -1607,6 +1837,9 @@ static gboolean hd_app_mgr_can_prestart (HdLauncherApp *launcher)
   if (!hd_app_mgr_check_loadavg ())
     return FALSE;
 
+  if (hd_pressure_get_level (priv->pressure) > HD_PRESSURE_NONE)
+    return FALSE;
+
   size_t free_pages = hd_app_mgr_read_lowmem (LOWMEM_PROC_FREE);
   if (free_pages == NSIZE)
     return TRUE;
@@ -1656,6 +1889,158 @@ hd_app_mgr_state_check (void)
  * - There are still apps to be prestarted.
  * - If memory is not low enough.
  */
+typedef struct
+{
+  GArray *pids;
+  GArray *mems;
+} MemSampleJob;
+
+static gboolean
+hd_app_mgr_mem_sampled_idle (gpointer data)
+{
+  MemSampleJob *job = data;
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+  guint i;
+
+  g_hash_table_remove_all (priv->mem_sample);
+  for (i = 0; i < job->pids->len; i++)
+    {
+      HdProcMem *mem = g_new (HdProcMem, 1);
+
+      *mem = g_array_index (job->mems, HdProcMem, i);
+      g_hash_table_insert (priv->mem_sample,
+                           GINT_TO_POINTER (g_array_index (job->pids, GPid, i)),
+                           mem);
+    }
+  priv->mem_sample_time = g_get_monotonic_time ();
+  priv->mem_sampling = FALSE;
+
+  g_array_free (job->pids, TRUE);
+  g_array_free (job->mems, TRUE);
+  g_free (job);
+
+  hd_app_mgr_state_check ();
+  return FALSE;
+}
+
+static gpointer
+hd_app_mgr_mem_sample_thread (gpointer data)
+{
+  MemSampleJob *job = data;
+  guint i;
+
+  for (i = 0; i < job->pids->len; i++)
+    hd_proc_mem_read (NULL, g_array_index (job->pids, GPid, i),
+                      &g_array_index (job->mems, HdProcMem, i));
+
+  clutter_threads_add_idle (hd_app_mgr_mem_sampled_idle, job);
+  return NULL;
+}
+
+/* Start reading the memory of the hibernatable apps, unless it's being
+ * read already. */
+static void
+hd_app_mgr_mem_sample (HdAppMgrPrivate *priv)
+{
+  MemSampleJob *job;
+  GList *l;
+
+  if (priv->mem_sampling)
+    return;
+
+  job = g_new (MemSampleJob, 1);
+  job->pids = g_array_new (FALSE, FALSE, sizeof (GPid));
+  for (l = priv->queues[QUEUE_HIBERNATABLE]->head; l; l = l->next)
+    {
+      GPid pid = hd_running_app_get_pid (l->data);
+
+      if (pid > 0)
+        g_array_append_val (job->pids, pid);
+    }
+  job->mems = g_array_sized_new (FALSE, TRUE, sizeof (HdProcMem),
+                                 job->pids->len);
+  g_array_set_size (job->mems, job->pids->len);
+
+  priv->mem_sampling = TRUE;
+  if (hd_disable_threads ())
+    hd_app_mgr_mem_sample_thread (job);
+  else
+    g_thread_unref (g_thread_new ("app-mem",
+                                  hd_app_mgr_mem_sample_thread, job));
+}
+
+/* How much memory needs to be freed to leave the bgkill state, in kB,
+ * or 0 if it's not known. */
+static guint64
+hd_app_mgr_mem_deficit (HdAppMgrPrivate *priv)
+{
+  size_t free_pages = hd_app_mgr_read_lowmem (LOWMEM_PROC_FREE);
+  size_t target;
+
+  if (free_pages == NSIZE
+      || priv->notify_low_pages == NSIZE || priv->nr_decay_pages == NSIZE)
+    return 0;
+
+  target = priv->notify_low_pages + priv->nr_decay_pages;
+  if (free_pages >= target)
+    return 0;
+
+  return (guint64) (target - free_pages) * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+/* Returns the hibernatable apps to hibernate, referenced: the fewest which
+ * free enough memory, preferring the big ones which haven't been used for
+ * a while and aren't predicted to be opened soon. */
+static GList *
+hd_app_mgr_choose_victims (HdAppMgrPrivate *priv)
+{
+  GQueue *queue = priv->queues[QUEUE_HIBERNATABLE];
+  HdProcMemCandidate *candidates = g_new0 (HdProcMemCandidate,
+                                           queue->length);
+  gdouble wakeup_cost = hd_transition_get_double ("memory_pressure",
+                                                  "wakeup_cost", 4);
+  time_t now = time (NULL);
+  GList *l, *victims = NULL;
+  guint i, n_victims;
+
+  for (l = queue->head, i = 0; l; l = l->next, i++)
+    {
+      HdRunningApp *app = l->data;
+      HdLauncherApp *launcher = hd_running_app_get_launcher_app (app);
+      HdProcMem *mem = g_hash_table_lookup (priv->mem_sample,
+                          GINT_TO_POINTER (hd_running_app_get_pid (app)));
+      time_t shown = hd_running_app_get_last_shown (app);
+
+      if (!shown)
+        shown = hd_running_app_get_last_launch (app);
+
+      candidates[i].data = app;
+      if (mem)
+        candidates[i].mem = *mem;
+      candidates[i].idle = shown ? now - shown : 0;
+      /* Waking up an app the user is about to open costs more. */
+      candidates[i].cost = 1.0;
+      if (launcher)
+        candidates[i].cost += wakeup_cost * hd_app_predictor_score (
+                      priv->predictor,
+                      hd_launcher_item_get_id (HD_LAUNCHER_ITEM (launcher)));
+    }
+
+  n_victims = hd_proc_mem_choose_victims (candidates, queue->length,
+                                          hd_app_mgr_mem_deficit (priv));
+  for (i = 0; i < n_victims; i++)
+    {
+      g_debug ("%s: hibernating %s, %" G_GUINT64_FORMAT " kB, score %.0f",
+               __FUNCTION__,
+               hd_running_app_get_id (candidates[i].data),
+               candidates[i].mem.pss, candidates[i].score);
+      victims = g_list_prepend (victims, g_object_ref (candidates[i].data));
+    }
+
+  g_free (candidates);
+  return g_list_reverse (victims);
+}
+
 static gboolean
 hd_app_mgr_state_check_loop (gpointer data)
 {
@@ -1663,7 +2048,7 @@ hd_app_mgr_state_check_loop (gpointer data)
   HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
 
   /* First check if we are really low on memory. */
-  if (priv->lowmem)
+  if (hd_app_mgr_is_lowmem (priv))
     {
       /* If there are prestarted apps, kill one of them. */
       if (!g_queue_is_empty (priv->queues[QUEUE_PRESTARTED]))
@@ -1676,13 +2061,28 @@ hd_app_mgr_state_check_loop (gpointer data)
     }
 
   /* If we're running low, hibernate an app. */
-  else if (priv->bg_killing)
+  else if (hd_app_mgr_is_bg_killing (priv))
     {
-      /* TODO: Hibernate an app and loop. */
       if (!g_queue_is_empty (priv->queues[QUEUE_HIBERNATABLE]))
         {
-          HdRunningApp *app = g_queue_peek_tail (priv->queues[QUEUE_HIBERNATABLE]);
-          hd_app_mgr_hibernate (app);
+          /* Choose by how much memory the apps hold, which is read in
+           * a thread, so wait for it. */
+          if (g_get_monotonic_time () - priv->mem_sample_time > MEM_SAMPLE_AGE)
+            hd_app_mgr_mem_sample (priv);
+          else
+            {
+              GList *victims = hd_app_mgr_choose_victims (priv), *l;
+
+              for (l = victims; l; l = l->next)
+                {
+                  hd_app_mgr_hibernate (l->data);
+                  g_object_unref (l->data);
+                }
+              g_list_free (victims);
+
+              /* Their memory is gone now. */
+              priv->mem_sample_time = 0;
+            }
           if (!g_queue_is_empty (priv->queues[QUEUE_HIBERNATABLE]))
             loop = TRUE;
         }
@@ -1743,6 +2143,12 @@ hd_app_mgr_dbus_name_owner_changed (DBusGProxy *proxy,
   if (!old_owner[0] == !new_owner[0])
     return;
 
+  /* Most of these are of unique connection names, which aren't any
+   * app's service.  The launcher of a running app may be gone from
+   * the tree already, so don't look there. */
+  if (name[0] == ':')
+    return;
+
   /* Check if the service is one we want always on. */
   apps = priv->running_apps;
   while (apps)
@@ -1775,26 +2181,12 @@ hd_app_mgr_dbus_name_owner_changed (DBusGProxy *proxy,
     }
 }
 
-static gint
-_hd_app_mgr_compare_launcher_exec (HdLauncherItem *item,
-                                   gchar *filename)
-{
-  HdLauncherApp *launcher;
-
-  if (hd_launcher_item_get_item_type (item) != HD_APPLICATION_LAUNCHER)
-    return -1;
-
-  launcher = HD_LAUNCHER_APP (item);
-  return g_strcmp0 (hd_launcher_app_get_exec (launcher), filename);
-}
-
 static DBusHandlerResult hd_app_mgr_dbus_app_died (DBusConnection *conn,
                                                    DBusMessage *msg,
                                                    void *data)
 {
   HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
   HdLauncherApp *launcher = NULL;
-  GList *link;
   gchar *filename;
   GPid pid;
   gint status;
@@ -1822,18 +2214,15 @@ static DBusHandlerResult hd_app_mgr_dbus_app_died (DBusConnection *conn,
   }
 
   /* Find which app died. */
-  link = g_list_find_custom (hd_launcher_tree_get_items (priv->tree),
-                             (gconstpointer)filename,
-                             (GCompareFunc)_hd_app_mgr_compare_launcher_exec);
+  launcher = hd_launcher_tree_find_app_by_exec (priv->tree, filename);
 
   /* NOTE: Should we report crashes of app we don't know about? */
   g_debug ("%s: app: %s, filename: %s", __FUNCTION__,
-      link ? hd_launcher_item_get_id (HD_LAUNCHER_ITEM (link->data)) : "<unknown>",
+      launcher ? hd_launcher_item_get_id (HD_LAUNCHER_ITEM (launcher)) : "<unknown>",
       filename);
 
-  if (link)
+  if (launcher)
     {
-      launcher = link->data;
       g_signal_emit (hd_app_mgr_get (), app_mgr_signals[APP_CRASHED],
                      0, launcher, NULL);
     }
@@ -1886,6 +2275,19 @@ hd_app_mgr_dbus_prestart (HdAppMgr *self, const gboolean enable)
   return TRUE;
 }
 
+gboolean
+hd_app_mgr_dbus_get_predictor_stats (HdAppMgr *self,
+                                     guint *launches,
+                                     guint *predicted,
+                                     guint *warm,
+                                     GError **error)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (self);
+
+  hd_app_predictor_get_stats (priv->predictor, launches, predicted, warm);
+  return TRUE;
+}
+
 /* hd_app_mgr_slide_is_open():
  *
  * Check if the Device slide keyboard (also known as hardware keyboard or HKB) is open.
@@ -2040,7 +2442,10 @@ hd_app_mgr_dbus_signal_handler (DBusConnection *conn,
   if (dbus_message_is_signal (msg,
                               LOWMEM_ON_SIGNAL_INTERFACE,
                               LOWMEM_ON_SIGNAL_NAME))
-    priv->lowmem = TRUE;
+    {
+      priv->lowmem = TRUE;
+      hd_launcher_trim_memory ();
+    }
   else if (dbus_message_is_signal (msg,
                                    LOWMEM_OFF_SIGNAL_INTERFACE,
                                    LOWMEM_OFF_SIGNAL_NAME))
@@ -2048,7 +2453,10 @@ hd_app_mgr_dbus_signal_handler (DBusConnection *conn,
   else if (dbus_message_is_signal (msg,
                                    BGKILL_ON_SIGNAL_INTERFACE,
                                    BGKILL_ON_SIGNAL_NAME))
-    priv->bg_killing = TRUE;
+    {
+      priv->bg_killing = TRUE;
+      hd_launcher_trim_memory ();
+    }
   else if (dbus_message_is_signal (msg,
                                    BGKILL_OFF_SIGNAL_INTERFACE,
                                    BGKILL_OFF_SIGNAL_NAME))
@@ -2112,7 +2520,11 @@ hd_app_mgr_dbus_signal_handler (DBusConnection *conn,
     }
 
   if (changed)
-    hd_app_mgr_state_check ();
+    {
+      /* With the lowmem module, these signals are its events. */
+      hd_pressure_check (priv->pressure);
+      hd_app_mgr_state_check ();
+    }
 
   return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
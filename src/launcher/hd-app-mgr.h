@@ -73,6 +73,11 @@ gboolean hd_app_mgr_relaunch_set_top (HdLauncherApp *app);
 /* D-Bus API */
 gboolean hd_app_mgr_dbus_launch_app (HdAppMgr *self, const gchar *id);
 gboolean hd_app_mgr_dbus_prestart (HdAppMgr *self, const gboolean enable);
+gboolean hd_app_mgr_dbus_get_predictor_stats (HdAppMgr *self,
+                                              guint *launches,
+                                              guint *predicted,
+                                              guint *warm,
+                                              GError **error);
 
 /* Controlling running apps. */
 gboolean hd_app_mgr_activate     (HdRunningApp *app);
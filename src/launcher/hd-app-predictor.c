@@ -0,0 +1,540 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-app-predictor.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#define PREDICTOR_MAGIC   0x50414448 /* HDAP */
+#define PREDICTOR_VERSION 1
+
+/* Times of the day, of 3 hours each. */
+#define N_SLOTS           8
+/* Of all the counts, in seconds. */
+#define HALF_LIFE         (7 * 24 * 3600)
+/* An app opened this soon after another one follows it. */
+#define SUCCESSION        (30 * 60)
+/* A launch was predicted if its app was among this many best scores. */
+#define PREDICTED_TOP     3
+/* Launches for the frequency to count half. */
+#define FREQ_HALF         5.0
+/* Smaller counts are forgotten when the history is saved. */
+#define MIN_COUNT         0.01
+/* Seconds from a launch to saving the history. */
+#define SAVE_DELAY        30
+
+/*
+ * The file is laid out as
+ *   FileHeader
+ *   FileApp[n_apps]
+ *   FileNext[n_next]
+ *   strings
+ * in host byte order, like the launcher cache.
+ */
+typedef struct
+{
+  guint32 magic, version;
+  guint32 size;
+  guint32 n_apps, n_next;
+  guint32 strings, strings_size;
+  guint32 launches, predicted, warm;
+} FileHeader;
+
+typedef struct
+{
+  gint64  stamp;
+  guint32 id;
+  /* The apps opened after this one are FileNext[first_next..+n_next-1]. */
+  guint32 first_next, n_next;
+  gfloat  freq;
+  gfloat  slots[N_SLOTS];
+} FileApp;
+
+typedef struct
+{
+  /* Index in FileApp[]. */
+  guint32 app;
+  gfloat  count;
+} FileNext;
+
+typedef struct
+{
+  gchar      *id;
+  /* When the counts were last decayed. */
+  gint64      stamp;
+  gdouble     freq;
+  gdouble     slots[N_SLOTS];
+  /* id -> gdouble *, how often each app was opened after this one */
+  GHashTable *next;
+} AppHistory;
+
+struct _HdAppPredictor
+{
+  gchar      *fname;
+  /* id -> AppHistory */
+  GHashTable *apps;
+
+  /* The last app opened, and when. */
+  gchar      *last_id;
+  gint64      last_time;
+
+  guint32     launches, predicted, warm;
+  guint       save_id;
+};
+
+static AppHistory *
+app_history_new (const gchar *id)
+{
+  AppHistory *app = g_new0 (AppHistory, 1);
+
+  app->id = g_strdup (id);
+  app->next = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                     g_free, g_free);
+  return app;
+}
+
+static void
+app_history_free (AppHistory *app)
+{
+  g_hash_table_destroy (app->next);
+  g_free (app->id);
+  g_free (app);
+}
+
+static gdouble
+decay_factor (gint64 from, gint64 to)
+{
+  return to > from ? exp2 ((gdouble) (from - to) / HALF_LIFE) : 1.0;
+}
+
+static void
+app_history_decay (AppHistory *app, gint64 now)
+{
+  gdouble factor = decay_factor (app->stamp, now);
+  GHashTableIter iter;
+  gpointer count;
+  guint i;
+
+  if (factor < 1.0)
+    {
+      app->freq *= factor;
+      for (i = 0; i < N_SLOTS; i++)
+        app->slots[i] *= factor;
+      g_hash_table_iter_init (&iter, app->next);
+      while (g_hash_table_iter_next (&iter, NULL, &count))
+        *(gdouble *) count *= factor;
+    }
+  app->stamp = MAX (app->stamp, now);
+}
+
+static guint
+time_slot (gint64 now)
+{
+  time_t t = now;
+  struct tm tm;
+
+  localtime_r (&t, &tm);
+  return tm.tm_hour * N_SLOTS / 24;
+}
+
+static gboolean
+hd_app_predictor_load (HdAppPredictor *predictor)
+{
+  const FileHeader *header;
+  const FileApp *apps;
+  const FileNext *next;
+  const gchar *strings;
+  AppHistory **loaded;
+  gchar *contents;
+  gsize size;
+  guint64 tables;
+  guint i, j;
+
+  if (!g_file_get_contents (predictor->fname, &contents, &size, NULL))
+    return FALSE;
+
+  header = (const FileHeader *) contents;
+  if (size < sizeof (*header))
+    tables = 0;
+  else
+    tables = sizeof (*header)
+      + (guint64) header->n_apps * sizeof (FileApp)
+      + (guint64) header->n_next * sizeof (FileNext);
+  if (!tables
+      || header->magic != PREDICTOR_MAGIC
+      || header->version != PREDICTOR_VERSION
+      || header->size != size
+      || tables != header->strings
+      || header->strings_size == 0
+      || (guint64) header->strings + header->strings_size != size
+      || contents[size - 1] != '\0')
+    {
+      g_warning ("%s: %s is invalid", __FUNCTION__, predictor->fname);
+      g_free (contents);
+      return FALSE;
+    }
+
+  apps = (const FileApp *) (header + 1);
+  next = (const FileNext *) (apps + header->n_apps);
+  strings = contents + header->strings;
+
+#define STRING(offset) \
+  ((offset) < header->strings_size ? strings + (offset) : "")
+
+  loaded = g_new0 (AppHistory *, header->n_apps);
+  for (i = 0; i < header->n_apps; i++)
+    {
+      AppHistory *app;
+
+      /* Replacing the first would free what @loaded points to. */
+      if (g_hash_table_lookup (predictor->apps, STRING (apps[i].id)))
+        {
+          g_warning ("%s: %s is in %s twice", __FUNCTION__,
+                     STRING (apps[i].id), predictor->fname);
+          continue;
+        }
+
+      app = app_history_new (STRING (apps[i].id));
+      app->stamp = apps[i].stamp;
+      app->freq = apps[i].freq;
+      for (j = 0; j < N_SLOTS; j++)
+        app->slots[j] = apps[i].slots[j];
+      g_hash_table_replace (predictor->apps, app->id, app);
+      loaded[i] = app;
+    }
+
+  for (i = 0; i < header->n_apps; i++)
+    {
+      if (!loaded[i]
+          || (guint64) apps[i].first_next + apps[i].n_next > header->n_next)
+        continue;
+
+      for (j = apps[i].first_next; j < apps[i].first_next + apps[i].n_next;
+           j++)
+        if (next[j].app < header->n_apps && loaded[next[j].app])
+          {
+            gdouble *count = g_new (gdouble, 1);
+
+            *count = next[j].count;
+            g_hash_table_replace (loaded[i]->next,
+                                  g_strdup (loaded[next[j].app]->id), count);
+          }
+    }
+
+#undef STRING
+
+  predictor->launches = header->launches;
+  predictor->predicted = header->predicted;
+  predictor->warm = header->warm;
+
+  g_free (loaded);
+  g_free (contents);
+  return TRUE;
+}
+
+void
+hd_app_predictor_save (HdAppPredictor *predictor)
+{
+  FileHeader header;
+  GArray *apps, *next;
+  GString *strings, *out;
+  GHashTable *indices;
+  GHashTableIter iter;
+  gpointer value;
+  gint64 now = time (NULL);
+  GError *error = NULL;
+  gchar *dir;
+  guint i;
+
+  if (predictor->save_id)
+    {
+      g_source_remove (predictor->save_id);
+      predictor->save_id = 0;
+    }
+
+  /* Forget the apps which haven't been opened for a long time. */
+  apps = g_array_new (FALSE, FALSE, sizeof (FileApp));
+  strings = g_string_new (NULL);
+  indices = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_iter_init (&iter, predictor->apps);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      AppHistory *app = value;
+      FileApp file_app;
+
+      app_history_decay (app, now);
+      if (app->freq < MIN_COUNT)
+        continue;
+
+      memset (&file_app, 0, sizeof (file_app));
+      file_app.stamp = app->stamp;
+      file_app.id = strings->len;
+      file_app.freq = app->freq;
+      for (i = 0; i < N_SLOTS; i++)
+        file_app.slots[i] = app->slots[i];
+      g_string_append_len (strings, app->id, strlen (app->id) + 1);
+
+      g_hash_table_insert (indices, app->id, GUINT_TO_POINTER (apps->len));
+      g_array_append_val (apps, file_app);
+    }
+  /* So the strings are never empty. */
+  g_string_append_c (strings, '\0');
+
+  next = g_array_new (FALSE, FALSE, sizeof (FileNext));
+  for (i = 0; i < apps->len; i++)
+    {
+      FileApp *file_app = &g_array_index (apps, FileApp, i);
+      AppHistory *app = g_hash_table_lookup (predictor->apps,
+                                             strings->str + file_app->id);
+      gpointer key, index;
+
+      file_app->first_next = next->len;
+      g_hash_table_iter_init (&iter, app->next);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          FileNext file_next;
+
+          if (*(gdouble *) value < MIN_COUNT
+              || !g_hash_table_lookup_extended (indices, key, NULL, &index))
+            continue;
+
+          file_next.app = GPOINTER_TO_UINT (index);
+          file_next.count = *(gdouble *) value;
+          g_array_append_val (next, file_next);
+        }
+      file_app->n_next = next->len - file_app->first_next;
+    }
+
+  memset (&header, 0, sizeof (header));
+  header.magic = PREDICTOR_MAGIC;
+  header.version = PREDICTOR_VERSION;
+  header.n_apps = apps->len;
+  header.n_next = next->len;
+  header.strings = sizeof (header)
+    + apps->len * sizeof (FileApp)
+    + next->len * sizeof (FileNext);
+  header.strings_size = strings->len;
+  header.size = header.strings + header.strings_size;
+  header.launches = predictor->launches;
+  header.predicted = predictor->predicted;
+  header.warm = predictor->warm;
+
+  out = g_string_sized_new (header.size);
+  g_string_append_len (out, (gchar *) &header, sizeof (header));
+  g_string_append_len (out, apps->data, apps->len * sizeof (FileApp));
+  g_string_append_len (out, next->data, next->len * sizeof (FileNext));
+  g_string_append_len (out, strings->str, strings->len);
+
+  dir = g_path_get_dirname (predictor->fname);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+
+  if (!g_file_set_contents (predictor->fname, out->str, out->len, &error))
+    {
+      g_warning ("%s: %s", __FUNCTION__, error->message);
+      g_error_free (error);
+    }
+
+  g_string_free (out, TRUE);
+  g_string_free (strings, TRUE);
+  g_array_free (next, TRUE);
+  g_array_free (apps, TRUE);
+  g_hash_table_destroy (indices);
+}
+
+static gboolean
+hd_app_predictor_save_timeout (gpointer data)
+{
+  HdAppPredictor *predictor = data;
+
+  predictor->save_id = 0;
+  hd_app_predictor_save (predictor);
+  return FALSE;
+}
+
+HdAppPredictor *
+hd_app_predictor_new (const gchar *fname)
+{
+  HdAppPredictor *predictor = g_new0 (HdAppPredictor, 1);
+
+  predictor->fname = g_strdup (fname);
+  predictor->apps = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                           (GDestroyNotify) app_history_free);
+  hd_app_predictor_load (predictor);
+
+  return predictor;
+}
+
+void
+hd_app_predictor_free (HdAppPredictor *predictor)
+{
+  if (!predictor)
+    return;
+
+  if (predictor->save_id)
+    g_source_remove (predictor->save_id);
+  g_hash_table_destroy (predictor->apps);
+  g_free (predictor->last_id);
+  g_free (predictor->fname);
+  g_free (predictor);
+}
+
+static gdouble
+hd_app_predictor_score_at (HdAppPredictor *predictor, const gchar *id,
+                           gint64 now, guint slot)
+{
+  AppHistory *app, *last;
+  gdouble freq, in_slot = 0, after_last = 0, sum;
+  GHashTableIter iter;
+  gpointer value;
+  guint i;
+
+  if (!id || !(app = g_hash_table_lookup (predictor->apps, id)))
+    return 0;
+
+  /* How often it's opened at all... */
+  freq = app->freq * decay_factor (app->stamp, now);
+  freq = freq / (freq + FREQ_HALF);
+
+  /* ...at this time of the day... */
+  for (i = 0, sum = 0; i < N_SLOTS; i++)
+    sum += app->slots[i];
+  if (sum > 0)
+    in_slot = app->slots[slot] / sum;
+
+  /* ...and after the app opened last. */
+  if (predictor->last_id && now - predictor->last_time < SUCCESSION
+      && (last = g_hash_table_lookup (predictor->apps, predictor->last_id)))
+    {
+      gdouble *count = g_hash_table_lookup (last->next, id);
+
+      sum = 0;
+      g_hash_table_iter_init (&iter, last->next);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        sum += *(gdouble *) value;
+      if (count && sum > 0)
+        after_last = *count / sum;
+    }
+
+  return 0.4 * freq + 0.3 * in_slot + 0.3 * after_last;
+}
+
+gdouble
+hd_app_predictor_score (HdAppPredictor *predictor, const gchar *id)
+{
+  gint64 now = time (NULL);
+
+  return hd_app_predictor_score_at (predictor, id, now, time_slot (now));
+}
+
+/* Whether @id has one of the PREDICTED_TOP best scores. */
+static gboolean
+hd_app_predictor_is_predicted (HdAppPredictor *predictor, const gchar *id,
+                               gint64 now, guint slot)
+{
+  gdouble score = hd_app_predictor_score_at (predictor, id, now, slot);
+  GHashTableIter iter;
+  gpointer key;
+  guint better = 0;
+
+  if (score <= 0)
+    return FALSE;
+
+  g_hash_table_iter_init (&iter, predictor->apps);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    if (hd_app_predictor_score_at (predictor, key, now, slot) > score
+        && ++better >= PREDICTED_TOP)
+      return FALSE;
+
+  return TRUE;
+}
+
+void
+hd_app_predictor_record (HdAppPredictor *predictor, const gchar *id,
+                         HdAppPredictorLaunch launch)
+{
+  gint64 now = time (NULL);
+  guint slot = time_slot (now);
+  AppHistory *app;
+
+  if (!id)
+    return;
+
+  if (launch != HD_APP_PREDICTOR_RUNNING)
+    {
+      predictor->launches++;
+      if (launch == HD_APP_PREDICTOR_WARM)
+        predictor->warm++;
+      if (hd_app_predictor_is_predicted (predictor, id, now, slot))
+        predictor->predicted++;
+    }
+
+  if (!(app = g_hash_table_lookup (predictor->apps, id)))
+    {
+      app = app_history_new (id);
+      app->stamp = now;
+      g_hash_table_insert (predictor->apps, app->id, app);
+    }
+  app_history_decay (app, now);
+  app->freq += 1;
+  app->slots[slot] += 1;
+
+  if (predictor->last_id && strcmp (predictor->last_id, id)
+      && now - predictor->last_time < SUCCESSION)
+    {
+      AppHistory *last = g_hash_table_lookup (predictor->apps,
+                                              predictor->last_id);
+      gdouble *count;
+
+      if (last)
+        {
+          app_history_decay (last, now);
+          if (!(count = g_hash_table_lookup (last->next, id)))
+            {
+              count = g_new0 (gdouble, 1);
+              g_hash_table_insert (last->next, g_strdup (id), count);
+            }
+          *count += 1;
+        }
+    }
+
+  g_free (predictor->last_id);
+  predictor->last_id = g_strdup (id);
+  predictor->last_time = now;
+
+  if (!predictor->save_id)
+    predictor->save_id = g_timeout_add_seconds (SAVE_DELAY,
+                                                hd_app_predictor_save_timeout,
+                                                predictor);
+}
+
+void
+hd_app_predictor_get_stats (HdAppPredictor *predictor,
+                            guint *launches, guint *predicted, guint *warm)
+{
+  *launches = predictor->launches;
+  *predicted = predictor->predicted;
+  *warm = predictor->warm;
+}
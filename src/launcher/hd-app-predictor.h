@@ -0,0 +1,72 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * An HdAppPredictor learns which apps the user opens: how often, at what
+ * time of the day and after which other app.  All the counts decay with
+ * a half-life of a week, so old habits are forgotten.  It scores the apps
+ * by how likely they are to be opened next, which HdAppMgr uses to order
+ * its prestart and hibernation queues.
+ *
+ * The history is kept in a small binary file, written some time after
+ * the last launch and when hildon-desktop exits.
+ */
+
+#ifndef __HD_APP_PREDICTOR_H__
+#define __HD_APP_PREDICTOR_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _HdAppPredictor HdAppPredictor;
+
+typedef enum
+{
+  /* The app wasn't running. */
+  HD_APP_PREDICTOR_COLD,
+  /* It was prestarted, so the prediction paid off. */
+  HD_APP_PREDICTOR_WARM,
+  /* It was running already and was switched to. */
+  HD_APP_PREDICTOR_RUNNING
+} HdAppPredictorLaunch;
+
+HdAppPredictor *hd_app_predictor_new    (const gchar *fname);
+void            hd_app_predictor_free   (HdAppPredictor *predictor);
+void            hd_app_predictor_save   (HdAppPredictor *predictor);
+
+/* The user has opened the app @id. */
+void            hd_app_predictor_record (HdAppPredictor *predictor,
+                                         const gchar *id,
+                                         HdAppPredictorLaunch launch);
+
+/* How likely @id is to be opened next, between 0 and 1. */
+gdouble         hd_app_predictor_score  (HdAppPredictor *predictor,
+                                         const gchar *id);
+
+/* Of the launches of apps which weren't running, how many were of one of
+ * the top predictions and how many found their app prestarted. */
+void            hd_app_predictor_get_stats (HdAppPredictor *predictor,
+                                            guint *launches,
+                                            guint *predicted,
+                                            guint *warm);
+
+G_END_DECLS
+
+#endif /* __HD_APP_PREDICTOR_H__ */
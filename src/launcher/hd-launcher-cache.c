@@ -0,0 +1,397 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-launcher-cache.h"
+#include "hd-launcher-item.h"
+
+#include <sys/stat.h>
+#include <string.h>
+
+#define CACHE_MAGIC   0x434c4448 /* HDLC */
+#define CACHE_VERSION 2
+
+/*
+ * The file is laid out as
+ *   CacheHeader
+ *   CacheDir[n_dirs]
+ *   CacheItem[n_items]
+ *   CacheKey[n_keys]
+ *   strings
+ * in host byte order.  Strings are referred to by their offset from the
+ * start of the strings, and they are all NUL-terminated.
+ */
+typedef struct
+{
+  guint32 magic, version;
+  /* Of the whole file. */
+  guint32 size;
+  guint32 hash;
+  guint32 n_dirs, n_items, n_keys;
+  guint32 strings, strings_size;
+  guint32 unused;
+} CacheHeader;
+
+typedef struct
+{
+  guint32 path, unused;
+  gint64  mtime_sec, mtime_nsec;
+} CacheDir;
+
+typedef struct
+{
+  guint32 id, category;
+  /* The item's keys are CacheKey[first_key..first_key+n_keys-1]. */
+  guint32 first_key, n_keys;
+  guint32 hash;
+} CacheItem;
+
+typedef struct
+{
+  guint32 key, value;
+} CacheKey;
+
+struct _HdLauncherCache
+{
+  GArray     *dirs, *items, *keys;
+  GString    *strings;
+  /* string -> its offset + 1 in @strings */
+  GHashTable *string_offsets;
+  /* path -> nothing, the directories in @dirs */
+  GHashTable *dir_paths;
+  /* Of all the items and of the one being added. */
+  guint32     hash, item_hash;
+};
+
+HdLauncherCache *
+hd_launcher_cache_new (void)
+{
+  HdLauncherCache *cache;
+
+  cache = g_new0 (HdLauncherCache, 1);
+  cache->dirs = g_array_new (FALSE, FALSE, sizeof (CacheDir));
+  cache->items = g_array_new (FALSE, FALSE, sizeof (CacheItem));
+  cache->keys = g_array_new (FALSE, FALSE, sizeof (CacheKey));
+  cache->strings = g_string_new (NULL);
+  cache->string_offsets = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                 g_free, NULL);
+  cache->dir_paths = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            g_free, NULL);
+  /* FNV-1a */
+  cache->hash = 2166136261U;
+
+  return cache;
+}
+
+void
+hd_launcher_cache_free (HdLauncherCache *cache)
+{
+  if (!cache)
+    return;
+
+  g_array_free (cache->dirs, TRUE);
+  g_array_free (cache->items, TRUE);
+  g_array_free (cache->keys, TRUE);
+  g_string_free (cache->strings, TRUE);
+  g_hash_table_destroy (cache->string_offsets);
+  g_hash_table_destroy (cache->dir_paths);
+  g_free (cache);
+}
+
+/* Add @str to the strings unless it's there already, and to the hashes
+ * of the items if @hash. */
+static guint32
+hd_launcher_cache_add_string (HdLauncherCache *cache, const gchar *str,
+                              gboolean hash)
+{
+  gpointer offset;
+
+  if (hash)
+    {
+      const guchar *p = (const guchar *)str;
+
+      do
+        {
+          cache->hash ^= *p;
+          cache->hash *= 16777619U;
+          cache->item_hash ^= *p;
+          cache->item_hash *= 16777619U;
+        }
+      while (*p++);
+    }
+
+  if ((offset = g_hash_table_lookup (cache->string_offsets, str)) != NULL)
+    return GPOINTER_TO_UINT (offset) - 1;
+
+  offset = GUINT_TO_POINTER (cache->strings->len + 1);
+  g_hash_table_insert (cache->string_offsets, g_strdup (str), offset);
+  g_string_append_len (cache->strings, str, strlen (str) + 1);
+
+  return GPOINTER_TO_UINT (offset) - 1;
+}
+
+static void
+hd_launcher_cache_add_dir (HdLauncherCache *cache, const gchar *path)
+{
+  CacheDir dir;
+  struct stat st;
+
+  if (g_hash_table_lookup_extended (cache->dir_paths, path, NULL, NULL))
+    return;
+  g_hash_table_insert (cache->dir_paths, g_strdup (path), NULL);
+
+  if (stat (path, &st))
+    return;
+
+  memset (&dir, 0, sizeof (dir));
+  dir.path = hd_launcher_cache_add_string (cache, path, FALSE);
+  dir.mtime_sec = st.st_mtim.tv_sec;
+  dir.mtime_nsec = st.st_mtim.tv_nsec;
+  g_array_append_val (cache->dirs, dir);
+}
+
+guint32
+hd_launcher_cache_add_item (HdLauncherCache *cache,
+                            const gchar *id, const gchar *category,
+                            GKeyFile *key_file, const gchar *path)
+{
+  CacheItem item;
+  gchar **keys, *dir;
+  guint i;
+
+  cache->item_hash = 2166136261U;
+  item.id = hd_launcher_cache_add_string (cache, id, TRUE);
+  item.category = hd_launcher_cache_add_string (cache,
+                                                category ? category : "",
+                                                TRUE);
+  item.first_key = cache->keys->len;
+  item.n_keys = 0;
+
+  /* The translations are looked up with gettext, not from here. */
+  keys = g_key_file_get_keys (key_file, HD_DESKTOP_ENTRY_GROUP, NULL, NULL);
+  for (i = 0; keys && keys[i]; i++)
+    {
+      CacheKey key;
+      gchar *value;
+
+      if (strchr (keys[i], '['))
+        continue;
+      if (!(value = g_key_file_get_value (key_file, HD_DESKTOP_ENTRY_GROUP,
+                                          keys[i], NULL)))
+        continue;
+
+      key.key = hd_launcher_cache_add_string (cache, keys[i], TRUE);
+      key.value = hd_launcher_cache_add_string (cache, value, TRUE);
+      g_array_append_val (cache->keys, key);
+      item.n_keys++;
+      g_free (value);
+    }
+  g_strfreev (keys);
+
+  item.hash = cache->item_hash;
+  g_array_append_val (cache->items, item);
+
+  dir = g_path_get_dirname (path);
+  hd_launcher_cache_add_dir (cache, dir);
+  g_free (dir);
+
+  return item.hash;
+}
+
+guint32
+hd_launcher_cache_get_hash (HdLauncherCache *cache)
+{
+  return cache->hash;
+}
+
+gboolean
+hd_launcher_cache_write (HdLauncherCache *cache, const gchar *fname)
+{
+  CacheHeader header;
+  GString *out;
+  gchar *old, *dir;
+  gsize old_size;
+  GError *error = NULL;
+  gboolean written = FALSE;
+
+  memset (&header, 0, sizeof (header));
+  header.magic = CACHE_MAGIC;
+  header.version = CACHE_VERSION;
+  header.hash = cache->hash;
+  header.n_dirs = cache->dirs->len;
+  header.n_items = cache->items->len;
+  header.n_keys = cache->keys->len;
+  header.strings = sizeof (header)
+    + cache->dirs->len * sizeof (CacheDir)
+    + cache->items->len * sizeof (CacheItem)
+    + cache->keys->len * sizeof (CacheKey);
+  header.strings_size = cache->strings->len;
+  header.size = header.strings + header.strings_size;
+
+  out = g_string_sized_new (header.size);
+  g_string_append_len (out, (gchar *)&header, sizeof (header));
+  g_string_append_len (out, cache->dirs->data,
+                       cache->dirs->len * sizeof (CacheDir));
+  g_string_append_len (out, cache->items->data,
+                       cache->items->len * sizeof (CacheItem));
+  g_string_append_len (out, cache->keys->data,
+                       cache->keys->len * sizeof (CacheKey));
+  g_string_append_len (out, cache->strings->str, cache->strings->len);
+
+  /* Don't wear the flash if nothing has changed. */
+  if (g_file_get_contents (fname, &old, &old_size, NULL))
+    {
+      gboolean same = old_size == out->len && !memcmp (old, out->str,
+                                                       out->len);
+      g_free (old);
+      if (same)
+        goto out;
+    }
+
+  dir = g_path_get_dirname (fname);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+
+  if (g_file_set_contents (fname, out->str, out->len, &error))
+    written = TRUE;
+  else
+    {
+      g_warning ("%s: %s", __FUNCTION__, error->message);
+      g_error_free (error);
+    }
+
+out:
+  g_string_free (out, TRUE);
+  return written;
+}
+
+/* Check the tables of @header are within the file. */
+static gboolean
+hd_launcher_cache_header_is_valid (const CacheHeader *header, gsize size)
+{
+  guint64 tables;
+
+  if (size < sizeof (*header)
+      || header->magic != CACHE_MAGIC
+      || header->version != CACHE_VERSION
+      || header->size != size)
+    return FALSE;
+
+  tables = sizeof (*header)
+    + (guint64)header->n_dirs * sizeof (CacheDir)
+    + (guint64)header->n_items * sizeof (CacheItem)
+    + (guint64)header->n_keys * sizeof (CacheKey);
+  return tables == header->strings
+    && header->strings_size > 0
+    && (guint64)header->strings + header->strings_size == size
+    && ((const gchar *)header)[size - 1] == '\0';
+}
+
+GList *
+hd_launcher_cache_read (const gchar *fname, guint32 *hash)
+{
+  GMappedFile *file;
+  const CacheHeader *header;
+  const CacheDir *dirs;
+  const CacheItem *items;
+  const CacheKey *keys;
+  const gchar *strings;
+  GList *result = NULL;
+  guint i, j;
+
+  if (!(file = g_mapped_file_new (fname, FALSE, NULL)))
+    return NULL;
+
+  header = (const CacheHeader *)g_mapped_file_get_contents (file);
+  if (!hd_launcher_cache_header_is_valid (header,
+                                          g_mapped_file_get_length (file)))
+    {
+      g_warning ("%s: %s is invalid", __FUNCTION__, fname);
+      goto out;
+    }
+
+  dirs = (const CacheDir *)(header + 1);
+  items = (const CacheItem *)(dirs + header->n_dirs);
+  keys = (const CacheKey *)(items + header->n_items);
+  strings = (const gchar *)header + header->strings;
+
+#define STRING(offset) \
+  ((offset) < header->strings_size ? strings + (offset) : "")
+
+  for (i = 0; i < header->n_dirs; i++)
+    {
+      struct stat st;
+
+      if (stat (STRING (dirs[i].path), &st)
+          || st.st_mtim.tv_sec != dirs[i].mtime_sec
+          || st.st_mtim.tv_nsec != dirs[i].mtime_nsec)
+        {
+          g_debug ("%s: %s has changed", __FUNCTION__,
+                   STRING (dirs[i].path));
+          goto out;
+        }
+    }
+
+  for (i = 0; i < header->n_items; i++)
+    {
+      HdLauncherItem *item;
+      GKeyFile *key_file;
+
+      if ((guint64)items[i].first_key + items[i].n_keys > header->n_keys)
+        {
+          g_warning ("%s: %s is invalid", __FUNCTION__, fname);
+          g_list_foreach (result, (GFunc) g_object_unref, NULL);
+          g_list_free (result);
+          result = NULL;
+          goto out;
+        }
+
+      key_file = g_key_file_new ();
+      for (j = 0; j < items[i].n_keys; j++)
+        {
+          const CacheKey *key = &keys[items[i].first_key + j];
+          g_key_file_set_value (key_file, HD_DESKTOP_ENTRY_GROUP,
+                                STRING (key->key), STRING (key->value));
+        }
+
+      item = hd_launcher_item_new_from_keyfile (STRING (items[i].id),
+                                                *STRING (items[i].category)
+                                                  ? STRING (items[i].category)
+                                                  : NULL,
+                                                key_file, NULL);
+      if (item)
+        {
+          hd_launcher_item_set_content_hash (item, items[i].hash);
+          result = g_list_prepend (result, item);
+        }
+      g_key_file_free (key_file);
+    }
+
+#undef STRING
+
+  result = g_list_reverse (result);
+  *hash = header->hash;
+
+out:
+  g_mapped_file_unref (file);
+  return result;
+}
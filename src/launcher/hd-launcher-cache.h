@@ -0,0 +1,66 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * An HdLauncherCache is what a walk of the menu tree found, in a binary
+ * file which can be mmap()ed at the next start instead of parsing the
+ * menu and every .desktop file again.  For each item it keeps the id,
+ * the category and the untranslated keys of the desktop entry, so the
+ * items are made by the usual hd_launcher_item_new_from_keyfile().
+ *
+ * The cache is valid as long as none of the directories the .desktop
+ * files came from has been modified since.  Installing or removing a
+ * package replaces files by renaming, so it changes the directory.
+ */
+
+#ifndef __HD_LAUNCHER_CACHE_H__
+#define __HD_LAUNCHER_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _HdLauncherCache HdLauncherCache;
+
+HdLauncherCache *hd_launcher_cache_new      (void);
+void             hd_launcher_cache_free     (HdLauncherCache *cache);
+
+/* Record an item made from @key_file, which was read from @path.
+ * Returns the hash of the item's contents. */
+guint32          hd_launcher_cache_add_item (HdLauncherCache *cache,
+                                             const gchar *id,
+                                             const gchar *category,
+                                             GKeyFile *key_file,
+                                             const gchar *path);
+
+/* Identifies the items recorded, but not where they came from. */
+guint32          hd_launcher_cache_get_hash (HdLauncherCache *cache);
+
+/* Write @cache to @fname, unless it's there already. */
+gboolean         hd_launcher_cache_write    (HdLauncherCache *cache,
+                                             const gchar *fname);
+
+/* Returns the items of the cache in @fname and sets @hash, or returns
+ * NULL if there's no valid cache there. */
+GList *          hd_launcher_cache_read     (const gchar *fname,
+                                             guint32 *hash);
+
+G_END_DECLS
+
+#endif /* __HD_LAUNCHER_CACHE_H__ */
@@ -42,6 +42,7 @@
 #include "hd-app-mgr.h"
 #include "hd-launcher.h"
 #include "hd-launcher-item.h"
+#include "hd-launcher-icons.h"
 #include "hd-launcher-tile.h"
 
 #include "home/hd-render-manager.h"
@@ -110,70 +111,22 @@ _hd_launcher_editor_load (HdLauncherEditor *editor)
   HdLauncherEditorPrivate *priv = HD_LAUNCHER_EDITOR (editor)->priv;
   HdLauncherTree *tree;
   GList *entries;
-  GtkIconTheme *icon_theme = gtk_icon_theme_get_default ();
 
   tree = hd_app_mgr_get_tree();
   entries = hd_launcher_tree_get_items(tree);
   while (entries)
     {
       HdLauncherItem *item = entries->data;
-      const gchar *icon_fname = NULL;
-      const gchar *icon_name = NULL;
-      GtkIconInfo *icon_info = NULL;
-      GdkPixbuf *pixbuf = NULL;
+      GdkPixbuf *pixbuf;
 
       const gchar* category = hd_launcher_item_get_category(item);
       if (editor->category && strcmp(category, editor->category)) {
           goto next;
       }
 
-      icon_name = hd_launcher_item_get_icon_name (item);
-
-      /* The desktop file contains path to the icon. */
-      if (g_file_test (icon_name, G_FILE_TEST_EXISTS)
-            && (g_strrstr (icon_name, ".png") != NULL))
-        {
-          icon_fname = icon_name;
-        }
-      else
-        {
-          /* Try to get the 64x64 icon. */
-          if (icon_name)
-            {
-              icon_info = gtk_icon_theme_lookup_icon (icon_theme,
-                                          icon_name,
-                                          HD_LAUNCHER_TILE_ICON_REAL_SIZE,
-                                          GTK_ICON_LOOKUP_NO_SVG);
-            }
-          if (icon_info == NULL)
-            {
-              /* Try to get the Harmattan (80x80) icon. The icon will be scaled 
-               * down to 64x64. */
-              icon_info = gtk_icon_theme_lookup_icon(icon_theme, 
-                                                icon_name,
-                                                HD_LAUNCHER_TILE_ICON_REAL_SIZE_HARMATTAN_COMP,
-                                                GTK_ICON_LOOKUP_NO_SVG);
-            }
-          if (icon_info == NULL)
-            {
-              /* Try to load the default icon. */
-              icon_info = gtk_icon_theme_lookup_icon(icon_theme,
-                                                HD_LAUNCHER_DEFAULT_ICON,
-                                                HD_LAUNCHER_TILE_ICON_REAL_SIZE,
-                                                GTK_ICON_LOOKUP_NO_SVG);
-            }
-          if (icon_info)
-            {
-              icon_fname = gtk_icon_info_get_filename (icon_info);
-            }
-        }
-
-      if (icon_fname)
-        {
-          pixbuf = gdk_pixbuf_new_from_file_at_size(icon_fname,
-                                          HD_LAUNCHER_TILE_ICON_REAL_SIZE,
-                                          HD_LAUNCHER_TILE_ICON_REAL_SIZE, 0);
-        }
+      /* Decoded already for the tiles. */
+      pixbuf = hd_launcher_icons_get_pixbuf (
+                                  hd_launcher_item_get_icon_name (item));
 
       gtk_list_store_insert_with_values (GTK_LIST_STORE (priv->model),
                  NULL, -1,
@@ -181,6 +134,8 @@ _hd_launcher_editor_load (HdLauncherEditor *editor)
                  COL_LABEL, hd_launcher_item_get_local_name(item),
                  COL_DESKTOP_ID, hd_launcher_item_get_id(item),
                  -1);
+      if (pixbuf)
+        g_object_unref (pixbuf);
 
 next:
       entries = entries->next;
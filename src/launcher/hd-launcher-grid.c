@@ -90,6 +90,9 @@ struct _HdLauncherGridPrivate
   /* an internal status indicating how to relayout the grid (which usually is
    * the same of the real device orientation, but may not be in sync with it) */
   gboolean is_portrait;
+
+  /* How many rows above and below the visible ones get their icons. */
+  gint preload_rows;
 };
 
 enum
@@ -116,6 +119,7 @@ static gboolean _hd_launcher_grid_blocker_release_cb (ClutterActor *actor,
                                         gpointer *data);
 
 static gboolean      hd_launcher_grid_is_portrait (HdLauncherGrid *self);
+static void          hd_launcher_grid_materialize_visible (HdLauncherGrid *grid);
 #define HD_LAUNCHER_GRID_MAX_COLUMNS_LANDSCAPE (int)(HD_COMP_MGR_LANDSCAPE_WIDTH/160)
 #define HD_LAUNCHER_GRID_MAX_COLUMNS_PORTRAIT (int)(HD_COMP_MGR_PORTRAIT_WIDTH/160)
 
@@ -241,6 +245,8 @@ adjustment_value_notify (GObject    *gobject,
   clutter_actor_set_anchor_point(grid,
                              0,
                              tidy_adjustment_get_value(priv->v_adjustment));
+
+  hd_launcher_grid_materialize_visible (HD_LAUNCHER_GRID (grid));
 }
 
 static void
@@ -569,6 +575,75 @@ void hd_launcher_grid_layout (HdLauncherGrid *grid)
 
   if (priv->v_adjustment)
     hd_launcher_grid_refresh_v_adjustment (grid);
+
+  hd_launcher_grid_materialize_visible (grid);
+}
+
+/* Returns the part of @grid which tiles should have their icons in:
+ * what is visible, and @priv->preload_rows rows above and below it. */
+static void
+hd_launcher_grid_get_materialize_range (HdLauncherGrid *grid,
+                                        gint *top, gint *bottom)
+{
+  HdLauncherGridPrivate *priv = grid->priv;
+  gint margin;
+
+  margin = priv->preload_rows * (HD_LAUNCHER_TILE_HEIGHT + priv->v_spacing);
+  *top = (priv->v_adjustment
+          ? (gint) tidy_adjustment_get_value (priv->v_adjustment)
+          : 0) - margin;
+  *bottom = *top + margin * 2 + (hd_launcher_grid_is_portrait (grid)
+                                 ? HD_COMP_MGR_PORTRAIT_HEIGHT
+                                 : HD_COMP_MGR_LANDSCAPE_HEIGHT);
+}
+
+/* Give their icons to the tiles around the visible part of @grid.  The
+ * tiles are in layout order, so this stops at the first one below it. */
+static void
+hd_launcher_grid_materialize_visible (HdLauncherGrid *grid)
+{
+  HdLauncherGridPrivate *priv = grid->priv;
+  gint top, bottom;
+  GList *l;
+
+  hd_launcher_grid_get_materialize_range (grid, &top, &bottom);
+  for (l = priv->tiles; l; l = l->next)
+    {
+      gint y = clutter_actor_get_y (l->data);
+
+      if (y >= bottom)
+        break;
+      if (y + HD_LAUNCHER_TILE_HEIGHT > top)
+        hd_launcher_tile_set_materialized (l->data, TRUE);
+    }
+}
+
+/* hd_launcher_grid_release_tiles:
+ * @grid: launcher's grid
+ * @all: whether to release the visible tiles too
+ *
+ * Takes the icons from the tiles which are out of sight, or from all of
+ * them if @all (when @grid isn't shown).  They get them back when they
+ * are scrolled to or the grid is shown again.
+ */
+void
+hd_launcher_grid_release_tiles (HdLauncherGrid *grid, gboolean all)
+{
+  HdLauncherGridPrivate *priv;
+  gint top, bottom;
+  GList *l;
+
+  g_return_if_fail (HD_IS_LAUNCHER_GRID (grid));
+
+  priv = grid->priv;
+  hd_launcher_grid_get_materialize_range (grid, &top, &bottom);
+  for (l = priv->tiles; l; l = l->next)
+    {
+      gint y = clutter_actor_get_y (l->data);
+
+      if (all || y >= bottom || y + HD_LAUNCHER_TILE_HEIGHT <= top)
+        hd_launcher_tile_set_materialized (l->data, FALSE);
+    }
 }
 
 static void
@@ -729,6 +804,8 @@ hd_launcher_grid_init (HdLauncherGrid *launcher)
   /* set grid's orientation and h/v_spacing values to landscape by default */
   hd_launcher_grid_set_portrait (launcher, FALSE);
 
+  priv->preload_rows = hd_transition_get_int ("launcher", "preload_rows", 1);
+
   clutter_actor_set_reactive (CLUTTER_ACTOR (launcher), FALSE);
 
   g_signal_connect(
@@ -764,6 +841,25 @@ hd_launcher_grid_clear (HdLauncherGrid *grid)
     }
 }
 
+/* Move @tile to @position among the tiles of @grid, or to the end if
+ * @position is negative.  The grid needs to be laid out again. */
+void
+hd_launcher_grid_move_tile (HdLauncherGrid *grid, ClutterActor *tile,
+                            gint position)
+{
+  HdLauncherGridPrivate *priv;
+  GList *l;
+
+  g_return_if_fail (HD_IS_LAUNCHER_GRID (grid));
+
+  priv = grid->priv;
+  if (!(l = g_list_find (priv->tiles, tile)))
+    return;
+
+  priv->tiles = g_list_delete_link (priv->tiles, l);
+  priv->tiles = g_list_insert (priv->tiles, tile, position);
+}
+
 /* Reset the grid before it is shown */
 void
 hd_launcher_grid_reset(HdLauncherGrid *grid, gboolean hard)
@@ -829,6 +925,9 @@ hd_launcher_grid_transition_begin(HdLauncherGrid *grid,
       if (priv->v_adjustment)
         tidy_adjustment_set_valuex (priv->v_adjustment, 0);
     }
+
+  /* The tiles may have been released while the grid was away. */
+  hd_launcher_grid_materialize_visible (grid);
 }
 
 void
@@ -0,0 +1,899 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-launcher-icons.h"
+#include "hd-launcher.h"
+#include "hd-launcher-tile.h"
+#include "hildon-desktop.h"
+
+#include <clutter/clutter.h>
+#include <gtk/gtk.h>
+
+#include <sys/stat.h>
+#include <string.h>
+
+/* A power of two, and it holds (512 / 66)^2 = 49 icons, which fit in
+ * the 64 bits of HdLauncherAtlas::used. */
+#define ATLAS_SIZE    512
+#define SLOT_SIZE     HD_LAUNCHER_TILE_ICON_SIZE
+#define SLOTS_PER_ROW (ATLAS_SIZE / SLOT_SIZE)
+#define N_SLOTS       (SLOTS_PER_ROW * SLOTS_PER_ROW)
+
+/* Write the cache this many seconds after decoding new icons. */
+#define SAVE_DELAY    5
+
+#define CACHE_MAGIC   0x49434c48 /* HLCI */
+#define CACHE_VERSION 1
+
+/*
+ * The cache file is laid out as
+ *   CacheHeader
+ *   CacheIcon[n_icons]
+ *   strings
+ *   pixels
+ * in host byte order.  Strings are referred to by their offset from the
+ * start of the strings, and they are all NUL-terminated.
+ */
+typedef struct
+{
+  guint32 magic, version;
+  /* Of the whole file. */
+  guint32 size;
+  /* The icon theme the icons are from. */
+  guint32 theme;
+  guint32 n_icons;
+  guint32 strings, strings_size;
+  guint32 pixels;
+} CacheHeader;
+
+typedef struct
+{
+  guint32 name, file;
+  gint64  mtime_sec, mtime_nsec;
+  guint32 width, height;
+  /* From the start of the pixels, width * height * 4 bytes. */
+  guint32 pixels, unused;
+} CacheIcon;
+
+typedef struct
+{
+  ClutterTexture *texture;
+  /* Bit n is set if slot n is taken. */
+  guint64         used;
+} HdLauncherAtlas;
+
+typedef struct
+{
+  /* NULL if there's no such icon in the theme. */
+  gchar          *file;
+  gint64          mtime_sec, mtime_nsec;
+  /* Came from the cache or from before the theme changed, so @file
+   * may not be the right one any more. */
+  gboolean        unchecked;
+
+  /* RGBA with the border, NULL until decoded.  Either @own_pixels or
+   * in the mapped cache. */
+  const guchar   *pixels;
+  guchar         *own_pixels;
+  guint           width, height;
+
+  /* NULL unless a texture shows it. */
+  HdLauncherAtlas *atlas;
+  guint           slot;
+  ClutterGeometry region;
+  /* How many TidySubTextures show it, and whether it's been dropped
+   * from @icons.icons.  It's freed when it's dropped and none do. */
+  guint           n_textures;
+  gboolean        orphan;
+
+  /* Given to the decoding thread, and the TidySubTextures handed out
+   * before it was done, which show nothing until then. */
+  gboolean        queued;
+  GSList         *waiting;
+} HdLauncherIcon;
+
+/* One icon to decode in the background. */
+typedef struct
+{
+  gchar  *name, *file;
+  guchar *pixels;
+  guint   width, height;
+} DecodeJob;
+
+static struct
+{
+  /* The icons below are from this theme. */
+  gchar       *theme;
+  /* icon name -> HdLauncherIcon */
+  GHashTable  *icons;
+  /* HdLauncherAtlases with at least one slot taken. */
+  GPtrArray   *atlases;
+
+  gchar       *cache_file;
+  GMappedFile *cache;
+  guint        save_id;
+} icons;
+
+static void
+hd_launcher_icon_free (HdLauncherIcon *icon)
+{
+  /* Tiles still show it, hd_launcher_icons_texture_gone() will free it. */
+  if (icon->n_textures)
+    {
+      icon->orphan = TRUE;
+      return;
+    }
+
+  g_free (icon->file);
+  g_free (icon->own_pixels);
+  g_free (icon);
+}
+
+/* Returns the file of @icon_name in the current theme, or NULL. */
+static gchar *
+hd_launcher_icons_lookup (const gchar *icon_name)
+{
+  GtkIconTheme *icon_theme;
+  GtkIconInfo *info;
+  gchar *file = NULL;
+
+  /* The desktop file contains path to the icon. */
+  if (g_strrstr (icon_name, ".png") != NULL
+      && g_file_test (icon_name, G_FILE_TEST_EXISTS))
+    return g_strdup (icon_name);
+
+  /* Try to get the 64x64 icon, then the Harmattan (80x80) one, which
+   * will be scaled down to 64x64. */
+  icon_theme = gtk_icon_theme_get_default ();
+  info = gtk_icon_theme_lookup_icon (icon_theme, icon_name,
+                                     HD_LAUNCHER_TILE_ICON_REAL_SIZE,
+                                     GTK_ICON_LOOKUP_NO_SVG);
+  if (!info)
+    info = gtk_icon_theme_lookup_icon (icon_theme, icon_name,
+                        HD_LAUNCHER_TILE_ICON_REAL_SIZE_HARMATTAN_COMP,
+                        GTK_ICON_LOOKUP_NO_SVG);
+  if (info)
+    {
+      file = g_strdup (gtk_icon_info_get_filename (info));
+      gtk_icon_info_free (info);
+    }
+
+  return file;
+}
+
+/* Decode @file and add a 1 pixel transparent border around it, or the
+ * glow effect won't work properly.  It's called from the decoding
+ * thread too, so no GTK+ here. */
+static guchar *
+hd_launcher_icons_decode (const gchar *file, guint *width, guint *height)
+{
+  GdkPixbuf *pixbuf;
+  const guchar *src;
+  guchar *pixels;
+  gint w, h, x, y, n_channels, rowstride;
+
+  /* The file isn't guaranteed to be the correct size. */
+  pixbuf = gdk_pixbuf_new_from_file_at_size (file,
+                                   HD_LAUNCHER_TILE_ICON_REAL_SIZE,
+                                   HD_LAUNCHER_TILE_ICON_REAL_SIZE, NULL);
+  if (!pixbuf)
+    return NULL;
+
+  w = MIN (gdk_pixbuf_get_width (pixbuf), HD_LAUNCHER_TILE_ICON_REAL_SIZE);
+  h = MIN (gdk_pixbuf_get_height (pixbuf), HD_LAUNCHER_TILE_ICON_REAL_SIZE);
+  n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  src = gdk_pixbuf_get_pixels (pixbuf);
+
+  *width = w + 2;
+  *height = h + 2;
+  pixels = g_malloc0 (*width * *height * 4);
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+      {
+        const guchar *s = src + y * rowstride + x * n_channels;
+        guchar *d = pixels + ((y + 1) * *width + x + 1) * 4;
+
+        d[0] = s[0];
+        d[1] = s[1];
+        d[2] = s[2];
+        d[3] = n_channels == 4 ? s[3] : 0xff;
+      }
+
+  g_object_unref (pixbuf);
+  return pixels;
+}
+
+static gboolean
+hd_launcher_icons_file_has_mtime (const gchar *file,
+                                  gint64 mtime_sec, gint64 mtime_nsec)
+{
+  struct stat st;
+
+  return !stat (file, &st)
+    && st.st_mtim.tv_sec == mtime_sec
+    && st.st_mtim.tv_nsec == mtime_nsec;
+}
+
+/* (Re)map the cache and use the pixels there for the icons which are
+ * the same, or add them unchecked if we don't have them yet. */
+static void
+hd_launcher_icons_map_cache (void)
+{
+  GMappedFile *file;
+  const CacheHeader *header;
+  const CacheIcon *entries;
+  const gchar *strings, *old_start = NULL, *old_end = NULL;
+  const guchar *pixels;
+  GHashTableIter iter;
+  gpointer value;
+  gsize size;
+  guint i;
+
+  if (!(file = g_mapped_file_new (icons.cache_file, FALSE, NULL)))
+    return;
+
+  header = (const CacheHeader *)g_mapped_file_get_contents (file);
+  size = g_mapped_file_get_length (file);
+  if (size < sizeof (*header)
+      || header->magic != CACHE_MAGIC
+      || header->version != CACHE_VERSION
+      || header->size != size
+      || header->strings != sizeof (*header)
+                            + (guint64)header->n_icons * sizeof (CacheIcon)
+      || (guint64)header->strings + header->strings_size > header->pixels
+      || header->pixels > size
+      || !header->strings_size
+      || ((const gchar *)header)[header->strings + header->strings_size - 1])
+    {
+      g_warning ("%s: %s is invalid", __FUNCTION__, icons.cache_file);
+      g_mapped_file_unref (file);
+      return;
+    }
+
+  entries = (const CacheIcon *)(header + 1);
+  strings = (const gchar *)header + header->strings;
+  pixels = (const guchar *)header + header->pixels;
+
+#define STRING(offset) \
+  ((offset) < header->strings_size ? strings + (offset) : "")
+
+  if (strcmp (STRING (header->theme), icons.theme))
+    { /* From another theme, it'll be overwritten. */
+      g_mapped_file_unref (file);
+      return;
+    }
+
+  for (i = 0; i < header->n_icons; i++)
+    {
+      const CacheIcon *entry = &entries[i];
+      HdLauncherIcon *icon;
+
+      if (entry->width > SLOT_SIZE || entry->height > SLOT_SIZE
+          || (guint64)header->pixels + entry->pixels
+             + entry->width * entry->height * 4 > size)
+        continue;
+
+      icon = g_hash_table_lookup (icons.icons, STRING (entry->name));
+      if (!icon)
+        {
+          icon = g_new0 (HdLauncherIcon, 1);
+          icon->file = g_strdup (STRING (entry->file));
+          icon->mtime_sec = entry->mtime_sec;
+          icon->mtime_nsec = entry->mtime_nsec;
+          icon->unchecked = TRUE;
+          icon->pixels = pixels + entry->pixels;
+          icon->width = entry->width;
+          icon->height = entry->height;
+          g_hash_table_insert (icons.icons, g_strdup (STRING (entry->name)),
+                               icon);
+        }
+      else if (icon->pixels
+               && !g_strcmp0 (icon->file, STRING (entry->file))
+               && icon->mtime_sec == entry->mtime_sec
+               && icon->mtime_nsec == entry->mtime_nsec
+               && icon->width == entry->width
+               && icon->height == entry->height)
+        { /* We've just written it, use the page cache's copy. */
+          icon->pixels = pixels + entry->pixels;
+          g_free (icon->own_pixels);
+          icon->own_pixels = NULL;
+        }
+    }
+
+#undef STRING
+
+  /* Nothing should be left in the old mapping, but in case. */
+  if (icons.cache)
+    {
+      old_start = g_mapped_file_get_contents (icons.cache);
+      old_end = old_start + g_mapped_file_get_length (icons.cache);
+    }
+  g_hash_table_iter_init (&iter, icons.icons);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      HdLauncherIcon *icon = value;
+
+      if ((const gchar *)icon->pixels >= old_start
+          && (const gchar *)icon->pixels < old_end)
+        {
+          gsize n = icon->width * icon->height * 4;
+
+          icon->own_pixels = g_malloc (n);
+          memcpy (icon->own_pixels, icon->pixels, n);
+          icon->pixels = icon->own_pixels;
+        }
+    }
+
+  if (icons.cache)
+    g_mapped_file_unref (icons.cache);
+  icons.cache = file;
+}
+
+static gboolean
+hd_launcher_icons_save (gpointer unused)
+{
+  CacheHeader header;
+  GArray *entries;
+  GString *strings, *pixels, *out;
+  GHashTableIter iter;
+  gpointer key, value;
+  GError *error = NULL;
+  gchar *dir;
+
+  icons.save_id = 0;
+  if (!icons.icons)
+    return FALSE;
+
+  entries = g_array_new (FALSE, FALSE, sizeof (CacheIcon));
+  strings = g_string_new (NULL);
+  pixels = g_string_new (NULL);
+
+  memset (&header, 0, sizeof (header));
+  header.magic = CACHE_MAGIC;
+  header.version = CACHE_VERSION;
+  header.theme = strings->len;
+  g_string_append_len (strings, icons.theme, strlen (icons.theme) + 1);
+
+  g_hash_table_iter_init (&iter, icons.icons);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      HdLauncherIcon *icon = value;
+      CacheIcon entry;
+
+      if (!icon->file || !icon->pixels)
+        continue;
+
+      memset (&entry, 0, sizeof (entry));
+      entry.name = strings->len;
+      g_string_append_len (strings, key, strlen (key) + 1);
+      entry.file = strings->len;
+      g_string_append_len (strings, icon->file, strlen (icon->file) + 1);
+      entry.mtime_sec = icon->mtime_sec;
+      entry.mtime_nsec = icon->mtime_nsec;
+      entry.width = icon->width;
+      entry.height = icon->height;
+      entry.pixels = pixels->len;
+      g_string_append_len (pixels, (const gchar *)icon->pixels,
+                           icon->width * icon->height * 4);
+      g_array_append_val (entries, entry);
+    }
+
+  /* Keep the pixels aligned. */
+  while (strings->len % 4)
+    g_string_append_c (strings, '\0');
+
+  header.n_icons = entries->len;
+  header.strings = sizeof (header) + entries->len * sizeof (CacheIcon);
+  header.strings_size = strings->len;
+  header.pixels = header.strings + strings->len;
+  header.size = header.pixels + pixels->len;
+
+  out = g_string_sized_new (header.size);
+  g_string_append_len (out, (gchar *)&header, sizeof (header));
+  g_string_append_len (out, entries->data,
+                       entries->len * sizeof (CacheIcon));
+  g_string_append_len (out, strings->str, strings->len);
+  g_string_append_len (out, pixels->str, pixels->len);
+
+  dir = g_path_get_dirname (icons.cache_file);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+
+  if (g_file_set_contents (icons.cache_file, out->str, out->len, &error))
+    hd_launcher_icons_map_cache ();
+  else
+    {
+      g_warning ("%s: %s", __FUNCTION__, error->message);
+      g_error_free (error);
+    }
+
+  g_string_free (out, TRUE);
+  g_string_free (pixels, TRUE);
+  g_string_free (strings, TRUE);
+  g_array_free (entries, TRUE);
+
+  return FALSE;
+}
+
+static void
+hd_launcher_icons_queue_save (void)
+{
+  if (!icons.save_id)
+    icons.save_id = g_timeout_add_seconds (SAVE_DELAY,
+                                           hd_launcher_icons_save, NULL);
+}
+
+/* Icons may have been installed or removed: check them again before
+ * using them. */
+static void
+hd_launcher_icons_theme_changed (GtkIconTheme *icon_theme, gpointer unused)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  if (!icons.icons)
+    return;
+
+  g_hash_table_iter_init (&iter, icons.icons);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    ((HdLauncherIcon *)value)->unchecked = TRUE;
+}
+
+/* Forget everything if the icon theme isn't the one we have icons for. */
+static void
+hd_launcher_icons_check_theme (void)
+{
+  gchar *theme = NULL;
+
+  g_object_get (gtk_settings_get_default (),
+                "gtk-icon-theme-name", &theme, NULL);
+  if (!theme)
+    theme = g_strdup ("");
+
+  if (icons.theme && !strcmp (theme, icons.theme))
+    {
+      g_free (theme);
+      return;
+    }
+
+  if (icons.theme)
+    {
+      g_debug ("%s: icon theme %s -> %s", __FUNCTION__, icons.theme, theme);
+      /* The atlases go with the last tile showing the old icons. */
+      g_hash_table_destroy (icons.icons);
+      if (icons.cache)
+        g_mapped_file_unref (icons.cache);
+      icons.cache = NULL;
+      g_free (icons.theme);
+    }
+  else
+    {
+      icons.cache_file = g_build_filename (g_get_user_cache_dir (),
+                                           "hildon-desktop",
+                                           "icons.cache", NULL);
+      g_signal_connect (gtk_icon_theme_get_default (), "changed",
+                        G_CALLBACK (hd_launcher_icons_theme_changed), NULL);
+      icons.atlases = g_ptr_array_new ();
+    }
+
+  icons.theme = theme;
+  icons.icons = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                 (GDestroyNotify) hd_launcher_icon_free);
+
+  hd_launcher_icons_map_cache ();
+}
+
+/* Returns what we know about @icon_name, which may not be decoded yet. */
+static HdLauncherIcon *
+hd_launcher_icons_resolve (const gchar *icon_name)
+{
+  HdLauncherIcon *icon;
+  struct stat st;
+
+  icon = g_hash_table_lookup (icons.icons, icon_name);
+  if (icon && icon->unchecked)
+    {
+      gchar *file = hd_launcher_icons_lookup (icon_name);
+
+      icon->unchecked = FALSE;
+      if (g_strcmp0 (file, icon->file)
+          || (file && !hd_launcher_icons_file_has_mtime (file,
+                                   icon->mtime_sec, icon->mtime_nsec)))
+        {
+          g_hash_table_remove (icons.icons, icon_name);
+          icon = NULL;
+        }
+      g_free (file);
+    }
+
+  if (!icon)
+    {
+      icon = g_new0 (HdLauncherIcon, 1);
+      icon->file = hd_launcher_icons_lookup (icon_name);
+      if (icon->file && !stat (icon->file, &st))
+        {
+          icon->mtime_sec = st.st_mtim.tv_sec;
+          icon->mtime_nsec = st.st_mtim.tv_nsec;
+        }
+      g_hash_table_insert (icons.icons, g_strdup (icon_name), icon);
+    }
+
+  return icon;
+}
+
+/* Decode @icon here and now. */
+static gboolean
+hd_launcher_icons_decode_now (HdLauncherIcon *icon)
+{
+  icon->pixels = icon->own_pixels =
+    hd_launcher_icons_decode (icon->file, &icon->width, &icon->height);
+  if (!icon->pixels)
+    {
+      g_warning ("%s: couldn't load %s\n", __FUNCTION__, icon->file);
+      return FALSE;
+    }
+
+  hd_launcher_icons_queue_save ();
+  return TRUE;
+}
+
+/* Returns @icon_name or the default icon, decoded, or NULL.  If
+ * @may_wait, an icon the decoding thread has is returned as it is. */
+static HdLauncherIcon *
+hd_launcher_icons_get (const gchar *icon_name, gboolean *is_default,
+                       gboolean may_wait)
+{
+  HdLauncherIcon *icon;
+
+  hd_launcher_icons_check_theme ();
+
+  *is_default = FALSE;
+  if (!icon_name)
+    icon_name = HD_LAUNCHER_DEFAULT_ICON;
+
+  icon = hd_launcher_icons_resolve (icon_name);
+  if (!icon->file)
+    {
+      *is_default = TRUE;
+      icon = hd_launcher_icons_resolve (HD_LAUNCHER_DEFAULT_ICON);
+      if (!icon->file)
+        {
+          g_warning ("%s: couldn't find icon %s\n", __FUNCTION__, icon_name);
+          return NULL;
+        }
+    }
+
+  /* Not prefetched, or the decoding thread hasn't got to it yet and
+   * we can't wait for it. */
+  if (!icon->pixels && !(icon->queued && may_wait)
+      && !hd_launcher_icons_decode_now (icon))
+    return NULL;
+
+  return icon;
+}
+
+/* Returns an atlas with a free slot, a new one if they're all full. */
+static HdLauncherAtlas *
+hd_launcher_icons_get_atlas (void)
+{
+  HdLauncherAtlas *atlas;
+  ClutterTexture *texture;
+  GError *error = NULL;
+  guchar *blank;
+  guint i;
+
+  for (i = 0; i < icons.atlases->len; i++)
+    {
+      atlas = g_ptr_array_index (icons.atlases, i);
+      if (atlas->used != (G_GUINT64_CONSTANT (1) << N_SLOTS) - 1)
+        return atlas;
+    }
+
+  blank = g_malloc0 (ATLAS_SIZE * ATLAS_SIZE * 4);
+  texture = CLUTTER_TEXTURE (clutter_texture_new ());
+  g_object_ref_sink (texture);
+  if (!clutter_texture_set_from_rgb_data (texture, blank, TRUE,
+                                          ATLAS_SIZE, ATLAS_SIZE,
+                                          ATLAS_SIZE * 4, 4, 0, &error))
+    {
+      g_warning ("%s: %s", __FUNCTION__, error->message);
+      g_error_free (error);
+      g_object_unref (texture);
+      g_free (blank);
+      return NULL;
+    }
+  g_free (blank);
+
+  atlas = g_new0 (HdLauncherAtlas, 1);
+  atlas->texture = texture;
+  g_ptr_array_add (icons.atlases, atlas);
+  return atlas;
+}
+
+/* Copy @icon into a free slot of the atlases. */
+static gboolean
+hd_launcher_icons_upload (HdLauncherIcon *icon)
+{
+  HdLauncherAtlas *atlas;
+  GError *error = NULL;
+  guint slot;
+
+  if (icon->atlas)
+    return TRUE;
+
+  if (!(atlas = hd_launcher_icons_get_atlas ()))
+    return FALSE;
+  for (slot = 0; atlas->used & (G_GUINT64_CONSTANT (1) << slot); slot++)
+    ;
+
+  icon->region.x = (slot % SLOTS_PER_ROW) * SLOT_SIZE;
+  icon->region.y = (slot / SLOTS_PER_ROW) * SLOT_SIZE;
+  icon->region.width = icon->width;
+  icon->region.height = icon->height;
+  if (!clutter_texture_set_area_from_rgb_data (atlas->texture, icon->pixels,
+                                               TRUE,
+                                               icon->region.x,
+                                               icon->region.y,
+                                               icon->width, icon->height,
+                                               icon->width * 4, 4, 0,
+                                               &error))
+    {
+      g_warning ("%s: %s", __FUNCTION__, error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  atlas->used |= G_GUINT64_CONSTANT (1) << slot;
+  icon->atlas = atlas;
+  icon->slot = slot;
+  return TRUE;
+}
+
+/* Give the slot of @icon back, and the atlas with it if it was the last
+ * one taken. */
+static void
+hd_launcher_icons_release (HdLauncherIcon *icon)
+{
+  HdLauncherAtlas *atlas = icon->atlas;
+
+  icon->atlas = NULL;
+  atlas->used &= ~(G_GUINT64_CONSTANT (1) << icon->slot);
+  if (atlas->used)
+    return;
+
+  g_ptr_array_remove (icons.atlases, atlas);
+  g_object_unref (atlas->texture);
+  g_free (atlas);
+  g_debug ("%s: atlas freed, %u left", __FUNCTION__, icons.atlases->len);
+}
+
+/* A TidySubTexture of @icon has been finalized. */
+static void
+hd_launcher_icons_texture_gone (gpointer data, GObject *sub)
+{
+  HdLauncherIcon *icon = data;
+
+  icon->waiting = g_slist_remove (icon->waiting, sub);
+  if (--icon->n_textures)
+    return;
+
+  if (icon->atlas)
+    hd_launcher_icons_release (icon);
+  if (icon->orphan)
+    hd_launcher_icon_free (icon);
+}
+
+/* The decoding thread is done with @icon: show it in the textures
+ * waiting for it.  If it couldn't decode it, try it once more here. */
+static void
+hd_launcher_icons_show_waiting (HdLauncherIcon *icon)
+{
+  GSList *l;
+
+  if ((icon->pixels || hd_launcher_icons_decode_now (icon))
+      && hd_launcher_icons_upload (icon))
+    for (l = icon->waiting; l; l = l->next)
+      {
+        tidy_sub_texture_set_parent_texture (l->data, icon->atlas->texture);
+        tidy_sub_texture_set_region (l->data, &icon->region);
+        clutter_actor_queue_redraw (l->data);
+      }
+
+  g_slist_free (icon->waiting);
+  icon->waiting = NULL;
+}
+
+TidySubTexture *
+hd_launcher_icons_get_texture (const gchar *icon_name, gboolean *is_default)
+{
+  HdLauncherIcon *icon;
+  TidySubTexture *sub;
+
+  if (!(icon = hd_launcher_icons_get (icon_name, is_default, TRUE)))
+    return NULL;
+
+  if (!icon->pixels)
+    { /* Rather than decoding it twice, wait for the decoding thread. */
+      sub = tidy_sub_texture_new (NULL);
+      clutter_actor_set_size (CLUTTER_ACTOR (sub), SLOT_SIZE, SLOT_SIZE);
+      icon->waiting = g_slist_prepend (icon->waiting, sub);
+    }
+  else if (hd_launcher_icons_upload (icon))
+    {
+      sub = tidy_sub_texture_new (icon->atlas->texture);
+      tidy_sub_texture_set_region (sub, &icon->region);
+      clutter_actor_set_size (CLUTTER_ACTOR (sub),
+                              icon->region.width, icon->region.height);
+    }
+  else
+    return NULL;
+
+  /* The slot is kept as long as a tile shows it. */
+  icon->n_textures++;
+  g_object_weak_ref (G_OBJECT (sub), hd_launcher_icons_texture_gone, icon);
+
+  return sub;
+}
+
+gsize
+hd_launcher_icons_get_atlas_bytes (void)
+{
+  return icons.atlases ? icons.atlases->len * ATLAS_SIZE * ATLAS_SIZE * 4 : 0;
+}
+
+GdkPixbuf *
+hd_launcher_icons_get_pixbuf (const gchar *icon_name)
+{
+  HdLauncherIcon *icon;
+  GdkPixbuf *whole, *copy;
+  gboolean is_default;
+
+  if (!(icon = hd_launcher_icons_get (icon_name, &is_default, FALSE)))
+    return NULL;
+
+  /* Without the border, and not pointing to our pixels, which may be
+   * replaced. */
+  whole = gdk_pixbuf_new_from_data (icon->pixels + (icon->width + 1) * 4,
+                                    GDK_COLORSPACE_RGB, TRUE, 8,
+                                    icon->width - 2, icon->height - 2,
+                                    icon->width * 4, NULL, NULL);
+  copy = gdk_pixbuf_copy (whole);
+  g_object_unref (whole);
+
+  return copy;
+}
+
+/*
+ * Prefetching
+ */
+
+static void
+decode_job_free (DecodeJob *job)
+{
+  g_free (job->name);
+  g_free (job->file);
+  g_free (job->pixels);
+  g_free (job);
+}
+
+static gboolean
+hd_launcher_icons_decoded_idle (gpointer data)
+{
+  GList *jobs = data, *l;
+  guint n = 0;
+
+  for (l = jobs; l; l = l->next)
+    {
+      DecodeJob *job = l->data;
+      HdLauncherIcon *icon;
+
+      /* The theme may have changed, or the icon been decoded on demand
+       * already. */
+      icon = icons.icons ? g_hash_table_lookup (icons.icons, job->name) : NULL;
+      if (!icon || !icon->queued || g_strcmp0 (icon->file, job->file))
+        continue;
+
+      icon->queued = FALSE;
+      if (!icon->pixels && job->pixels)
+        {
+          icon->pixels = icon->own_pixels = job->pixels;
+          icon->width = job->width;
+          icon->height = job->height;
+          job->pixels = NULL;
+          n++;
+        }
+      if (icon->waiting)
+        hd_launcher_icons_show_waiting (icon);
+    }
+
+  g_debug ("%s: %u icons decoded", __FUNCTION__, n);
+  if (n)
+    hd_launcher_icons_queue_save ();
+
+  g_list_foreach (jobs, (GFunc) decode_job_free, NULL);
+  g_list_free (jobs);
+
+  return FALSE;
+}
+
+static gpointer
+hd_launcher_icons_decode_thread (gpointer data)
+{
+  GList *l;
+
+  for (l = data; l; l = l->next)
+    {
+      DecodeJob *job = l->data;
+      job->pixels = hd_launcher_icons_decode (job->file,
+                                              &job->width, &job->height);
+    }
+
+  clutter_threads_add_idle (hd_launcher_icons_decoded_idle, data);
+  return NULL;
+}
+
+void
+hd_launcher_icons_prefetch (GList *icon_names)
+{
+  GHashTable *seen;
+  GList *jobs = NULL;
+
+  hd_launcher_icons_check_theme ();
+
+  /* The lookups use GTK+, so they're done here, all at once. */
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  for (; icon_names; icon_names = icon_names->next)
+    {
+      const gchar *icon_name = icon_names->data;
+      HdLauncherIcon *icon;
+      DecodeJob *job;
+
+      if (!icon_name || g_hash_table_lookup (seen, icon_name))
+        continue;
+      g_hash_table_insert (seen, (gpointer) icon_name, (gpointer) icon_name);
+
+      icon = hd_launcher_icons_resolve (icon_name);
+      if (!icon->file || icon->pixels || icon->queued)
+        continue;
+
+      icon->queued = TRUE;
+      job = g_new0 (DecodeJob, 1);
+      job->name = g_strdup (icon_name);
+      job->file = g_strdup (icon->file);
+      jobs = g_list_prepend (jobs, job);
+    }
+  g_hash_table_destroy (seen);
+
+  if (!jobs)
+    return;
+
+  g_debug ("%s: decoding %u icons", __FUNCTION__, g_list_length (jobs));
+  if (hd_disable_threads ())
+    hd_launcher_icons_decode_thread (jobs);
+  else
+    /* The thread only decodes files and hands the pixels back with an
+     * idle, so it doesn't need the clutter lock. */
+    g_thread_unref (g_thread_new ("icons",
+                                  hd_launcher_icons_decode_thread, jobs));
+}
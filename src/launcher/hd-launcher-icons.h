@@ -0,0 +1,59 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * The icons of the launcher, looked up in the icon theme, decoded at
+ * HD_LAUNCHER_TILE_ICON_REAL_SIZE with a transparent border of 1 pixel
+ * and packed into a few shared atlas textures.  Tiles show them with a
+ * TidySubTexture each, so a page of tiles binds one texture.
+ *
+ * The decoded icons are kept in ~/.cache/hildon-desktop/icons.cache,
+ * valid for the same icon theme as long as the icon files' mtimes are
+ * the same, so the next start doesn't decode them again.
+ */
+
+#ifndef __HD_LAUNCHER_ICONS_H__
+#define __HD_LAUNCHER_ICONS_H__
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <tidy/tidy-sub-texture.h>
+
+G_BEGIN_DECLS
+
+/* Returns a new actor showing @icon_name (or the default icon if there's
+ * no such icon, then sets @is_default), or NULL if there's neither.  If
+ * the icon is being prefetched, the actor shows it when it's decoded. */
+TidySubTexture *hd_launcher_icons_get_texture (const gchar *icon_name,
+                                               gboolean *is_default);
+
+/* The same icon without the border, for GTK+.  Unref it. */
+GdkPixbuf      *hd_launcher_icons_get_pixbuf  (const gchar *icon_name);
+
+/* How much the atlases of the icons shown by tiles take, in bytes.  An
+ * atlas is freed with the last tile showing one of its icons. */
+gsize           hd_launcher_icons_get_atlas_bytes (void);
+
+/* Look up @icon_names (a list of const gchar *) now and decode them in
+ * the background, so the calls above find them ready. */
+void            hd_launcher_icons_prefetch    (GList *icon_names);
+
+G_END_DECLS
+
+#endif /* __HD_LAUNCHER_ICONS_H__ */
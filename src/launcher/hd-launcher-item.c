@@ -71,6 +71,7 @@ struct _HdLauncherItemPrivate
   gchar *text_domain;
   gboolean nodisplay;
   gboolean cssu_force_landscape;
+  guint32 content_hash;
 
   gchar *category;
 };
@@ -304,6 +305,22 @@ hd_launcher_item_get_category (HdLauncherItem *item)
   return item->priv->category;
 }
 
+guint32
+hd_launcher_item_get_content_hash (HdLauncherItem *item)
+{
+  g_return_val_if_fail (HD_IS_LAUNCHER_ITEM (item), 0);
+
+  return item->priv->content_hash;
+}
+
+void
+hd_launcher_item_set_content_hash (HdLauncherItem *item, guint32 hash)
+{
+  g_return_if_fail (HD_IS_LAUNCHER_ITEM (item));
+
+  item->priv->content_hash = hash;
+}
+
 gboolean
 hd_launcher_item_parse_keyfile (HdLauncherItem *item,
                                 GKeyFile *key_file,
@@ -92,6 +92,12 @@ const gchar *      hd_launcher_item_get_text_domain  (HdLauncherItem *item);
 const gchar *      hd_launcher_item_get_category     (HdLauncherItem *item);
 gboolean           hd_launcher_item_get_cssu_force_landscape (HdLauncherItem *item);
 
+/* Identifies what the item was made of, to tell whether it has changed
+ * when the menu is walked again.  Set by HdLauncherTree. */
+guint32            hd_launcher_item_get_content_hash (HdLauncherItem *item);
+void               hd_launcher_item_set_content_hash (HdLauncherItem *item,
+                                                      guint32 hash);
+
 G_END_DECLS
 
 #endif /* __HD_LAUNCHER_ITEM_H__ */
@@ -28,6 +28,7 @@
 #include "hd-launcher.h"
 #include "hd-launcher-tile.h"
 #include "hd-launcher-grid.h"
+#include "hd-launcher-icons.h"
 
 #include <glib-object.h>
 #include <clutter/clutter.h>
@@ -61,6 +62,10 @@ struct _HdLauncherTilePrivate
 
   ClutterActor *click_area;
 
+  /* Whether the icon should be there, see
+   * hd_launcher_tile_set_materialized(). */
+  gboolean materialized;
+
   float glow_amount;
   float glow_radius; // radius of glow - loaded from transitions.ini
 
@@ -276,125 +281,33 @@ hd_launcher_tile_get_label (HdLauncherTile *tile)
   return priv->label;
 }
 
-void
-hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
-                                const gchar *icon_name)
+/* Create the icon of @tile from the shared atlases.  The glow is only
+ * made when the tile first glows. */
+static void
+hd_launcher_tile_load_icon (HdLauncherTile *tile)
 {
   HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
-  GtkIconTheme *icon_theme;
-  GdkPixbuf *pixbuf;
-  GtkIconInfo *info = NULL;
-  const gchar *fname;
+  TidySubTexture *icon;
+  gboolean is_default;
 
-  if (priv->icon_name)
-    {
-      g_free (priv->icon_name);
-    }
-  if (icon_name)
-    priv->icon_name = g_strdup (icon_name);
-  else
-    /* Set the default if none was passed. */
-    priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
-
-  fname = priv->icon_name;
-
-  /* Recreate the icon actor */
-  if (priv->icon)
-    {
-      clutter_actor_destroy (priv->icon);
-      priv->icon = NULL;
-    }
+  /* Neither the icon nor the default one was found before. */
+  if (!priv->icon_name)
+    return;
 
-  /* The desktop file contains path to the icon. */
-  if (g_file_test (fname, G_FILE_TEST_EXISTS)
-        && (g_strrstr (priv->icon_name, ".png") != NULL))
-    {
-      fname = priv->icon_name;
-    }
-  else
+  /* It's in an atlas shared with the other tiles. */
+  icon = hd_launcher_icons_get_texture (priv->icon_name, &is_default);
+  if (!icon)
     {
-      /* Try to get the 64x64 icon. */
-      icon_theme = gtk_icon_theme_get_default();
-      info = gtk_icon_theme_lookup_icon(icon_theme, priv->icon_name,
-                                        HD_LAUNCHER_TILE_ICON_REAL_SIZE,
-                                        GTK_ICON_LOOKUP_NO_SVG);
-
-      if (info == NULL)
-        {
-          /* Try to get the Harmattan (80x80) icon. The icon will be scaled 
-           * down to 64x64. */
-          info = gtk_icon_theme_lookup_icon(icon_theme, priv->icon_name,
-                                            HD_LAUNCHER_TILE_ICON_REAL_SIZE_HARMATTAN_COMP,
-                                            GTK_ICON_LOOKUP_NO_SVG);
-        }
-
-      if (info == NULL)
-        {
-          /* Try to get the default icon. */
-          g_free (priv->icon_name);
-          priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
-          info = gtk_icon_theme_lookup_icon(icon_theme, priv->icon_name,
-                                            HD_LAUNCHER_TILE_ICON_REAL_SIZE,
-                                            GTK_ICON_LOOKUP_NO_SVG);
-        }
-
-      if (info == NULL)
-        {
-          g_warning ("%s: couldn't find icon %s\n", __FUNCTION__, priv->icon_name);
-          g_free (priv->icon_name); 
-          priv->icon_name = NULL;
-          return;
-        }
-
-      fname = gtk_icon_info_get_filename(info);
-      if (fname == NULL)
-        {
-          g_warning ("%s: couldn't get icon %s\n", __FUNCTION__, priv->icon_name);
-          g_free (priv->icon_name);
-          priv->icon_name = NULL;
-          return;
-        }
+      g_free (priv->icon_name);
+      priv->icon_name = NULL;
+      return;
     }
-
-  /* We must expand these images so there is a 1 pixel transparent
-   * border around them, or the glow effect won't work properly. We use
-   * gdk_pixbuf_new_from_file_at_size as the pixbuf pointed to by fname
-   * isn't actually guaranteed to be the correct size.  */
-  pixbuf = gdk_pixbuf_new_from_file_at_size(fname,
-      HD_LAUNCHER_TILE_ICON_REAL_SIZE, HD_LAUNCHER_TILE_ICON_REAL_SIZE, 0);
-
-  if (pixbuf)
+  if (is_default)
     {
-      gint w = gdk_pixbuf_get_width(pixbuf);
-      gint h = gdk_pixbuf_get_height(pixbuf);
-      GdkPixbuf *pixbufb = gdk_pixbuf_new(
-          GDK_COLORSPACE_RGB, TRUE, 8, w+2, h+2);
-
-      gdk_pixbuf_fill(pixbufb, 0);
-      gdk_pixbuf_copy_area(pixbuf, 0, 0, w, h,
-                           pixbufb, 1, 1);
-
-      priv->icon = clutter_texture_new();
-      clutter_texture_set_from_rgb_data(
-          CLUTTER_TEXTURE(priv->icon),
-          gdk_pixbuf_get_pixels(pixbufb),
-          gdk_pixbuf_get_has_alpha(pixbufb),
-          gdk_pixbuf_get_width(pixbufb),
-          gdk_pixbuf_get_height(pixbufb),
-          gdk_pixbuf_get_rowstride(pixbufb),
-          gdk_pixbuf_get_n_channels(pixbufb), 0, 0);
-      g_object_unref(pixbufb);
+      g_free (priv->icon_name);
+      priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
     }
-  if (pixbuf)
-    g_object_unref(pixbuf);
-
-  if (!priv->icon)
-  {
-    g_warning ("%s: couldn't create texture for %s\n", __FUNCTION__, fname);
-    g_free (priv->icon_name);
-    priv->icon_name = NULL;
-    return;
-  }
+  priv->icon = CLUTTER_ACTOR (icon);
 
   clutter_actor_set_size (priv->icon,
       HD_LAUNCHER_TILE_ICON_SIZE,
@@ -402,12 +315,43 @@ hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
   clutter_actor_set_position (priv->icon,
       (HD_LAUNCHER_TILE_WIDTH - HD_LAUNCHER_TILE_ICON_SIZE) / 2, 0);
   clutter_container_add_actor (CLUTTER_CONTAINER(tile), priv->icon);
+}
+
+static void
+hd_launcher_tile_unload_icon (HdLauncherTile *tile)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
 
   if (priv->icon_glow)
-    /* free the old one */
-    clutter_actor_destroy (CLUTTER_ACTOR (priv->icon_glow));
+    {
+      clutter_actor_destroy (CLUTTER_ACTOR (priv->icon_glow));
+      priv->icon_glow = NULL;
+    }
+  if (priv->icon)
+    {
+      clutter_actor_destroy (priv->icon);
+      priv->icon = NULL;
+    }
+}
+
+static void
+hd_launcher_tile_ensure_glow (HdLauncherTile *tile)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+  TidySubTexture *icon;
+  ClutterGeometry region;
+
+  if (priv->icon_glow || !priv->icon)
+    return;
 
-  priv->icon_glow = tidy_highlight_new(CLUTTER_TEXTURE(priv->icon));
+  /* Not until the icon has been decoded. */
+  icon = TIDY_SUB_TEXTURE (priv->icon);
+  if (!tidy_sub_texture_get_parent_texture (icon))
+    return;
+  priv->icon_glow = tidy_highlight_new(
+                          tidy_sub_texture_get_parent_texture (icon));
+  tidy_sub_texture_get_region (icon, &region);
+  tidy_highlight_set_region (priv->icon_glow, &region);
   clutter_actor_set_size (CLUTTER_ACTOR(priv->icon_glow),
         HD_LAUNCHER_TILE_GLOW_SIZE,
         HD_LAUNCHER_TILE_GLOW_SIZE);
@@ -419,8 +363,66 @@ hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
   clutter_actor_lower_bottom(CLUTTER_ACTOR(priv->icon_glow));
 
   clutter_actor_hide(CLUTTER_ACTOR(priv->icon_glow));
+}
+
+void
+hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
+                                const gchar *icon_name)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+
+  if (priv->icon_name)
+    {
+      g_free (priv->icon_name);
+    }
+  if (icon_name)
+    priv->icon_name = g_strdup (icon_name);
+  else
+    /* Set the default if none was passed. */
+    priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
+
+  /* Recreate the icon actor, if the tile has one at all. */
+  if (!priv->materialized)
+    return;
 
-  gtk_icon_info_free(info);
+  hd_launcher_tile_unload_icon (tile);
+  hd_launcher_tile_load_icon (tile);
+}
+
+/* hd_launcher_tile_set_materialized:
+ * @tile: a launcher tile
+ * @materialized: whether @tile should have its icon
+ *
+ * Tiles are made without an icon, just the label and the click area, and
+ * the grid gives the icon to those near the visible part of it.  Tiles
+ * which lose it keep their place and can still be clicked.
+ */
+void
+hd_launcher_tile_set_materialized (HdLauncherTile *tile,
+                                   gboolean materialized)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+
+  if (priv->materialized == materialized)
+    return;
+  priv->materialized = materialized;
+
+  if (materialized)
+    hd_launcher_tile_load_icon (tile);
+  else
+    {
+      clutter_timeline_stop (priv->glow_timeline);
+      priv->glow_amount = 0;
+      hd_launcher_tile_unload_icon (tile);
+    }
+}
+
+gboolean
+hd_launcher_tile_is_materialized (HdLauncherTile *tile)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+
+  return priv->materialized;
 }
 
 void
@@ -539,6 +541,9 @@ hd_launcher_tile_set_glow(HdLauncherTile *tile, gboolean glow, gboolean hard)
 
   clutter_timeline_stop(priv->glow_timeline);
 
+  if (glow)
+    hd_launcher_tile_ensure_glow (tile);
+
   /* If we're already there, skip */
   if ((glow && priv->glow_amount==1) ||
       (!glow && priv->glow_amount==0))
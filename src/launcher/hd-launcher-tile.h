@@ -71,6 +71,11 @@ void hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
 void hd_launcher_tile_set_text      (HdLauncherTile *tile,
                                      const gchar *text);
 
+void     hd_launcher_tile_set_materialized (HdLauncherTile *tile,
+                                            gboolean materialized);
+gboolean hd_launcher_tile_is_materialized  (HdLauncherTile *tile);
+
+/* NULL unless the tile is materialized. */
 ClutterActor *hd_launcher_tile_get_icon (HdLauncherTile *tile);
 ClutterActor *hd_launcher_tile_get_label (HdLauncherTile *tile);
 
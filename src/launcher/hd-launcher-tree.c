@@ -4,6 +4,7 @@
 
 #include "hildon-desktop.h"
 #include "hd-launcher-tree.h"
+#include "hd-launcher-cache.h"
 
 #include "hd-gtk-style.h"
 
@@ -13,6 +14,7 @@
 #include <string.h>
 
 #include <clutter/clutter.h>
+#include <tidy/tidy-marshal.h>
 
 #define GMENU_I_KNOW_THIS_IS_UNSTABLE
 #include <gmenu-tree.h>
@@ -20,6 +22,14 @@
 #define HD_LAUNCHER_TREE_GET_PRIVATE(obj)  \
   (hd_launcher_tree_get_instance_private (HD_LAUNCHER_TREE (obj)))
 
+/* When the items come from the cache, the menu is loaded and walked
+ * this many seconds later, to see if they are still right. */
+#define HD_LAUNCHER_TREE_REVALIDATE_DELAY 10
+
+/* The menu changes once for each package installed; wait this many ms
+ * for more before walking it again. */
+#define HD_LAUNCHER_TREE_CHANGE_DELAY 500
+
 typedef struct
 {
   HdLauncherTree *tree;
@@ -28,6 +38,8 @@ typedef struct
 
   /* The items we have created so far. */
   GList *items;
+  /* And what to write in the cache about them. */
+  HdLauncherCache *cache;
 
   /* accessed by both threads */
   volatile gboolean cancelled : 1;
@@ -39,6 +51,9 @@ struct _HdLauncherTreePrivate
    * it's easier to iterate than a tree
    */
   GList *items_list;
+  /* Indexes of items_list: id -> item, and service and exec -> app.
+   * Where more items have the same key, the first one. */
+  GHashTable *items_by_id, *apps_by_service, *apps_by_exec;
 
   /* this is the actual tree of launchers, as
    * built by parsing the applications.menu file
@@ -48,13 +63,26 @@ struct _HdLauncherTreePrivate
 
   WalkThreadData *active_walk;
 
+  /* Where items_list is cached, and the hash of what's there. */
+  gchar *cache_file;
+  guint32 items_hash;
+  guint revalidate_id;
+  guint change_id;
+
   gboolean theme_changed_signal_connected : 1;
+  /* "finished" has been emitted (or is about to be) for items_list, so
+   * later walks are told about with the item-* signals. */
+  gboolean populated : 1;
 };
 
 enum
 {
   STARTING,
   FINISHED,
+  ITEM_ADDED,
+  ITEM_REMOVED,
+  ITEM_CHANGED,
+  REORDERED,
 
   LAST_SIGNAL
 };
@@ -70,6 +98,7 @@ static void hd_launcher_tree_handle_tree_changed (GMenuTree *menu_tree,
                                                   gpointer user_data);
 
 static void hd_launcher_tree_handle_theme_changed (HdLauncherTree *tree);
+static void hd_launcher_tree_load_menu (HdLauncherTree *tree);
 
 static WalkThreadData *
 walk_thread_data_new (HdLauncherTree *tree)
@@ -91,25 +120,165 @@ walk_thread_data_new_level (WalkThreadData *parent, GMenuTreeDirectory *dir)
   WalkThreadData *result = walk_thread_data_new (parent->tree);
   result->level = parent->level + 1;
   result->root = dir;
+  result->cache = parent->cache;
   return result;
 }
 
 static void
 walk_thread_data_free (WalkThreadData *data)
 {
+  if (data->level == 0)
+    hd_launcher_cache_free (data->cache);
   g_object_unref (data->tree);
 
   g_free (data);
 }
 
-/**
- * TODO: When we get here, we have two lists of items, the old one
- * and the new one.
- * Using idle times, we replace the old one with the new information
- * but, instead of replacing old items, copying the new values as the
- * old items contain run-time information we can't discard.
- * We also send signals for new and removed items.
- */
+/* Rebuild the indexes of items_list.  Call it whenever the list is
+ * replaced, before anyone can look at it. */
+static void
+hd_launcher_tree_index_items (HdLauncherTree *tree)
+{
+  HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
+  GHashTable *by_id, *by_service, *by_exec;
+  GList *l;
+
+  by_id = g_hash_table_new (g_str_hash, g_str_equal);
+  by_service = g_hash_table_new (g_str_hash, g_str_equal);
+  by_exec = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (l = priv->items_list; l; l = l->next)
+    {
+      const gchar *key;
+
+      /* The keys belong to the items, which outlive the indexes. */
+      key = hd_launcher_item_get_id (l->data);
+      if (key && !g_hash_table_lookup (by_id, key))
+        g_hash_table_insert (by_id, (gpointer) key, l->data);
+
+      if (!HD_IS_LAUNCHER_APP (l->data))
+        continue;
+
+      key = hd_launcher_app_get_service (l->data);
+      if (key && !g_hash_table_lookup (by_service, key))
+        g_hash_table_insert (by_service, (gpointer) key, l->data);
+
+      key = hd_launcher_app_get_exec (l->data);
+      if (key && !g_hash_table_lookup (by_exec, key))
+        g_hash_table_insert (by_exec, (gpointer) key, l->data);
+    }
+
+  if (priv->items_by_id)
+    {
+      g_hash_table_destroy (priv->items_by_id);
+      g_hash_table_destroy (priv->apps_by_service);
+      g_hash_table_destroy (priv->apps_by_exec);
+    }
+  priv->items_by_id = by_id;
+  priv->apps_by_service = by_service;
+  priv->apps_by_exec = by_exec;
+}
+
+static void
+emit_item_signal (HdLauncherTree *tree, guint signal_id, GList *items,
+                  HdLauncherItemType type)
+{
+  for (; items; items = items->next)
+    if (hd_launcher_item_get_item_type (items->data) == type)
+      g_signal_emit (tree, tree_signals[signal_id], 0, items->data);
+}
+
+/* Replace the items with @new_items and tell the differences.  Items
+ * which haven't changed are kept, as others hold on to them. */
+static void
+hd_launcher_tree_update_items (HdLauncherTree *tree, GList *new_items)
+{
+  HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
+  GHashTable *old_items, *old_positions;
+  GList *added = NULL, *removed = NULL, *changed = NULL, *l;
+  GHashTableIter iter;
+  gpointer item;
+  guint position, last_position;
+  gboolean reordered;
+
+  old_items = g_hash_table_new (g_str_hash, g_str_equal);
+  old_positions = g_hash_table_new (g_str_hash, g_str_equal);
+  for (l = priv->items_list, position = 1; l; l = l->next, position++)
+    {
+      g_hash_table_insert (old_items,
+                           (gpointer) hd_launcher_item_get_id (l->data),
+                           l->data);
+      g_hash_table_insert (old_positions,
+                           (gpointer) hd_launcher_item_get_id (l->data),
+                           GUINT_TO_POINTER (position));
+    }
+
+  /* The items we had are in a different order if they don't come in
+   * the order of their old positions. */
+  reordered = FALSE;
+  last_position = 0;
+  for (l = new_items; l; l = l->next)
+    {
+      HdLauncherItem *old;
+
+      old = g_hash_table_lookup (old_items, hd_launcher_item_get_id (l->data));
+      if (!old)
+        added = g_list_prepend (added, l->data);
+      else
+        {
+          position = GPOINTER_TO_UINT (g_hash_table_lookup (old_positions,
+                                           hd_launcher_item_get_id (old)));
+          if (position < last_position)
+            reordered = TRUE;
+          last_position = position;
+
+          g_hash_table_remove (old_items, hd_launcher_item_get_id (old));
+          if (hd_launcher_item_get_content_hash (old)
+              == hd_launcher_item_get_content_hash (l->data))
+            {
+              g_object_unref (l->data);
+              l->data = old;
+            }
+          else
+            changed = g_list_prepend (g_list_prepend (changed, old), l->data);
+        }
+    }
+
+  g_hash_table_iter_init (&iter, old_items);
+  while (g_hash_table_iter_next (&iter, NULL, &item))
+    removed = g_list_prepend (removed, item);
+  g_hash_table_destroy (old_items);
+  g_hash_table_destroy (old_positions);
+
+  /* The items to forget are referenced from @removed and @changed now. */
+  g_list_free (priv->items_list);
+  priv->items_list = new_items;
+  hd_launcher_tree_index_items (tree);
+
+  /* Apps before their categories go, categories before their apps come. */
+  emit_item_signal (tree, ITEM_REMOVED, removed, HD_APPLICATION_LAUNCHER);
+  emit_item_signal (tree, ITEM_REMOVED, removed, HD_CATEGORY_LAUNCHER);
+  added = g_list_reverse (added);
+  emit_item_signal (tree, ITEM_ADDED, added, HD_CATEGORY_LAUNCHER);
+  emit_item_signal (tree, ITEM_ADDED, added, HD_APPLICATION_LAUNCHER);
+  for (l = changed; l; l = l->next->next)
+    g_signal_emit (tree, tree_signals[ITEM_CHANGED], 0,
+                   l->data, l->next->data);
+  if (reordered)
+    g_signal_emit (tree, tree_signals[REORDERED], 0);
+
+  g_debug ("%s: %u added, %u removed, %u changed%s", __FUNCTION__,
+           g_list_length (added), g_list_length (removed),
+           g_list_length (changed) / 2, reordered ? ", reordered" : "");
+
+  g_list_foreach (removed, (GFunc) g_object_unref, NULL);
+  g_list_free (removed);
+  for (l = changed; l; l = l->next->next)
+    g_object_unref (l->next->data);
+  g_list_free (changed);
+  g_list_free (added);
+}
+
 static gboolean
 walk_thread_done_idle (gpointer user_data)
 {
@@ -118,13 +287,32 @@ walk_thread_done_idle (gpointer user_data)
 
   if ((priv->active_walk == data) && !data->cancelled)
     {
+      guint32 hash = hd_launcher_cache_get_hash (data->cache);
+
       /* This is the correct walking. */
-      g_list_foreach (priv->items_list, (GFunc) g_object_unref, NULL);
-      g_list_free (priv->items_list);
-      priv->items_list = data->items;
       priv->active_walk = NULL;
       gmenu_tree_item_unref (data->root);
-      g_signal_emit (data->tree, tree_signals[FINISHED], 0);
+      if (!priv->populated)
+        {
+          g_list_foreach (priv->items_list, (GFunc) g_object_unref, NULL);
+          g_list_free (priv->items_list);
+          priv->items_list = data->items;
+          hd_launcher_tree_index_items (data->tree);
+          priv->items_hash = hash;
+          priv->populated = TRUE;
+          g_signal_emit (data->tree, tree_signals[FINISHED], 0);
+        }
+      else if (hash != priv->items_hash)
+        {
+          hd_launcher_tree_update_items (data->tree, data->items);
+          priv->items_hash = hash;
+        }
+      else
+        { /* Nothing has changed, keep the items we have. */
+          g_list_foreach (data->items, (GFunc) g_object_unref, NULL);
+          g_list_free (data->items);
+        }
+      data->items = NULL;
 
       /* Once the first walk is done, connect to the theme change signal. */
       if (!priv->theme_changed_signal_connected)
@@ -143,7 +331,8 @@ walk_thread_done_idle (gpointer user_data)
   else
     {
       /* This is the result of an obsolete walking, get rid of it. */
-      g_list_foreach (data->items, (GFunc) g_object_unref, NULL);\
+      g_list_foreach (data->items, (GFunc) g_object_unref, NULL);
+      g_list_free (data->items);
       gmenu_tree_item_unref (data->root);
       walk_thread_data_free (data);
     }
@@ -238,6 +427,11 @@ walk_thread_func (gpointer user_data)
         item = hd_launcher_item_new_from_keyfile (id,
                   gmenu_tree_directory_get_menu_id (data->root),
                   key_file, NULL);
+        if (item)
+          hd_launcher_item_set_content_hash (item,
+                  hd_launcher_cache_add_item (data->cache, id,
+                          gmenu_tree_directory_get_menu_id (data->root),
+                          key_file, key_file_path));
 	g_key_file_free (key_file);
       }
       if (item)
@@ -250,7 +444,11 @@ walk_thread_func (gpointer user_data)
 
   if (data->level == 0)
     {
+      HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (data->tree);
+
       data->items = g_list_reverse (data->items);
+      if (!data->cancelled)
+        hd_launcher_cache_write (data->cache, priv->cache_file);
 
       clutter_threads_add_idle (walk_thread_done_idle, data);
     }
@@ -270,10 +468,30 @@ hd_launcher_tree_finalize (GObject *gobject)
       priv->active_walk = NULL;
     }
 
+  if (priv->items_by_id)
+    {
+      g_hash_table_destroy (priv->items_by_id);
+      g_hash_table_destroy (priv->apps_by_service);
+      g_hash_table_destroy (priv->apps_by_exec);
+      priv->items_by_id = priv->apps_by_service = priv->apps_by_exec = NULL;
+    }
   g_list_foreach (priv->items_list, (GFunc) g_object_unref, NULL);
   g_list_free (priv->items_list);
   priv->items_list = NULL;
 
+  if (priv->revalidate_id)
+    {
+      g_source_remove (priv->revalidate_id);
+      priv->revalidate_id = 0;
+    }
+  if (priv->change_id)
+    {
+      g_source_remove (priv->change_id);
+      priv->change_id = 0;
+    }
+  g_free (priv->cache_file);
+  priv->cache_file = NULL;
+
   if (priv->root)
     {
       gmenu_tree_item_unref (priv->root);
@@ -310,6 +528,41 @@ hd_launcher_tree_class_init (HdLauncherTreeClass *klass)
                   0, NULL, NULL,
                   g_cclosure_marshal_VOID__VOID,
                   G_TYPE_NONE, 0);
+
+  /* After "finished", the items which have come, gone or changed
+   * since are told about one by one with these. */
+  tree_signals[ITEM_ADDED] =
+    g_signal_new ("item-added",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_FIRST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__OBJECT,
+                  G_TYPE_NONE, 1, HD_TYPE_LAUNCHER_ITEM);
+  tree_signals[ITEM_REMOVED] =
+    g_signal_new ("item-removed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_FIRST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__OBJECT,
+                  G_TYPE_NONE, 1, HD_TYPE_LAUNCHER_ITEM);
+  /* (item, old_item): old_item has been replaced by item. */
+  tree_signals[ITEM_CHANGED] =
+    g_signal_new ("item-changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_FIRST,
+                  0, NULL, NULL,
+                  _tidy_marshal_VOID__OBJECT_OBJECT,
+                  G_TYPE_NONE, 2,
+                  HD_TYPE_LAUNCHER_ITEM, HD_TYPE_LAUNCHER_ITEM);
+  /* Items we had before have moved around, eg. in the editor.  It comes
+   * after the item-* signals of the same change. */
+  tree_signals[REORDERED] =
+    g_signal_new ("reordered",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_FIRST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID,
+                  G_TYPE_NONE, 0);
 }
 
 static void
@@ -318,6 +571,9 @@ hd_launcher_tree_init (HdLauncherTree *tree)
   tree->priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
 
   tree->priv->active_walk = NULL;
+  tree->priv->cache_file = g_build_filename (g_get_user_cache_dir (),
+                                             "hildon-desktop",
+                                             "launcher.cache", NULL);
 }
 
 HdLauncherTree *
@@ -361,7 +617,7 @@ hd_launcher_tree_handle_tree_changed (GMenuTree *menu_tree,
       priv->active_walk->cancelled = TRUE;
       priv->active_walk = NULL;
     }
-  else
+  else if (!priv->populated)
     {
       /* Only signal starting for the first walking. */
       g_signal_emit (self, tree_signals[STARTING], 0);
@@ -369,6 +625,7 @@ hd_launcher_tree_handle_tree_changed (GMenuTree *menu_tree,
 
   data = walk_thread_data_new (self);
   data->root = root;
+  data->cache = hd_launcher_cache_new ();
 
   priv->active_walk = data;
   if (hd_disable_threads ())
@@ -394,21 +651,32 @@ hd_launcher_tree_handle_theme_changed (HdLauncherTree *tree)
   g_signal_emit (tree, tree_signals[FINISHED], 0);
 }
 
-/**
- * hd_launcher_tree_populate:
- * @tree: a #HdLauncherTree
- *
- * Populates the @tree with the launchers by walking
- * the applications directory using an helper thread
- * to avoid blocking.
- *
- * Emits the #HdLauncherTree::finished
- * when done.
- */
-void
-hd_launcher_tree_populate (HdLauncherTree *tree)
+static gboolean
+hd_launcher_tree_menu_changed_timeout (gpointer user_data)
+{
+  HdLauncherTree *tree = user_data;
+
+  tree->priv->change_id = 0;
+  hd_launcher_tree_handle_tree_changed (tree->priv->tree, tree);
+
+  return FALSE;
+}
+
+static void
+hd_launcher_tree_menu_changed (GMenuTree *menu_tree, gpointer user_data)
+{
+  HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE (user_data)->priv;
+
+  if (priv->change_id)
+    g_source_remove (priv->change_id);
+  priv->change_id = g_timeout_add (HD_LAUNCHER_TREE_CHANGE_DELAY,
+                                   hd_launcher_tree_menu_changed_timeout,
+                                   user_data);
+}
+
+static void
+hd_launcher_tree_load_menu (HdLauncherTree *tree)
 {
-  g_return_if_fail (HD_IS_LAUNCHER_TREE (tree));
   HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
   GError *error = NULL;
 
@@ -441,10 +709,69 @@ hd_launcher_tree_populate (HdLauncherTree *tree)
   hd_launcher_tree_handle_tree_changed (priv->tree, tree);
 
   g_signal_connect (priv->tree, "changed",
-                    G_CALLBACK (hd_launcher_tree_handle_tree_changed),
+                    G_CALLBACK (hd_launcher_tree_menu_changed),
                     (gpointer)tree);
 }
 
+/* The items have been loaded from the cache, tell everyone as if they
+ * had been walked. */
+static gboolean
+hd_launcher_tree_cache_loaded_idle (gpointer user_data)
+{
+  HdLauncherTree *tree = user_data;
+
+  g_signal_emit (tree, tree_signals[STARTING], 0);
+  g_signal_emit (tree, tree_signals[FINISHED], 0);
+
+  return FALSE;
+}
+
+static gboolean
+hd_launcher_tree_revalidate (gpointer user_data)
+{
+  HdLauncherTree *tree = user_data;
+
+  tree->priv->revalidate_id = 0;
+  hd_launcher_tree_load_menu (tree);
+
+  return FALSE;
+}
+
+/**
+ * hd_launcher_tree_populate:
+ * @tree: a #HdLauncherTree
+ *
+ * Populates the @tree with the launchers by walking
+ * the applications directory using an helper thread
+ * to avoid blocking.
+ *
+ * Emits the #HdLauncherTree::finished
+ * when done.
+ */
+void
+hd_launcher_tree_populate (HdLauncherTree *tree)
+{
+  g_return_if_fail (HD_IS_LAUNCHER_TREE (tree));
+  HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
+
+  /* Use the cache if we can and check it later, when the desktop has
+   * settled.  Loading the menu reads every .desktop file too. */
+  priv->items_list = hd_launcher_cache_read (priv->cache_file,
+                                             &priv->items_hash);
+  hd_launcher_tree_index_items (tree);
+  if (priv->items_list)
+    {
+      priv->populated = TRUE;
+      clutter_threads_add_idle (hd_launcher_tree_cache_loaded_idle, tree);
+      priv->revalidate_id =
+        g_timeout_add_seconds (HD_LAUNCHER_TREE_REVALIDATE_DELAY,
+                               hd_launcher_tree_revalidate, tree);
+      return;
+    }
+
+  hd_launcher_tree_load_menu (tree);
+}
+
 GList *
 hd_launcher_tree_get_items (HdLauncherTree *tree)
 {
@@ -461,46 +788,37 @@ hd_launcher_tree_get_size (HdLauncherTree *tree)
   return g_list_length (tree->priv->items_list);
 }
 
-static gint
-_compare_item_id (gconstpointer a, gconstpointer b)
-{
-  return g_strcmp0(hd_launcher_item_get_id(HD_LAUNCHER_ITEM (a)),
-                   (const gchar *)b);
-}
-
 HdLauncherItem *
 hd_launcher_tree_find_item (HdLauncherTree *tree, const gchar *id)
 {
   g_return_val_if_fail (HD_IS_LAUNCHER_TREE (tree), NULL);
   HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
 
-  GList *res = g_list_find_custom (priv->items_list, id,
-                                   (GCompareFunc)_compare_item_id);
-  if (res)
-    return res->data;
-  return NULL;
+  if (!id || !priv->items_by_id)
+    return NULL;
+  return g_hash_table_lookup (priv->items_by_id, id);
 }
 
-static gint
-_compare_service (gconstpointer a, gconstpointer b)
+HdLauncherApp *
+hd_launcher_tree_find_app_by_service (HdLauncherTree *tree, const gchar *service)
 {
-  if (!HD_IS_LAUNCHER_APP(a))
-    return !0;
-  return g_strcmp0(hd_launcher_app_get_service(HD_LAUNCHER_APP (a)),
-                   (const gchar *)b);
+  g_return_val_if_fail (HD_IS_LAUNCHER_TREE (tree), NULL);
+  HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
+
+  if (!service || !priv->apps_by_service)
+    return NULL;
+  return g_hash_table_lookup (priv->apps_by_service, service);
 }
 
 HdLauncherApp *
-hd_launcher_tree_find_app_by_service (HdLauncherTree *tree, const gchar *service)
+hd_launcher_tree_find_app_by_exec (HdLauncherTree *tree, const gchar *exec)
 {
   g_return_val_if_fail (HD_IS_LAUNCHER_TREE (tree), NULL);
   HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
 
-  GList *res = g_list_find_custom (priv->items_list, service,
-                                   (GCompareFunc)_compare_service);
-  if (res)
-    return res->data;
-  return NULL;
+  if (!exec || !priv->apps_by_exec)
+    return NULL;
+  return g_hash_table_lookup (priv->apps_by_exec, exec);
 }
 
 #define CREATE_MODE (S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH)
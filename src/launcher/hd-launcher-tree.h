@@ -71,6 +71,10 @@ HdLauncherItem *hd_launcher_tree_find_item   (HdLauncherTree *tree,
 HdLauncherApp  *hd_launcher_tree_find_app_by_service (
                                               HdLauncherTree *tree,
                                               const gchar *service);
+/* Finds the app whose executable is @exec, the same path. */
+HdLauncherApp  *hd_launcher_tree_find_app_by_exec (
+                                              HdLauncherTree *tree,
+                                              const gchar *exec);
 
 /* Utility functions. */
 void hd_launcher_tree_ensure_user_menu (void);
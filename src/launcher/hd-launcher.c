@@ -41,6 +41,7 @@
 
 #include "hildon-desktop.h"
 #include "hd-launcher-grid.h"
+#include "hd-launcher-icons.h"
 #include "hd-launcher-page.h"
 #include "hd-launcher-editor.h"
 #include "hd-gtk-utils.h"
@@ -90,6 +91,10 @@ struct _HdLauncherPrivate
 
   HdLauncherTree *tree;
   HdLauncherTraverseData *current_traversal;
+  /* Item id -> its HdLauncherTile */
+  GHashTable *tiles;
+  /* An update of the tree came during a traversal, start over. */
+  guint rebuild_id;
 
   GtkWidget *editor;
   /* GConfClient to check whether menu editing is enabled or not */
@@ -145,6 +150,18 @@ static void hd_launcher_populate_tree_starting (HdLauncherTree *tree,
 static void hd_launcher_populate_tree_finished (HdLauncherTree *tree,
                                                 gpointer data);
 static void hd_launcher_lazy_traverse_cleanup  (gpointer data);
+static void hd_launcher_tree_item_added   (HdLauncherTree *tree,
+                                           HdLauncherItem *item,
+                                           gpointer data);
+static void hd_launcher_tree_item_removed (HdLauncherTree *tree,
+                                           HdLauncherItem *item,
+                                           gpointer data);
+static void hd_launcher_tree_item_changed (HdLauncherTree *tree,
+                                           HdLauncherItem *item,
+                                           HdLauncherItem *old_item,
+                                           gpointer data);
+static void hd_launcher_tree_reordered    (HdLauncherTree *tree,
+                                           gpointer data);
 static void hd_launcher_transition_new_frame(ClutterTimeline *timeline,
                                              gint frame_num, gpointer data);
 
@@ -217,6 +234,8 @@ hd_launcher_init (HdLauncher *self)
   self->priv = priv = HD_LAUNCHER_GET_PRIVATE (self);
   priv->gconf_client = gconf_client_get_default ();
   g_datalist_init (&priv->pages);
+  priv->tiles = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       g_free, NULL);
 }
 
 static void hd_launcher_constructed (GObject *gobject)
@@ -235,6 +254,18 @@ static void hd_launcher_constructed (GObject *gobject)
   g_signal_connect (priv->tree, "finished",
                     G_CALLBACK (hd_launcher_populate_tree_finished),
                     gobject);
+  g_signal_connect (priv->tree, "item-added",
+                    G_CALLBACK (hd_launcher_tree_item_added),
+                    gobject);
+  g_signal_connect (priv->tree, "item-removed",
+                    G_CALLBACK (hd_launcher_tree_item_removed),
+                    gobject);
+  g_signal_connect (priv->tree, "item-changed",
+                    G_CALLBACK (hd_launcher_tree_item_changed),
+                    gobject);
+  g_signal_connect (priv->tree, "reordered",
+                    G_CALLBACK (hd_launcher_tree_reordered),
+                    gobject);
 
   /* Add callback for clicked background */
   clutter_actor_set_reactive ( self, TRUE );
@@ -278,6 +309,17 @@ hd_launcher_dispose (GObject *gobject)
 
   g_datalist_clear (&priv->pages);
 
+  if (priv->tiles)
+    {
+      g_hash_table_destroy (priv->tiles);
+      priv->tiles = NULL;
+    }
+  if (priv->rebuild_id)
+    {
+      g_source_remove (priv->rebuild_id);
+      priv->rebuild_id = 0;
+    }
+
   G_OBJECT_CLASS (hd_launcher_parent_class)->dispose (gobject);
 }
 
@@ -344,6 +386,36 @@ hd_launcher_update_orientation (gboolean portraited)
       _hd_launcher_update_orientation_cb, GBOOLEAN_TO_POINTER (portraited));
 }
 
+static void
+_hd_launcher_release_page_tiles (GQuark key_id, gpointer data,
+                                 gpointer user_data)
+{
+  HdLauncherGrid *grid = HD_LAUNCHER_GRID (
+                           hd_launcher_page_get_grid (HD_LAUNCHER_PAGE (data)));
+
+  /* Keep what's on the screen if this is the page being shown. */
+  hd_launcher_grid_release_tiles (grid, data != user_data);
+}
+
+/* hd_launcher_trim_memory:
+ *
+ * Take the icons from the launcher tiles which aren't on the screen, when
+ * the system is running out of memory.  They come back as they are needed.
+ */
+void
+hd_launcher_trim_memory (void)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (hd_launcher_get ());
+  gsize before = hd_launcher_icons_get_atlas_bytes ();
+
+  g_datalist_foreach (&priv->pages, _hd_launcher_release_page_tiles,
+                      STATE_IS_LAUNCHER (hd_render_manager_get_state ())
+                        ? priv->active_page : NULL);
+  g_debug ("%s: icon atlases %" G_GSIZE_FORMAT " -> %" G_GSIZE_FORMAT " kB",
+           __FUNCTION__, before / 1024,
+           hd_launcher_icons_get_atlas_bytes () / 1024);
+}
+
 /* hd_launcher_show:
  *
  * When the is_top_page is TRUE, the active_page private variable is set to top_page.
@@ -544,11 +616,10 @@ _hd_launcher_editor_done (HdLauncherEditor *editor,
 
   priv->editor_done = TRUE;
 
-  if (!modified)
-    {
-      /* Go back directly to the launcher. */
-      hd_render_manager_set_state (HDRM_STATE_LAUNCHER);
-    }
+  /* Go back to the launcher.  If the editor has changed something, the
+   * tree tells us when the menu has been read again and the tiles are
+   * updated in place then. */
+  hd_render_manager_set_state (HDRM_STATE_LAUNCHER);
 }
 
 static gboolean
@@ -714,6 +785,7 @@ hd_launcher_populate_tree_starting (HdLauncherTree *tree, gpointer data)
       priv->current_traversal->cancelled = TRUE;
     }
   priv->current_traversal = NULL;
+  g_hash_table_remove_all (priv->tiles);
 
   if (priv->pages)
     {
@@ -745,6 +817,57 @@ hd_launcher_create_page (HdLauncherItem *item, gpointer data)
   g_datalist_set_data_full (&priv->pages, hd_launcher_item_get_id (item), newpage, (GDestroyNotify) clutter_actor_destroy);
 }
 
+/* Put @tile in the page of @item's category and connect it to @item.
+ * Returns the page, or NULL if there's none, and @tile is gone then. */
+static HdLauncherPage *
+hd_launcher_add_tile (HdLauncherItem *item, HdLauncherTile *tile)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (hd_launcher_get ());
+  HdLauncherPage *page;
+
+  /* Find in which page it goes */
+  page = g_datalist_get_data (&priv->pages,
+                              hd_launcher_item_get_category (item));
+  if (!page)
+    /* Put it in the top level. */
+    page = g_datalist_get_data (&priv->pages, HD_LAUNCHER_ITEM_TOP_CATEGORY);
+
+  /* If we don't have a top level, we're in deep trouble, but we still
+   * check just in case.
+   */
+  if (!page)
+    {
+      g_warning ("%s: Couldn't find any page to accept entry %s",
+          __FUNCTION__, hd_launcher_item_get_id (item));
+      g_object_unref (tile);
+      return NULL;
+    }
+
+  hd_launcher_page_add_tile (page, tile);
+
+  if (hd_launcher_item_get_item_type(item) == HD_CATEGORY_LAUNCHER)
+    {
+      g_signal_connect (tile, "clicked",
+                        G_CALLBACK (hd_launcher_category_tile_clicked),
+                        g_datalist_get_data (&priv->pages,
+                          hd_launcher_item_get_id (item)));
+    }
+  else if (hd_launcher_item_get_item_type(item) == HD_APPLICATION_LAUNCHER)
+    {
+      g_signal_connect (tile, "clicked",
+                        G_CALLBACK (hd_launcher_application_tile_clicked),
+                        item);
+    }
+
+  g_signal_connect (tile, "long-clicked",
+                G_CALLBACK (hd_launcher_application_tile_long_clicked),
+                item);
+
+  g_hash_table_insert (priv->tiles, g_strdup (hd_launcher_item_get_id (item)),
+                       tile);
+  return page;
+}
+
 static gboolean
 hd_launcher_lazy_traverse_tree (gpointer data)
 {
@@ -752,7 +875,6 @@ hd_launcher_lazy_traverse_tree (gpointer data)
   HdLauncherTraverseData *tdata = data;
   HdLauncherItem *item;
   HdLauncherTile *tile;
-  HdLauncherPage *page = NULL;
   guint i;
 
   if (!tdata ||
@@ -780,44 +902,7 @@ hd_launcher_lazy_traverse_tree (gpointer data)
           return FALSE;
         }
 
-      /* Find in which page it goes */
-      page = g_datalist_get_data (&priv->pages,
-                                  hd_launcher_item_get_category (item));
-      if (!page)
-        /* Put it in the top level. */
-        page = g_datalist_get_data (&priv->pages, HD_LAUNCHER_ITEM_TOP_CATEGORY);
-
-      /* If we don't have a top level, we're in deep trouble, but we still
-       * check just in case.
-       */
-      if (!page)
-        {
-          g_warning ("%s: Couldn't find any page to accept entry %s",
-              __FUNCTION__, hd_launcher_item_get_id (item));
-          g_object_unref (tile);
-        }
-      else
-        {
-          hd_launcher_page_add_tile (page, tile);
-
-          if (hd_launcher_item_get_item_type(item) == HD_CATEGORY_LAUNCHER)
-            {
-              g_signal_connect (tile, "clicked",
-                                G_CALLBACK (hd_launcher_category_tile_clicked),
-                                g_datalist_get_data (&priv->pages,
-                                  hd_launcher_item_get_id (item)));
-            }
-          else if (hd_launcher_item_get_item_type(item) == HD_APPLICATION_LAUNCHER)
-            {
-              g_signal_connect (tile, "clicked",
-                                G_CALLBACK (hd_launcher_application_tile_clicked),
-                                item);
-            }
-
-          g_signal_connect (tile, "long-clicked",
-                        G_CALLBACK (hd_launcher_application_tile_long_clicked),
-                        item);
-        }
+      hd_launcher_add_tile (item, tile);
 
       g_object_unref (G_OBJECT (item));
       tdata->items = g_list_delete_link (tdata->items, tdata->items);
@@ -861,6 +946,18 @@ hd_launcher_lazy_traverse_cleanup (gpointer data)
   g_free (data);
 }
 
+static void
+hd_launcher_prefetch_icons (GList *items)
+{
+  GList *names = NULL;
+
+  for (; items; items = items->next)
+    names = g_list_prepend (names,
+                (gpointer) hd_launcher_item_get_icon_name (items->data));
+  hd_launcher_icons_prefetch (names);
+  g_list_free (names);
+}
+
 static void
 hd_launcher_populate_tree_finished (HdLauncherTree *tree, gpointer data)
 {
@@ -874,6 +971,9 @@ hd_launcher_populate_tree_finished (HdLauncherTree *tree, gpointer data)
   tdata->items = g_list_copy(hd_launcher_tree_get_items(tree));
   g_list_foreach (tdata->items, (GFunc)g_object_ref, NULL);
 
+  /* Have the icons decoded while the tiles are being made. */
+  hd_launcher_prefetch_icons (tdata->items);
+
   if (priv->current_traversal)
     {
       priv->current_traversal->cancelled = TRUE;
@@ -910,6 +1010,228 @@ hd_launcher_populate_tree_finished (HdLauncherTree *tree, gpointer data)
                                  hd_launcher_lazy_traverse_cleanup);
 }
 
+/*
+ * Following the changes of the tree
+ */
+
+static gboolean
+hd_launcher_rebuild_idle (gpointer data)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (data);
+
+  priv->rebuild_id = 0;
+  hd_launcher_populate_tree_starting (priv->tree, data);
+  hd_launcher_populate_tree_finished (priv->tree, data);
+
+  return FALSE;
+}
+
+/* The traversal in progress works from a copy of the old items, so
+ * instead of patching it, start over once it's all been told. */
+static gboolean
+hd_launcher_rebuild_if_traversing (HdLauncher *launcher)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (launcher);
+
+  if (!priv->current_traversal)
+    return FALSE;
+
+  if (!priv->rebuild_id)
+    priv->rebuild_id = g_idle_add (hd_launcher_rebuild_idle, launcher);
+  return TRUE;
+}
+
+/* Where the tile of @item goes in @grid: after the tiles there of the
+ * items which come before it in the tree. */
+static gint
+hd_launcher_tile_position (HdLauncher *launcher, HdLauncherItem *item,
+                           ClutterActor *grid)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (launcher);
+  ClutterActor *tile;
+  GList *l;
+  gint position;
+
+  position = 0;
+  for (l = hd_launcher_tree_get_items (priv->tree);
+       l && l->data != item; l = l->next)
+    {
+      tile = g_hash_table_lookup (priv->tiles,
+                                  hd_launcher_item_get_id (l->data));
+      if (tile && clutter_actor_get_parent (tile) == grid)
+        position++;
+    }
+
+  return position;
+}
+
+static void
+hd_launcher_tree_item_added (HdLauncherTree *tree,
+                             HdLauncherItem *item,
+                             gpointer data)
+{
+  HdLauncher *launcher = HD_LAUNCHER (data);
+  HdLauncherTile *tile;
+  HdLauncherPage *page;
+  ClutterActor *grid;
+
+  if (hd_launcher_rebuild_if_traversing (launcher))
+    return;
+
+  hd_launcher_create_page (item, NULL);
+
+  tile = hd_launcher_tile_new (hd_launcher_item_get_icon_name (item),
+                               hd_launcher_item_get_local_name (item));
+  if ((page = hd_launcher_add_tile (item, tile)) != NULL)
+    {
+      /* It's been appended, put it in its place. */
+      grid = hd_launcher_page_get_grid (page);
+      hd_launcher_grid_move_tile (HD_LAUNCHER_GRID (grid),
+                                  CLUTTER_ACTOR (tile),
+                                  hd_launcher_tile_position (launcher,
+                                                             item, grid));
+      _hd_launcher_layout_page (0, page, NULL);
+    }
+}
+
+/* Destroy the tile of @item and return the page it was in. */
+static ClutterActor *
+hd_launcher_remove_tile (HdLauncher *launcher, HdLauncherItem *item)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (launcher);
+  ClutterActor *tile, *page;
+
+  tile = g_hash_table_lookup (priv->tiles, hd_launcher_item_get_id (item));
+  if (!tile)
+    return NULL;
+  g_hash_table_remove (priv->tiles, hd_launcher_item_get_id (item));
+
+  /* The tile is in the grid of the page. */
+  page = clutter_actor_get_parent (tile);
+  while (page && !HD_IS_LAUNCHER_PAGE (page))
+    page = clutter_actor_get_parent (page);
+
+  clutter_actor_destroy (tile);
+  return page;
+}
+
+/* Put the tiles of every page in the order of the tree again. */
+static void
+hd_launcher_tree_reordered (HdLauncherTree *tree, gpointer data)
+{
+  HdLauncher *launcher = HD_LAUNCHER (data);
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (launcher);
+  ClutterActor *tile, *grid;
+  GList *l;
+
+  if (hd_launcher_rebuild_if_traversing (launcher))
+    return;
+
+  /* Moving each to the end of its grid in the order of the tree
+   * leaves them in that order. */
+  for (l = hd_launcher_tree_get_items (tree); l; l = l->next)
+    {
+      tile = g_hash_table_lookup (priv->tiles,
+                                  hd_launcher_item_get_id (l->data));
+      if (tile && (grid = clutter_actor_get_parent (tile)) != NULL
+          && HD_IS_LAUNCHER_GRID (grid))
+        hd_launcher_grid_move_tile (HD_LAUNCHER_GRID (grid), tile, -1);
+    }
+
+  g_datalist_foreach (&priv->pages, _hd_launcher_layout_page, NULL);
+}
+
+static gboolean
+hd_launcher_tile_is_in_page (gpointer key, gpointer value, gpointer page)
+{
+  ClutterActor *actor;
+
+  for (actor = value; actor; actor = clutter_actor_get_parent (actor))
+    if (actor == page)
+      return TRUE;
+  return FALSE;
+}
+
+static void
+hd_launcher_tree_item_removed (HdLauncherTree *tree,
+                               HdLauncherItem *item,
+                               gpointer data)
+{
+  HdLauncher *launcher = HD_LAUNCHER (data);
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (launcher);
+  ClutterActor *page;
+
+  if (hd_launcher_rebuild_if_traversing (launcher))
+    return;
+
+  if ((page = hd_launcher_remove_tile (launcher, item)) != NULL)
+    _hd_launcher_layout_page (0, page, NULL);
+
+  if (hd_launcher_item_get_item_type (item) != HD_CATEGORY_LAUNCHER)
+    return;
+
+  page = g_datalist_get_data (&priv->pages, hd_launcher_item_get_id (item));
+  if (page && page == priv->active_page)
+    {
+      priv->active_page = NULL;
+      if (STATE_IS_LAUNCHER (hd_render_manager_get_state ()))
+        hd_render_manager_set_state (priv->portraited
+                                     ? HDRM_STATE_HOME_PORTRAIT
+                                     : HDRM_STATE_HOME);
+    }
+  /* Apps which have moved out of it are told about later. */
+  if (page)
+    g_hash_table_foreach_remove (priv->tiles, hd_launcher_tile_is_in_page,
+                                 page);
+  g_datalist_remove_data (&priv->pages, hd_launcher_item_get_id (item));
+}
+
+static void
+hd_launcher_tree_item_changed (HdLauncherTree *tree,
+                               HdLauncherItem *item,
+                               HdLauncherItem *old_item,
+                               gpointer data)
+{
+  HdLauncher *launcher = HD_LAUNCHER (data);
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (launcher);
+  HdLauncherTile *tile;
+  ClutterActor *page;
+
+  if (hd_launcher_rebuild_if_traversing (launcher))
+    return;
+
+  tile = g_hash_table_lookup (priv->tiles, hd_launcher_item_get_id (item));
+  if (tile
+      && hd_launcher_item_get_item_type (item)
+         == hd_launcher_item_get_item_type (old_item)
+      && !g_strcmp0 (hd_launcher_item_get_category (item),
+                     hd_launcher_item_get_category (old_item)))
+    { /* Same place, just update the tile. */
+      hd_launcher_tile_set_icon_name (tile,
+                                      hd_launcher_item_get_icon_name (item));
+      hd_launcher_tile_set_text (tile,
+                                 hd_launcher_item_get_local_name (item));
+
+      g_signal_handlers_disconnect_by_func (tile,
+                        hd_launcher_application_tile_clicked, old_item);
+      g_signal_handlers_disconnect_by_func (tile,
+                        hd_launcher_application_tile_long_clicked, old_item);
+      if (hd_launcher_item_get_item_type (item) == HD_APPLICATION_LAUNCHER)
+        g_signal_connect (tile, "clicked",
+                          G_CALLBACK (hd_launcher_application_tile_clicked),
+                          item);
+      g_signal_connect (tile, "long-clicked",
+                        G_CALLBACK (hd_launcher_application_tile_long_clicked),
+                        item);
+      return;
+    }
+
+  /* It has moved to another category. */
+  if ((page = hd_launcher_remove_tile (launcher, old_item)) != NULL)
+    _hd_launcher_layout_page (0, page, NULL);
+  hd_launcher_tree_item_added (tree, item, data);
+}
+
 /* handle clicks to the fake launch image. If we've been up this long the
    app may have died and we just want to remove ourselves. */
 static gboolean
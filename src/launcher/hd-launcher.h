@@ -93,6 +93,7 @@ void hd_launcher_stop_loading_transition (void);
 
 void hd_launcher_activate(int p);
 void hd_launcher_update_orientation (gboolean portraited);
+void hd_launcher_trim_memory (void);
 
 gboolean hd_launcher_is_editor_in_landscape (void);
 gboolean hd_launcher_is_portrait (void);
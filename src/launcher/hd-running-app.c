@@ -41,6 +41,7 @@ struct _HdRunningAppPrivate
   HdRunningAppState state;
   GPid pid;
   time_t last_launch;
+  time_t last_shown;
 };
 
 G_DEFINE_TYPE_WITH_CODE (HdRunningApp,
@@ -146,6 +147,20 @@ hd_running_app_set_last_launch (HdRunningApp *app, time_t time)
   priv->last_launch = time;
 }
 
+time_t
+hd_running_app_get_last_shown (HdRunningApp *app)
+{
+  HdRunningAppPrivate *priv = HD_RUNNING_APP_GET_PRIVATE (app);
+  return priv->last_shown;
+}
+
+void
+hd_running_app_set_last_shown (HdRunningApp *app, time_t time)
+{
+  HdRunningAppPrivate *priv = HD_RUNNING_APP_GET_PRIVATE (app);
+  priv->last_shown = time;
+}
+
 HdLauncherApp  *
 hd_running_app_get_launcher_app  (HdRunningApp *app)
 {
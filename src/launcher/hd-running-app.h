@@ -85,6 +85,9 @@ GPid hd_running_app_get_pid (HdRunningApp *app);
 void hd_running_app_set_pid (HdRunningApp *app, GPid pid);
 time_t hd_running_app_get_last_launch (HdRunningApp *app);
 void   hd_running_app_set_last_launch (HdRunningApp *app, time_t time);
+/* When the app last went from the top to the background. */
+time_t hd_running_app_get_last_shown (HdRunningApp *app);
+void   hd_running_app_set_last_shown (HdRunningApp *app, time_t time);
 
 /* Some convenience functions. */
 const gchar *hd_running_app_get_service (HdRunningApp *app);
@@ -56,6 +56,8 @@
 #include "hd-home.h"
 #include "hd-shortcuts.h"
 #include "hd-xinput.h"
+#include "hd-startup.h"
+#include "hd-frame-stats.h"
 
 #ifndef DISABLE_A11Y
 #include "hildon-desktop-a11y.h"
@@ -377,6 +379,7 @@ main (int argc, char **argv)
   MBWindowManager *wm;
   HdAppMgr *app_mgr;
 
+  hd_startup_mark ("start");
   signal (SIGUSR1, dump_debug_info_sighand);
   signal (SIGHUP,  relaunch);
   signal (SIGTERM, terminating);
@@ -399,6 +402,7 @@ main (int argc, char **argv)
   /* Initialise the async error handler. Do it after gtk is inited, or gtk
    * will grab the handler for itself */
   mb_wm_util_async_x_error_init();
+  hd_startup_mark ("gtk_init");
 
   hd_mutex_init ();
 
@@ -418,6 +422,7 @@ main (int argc, char **argv)
   /* Use software-based selection, which is much faster on SGX than rendering
    * with 'GL and reading back */
   clutter_set_software_selection(TRUE);
+  hd_startup_mark ("clutter_init");
 
 #ifndef DISABLE_A11Y
   hildon_desktop_a11y_init ();
@@ -446,18 +451,23 @@ main (int argc, char **argv)
   hd_util_display_portraitness_init(wm);
   mb_wm_init (wm);
   g_assert (mb_wm_comp_mgr_enabled (wm->comp_mgr));
-  
+  hd_startup_mark ("mb_wm_init");
+
   hd_shortcuts_setup(wm);
+  hd_startup_mark ("shortcuts");
 
   hd_init_xinput (dpy);
   hd_enumerate_input_devices (dpy);
   hd_rotate_input_devices (dpy);
+  hd_startup_mark ("input devices");
 
   clutter_x11_add_filter (hd_clutter_x11_event_filter, wm);
 
   app_mgr = hd_app_mgr_get ();
+  hd_startup_mark ("app_mgr");
 
   hd_volume_profile_init ();
+  hd_startup_mark ("volume profile");
 
   /* Check if orientation is locked to portrait or the device is in vertical position. */
   if (hd_orientation_lock_is_locked_to_portrait () ||
@@ -473,13 +483,15 @@ main (int argc, char **argv)
       if (hd_util_change_screen_orientation (wm, FALSE))
         hd_util_root_window_configured (wm);
     }
-
+  hd_startup_mark ("orientation");
 
   /* NB: we call gtk_main as opposed to clutter_main or mb_wm_main_loop
    * because it does the most extra magic, such as supporting quit functions
    * that the others don't. Except for adding the clutter_x11_add_filter
    * (manually done above) it appears be a super set of the other two
    * so everything *should* be covered this way. */
+  hd_startup_run ();
+  hd_frame_stats_init ();
   gtk_main ();
 
   hd_close_input_devices (dpy);
@@ -68,6 +68,8 @@ typedef enum HdAtoms
   HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SCALE,
   HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_PARENT,
   HD_ATOM_HILDON_TEXTURE_CLIENT_READY,
+  HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SHM_RING,
+  HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_BUFFER_READY,
 
   HD_ATOM_HILDON_LOADING_SCREENSHOT,
 
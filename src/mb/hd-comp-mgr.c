@@ -39,6 +39,11 @@
 #include "hd-render-manager.h"
 #include "hd-title-bar.h"
 #include "hd-orientation-lock.h"
+#include "hd-clutter-cache.h"
+#include "hd-damage.h"
+#include "hd-frame-scheduler.h"
+#include "hd-frame-stats.h"
+#include "hd-startup.h"
 #include "launcher/hd-app-mgr.h"
 #include "launcher/hd-launcher-editor.h"
 
@@ -54,6 +59,7 @@
 #include <clutter/x11/clutter-x11.h>
 
 #include "../tidy/tidy-blur-group.h"
+#include "../tidy/tidy-offscreen-pool.h"
 
 #include <dbus/dbus-glib-bindings.h>
 #include <mce/dbus-names.h>
@@ -91,6 +97,11 @@ struct HdCompMgrPrivate
   GHashTable            *shown_apps;
   GHashTable            *hibernating_apps;
 
+  /* Registered clients by their actor and by their X window,
+   * see hd_comp_mgr_client_from_actor(). */
+  GHashTable            *clients_by_actor;
+  GHashTable            *clients_by_xwindow;
+
   Atom                   *atoms;
 
   DBusConnection        *dbus_connection;
@@ -602,6 +613,8 @@ hd_comp_mgr_init (MBWMObject *obj, va_list vap)
 			   g_direct_equal,
 			   NULL,
                (GDestroyNotify)mb_wm_object_unref);
+  priv->clients_by_actor = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->clients_by_xwindow = g_hash_table_new (g_direct_hash, g_direct_equal);
 
   /* Be notified about all X window property changes around here. */
   priv->property_changed_cb_id = mb_wm_main_context_x_event_handler_add (
@@ -643,6 +656,10 @@ hd_comp_mgr_destroy (MBWMObject *obj)
     g_hash_table_destroy (priv->shown_apps);
   if (priv->hibernating_apps)
     g_hash_table_destroy (priv->hibernating_apps);
+  if (priv->clients_by_actor)
+    g_hash_table_destroy (priv->clients_by_actor);
+  if (priv->clients_by_xwindow)
+    g_hash_table_destroy (priv->clients_by_xwindow);
   if (priv->app_mgr)
     {
       g_object_unref (priv->app_mgr);
@@ -1156,6 +1173,103 @@ lp_forecast (MBWindowManager *wm, MBWindowManagerClient *client)
   g_ptr_array_free (stack, TRUE);
 }
 
+/* The actor of @c if it has one already. */
+static ClutterActor *
+hd_comp_mgr_client_actor (MBWindowManagerClient *c)
+{
+  if (!c->cm_client)
+    return NULL;
+  return mb_wm_comp_mgr_clutter_client_get_actor (
+                           MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client));
+}
+
+static gboolean
+hd_comp_mgr_index_entry_is (gpointer key, gpointer value, gpointer c)
+{
+  return value == c;
+}
+
+/* Add @c to the client registry.  The actor is only created when the
+ * client is mapped, so this is called both at registration and after
+ * the parent map_notify().  If the client has got a new actor since,
+ * the entry of the old one is dropped. */
+static void
+hd_comp_mgr_index_client (HdCompMgr *hmgr, MBWindowManagerClient *c)
+{
+  HdCompMgrPrivate *priv = hmgr->priv;
+  ClutterActor *actor;
+
+  if (c->window)
+    g_hash_table_insert (priv->clients_by_xwindow,
+                         (gpointer)c->window->xwindow, c);
+  if ((actor = hd_comp_mgr_client_actor (c)) != NULL
+      && g_hash_table_lookup (priv->clients_by_actor, actor) != c)
+    {
+      g_hash_table_foreach_remove (priv->clients_by_actor,
+                                   hd_comp_mgr_index_entry_is, c);
+      g_hash_table_insert (priv->clients_by_actor, actor, c);
+    }
+}
+
+/* Remove the entries of @c from the registry, whichever actor or
+ * window they are under, but not the ones which have been taken over
+ * by another client since. */
+static void
+hd_comp_mgr_unindex_client (HdCompMgr *hmgr, MBWindowManagerClient *c)
+{
+  HdCompMgrPrivate *priv = hmgr->priv;
+
+  g_hash_table_foreach_remove (priv->clients_by_xwindow,
+                               hd_comp_mgr_index_entry_is, c);
+  g_hash_table_foreach_remove (priv->clients_by_actor,
+                               hd_comp_mgr_index_entry_is, c);
+}
+
+/* Whether @c is still managed by the window manager.  An unmanaged
+ * client can live on for a while, eg. during its close effect, and
+ * its actor with it.  This walks the stack, so it's only asked when
+ * the client is unmapped, the registry is trusted otherwise. */
+static gboolean
+hd_comp_mgr_client_is_managed (HdCompMgr *hmgr, MBWindowManagerClient *c)
+{
+  return c->window
+    && mb_wm_managed_client_from_xwindow (MB_WM_COMP_MGR (hmgr)->wm,
+                                          c->window->xwindow) == c;
+}
+
+MBWindowManagerClient *
+hd_comp_mgr_client_from_actor (ClutterActor *actor)
+{
+  HdCompMgr *hmgr = hd_comp_mgr_get ();
+  MBWindowManagerClient *c;
+  MBWMCompMgrClient *cc;
+
+  if (!hmgr || !actor)
+    return NULL;
+  if ((c = g_hash_table_lookup (hmgr->priv->clients_by_actor, actor)) != NULL)
+    return c;
+
+  /* The actor may have been replaced since the client was mapped;
+   * the clutter client still knows it, but it's only ours if the
+   * registry still has it under its window. */
+  cc = g_object_get_data (G_OBJECT (actor), "HD-MBWMCompMgrClutterClient");
+  if (!cc || !(c = cc->wm_client) || !c->window)
+    return NULL;
+  return g_hash_table_lookup (hmgr->priv->clients_by_xwindow,
+                              (gpointer)c->window->xwindow) == c ? c : NULL;
+}
+
+MBWindowManagerClient *
+hd_comp_mgr_client_from_xwindow (Window xwindow)
+{
+  HdCompMgr *hmgr = hd_comp_mgr_get ();
+
+  if (!hmgr || !xwindow)
+    return NULL;
+  return g_hash_table_lookup (hmgr->priv->clients_by_xwindow,
+                              (gpointer)xwindow);
+}
+
 static void
 hd_comp_mgr_register_client (MBWMCompMgr           * mgr,
 			     MBWindowManagerClient * c,
@@ -1177,6 +1291,7 @@ hd_comp_mgr_register_client (MBWMCompMgr           * mgr,
 
   if (parent_klass->register_client)
     parent_klass->register_client (mgr, c, activate);
+  hd_comp_mgr_index_client (HD_COMP_MGR (mgr), c);
 
   if (!activate)
     {
@@ -1207,6 +1322,7 @@ hd_comp_mgr_unregister_client (MBWMCompMgr *mgr, MBWindowManagerClient *c)
 
   g_debug ("%s, c=%p ctype=%d", __FUNCTION__, c, MB_WM_CLIENT_CLIENT_TYPE (c));
   actor = mb_wm_comp_mgr_clutter_client_get_actor (cclient);
+  hd_comp_mgr_unindex_client (HD_COMP_MGR (mgr), c);
 
   /* Check if it's the last window for the app. */
   if (hclient->priv->app)
@@ -1499,11 +1615,25 @@ hd_comp_mgr_texture_update_area(HdCompMgr *hmgr,
   if (blur_update)
     return;
 
-  /* Update the screen. This function checks for scaling/visibility and
-   * chooses the area to update accordingly */
+  /* Update the screen at the next frame tick.  Applications in the
+   * background (eg. in the switcher) needn't be drawn as often as
+   * they update, it only takes time from the animations. */
   {
+    static HdTransitionParam *background_ms;
     ClutterGeometry area = {x,y,width, height};
-    hd_util_partial_redraw_if_possible(actor, &area);
+    MBWindowManagerClient *c;
+    guint interval = 0;
+
+    c = hd_comp_mgr_client_from_actor (clutter_actor_get_parent (actor));
+    if (c && HD_IS_APP (c) && c->cm_client
+        && HD_COMP_MGR_CLIENT (c->cm_client) != hmgr->priv->current_hclient)
+      {
+        if (G_UNLIKELY (!background_ms))
+          background_ms = hd_transition_param_lookup ("damage",
+                                                      "background_ms");
+        interval = MAX (hd_transition_param_get_int (background_ms, 100), 0);
+      }
+    hd_damage_add_actor_area (actor, &area, interval);
   }
 }
 
@@ -2088,6 +2218,7 @@ hd_comp_mgr_map_notify (MBWMCompMgr *mgr, MBWindowManagerClient *c)
       /*g_printerr ("%s: client '%s' is live background\n", __func__,
                   mb_wm_client_get_name (c)); */
       parent_klass->map_notify (mgr, c);
+      hd_comp_mgr_index_client (HD_COMP_MGR (mgr), c);
 
       hd_home_set_live_background (HD_HOME (priv->home), c);
       mb_wm_comp_mgr_clutter_client_set_flags (
@@ -2184,6 +2315,7 @@ hd_comp_mgr_map_notify (MBWMCompMgr *mgr, MBWindowManagerClient *c)
         }
 
       parent_klass->map_notify (mgr, c);
+      hd_comp_mgr_index_client (HD_COMP_MGR (mgr), c);
     }
 
   /* Now the actor has been created and added to the desktop, make sure we
@@ -2799,6 +2931,9 @@ hd_comp_mgr_unmap_notify (MBWMCompMgr *mgr, MBWindowManagerClient *c)
            c && c->window ? c->window->xwindow : 0,
            mb_wm_client_get_name (c));
 
+  if (!hd_comp_mgr_client_is_managed (HD_COMP_MGR (mgr), c))
+    hd_comp_mgr_unindex_client (HD_COMP_MGR (mgr), c);
+
   if (c->window->live_background)
     {
       /*g_printerr ("%s: remove live_bg\n", __func__);*/
@@ -3810,6 +3945,13 @@ hd_comp_mgr_dump_debug_info (const gchar *tag)
   XFree(inputshape);
 
   dump_clutter_actor_tree (clutter_stage_get_default (), NULL);
+  hd_clutter_cache_dump_debug_info ();
+  hd_damage_dump_debug_info ();
+  hd_frame_scheduler_dump_debug_info ();
+  hd_frame_stats_dump_debug_info ();
+  tidy_offscreen_pool_dump_debug_info ();
+  hd_render_manager_dump_debug_info ();
+  hd_startup_dump_debug_info ();
   hd_app_mgr_dump_app_list (TRUE);
 #endif
 }
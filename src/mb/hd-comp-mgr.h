@@ -153,6 +153,10 @@ gint hd_comp_mgr_get_current_home_view_id (HdCompMgr *hmgr);
 
 MBWindowManagerClient * hd_comp_mgr_get_desktop_client (HdCompMgr *hmgr);
 
+/* Registered clients by their actor or X window, NULL if none. */
+MBWindowManagerClient * hd_comp_mgr_client_from_actor (ClutterActor *actor);
+MBWindowManagerClient * hd_comp_mgr_client_from_xwindow (Window xwindow);
+
 void hd_comp_mgr_dump_debug_info (const gchar *tag);
 
 gboolean hd_comp_mgr_restack (MBWMCompMgr * mgr);
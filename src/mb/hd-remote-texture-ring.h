@@ -0,0 +1,158 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _HAVE_HD_REMOTE_TEXTURE_RING_H
+#define _HAVE_HD_REMOTE_TEXTURE_RING_H
+
+/*
+ * Buffer ring transport for remote textures.  This header is shared
+ * with the producers, so it only depends on libc.
+ *
+ * The producer creates a memfd with MFD_ALLOW_SEALING, sizes it, lays
+ * it out as a header followed by 2 or 3 frame buffers, seals it with
+ * F_SEAL_SHRINK (and F_SEAL_SEAL) and announces it with
+ * _HILDON_TEXTURE_CLIENT_MESSAGE_SHM_RING (pid, fd, width, height, bpp).
+ * The compositor opens it as HD_REMOTE_TEXTURE_RING_PATH_FORMAT and
+ * refuses it unless it's sealed against shrinking, because it couldn't
+ * survive the pages of a frame being truncated away under it.  The
+ * descriptor must stay open until the compositor has received the
+ * first frame.  For each frame the producer:
+ *
+ *   b = hd_remote_texture_ring_begin_frame (ring);   -- -1: no free buffer
+ *   ...draw into the buffer at ring->offset[b]...
+ *   hd_remote_texture_ring_end_frame (ring, b);
+ *
+ * and sends _HILDON_TEXTURE_CLIENT_MESSAGE_BUFFER_READY (seq, x, y,
+ * width, height), the damage relative to the previous frame.
+ *
+ * The compositor marks the buffer it uploads from in @reading and the
+ * producer never draws into that one or the newest complete one, so
+ * the compositor never sees a half-drawn frame.  Both sides check the
+ * other's claim after publishing their own (the per-buffer sequence
+ * number is odd while the buffer is being drawn), so a race makes one
+ * of them back off rather than both using the buffer.
+ */
+
+#include <stdint.h>
+
+#define HD_REMOTE_TEXTURE_RING_MAGIC       0x48445254 /* HDRT */
+#define HD_REMOTE_TEXTURE_RING_VERSION     1
+#define HD_REMOTE_TEXTURE_RING_MAX_BUFFERS 3
+
+/* printf() format of where the compositor opens the ring of the
+ * producer's pid and fd. */
+#define HD_REMOTE_TEXTURE_RING_PATH_FORMAT "/proc/%lu/fd/%lu"
+
+typedef struct
+{
+  uint32_t magic, version;
+  uint32_t width, height, bpp, rowstride;
+  uint32_t n_buffers;
+  /* Where the buffers are, from the start of the header. */
+  uint32_t offset[HD_REMOTE_TEXTURE_RING_MAX_BUFFERS];
+
+  /* Sequence number of the frame in each buffer; odd while the
+   * producer is drawing it. */
+  volatile uint32_t seq[HD_REMOTE_TEXTURE_RING_MAX_BUFFERS];
+  /* The buffer with the newest complete frame. */
+  volatile uint32_t latest;
+  /* The buffer the compositor is using, or n_buffers if none. */
+  volatile uint32_t reading;
+} HdRemoteTextureRing;
+
+/* Returns the buffer to draw the next frame into, or -1 if there is
+ * none free right now (the compositor is behind; try again later). */
+static inline int
+hd_remote_texture_ring_begin_frame (HdRemoteTextureRing *ring)
+{
+  uint32_t i;
+
+  for (i = 0; i < ring->n_buffers; i++)
+    {
+      uint32_t seq;
+
+      if (i == ring->latest || i == ring->reading)
+        continue;
+
+      seq = ring->seq[i];
+      ring->seq[i] = seq | 1;
+      __sync_synchronize ();
+      if (ring->reading != i)
+        return i;
+
+      /* The compositor has just taken it. */
+      ring->seq[i] = seq;
+      __sync_synchronize ();
+    }
+
+  return -1;
+}
+
+/* Publish buffer @b as the newest frame and return its sequence number. */
+static inline uint32_t
+hd_remote_texture_ring_end_frame (HdRemoteTextureRing *ring, int b)
+{
+  uint32_t seq, i;
+
+  /* One more than the newest so far, even. */
+  for (i = seq = 0; i < ring->n_buffers; i++)
+    if ((int)i != b && !(ring->seq[i] & 1) && ring->seq[i] > seq)
+      seq = ring->seq[i];
+  seq += 2;
+
+  __sync_synchronize ();
+  ring->seq[b] = seq;
+  ring->latest = b;
+  __sync_synchronize ();
+
+  return seq;
+}
+
+/* Compositor side: claim the newest complete frame unless it's in
+ * @current already.  Returns its buffer and sets @seq, or returns -1
+ * if there's nothing new, or the producer has just started drawing
+ * into it again (it'll announce a newer frame soon then).  @n_buffers
+ * is what the compositor has checked, not @ring->n_buffers, which the
+ * producer may change at any time. */
+static inline int
+hd_remote_texture_ring_acquire (HdRemoteTextureRing *ring, uint32_t n_buffers,
+                                uint32_t current, uint32_t *seq)
+{
+  uint32_t latest, previous, latest_seq;
+
+  latest = ring->latest;
+  if (latest >= n_buffers || latest == current)
+    return -1;
+
+  previous = ring->reading;
+  ring->reading = latest;
+  __sync_synchronize ();
+  latest_seq = ring->seq[latest];
+  if ((latest_seq & 1) || !latest_seq)
+    {
+      ring->reading = previous;
+      __sync_synchronize ();
+      return -1;
+    }
+
+  *seq = latest_seq;
+  return latest;
+}
+
+#endif
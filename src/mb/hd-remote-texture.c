@@ -28,6 +28,12 @@
 
 #include <sys/time.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
 #include <time.h>
 
 #define CLIENT_MESSAGE_DEBUG 0//1
@@ -46,6 +52,8 @@ static guint32 offset_atom;
 static guint32 scale_atom;
 static guint32 parent_atom;
 static guint32 ready_atom;
+static guint32 shm_ring_atom;
+static guint32 buffer_ready_atom;
 static gboolean atoms_initialized = 0;
 
 void
@@ -57,6 +65,12 @@ hd_remote_texture_request_geometry (MBWindowManagerClient *client,
 static void
 hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
                           guint width, guint height, guint bpp);
+static void
+hd_remote_texture_set_ring(HdRemoteTexture *tex, gulong pid, gulong fd,
+                           guint width, guint height, guint bpp);
+static void
+hd_remote_texture_buffer_ready(HdRemoteTexture *tex, guint32 seq,
+                               gint x, gint y, gint width, gint height);
 
 static Bool
 hd_remote_texture_client_message (XClientMessageEvent *xev, void *userdata)
@@ -95,6 +109,29 @@ hd_remote_texture_client_message (XClientMessageEvent *xev, void *userdata)
                   self, shm_key,
                   shm_width, shm_height, shm_bpp);
     }
+  else if (xev->message_type == shm_ring_atom)
+    {
+        gulong ring_pid = (gulong) xev->data.l[0];
+        gulong ring_fd = (gulong) xev->data.l[1];
+        guint ring_width = (guint) xev->data.l[2];
+        guint ring_height = (guint) xev->data.l[3];
+        guint ring_bpp = (guint) xev->data.l[4];
+
+        CM_DEBUG ("RemoteTexture %p: shm_ring(pid=%lu, fd=%lu, width=%d, "
+                  "height=%d, bpp=%d)\n", self, ring_pid, ring_fd,
+                  ring_width, ring_height, ring_bpp);
+        hd_remote_texture_set_ring(self, ring_pid, ring_fd,
+            ring_width, ring_height, ring_bpp);
+    }
+  else if (xev->message_type == buffer_ready_atom)
+    {
+        guint32 seq = (guint32) xev->data.l[0];
+
+        CM_DEBUG ("RemoteTexture %p: buffer_ready(seq=%u)\n", self, seq);
+        hd_remote_texture_buffer_ready(self, seq,
+            (gint) xev->data.l[1], (gint) xev->data.l[2],
+            (gint) xev->data.l[3], (gint) xev->data.l[4]);
+    }
   else if (xev->message_type == damage_atom)
     {
         gint x = (gint) xev->data.l[0];
@@ -274,6 +311,10 @@ hd_remote_texture_realize (MBWindowManagerClient *client)
 	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_PARENT);
 	ready_atom = hd_comp_mgr_get_atom
 	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_READY);
+	shm_ring_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SHM_RING);
+	buffer_ready_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_BUFFER_READY);
 
 	atoms_initialized = 1;
     }
@@ -349,6 +390,7 @@ hd_remote_texture_destroy (MBWMObject *this)
   }
   /* unattach ourselves if we were attached */
   hd_remote_texture_set_shm(self, 0, 0, 0, 0);
+  hd_remote_texture_set_ring(self, 0, 0, 0, 0, 0);
   /* free our texture */
   clutter_actor_destroy(CLUTTER_ACTOR(self->texture));
   self->texture = 0;
@@ -478,6 +520,8 @@ hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
 
   if (key == 0)
     return;
+  /* one transport at a time */
+  hd_remote_texture_set_ring(tex, 0, 0, 0, 0, 0);
 
   tex->shm_key = key;
   tex->shm_width = width;
@@ -510,4 +554,142 @@ hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
       tex->shm_bpp);
 }
 
+/* Attach the buffer ring the producer @pid has in its descriptor @fd,
+ * or just detach the current one if @pid is 0.  Nothing is shown until
+ * the first frame is ready. */
+static void
+hd_remote_texture_set_ring(HdRemoteTexture *tex, gulong pid, gulong fd,
+                           guint width, guint height, guint bpp)
+{
+  HdRemoteTextureRing *ring;
+  struct stat st;
+  gchar path[64];
+  gboolean sealed;
+  guint i, n_buffers;
+  int ring_fd;
+
+  if (tex->ring)
+    {
+      tidy_mem_texture_set_data(tex->texture, 0, 0, 0, 0);
+      munmap(tex->ring, tex->ring_size);
+      tex->ring = NULL;
+      tex->ring_size = 0;
+    }
+
+  if (pid == 0)
+    return;
+  hd_remote_texture_set_shm(tex, 0, 0, 0, 0);
+
+  snprintf(path, sizeof(path), HD_REMOTE_TEXTURE_RING_PATH_FORMAT, pid, fd);
+  if ((ring_fd = open(path, O_RDWR)) < 0)
+    {
+      g_critical("%s: open(%s): %s", __FUNCTION__, path, g_strerror(errno));
+      return;
+    }
+
+  /* Touching a page the producer has truncated away would be a SIGBUS,
+   * so it has to have made sure it can't. */
+#ifdef F_GET_SEALS
+  {
+    int seals = fcntl(ring_fd, F_GET_SEALS);
+    sealed = seals >= 0 && (seals & F_SEAL_SHRINK);
+  }
+#else
+  sealed = FALSE;
+#endif
+  if (!sealed)
+    {
+      g_critical("%s: %s is not sealed against shrinking", __FUNCTION__,
+                 path);
+      close(ring_fd);
+      return;
+    }
+
+  /* We need to write @reading, so it's mapped read-write.  The mapping
+   * keeps the object, the descriptor isn't needed after this. */
+  ring = MAP_FAILED;
+  if (fstat(ring_fd, &st) == 0 && (gsize)st.st_size >= sizeof(*ring))
+    ring = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED, ring_fd, 0);
+  close(ring_fd);
+  if (ring == MAP_FAILED)
+    {
+      g_critical("%s: can't map %s", __FUNCTION__, path);
+      return;
+    }
+
+  /* Don't trust the producer with our address space: check the layout
+   * once and only use our copy of it from now on. */
+  tex->ring_width = ring->width;
+  tex->ring_height = ring->height;
+  tex->ring_bpp = ring->bpp;
+  tex->ring_rowstride = ring->rowstride;
+  tex->ring_n_buffers = n_buffers = ring->n_buffers;
+  for (i = 0; i < HD_REMOTE_TEXTURE_RING_MAX_BUFFERS; i++)
+    tex->ring_offset[i] = ring->offset[i];
+
+  if (ring->magic != HD_REMOTE_TEXTURE_RING_MAGIC
+      || ring->version != HD_REMOTE_TEXTURE_RING_VERSION
+      || tex->ring_width != width || tex->ring_height != height
+      || tex->ring_bpp != bpp
+      || n_buffers < 2 || n_buffers > HD_REMOTE_TEXTURE_RING_MAX_BUFFERS
+      || (guint64)tex->ring_rowstride < (guint64)width * bpp)
+    goto invalid;
+  for (i = 0; i < n_buffers; i++)
+    if (tex->ring_offset[i] < sizeof(*ring)
+        || (guint64)tex->ring_offset[i]
+             + (guint64)tex->ring_rowstride * height > (guint64)st.st_size)
+      goto invalid;
+
+  tex->ring = ring;
+  tex->ring_size = st.st_size;
+  tex->ring_buffer = n_buffers;
+  tex->ring_seq = 0;
+  ring->reading = n_buffers;
+  /* There may be a frame already. */
+  hd_remote_texture_buffer_ready(tex, 0, 0, 0, 0, 0);
+  return;
+
+invalid:
+  g_critical("%s: %s doesn't look like a %ux%ux%u ring", __FUNCTION__,
+             path, width, height, bpp);
+  munmap(ring, st.st_size);
+}
+
+/* A frame has been completed by the producer.  Switch to the newest
+ * one, unless the producer is already drawing into it again, in which
+ * case it'll tell us about the next one soon.  @x, @y, @width and
+ * @height is what changed since the previous frame @seq - 2. */
+static void
+hd_remote_texture_buffer_ready(HdRemoteTexture *tex, guint32 seq,
+                               gint x, gint y, gint width, gint height)
+{
+  HdRemoteTextureRing *ring = tex->ring;
+  guint32 latest_seq;
+  int latest;
+
+  if (!ring
+      || (latest = hd_remote_texture_ring_acquire(ring, tex->ring_n_buffers,
+                                  tex->ring_buffer, &latest_seq)) < 0)
+    return;
 
+  if (tex->ring_buffer < tex->ring_n_buffers)
+    tidy_mem_texture_swap_data(tex->texture,
+                               (const guchar *)ring + tex->ring_offset[latest]);
+  else
+    tidy_mem_texture_set_data_full(tex->texture,
+                               (const guchar *)ring + tex->ring_offset[latest],
+                               tex->ring_width, tex->ring_height,
+                               tex->ring_bpp, tex->ring_rowstride);
+  tex->ring_buffer = latest;
+
+  /* We can only trust @x..@height if we haven't missed a frame. */
+  if (latest_seq != seq || seq != tex->ring_seq + 2 || !width || !height)
+    {
+      x = y = 0;
+      width = tex->ring_width;
+      height = tex->ring_height;
+    }
+  tex->ring_seq = latest_seq;
+  tidy_mem_texture_damage(tex->texture, x, y, width, height);
+}
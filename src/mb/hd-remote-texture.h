@@ -28,6 +28,8 @@
 #include <matchbox/client-types/mb-wm-client-app.h>
 #include <tidy/tidy-mem-texture.h>
 
+#include "hd-remote-texture-ring.h"
+
 typedef struct HdRemoteTexture      HdRemoteTexture;
 typedef struct HdRemoteTextureClass HdRemoteTextureClass;
 
@@ -49,6 +51,19 @@ struct HdRemoteTexture
   guint         shm_height;
   guint         shm_bpp;
   const guchar *shm_addr;
+
+  /* Buffer ring transport, instead of shm_*.  The layout is copied
+   * from the header when it's checked, since the producer can change
+   * the header under us.  The object can't shrink under the mapping,
+   * that's checked too. */
+  HdRemoteTextureRing *ring;
+  gsize                ring_size;
+  guint                ring_width, ring_height, ring_bpp, ring_rowstride;
+  guint                ring_n_buffers;
+  guint32              ring_offset[HD_REMOTE_TEXTURE_RING_MAX_BUFFERS];
+  /* The buffer we use and the sequence number of the frame in it. */
+  guint                ring_buffer;
+  guint32              ring_seq;
 };
 
 struct HdRemoteTextureClass
@@ -0,0 +1,93 @@
+#ifndef _TIDY_BLUR_DUAL_FILTER
+#define _TIDY_BLUR_DUAL_FILTER
+
+#include <math.h>
+
+/* The dual filter blur of TidyBlurGroup: rather than running the blur
+ * kernel over the half size texture once per step, the half size texture
+ * is downsampled to 1/4 and 1/8 size with one kernel and upsampled back
+ * with another.  The pass count is fixed (2 per level) and most of the
+ * passes are over the small levels, whatever the radius.
+ *
+ * This is kept free of clutter so tests/test-blur-dual.c can check the
+ * shaders against a reference. */
+
+/* Levels below the half size texture. */
+#define TIDY_BLUR_DUAL_FILTER_LEVELS      2
+/* The largest offset we use at a level before going a level deeper. */
+#define TIDY_BLUR_DUAL_FILTER_MAX_OFFSET  2.0f
+
+/* Both are run with the vertex shader of the blur group, which passes
+ * tex_coord -+ (blurx, blury) as tex_coord_a and tex_coord_b.  The source
+ * is sampled linearly.
+ *
+ * Downsampling: the centre and the 4 diagonals, (blurx, blury) = offset
+ * source texels.  The same kernel as the step blur. */
+#define TIDY_BLUR_DUAL_FILTER_DOWN_FRAGMENT_SHADER \
+  "precision lowp float;\n" \
+  "varying mediump vec2  tex_coord;\n" \
+  "varying mediump vec2  tex_coord_a;\n" \
+  "varying mediump vec2  tex_coord_b;\n" \
+  "uniform lowp sampler2D tex;\n" \
+  "void main () {\n" \
+  "  lowp vec4 color = \n" \
+  "       texture2D (tex, vec2(tex_coord_a.x, tex_coord_a.y)) * 0.125 + \n" \
+  "       texture2D (tex, vec2(tex_coord_a.x, tex_coord_b.y)) * 0.125 + \n" \
+  "       texture2D (tex, vec2(tex_coord_b.x, tex_coord_b.y)) * 0.125 + \n" \
+  "       texture2D (tex, vec2(tex_coord_b.x, tex_coord_a.y)) * 0.125 + \n" \
+  "       texture2D (tex, vec2(tex_coord.x, tex_coord.y)) * 0.5; \n" \
+  "  gl_FragColor = color;\n" \
+  "}\n"
+
+/* Upsampling: the 4 diagonals at twice the weight of the 4 taps along
+ * the axes, (blurx, blury) = half the offset in source texels. */
+#define TIDY_BLUR_DUAL_FILTER_UP_FRAGMENT_SHADER \
+  "precision lowp float;\n" \
+  "varying mediump vec2  tex_coord;\n" \
+  "varying mediump vec2  tex_coord_a;\n" \
+  "varying mediump vec2  tex_coord_b;\n" \
+  "uniform lowp sampler2D tex;\n" \
+  "void main () {\n" \
+  "  mediump vec2 d = tex_coord_b - tex_coord;\n" \
+  "  lowp vec4 color = \n" \
+  "       texture2D (tex, vec2(tex_coord_a.x, tex_coord_a.y)) * 0.1666667 + \n" \
+  "       texture2D (tex, vec2(tex_coord_a.x, tex_coord_b.y)) * 0.1666667 + \n" \
+  "       texture2D (tex, vec2(tex_coord_b.x, tex_coord_b.y)) * 0.1666667 + \n" \
+  "       texture2D (tex, vec2(tex_coord_b.x, tex_coord_a.y)) * 0.1666667 + \n" \
+  "       texture2D (tex, tex_coord - vec2(2.0*d.x, 0.0)) * 0.0833333 + \n" \
+  "       texture2D (tex, tex_coord + vec2(2.0*d.x, 0.0)) * 0.0833333 + \n" \
+  "       texture2D (tex, tex_coord - vec2(0.0, 2.0*d.y)) * 0.0833333 + \n" \
+  "       texture2D (tex, tex_coord + vec2(0.0, 2.0*d.y)) * 0.0833333; \n" \
+  "  gl_FragColor = color;\n" \
+  "}\n"
+
+/* How deep to go and with what offset to blur about as much as @radius
+ * steps of the step blur would.  A step spreads the image by a variance
+ * of 1/2 texel^2 (at half size); a pyramid @levels deep spreads it by
+ * about base + k * offset^2, as measured by tests/test-blur-dual. */
+static inline void
+tidy_blur_dual_filter_params (int radius, int *levels, float *offset)
+{
+  static const float base[TIDY_BLUR_DUAL_FILTER_LEVELS] = { 0.75f, 3.75f };
+  static const float k[TIDY_BLUR_DUAL_FILTER_LEVELS]    = { 1.8f,  9.2f };
+  float variance = radius * 0.5f;
+  int i;
+
+  for (i = 0; i < TIDY_BLUR_DUAL_FILTER_LEVELS; i++)
+    {
+      float o2 = variance > base[i] ? (variance - base[i]) / k[i] : 0;
+
+      if (o2 <= TIDY_BLUR_DUAL_FILTER_MAX_OFFSET
+                * TIDY_BLUR_DUAL_FILTER_MAX_OFFSET
+          || i == TIDY_BLUR_DUAL_FILTER_LEVELS - 1)
+        {
+          *levels = i + 1;
+          *offset = sqrtf (o2);
+          if (*offset > 2 * TIDY_BLUR_DUAL_FILTER_MAX_OFFSET)
+            *offset = 2 * TIDY_BLUR_DUAL_FILTER_MAX_OFFSET;
+          return;
+        }
+    }
+}
+
+#endif
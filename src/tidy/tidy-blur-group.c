@@ -8,6 +8,8 @@
 
 #include "tidy-blur-group.h"
 #include "tidy-util.h"
+#include "tidy-offscreen-pool.h"
+#include "tidy-blur-dual-filter.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -25,8 +27,9 @@
 /* #define it something sane */
 #define TIDY_IS_SANE_BLUR_GROUP(obj)    ((obj) != NULL)
 
-/* This destroys and re-allocates the texture if the actor size changes
- * (eg. screen rotation). We may not want to do this as it takes some time. */
+/* This gives back the textures if the actor size changes (eg. screen
+ * rotation), to be borrowed again at the new size. We may not want to do
+ * this as it takes some time. */
 #define RESIZE_TEXTURE 0
 
 /* This fixes the bug where the SGX GLSL compiler uses the current locale for
@@ -139,6 +142,8 @@ struct _TidyBlurGroupPrivate
   /* Internal TidyBlurGroup stuff */
   ClutterShader *shader_blur;
   ClutterShader *shader_saturate;
+  ClutterShader *shader_dual_down;
+  ClutterShader *shader_dual_up;
   CoglHandle tex;
   CoglHandle fbo;
   CoglHandle tex_a;
@@ -171,6 +176,9 @@ struct _TidyBlurGroupPrivate
   /* don't progress the animation for one clutter_actor_paint() */
   gboolean skip_progress;
 
+  /* blur with the dual filter pyramid rather than in steps */
+  gboolean dual_filter;
+
   /* is the 'blurless desaturation' tweak enabled? */
   gboolean tweaks_blurless;
   /* saturation for blurless (0 no color, 1 full color) */
@@ -246,50 +254,19 @@ static void tidy_blur_group_check_shader(TidyBlurGroup *group,
    }
 }
 
-/* Allocate @priv->fbo_[ab]. */
+/* Borrow @priv->fbo and @priv->fbo_[ab] from the offscreen pool for as
+ * long as we're blurring. */
 static void
-tidy_blur_group_allocate_textures (TidyBlurGroup *self)
+tidy_blur_group_acquire_textures (TidyBlurGroup *self)
 {
   TidyBlurGroupPrivate *priv = self->priv;
   guint tex_width, tex_height;
+  CoglPixelFormat format;
 
-#ifdef __i386__
-  if (!cogl_features_available(COGL_FEATURE_OFFSCREEN))
-    /* Don't try to allocate FBOs. */
-    return;
-#endif
-
-#if !RESIZE_TEXTURE
-  if (priv->fbo && priv->fbo_a && priv->fbo_b)
-    /* Rotate in _paint() rather than resize. */
-    return;
-#endif
-
-  /* Free the textures. */
   if (priv->fbo)
-    {
-      cogl_offscreen_unref(priv->fbo);
-      cogl_texture_unref(priv->tex);
-      priv->fbo = 0;
-      priv->tex = 0;
-    }
-  if (priv->fbo_a)
-    {
-      cogl_offscreen_unref(priv->fbo_a);
-      cogl_texture_unref(priv->tex_a);
-      priv->fbo_a = 0;
-      priv->tex_a = 0;
-    }
-  if (priv->fbo_b)
-    {
-      cogl_offscreen_unref(priv->fbo_b);
-      cogl_texture_unref(priv->tex_b);
-      priv->fbo_b = 0;
-      priv->tex_b = 0;
-    }
+    return;
 
-  /* (Re)create the textures + offscreen buffers.  Downsample by 2.
-   * We can specify mipmapping here, but we don't need it. */
+  /* Downsample by 2. */
   clutter_actor_get_size(CLUTTER_ACTOR(self), &tex_width, &tex_height);
 
   /* if we want blurless desaturation, don't downsample (downsampling
@@ -299,31 +276,51 @@ tidy_blur_group_allocate_textures (TidyBlurGroup *self)
       tex_width  /= 2;
       tex_height /= 2;
     }
+  if (!tex_width || !tex_height)
+    return;
 
-  priv->tex = cogl_texture_new_with_size(
-            tex_width, tex_height, 0, FALSE /* mipmap */,
-            COGL_PIXEL_FORMAT_RGBA_8888);
+  tidy_offscreen_pool_acquire(tex_width, tex_height,
+                              COGL_PIXEL_FORMAT_RGBA_8888,
+                              &priv->tex, &priv->fbo);
+  if (!priv->fbo)
+    return;
   cogl_texture_set_filters(priv->tex, CGL_LINEAR, CGL_LINEAR);
-  priv->fbo = cogl_offscreen_new_to_texture(priv->tex);
 
-  priv->tex_a = cogl_texture_new_with_size(
-            tex_width, tex_height, 0, FALSE /* mipmap */,
-            priv->use_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
-                              COGL_PIXEL_FORMAT_RGB_565);
+  format = priv->use_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
+                             COGL_PIXEL_FORMAT_RGB_565;
+  tidy_offscreen_pool_acquire(tex_width, tex_height, format,
+                              &priv->tex_a, &priv->fbo_a);
+  tidy_offscreen_pool_acquire(tex_width, tex_height, format,
+                              &priv->tex_b, &priv->fbo_b);
+  if (!priv->fbo_a || !priv->fbo_b)
+    {
+      tidy_offscreen_pool_release(&priv->tex, &priv->fbo);
+      tidy_offscreen_pool_release(&priv->tex_a, &priv->fbo_a);
+      tidy_offscreen_pool_release(&priv->tex_b, &priv->fbo_b);
+      return;
+    }
   cogl_texture_set_filters(priv->tex_a, CGL_NEAREST, CGL_NEAREST);
-  priv->fbo_a = cogl_offscreen_new_to_texture(priv->tex_a);
-
-  priv->tex_b = cogl_texture_new_with_size(
-            tex_width, tex_height, 0, FALSE /* mipmap */,
-            priv->use_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
-                              COGL_PIXEL_FORMAT_RGB_565);
   cogl_texture_set_filters(priv->tex_b, CGL_NEAREST, CGL_NEAREST);
-  priv->fbo_b = cogl_offscreen_new_to_texture(priv->tex_b);
 
   priv->current_blur_step = 0;
   priv->source_changed = TRUE;
 }
 
+/* Give the textures back to the pool, what we blurred is lost. */
+static void
+tidy_blur_group_release_textures (TidyBlurGroup *self)
+{
+  TidyBlurGroupPrivate *priv = self->priv;
+
+  tidy_offscreen_pool_release(&priv->tex, &priv->fbo);
+  tidy_offscreen_pool_release(&priv->tex_a, &priv->fbo_a);
+  tidy_offscreen_pool_release(&priv->tex_b, &priv->fbo_b);
+
+  /* set our buffer as damaged, so next time it gets re-created */
+  priv->current_blur_step = 0;
+  priv->source_changed = TRUE;
+}
+
 static gboolean
 tidy_blur_group_children_visible(ClutterGroup *group)
 {
@@ -385,6 +382,105 @@ tidy_blur_group_fallback_blur(TidyBlurGroup *group, int tex_width, int tex_heigh
   cogl_blend_func(CGL_SRC_ALPHA, CGL_ONE_MINUS_SRC_ALPHA);
 }
 
+/* Draw @src over the whole of @fbo (@width x @height) with @shader, its
+ * taps (@offset_x, @offset_y) apart in texture coordinates.  Without
+ * shaders this just scales @src, which still blurs some. */
+static void
+tidy_blur_group_dual_filter_pass(TidyBlurGroup *group, ClutterShader *shader,
+                                 CoglHandle src, CoglHandle fbo,
+                                 gint width, gint height,
+                                 float offset_x, float offset_y)
+{
+  static const ClutterColor white = { 0xff, 0xff, 0xff, 0xff };
+  TidyBlurGroupPrivate *priv = group->priv;
+
+  tidy_util_cogl_push_offscreen_buffer(fbo);
+  if (priv->use_shader && shader)
+    {
+      clutter_shader_set_is_enabled (shader, TRUE);
+      clutter_shader_set_uniform_1f (shader, "blurx", offset_x);
+      clutter_shader_set_uniform_1f (shader, "blury", offset_y);
+    }
+
+  /* The kernels rely on linear sampling to average the texels between
+   * their taps. */
+  cogl_texture_set_filters(src, CGL_LINEAR, CGL_LINEAR);
+  cogl_blend_func(CGL_ONE, CGL_ZERO);
+  cogl_color (&white);
+  cogl_texture_rectangle (src, 0, 0,
+                          CLUTTER_INT_TO_FIXED (width),
+                          CLUTTER_INT_TO_FIXED (height),
+                          0, 0, CFX_ONE, CFX_ONE);
+  cogl_blend_func(CGL_SRC_ALPHA, CGL_ONE_MINUS_SRC_ALPHA);
+
+  if (priv->use_shader && shader)
+    clutter_shader_set_is_enabled (shader, FALSE);
+  tidy_util_cogl_pop_offscreen_buffer();
+}
+
+/* Blur @priv->tex_a into @priv->tex_b about as much as @priv->blur_step
+ * steps would, by downsampling it to a pyramid of smaller textures and
+ * back up.  @priv->tex_a is left alone, so when the radius grows we blur
+ * from it again rather than from what we blurred last time. */
+static void
+tidy_blur_group_dual_filter(TidyBlurGroup *group, gint tex_width,
+                            gint tex_height)
+{
+  TidyBlurGroupPrivate *priv = group->priv;
+  CoglHandle tex[TIDY_BLUR_DUAL_FILTER_LEVELS+1];
+  CoglHandle fbo[TIDY_BLUR_DUAL_FILTER_LEVELS+1];
+  gint width[TIDY_BLUR_DUAL_FILTER_LEVELS+1];
+  gint height[TIDY_BLUR_DUAL_FILTER_LEVELS+1];
+  CoglPixelFormat format;
+  gint levels, i;
+  float offset;
+
+  tidy_blur_dual_filter_params(priv->blur_step, &levels, &offset);
+
+  tex[0] = priv->tex_a;
+  fbo[0] = priv->fbo_a;
+  width[0] = tex_width;
+  height[0] = tex_height;
+  format = cogl_texture_get_format(priv->tex_a);
+
+  /* The smaller levels are only borrowed for as long as we blur. */
+  for (i = 1; i <= levels; i++)
+    {
+      width[i]  = MAX(width[i-1] / 2, 1);
+      height[i] = MAX(height[i-1] / 2, 1);
+      tidy_offscreen_pool_acquire(width[i], height[i], format,
+                                  &tex[i], &fbo[i]);
+      if (!fbo[i])
+        {
+          levels = i-1;
+          break;
+        }
+    }
+
+  if (!levels)
+    /* Do what we can without them. */
+    tidy_blur_group_dual_filter_pass(group, priv->shader_dual_down,
+                                     tex[0], priv->fbo_b,
+                                     width[0], height[0],
+                                     offset / width[0], offset / height[0]);
+
+  for (i = 1; i <= levels; i++)
+    tidy_blur_group_dual_filter_pass(group, priv->shader_dual_down,
+                                     tex[i-1], fbo[i],
+                                     width[i], height[i],
+                                     offset / width[i-1],
+                                     offset / height[i-1]);
+  for (i = levels; i > 0; i--)
+    tidy_blur_group_dual_filter_pass(group, priv->shader_dual_up,
+                                     tex[i], i > 1 ? fbo[i-1] : priv->fbo_b,
+                                     width[i-1], height[i-1],
+                                     offset / 2 / width[i],
+                                     offset / 2 / height[i]);
+
+  for (i = 1; i <= levels; i++)
+    tidy_offscreen_pool_release(&tex[i], &fbo[i]);
+}
+
 /* If priv->chequer, draw a chequer pattern over the screen */
 static void
 tidy_blur_group_do_chequer(TidyBlurGroup *group, guint width, guint height)
@@ -405,44 +501,6 @@ tidy_blur_group_do_chequer(TidyBlurGroup *group, guint width, guint height)
                           CFX_ONE*height/CHEQUER_SIZE);
 }
 
-/* Recursively set texture filtering state on this actor and children, and
- * save the old state in the object. */
-static void
-recursive_set_linear_texture_filter(ClutterActor *actor, GArray *filters)
-{
-  if (CLUTTER_IS_CONTAINER(actor))
-    clutter_container_foreach(CLUTTER_CONTAINER(actor),
-                   (ClutterCallback)recursive_set_linear_texture_filter,
-                   filters);
-  else if (CLUTTER_IS_TEXTURE(actor))
-    {
-      ClutterTexture *tex = CLUTTER_TEXTURE(actor);
-      ClutterTextureQuality quality;
-
-      quality = clutter_texture_get_filter_quality(tex);
-      g_array_append_val(filters, quality);
-      clutter_texture_set_filter_quality(tex, GL_LINEAR);
-    }
-}
-
-/* Recursively set texture filtering state on this actor and children, and
- * save the old state in the object. */
-static void
-recursive_reset_texture_filter(ClutterActor *actor,
-                               const ClutterTextureQuality **filtersp)
-{
-  if (CLUTTER_IS_CONTAINER(actor))
-    clutter_container_foreach(CLUTTER_CONTAINER(actor),
-                        (ClutterCallback)recursive_reset_texture_filter,
-                        filtersp);
-  else if (CLUTTER_IS_TEXTURE(actor))
-    {
-      clutter_texture_set_filter_quality(CLUTTER_TEXTURE(actor),
-                                         **filtersp);
-      (*filtersp)++;
-    }
-}
-
 /* An implementation for the ClutterGroup::paint() vfunc,
    painting all the child actors: */
 static void
@@ -459,8 +517,6 @@ tidy_blur_group_paint (ClutterActor *actor)
   gint                         width, height, tex_width, tex_height;
   gboolean                     rotate_90;
   ClutterColor                 col;
-  GArray                      *filters;
-  const ClutterTextureQuality *filters_array;
 
   if (!TIDY_IS_SANE_BLUR_GROUP(actor))
     return;
@@ -474,9 +530,8 @@ tidy_blur_group_paint (ClutterActor *actor)
   if (!tidy_blur_group_source_buffered(actor) ||
       !tidy_blur_group_children_visible(group))
     {
-      /* set our buffer as damaged, so next time it gets re-created */
-      priv->current_blur_step = 0;
-      priv->source_changed = TRUE;
+      /* we're not blurring, so we don't need our buffers */
+      tidy_blur_group_release_textures(container);
       /* render direct */
       CLUTTER_ACTOR_CLASS(tidy_blur_group_parent_class)->paint(actor);
       tidy_blur_group_do_chequer(container, width, height);
@@ -498,6 +553,14 @@ tidy_blur_group_paint (ClutterActor *actor)
     }
 #endif
 
+  tidy_blur_group_acquire_textures(container);
+  if (!priv->fbo)
+    { /* Can't blur without them. */
+      CLUTTER_ACTOR_CLASS(tidy_blur_group_parent_class)->paint(actor);
+      tidy_blur_group_do_chequer(container, width, height);
+      return;
+    }
+
   tex_width  = cogl_texture_get_width(priv->tex);
   tex_height = cogl_texture_get_height(priv->tex);
 
@@ -530,12 +593,9 @@ tidy_blur_group_paint (ClutterActor *actor)
       cogl_color (&white);
       /* Actually do the drawing of the children, but ensure that they are
        * all linear sampled so they are smoothly interpolated. Restore after. */
-      filters = g_array_new(FALSE, FALSE, sizeof(ClutterTextureQuality));
-      recursive_set_linear_texture_filter(actor, filters);
+      tidy_util_push_linear_filter();
       CLUTTER_ACTOR_CLASS(tidy_blur_group_parent_class)->paint(actor);
-      filters_array = (void *)filters->data;
-      recursive_reset_texture_filter(actor, &filters_array);
-      g_array_free(filters, TRUE);
+      tidy_util_pop_linear_filter();
 
       tidy_util_cogl_pop_offscreen_buffer();
       cogl_pop_matrix();
@@ -551,7 +611,18 @@ tidy_blur_group_paint (ClutterActor *actor)
     /* Progressing the animation doesn't play well with rotation. */
     goto skip_progress;
 
-  while (priv->current_blur_step < priv->blur_step &&
+  if (priv->dual_filter && priv->blur_step > priv->max_blur_step)
+    {
+      /* All of the blur in one go. */
+      priv->blur_done = FALSE;
+      tidy_blur_group_dual_filter(container, tex_width, tex_height);
+      priv->current_blur_step = priv->blur_step;
+      priv->max_blur_step = priv->blur_step;
+      priv->current_is_a = FALSE;
+    }
+
+  while (!priv->dual_filter &&
+         priv->current_blur_step < priv->blur_step &&
          steps_this_frame<MAX_STEPS_PER_FRAME)
     {
       priv->blur_done = FALSE;
@@ -875,27 +946,7 @@ tidy_blur_group_dispose (GObject *gobject)
   TidyBlurGroup *container = TIDY_BLUR_GROUP(gobject);
   TidyBlurGroupPrivate *priv = container->priv;
 
-  if (priv->fbo)
-    {
-      cogl_offscreen_unref(priv->fbo);
-      cogl_texture_unref(priv->tex);
-      priv->fbo = 0;
-      priv->tex = 0;
-    }
-  if (priv->fbo_a)
-    {
-      cogl_offscreen_unref(priv->fbo_a);
-      cogl_texture_unref(priv->tex_a);
-      priv->fbo_a = 0;
-      priv->tex_a = 0;
-    }
-  if (priv->fbo_b)
-    {
-      cogl_offscreen_unref(priv->fbo_b);
-      cogl_texture_unref(priv->tex_b);
-      priv->fbo_b = 0;
-      priv->tex_b = 0;
-    }
+  tidy_blur_group_release_textures(container);
   if (priv->tex_chequer)
     {
       cogl_texture_unref(priv->tex_chequer);
@@ -938,6 +989,9 @@ tidy_blur_group_init (TidyBlurGroup *self)
   priv->source_changed = TRUE;
   priv->tweaks_blurless = hd_transition_get_int("thp_tweaks", "blurless", 0);
   priv->blurless_saturation = hd_transition_get_double("thp_tweaks", "blurless_saturation", 0);
+  /* there's nothing to blur in blurless mode */
+  priv->dual_filter = !priv->tweaks_blurless &&
+                      hd_transition_get_int("blur", "dual_filter", 0);
 
 #if CLUTTER_COGL_HAS_GLES
   priv->use_shader = cogl_features_available(COGL_FEATURE_SHADERS_GLSL);
@@ -946,6 +1000,8 @@ tidy_blur_group_init (TidyBlurGroup *self)
 #endif
   priv->shader_blur = 0;
   priv->shader_saturate = 0;
+  priv->shader_dual_down = 0;
+  priv->shader_dual_up = 0;
 
   priv->tex = 0;
   priv->fbo = 0;
@@ -997,8 +1053,20 @@ tidy_blur_group_init (TidyBlurGroup *self)
   tidy_blur_group_check_shader(self, &priv->shader_saturate,
                                SATURATE_FRAGMENT_SHADER, 0);
 
+  if (priv->dual_filter)
+    {
+      tidy_blur_group_check_shader(self, &priv->shader_dual_down,
+                                   TIDY_BLUR_DUAL_FILTER_DOWN_FRAGMENT_SHADER,
+                                   BLUR_VERTEX_SHADER);
+      tidy_blur_group_check_shader(self, &priv->shader_dual_up,
+                                   TIDY_BLUR_DUAL_FILTER_UP_FRAGMENT_SHADER,
+                                   BLUR_VERTEX_SHADER);
+    }
+
+#if RESIZE_TEXTURE
   g_signal_connect(self, "notify::allocation",
-                   G_CALLBACK(tidy_blur_group_allocate_textures), NULL);
+                   G_CALLBACK(tidy_blur_group_release_textures), NULL);
+#endif
 }
 
 /*
@@ -6,6 +6,7 @@
 
 #include "tidy-cached-group.h"
 #include "tidy-util.h"
+#include "tidy-offscreen-pool.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -71,6 +72,10 @@ tidy_cached_group_paint (ClutterActor *actor)
   if (priv->cache_amount < 0.01 ||
       width==0 || height==0)
     {
+      /* we don't need our buffer until we're cached again, and then it
+       * will have to be redrawn */
+      tidy_offscreen_pool_release(&priv->tex, &priv->fbo);
+      priv->source_changed = TRUE;
       /* render direct */
       CLUTTER_ACTOR_CLASS (tidy_cached_group_parent_class)->paint(actor);
       return;
@@ -98,28 +103,29 @@ tidy_cached_group_paint (ClutterActor *actor)
 #if RESIZE_TEXTURE
   /* free texture if the size is wrong */
   if (tex_width!=exp_width || tex_height!=exp_height) {
-    if (priv->fbo)
-      {
-        cogl_offscreen_unref(priv->fbo);
-        cogl_texture_unref(priv->tex);
-        priv->fbo = 0;
-        priv->tex = 0;
-      }
+    tidy_offscreen_pool_release(&priv->tex, &priv->fbo);
     priv->source_changed = TRUE;
   }
 #endif
-  /* create the texture + offscreen buffer if they didn't exist. */
+  /* borrow the texture + offscreen buffer if we don't have them. */
   if (!priv->tex)
     {
       tex_width = exp_width;
       tex_height = exp_height;
 
-      priv->tex = cogl_texture_new_with_size(
-                tex_width, tex_height, 0, FALSE /*mipmap*/,
-                priv->use_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
-                                  COGL_PIXEL_FORMAT_RGB_565);
+      if (tex_width > 0 && tex_height > 0)
+        tidy_offscreen_pool_acquire(tex_width, tex_height,
+                                    priv->use_alpha
+                                      ? COGL_PIXEL_FORMAT_RGBA_8888
+                                      : COGL_PIXEL_FORMAT_RGB_565,
+                                    &priv->tex, &priv->fbo);
+      if (!priv->fbo)
+        {
+          CLUTTER_ACTOR_CLASS (tidy_cached_group_parent_class)->paint(actor);
+          return;
+        }
       cogl_texture_set_filters(priv->tex, CGL_NEAREST, CGL_NEAREST);
-      priv->fbo = cogl_offscreen_new_to_texture (priv->tex);
+      priv->source_changed = TRUE;
     }
   /* It may be that we have resized, but the texture has not.
    * If so, try and keep screen looking 'nice' by rotating so that
@@ -202,13 +208,7 @@ tidy_cached_group_dispose (GObject *gobject)
   TidyCachedGroup *container = TIDY_CACHED_GROUP(gobject);
   TidyCachedGroupPrivate *priv = container->priv;
 
-  if (priv->fbo)
-    {
-      cogl_offscreen_unref(priv->fbo);
-      cogl_texture_unref(priv->tex);
-      priv->fbo = 0;
-      priv->tex = 0;
-    }
+  tidy_offscreen_pool_release(&priv->tex, &priv->fbo);
 
   G_OBJECT_CLASS (tidy_cached_group_parent_class)->dispose (gobject);
 }
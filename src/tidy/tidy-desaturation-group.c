@@ -9,6 +9,7 @@
 
 #include "tidy-desaturation-group.h"
 #include "tidy-util.h"
+#include "tidy-offscreen-pool.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -175,41 +176,46 @@ static void tidy_desaturation_group_check_shader(TidyDesaturationGroup *group,
    }
 }
 
+/* Borrow @priv->fbo_a from the offscreen pool for as long as we're
+ * desaturated. */
 static void
-tidy_desaturation_group_allocate_textures (TidyDesaturationGroup *self)
+tidy_desaturation_group_acquire_textures (TidyDesaturationGroup *self)
 {
   TidyDesaturationGroupPrivate *priv = self->priv;
   guint tex_width, tex_height;
 
-#ifdef __i386__
-  if (!cogl_features_available(COGL_FEATURE_OFFSCREEN))
-    /* Don't try to allocate FBOs. */
-    return;
-#endif
-
-  /* Free the texture. */
   if (priv->fbo_a)
-    {
-      cogl_offscreen_unref(priv->fbo_a);
-      cogl_texture_unref(priv->tex_a);
-      priv->fbo_a = 0;
-      priv->tex_a = 0;
-    }
+    return;
 
-  /* (Re)create the texture and offscreen buffer.
-   * We can specify mipmapping here, but we don't need it. */
   clutter_actor_get_size(CLUTTER_ACTOR(self), &tex_width, &tex_height);
+  if (!tex_width || !tex_height)
+    return;
 
-  priv->tex_a = cogl_texture_new_with_size(
-            tex_width, tex_height, 0, FALSE /* mipmap */,
-            COGL_PIXEL_FORMAT_RGBA_8888);
+  tidy_offscreen_pool_acquire(tex_width, tex_height,
+                              COGL_PIXEL_FORMAT_RGBA_8888,
+                              &priv->tex_a, &priv->fbo_a);
+  if (!priv->fbo_a)
+    return;
   cogl_texture_set_filters(priv->tex_a, CGL_NEAREST, CGL_NEAREST);
-  priv->fbo_a = cogl_offscreen_new_to_texture(priv->tex_a);
 
   priv->current_desaturation_step = 0;
   priv->source_changed = TRUE;
 }
 
+/* Give the texture back to the pool.  Also when we're resized, so it's
+ * borrowed again at the new size. */
+static void
+tidy_desaturation_group_release_textures (TidyDesaturationGroup *self)
+{
+  TidyDesaturationGroupPrivate *priv = self->priv;
+
+  tidy_offscreen_pool_release(&priv->tex_a, &priv->fbo_a);
+
+  /* set our buffer as damaged, so next time it gets re-created */
+  priv->current_desaturation_step = 0;
+  priv->source_changed = TRUE;
+}
+
 static gboolean
 tidy_desaturation_group_children_visible(ClutterGroup *group)
 {
@@ -233,44 +239,6 @@ tidy_desaturation_group_children_visible(ClutterGroup *group)
   return FALSE;
 }
 
-/* Recursively set texture filtering state on this actor and children, and
- * save the old state in the object. */
-static void
-recursive_set_linear_texture_filter(ClutterActor *actor, GArray *filters)
-{
-  if (CLUTTER_IS_CONTAINER(actor))
-    clutter_container_foreach(CLUTTER_CONTAINER(actor),
-                   (ClutterCallback)recursive_set_linear_texture_filter,
-                   filters);
-  else if (CLUTTER_IS_TEXTURE(actor))
-    {
-      ClutterTexture *tex = CLUTTER_TEXTURE(actor);
-      ClutterTextureQuality quality;
-
-      quality = clutter_texture_get_filter_quality(tex);
-      g_array_append_val(filters, quality);
-      clutter_texture_set_filter_quality(tex, GL_LINEAR);
-    }
-}
-
-/* Recursively set texture filtering state on this actor and children, and
- * save the old state in the object. */
-static void
-recursive_reset_texture_filter(ClutterActor *actor,
-                               const ClutterTextureQuality **filtersp)
-{
-  if (CLUTTER_IS_CONTAINER(actor))
-    clutter_container_foreach(CLUTTER_CONTAINER(actor),
-                        (ClutterCallback)recursive_reset_texture_filter,
-                        filtersp);
-  else if (CLUTTER_IS_TEXTURE(actor))
-    {
-      clutter_texture_set_filter_quality(CLUTTER_TEXTURE(actor),
-                                         **filtersp);
-      (*filtersp)++;
-    }
-}
-
 static void
 tidy_desaturation_group_paint (ClutterActor *actor)
 {
@@ -282,8 +250,6 @@ tidy_desaturation_group_paint (ClutterActor *actor)
   ClutterActorBox              box;
   gint                         width, height, tex_width, tex_height;
   ClutterColor                 col;
-  GArray                      *filters;
-  const ClutterTextureQuality *filters_array;
 
   if (!TIDY_IS_SANE_DESATURATION_GROUP(actor))
     return;
@@ -297,9 +263,7 @@ tidy_desaturation_group_paint (ClutterActor *actor)
   if (!tidy_desaturation_group_source_buffered(actor) ||
       !tidy_desaturation_group_children_visible(group))
     {
-      /* set our buffer as damaged, so next time it gets re-created */
-      priv->current_desaturation_step = 0;
-      priv->source_changed = TRUE;
+      tidy_desaturation_group_release_textures(container);
       CLUTTER_ACTOR_CLASS(tidy_desaturation_group_parent_class)->paint(actor);
       return;
     }
@@ -309,6 +273,13 @@ tidy_desaturation_group_paint (ClutterActor *actor)
       return;
 #endif
 
+  tidy_desaturation_group_acquire_textures(container);
+  if (!priv->fbo_a)
+    {
+      CLUTTER_ACTOR_CLASS(tidy_desaturation_group_parent_class)->paint(actor);
+      return;
+    }
+
   tex_width  = cogl_texture_get_width(priv->tex_a);
   tex_height = cogl_texture_get_height(priv->tex_a);
 
@@ -324,12 +295,9 @@ tidy_desaturation_group_paint (ClutterActor *actor)
       cogl_color (&white);
       /* Actually do the drawing of the children, but ensure that they are
        * all linear sampled so they are smoothly interpolated. Restore after. */
-      filters = g_array_new(FALSE, FALSE, sizeof(ClutterTextureQuality));
-      recursive_set_linear_texture_filter(actor, filters);
+      tidy_util_push_linear_filter();
       CLUTTER_ACTOR_CLASS(tidy_desaturation_group_parent_class)->paint(actor);
-      filters_array = (void *)filters->data;
-      recursive_reset_texture_filter(actor, &filters_array);
-      g_array_free(filters, TRUE);
+      tidy_util_pop_linear_filter();
 
       tidy_util_cogl_pop_offscreen_buffer();
       cogl_pop_matrix();
@@ -389,13 +357,7 @@ tidy_desaturation_group_dispose (GObject *gobject)
   TidyDesaturationGroup *container = TIDY_DESATURATION_GROUP(gobject);
   TidyDesaturationGroupPrivate *priv = container->priv;
 
-  if (priv->fbo_a)
-    {
-      cogl_offscreen_unref(priv->fbo_a);
-      cogl_texture_unref(priv->tex_a);
-      priv->fbo_a = 0;
-      priv->tex_a = 0;
-    }
+  tidy_desaturation_group_release_textures(container);
 
   G_OBJECT_CLASS (tidy_desaturation_group_parent_class)->dispose (gobject);
 }
@@ -437,7 +399,7 @@ tidy_desaturation_group_init (TidyDesaturationGroup *self)
                                DESATURATE_SATURATE_FRAGMENT_SHADER, 0);
 
   g_signal_connect(self, "notify::allocation",
-                   G_CALLBACK(tidy_desaturation_group_allocate_textures), NULL);
+                   G_CALLBACK(tidy_desaturation_group_release_textures), NULL);
 }
 
 /*
@@ -471,8 +433,9 @@ void tidy_desaturation_group_desaturate(ClutterActor *desaturation_group)
 
   priv = TIDY_DESATURATION_GROUP(desaturation_group)->priv;
 
-  tidy_desaturation_group_allocate_textures(TIDY_DESATURATION_GROUP(desaturation_group));
-
+  /* Take a fresh copy of the children the next time we're painted. */
+  priv->source_changed = TRUE;
+  priv->current_desaturation_step = 0;
   priv->undo_desaturation = FALSE;
   priv->desaturation_step = 1;
   clutter_actor_queue_redraw(desaturation_group);
@@ -18,7 +18,9 @@ enum
 };
 
 /* Do our highlight with 2 rings. Outer ring of 12 samples,
- * inner ring of 4 */
+ * inner ring of 4.  Samples are clamped to the region of the texture
+ * we use (minus half a texel), so the neighbours in an atlas don't
+ * bleed in. */
   const char *HIGHLIGHT_FRAGMENT_SHADER =
   "precision lowp float;\n"
   "varying mediump vec2 tex_coord;\n"
@@ -26,7 +28,10 @@ enum
   "uniform lowp sampler2D tex;\n"
   "uniform mediump float blurx;\n"
   "uniform mediump float blury;\n"
+  "uniform mediump float rx1, ry1, rx2, ry2;\n"
   "void main () {\n"
+  "  mediump vec2 lo = vec2(rx1, ry1); \n"
+  "  mediump vec2 hi = vec2(rx2, ry2); \n"
   "  mediump float ax = blurx*0.354; \n"
   "  mediump float ay = blury*0.354; \n"
   "  mediump float bx = blurx*0.5; \n"
@@ -34,22 +39,22 @@ enum
   "  mediump float cx = blurx*0.707; \n"
   "  mediump float cy = blury*0.707; \n"
   "  lowp float alpha = \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*1.0000, tex_coord.y + blury*0.0000)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*0.8660, tex_coord.y + blury*0.5000)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*0.5000, tex_coord.y + blury*0.8660)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*0.0000, tex_coord.y + blury*1.0000)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*-0.5000, tex_coord.y + blury*0.8660)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*-0.8660, tex_coord.y + blury*0.5000)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*-1.0000, tex_coord.y + blury*0.0000)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*-0.8660, tex_coord.y + blury*-0.5000)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*-0.5000, tex_coord.y + blury*-0.8660)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*-0.0000, tex_coord.y + blury*-1.0000)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*0.5000, tex_coord.y + blury*-0.8661)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*0.8660, tex_coord.y + blury*-0.5000)).a * 0.0675 + \n"
-  "       texture2D (tex, vec2(tex_coord.x - blurx*0.3, tex_coord.y - blury*0.3)).a * 0.125 + \n"
-  "       texture2D (tex, vec2(tex_coord.x - blurx*0.3, tex_coord.y + blury*0.3)).a * 0.125 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*0.3, tex_coord.y + blury*0.3)).a * 0.125 + \n"
-  "       texture2D (tex, vec2(tex_coord.x + blurx*0.3, tex_coord.y - blury*0.3)).a * 0.125; \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*1.0000, tex_coord.y + blury*0.0000), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*0.8660, tex_coord.y + blury*0.5000), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*0.5000, tex_coord.y + blury*0.8660), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*0.0000, tex_coord.y + blury*1.0000), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*-0.5000, tex_coord.y + blury*0.8660), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*-0.8660, tex_coord.y + blury*0.5000), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*-1.0000, tex_coord.y + blury*0.0000), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*-0.8660, tex_coord.y + blury*-0.5000), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*-0.5000, tex_coord.y + blury*-0.8660), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*-0.0000, tex_coord.y + blury*-1.0000), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*0.5000, tex_coord.y + blury*-0.8661), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*0.8660, tex_coord.y + blury*-0.5000), lo, hi)).a * 0.0675 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x - blurx*0.3, tex_coord.y - blury*0.3), lo, hi)).a * 0.125 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x - blurx*0.3, tex_coord.y + blury*0.3), lo, hi)).a * 0.125 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*0.3, tex_coord.y + blury*0.3), lo, hi)).a * 0.125 + \n"
+  "       texture2D (tex, clamp (vec2(tex_coord.x + blurx*0.3, tex_coord.y - blury*0.3), lo, hi)).a * 0.125; \n"
   "  lowp vec4 color = frag_color; \n"
   "  color.a = color.a * alpha; \n"
   "  gl_FragColor = color;\n"
@@ -58,6 +63,7 @@ enum
 struct _TidyHighlightPrivate
 {
   ClutterTexture      *parent_texture;
+  ClutterGeometry      region; /* The region of the parent texture to use */
   ClutterShader       *shader;
 
   float                amount;
@@ -99,6 +105,15 @@ tidy_highlight_get_preferred_width (ClutterActor *self,
       return;
     }
 
+  if (priv->region.width && priv->region.height)
+    {
+      if (min_width_p)
+        *min_width_p = CLUTTER_UNITS_FROM_INT (priv->region.width);
+      if (natural_width_p)
+        *natural_width_p = CLUTTER_UNITS_FROM_INT (priv->region.width);
+      return;
+    }
+
   parent_texture_class = CLUTTER_ACTOR_GET_CLASS (parent_texture);
   parent_texture_class->get_preferred_width (parent_texture,
                                              for_height,
@@ -133,6 +148,15 @@ tidy_highlight_get_preferred_height (ClutterActor *self,
       return;
     }
 
+  if (priv->region.width && priv->region.height)
+    {
+      if (min_height_p)
+        *min_height_p = CLUTTER_UNITS_FROM_INT (priv->region.height);
+      if (natural_height_p)
+        *natural_height_p = CLUTTER_UNITS_FROM_INT (priv->region.height);
+      return;
+    }
+
   parent_texture_class = CLUTTER_ACTOR_GET_CLASS (parent_texture);
   parent_texture_class->get_preferred_height (parent_texture,
                                               for_width,
@@ -149,6 +173,8 @@ tidy_highlight_paint (ClutterActor *self)
   ClutterColor                 col = { 0xff, 0xff, 0xff, 0xff };
   CoglHandle                   cogl_texture;
   guint                        tex_width, tex_height;
+  ClutterGeometry              region;
+  ClutterFixed                 t_x1, t_y1, t_x2, t_y2;
   ClutterFixed                 overlapx, overlapy;
   CoglTextureVertex            verts[4];
 
@@ -178,6 +204,16 @@ tidy_highlight_paint (ClutterActor *self)
 
   tex_width = cogl_texture_get_width (cogl_texture);
   tex_height = cogl_texture_get_height (cogl_texture);
+  region = priv->region;
+  /* a region width/height of 0 is invalid, so use
+   * the entire texture */
+  if (region.width==0 || region.height==0)
+    {
+      region.x = 0;
+      region.y = 0;
+      region.width = tex_width;
+      region.height = tex_height;
+    }
 
   if (priv->shader)
     {
@@ -186,38 +222,52 @@ tidy_highlight_paint (ClutterActor *self)
                                      priv->amount / tex_width);
       clutter_shader_set_uniform_1f (priv->shader, "blury",
                                      priv->amount / tex_height);
+      clutter_shader_set_uniform_1f (priv->shader, "rx1",
+                                     (region.x + 0.5) / tex_width);
+      clutter_shader_set_uniform_1f (priv->shader, "ry1",
+                                     (region.y + 0.5) / tex_height);
+      clutter_shader_set_uniform_1f (priv->shader, "rx2",
+                        (region.x + region.width - 0.5) / tex_width);
+      clutter_shader_set_uniform_1f (priv->shader, "ry2",
+                        (region.y + region.height - 0.5) / tex_height);
     }
 
 
-  /* if we're bigger than the texture, make us 1:1 by just extending
-   * our edges outside those of the texture. We have to do this with
+  /* if we're bigger than the region, make us 1:1 by just extending
+   * our edges outside those of the region. We have to do this with
    * cogl_texture_polygon not cogl_rectangle, because clutter thinks
    * that we want to repeat rectangles and messes everything up */
   overlapx = CLUTTER_FLOAT_TO_FIXED(
-      ((x_2 - x_1) - tex_width) / (float)(tex_width*2));
+      ((x_2 - x_1) - region.width) / (float)(tex_width*2));
   overlapy = CLUTTER_FLOAT_TO_FIXED(
-      ((y_2 - y_1) - tex_height) / (float)(tex_height*2));
+      ((y_2 - y_1) - region.height) / (float)(tex_height*2));
+  t_x1 = CLUTTER_FLOAT_TO_FIXED (region.x / (float)tex_width);
+  t_y1 = CLUTTER_FLOAT_TO_FIXED (region.y / (float)tex_height);
+  t_x2 = CLUTTER_FLOAT_TO_FIXED ((region.x + region.width)
+                                 / (float)tex_width);
+  t_y2 = CLUTTER_FLOAT_TO_FIXED ((region.y + region.height)
+                                 / (float)tex_height);
 
   verts[0].x = 0;
   verts[0].y = 0;
   verts[0].z = 0;
-  verts[0].tx = -overlapx;
-  verts[0].ty = -overlapy;
+  verts[0].tx = t_x1-overlapx;
+  verts[0].ty = t_y1-overlapy;
   verts[1].x = CLUTTER_INT_TO_FIXED (x_2 - x_1);
   verts[1].y = 0;
   verts[1].z = 0;
-  verts[1].tx = CFX_ONE+overlapx;
-  verts[1].ty = -overlapy;
+  verts[1].tx = t_x2+overlapx;
+  verts[1].ty = t_y1-overlapy;
   verts[2].x = CLUTTER_INT_TO_FIXED (x_2 - x_1);
   verts[2].y = CLUTTER_INT_TO_FIXED (y_2 - y_1);
   verts[2].z = 0;
-  verts[2].tx = CFX_ONE+overlapx;
-  verts[2].ty = CFX_ONE+overlapy;
+  verts[2].tx = t_x2+overlapx;
+  verts[2].ty = t_y2+overlapy;
   verts[3].x = 0;
   verts[3].y = CLUTTER_INT_TO_FIXED (y_2 - y_1);
   verts[3].z = 0;
-  verts[3].tx = -overlapx;
-  verts[3].ty = CFX_ONE+overlapy;
+  verts[3].tx = t_x1-overlapx;
+  verts[3].ty = t_y2+overlapy;
 
   /* Parent paint translated us into position */
   cogl_texture_polygon (cogl_texture, 4, verts, FALSE);
@@ -421,6 +471,16 @@ void tidy_highlight_set_amount (TidyHighlight *sub,
   }
 }
 
+/* Use only @region of the parent texture, eg. for an icon in an atlas. */
+void tidy_highlight_set_region (TidyHighlight *sub,
+                                ClutterGeometry *region)
+{
+  g_return_if_fail (TIDY_IS_HIGHLIGHT (sub));
+
+  sub->priv->region = *region;
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (sub));
+}
+
 void tidy_highlight_set_color (TidyHighlight *sub,
                                ClutterColor *col)
 {
@@ -20,27 +20,52 @@
 /* ------------------------------------------------------------------------- */
 
 /* nice size for SGX? below 100 tends to slow framerate, and increases
- * number of textures that need updating. */
-#define TILE_SIZE_X 480
-#define TILE_SIZE_Y 480
+ * number of textures that need updating.  Textures are split into tiles
+ * of at most this size, of equal size rather than leaving a thin strip
+ * at the right and bottom. */
+#define TILE_SIZE_MAX 480
+/* Tile sizes are rounded up to a multiple of this. */
+#define TILE_ALIGN 16
+
+/* How many separate modified areas a tile keeps track of.  More than
+ * this and the closest ones are merged. */
+#define MAX_DIRTY_SPANS 4
+/* If at least this fraction (in 1/16ths) of a tile is modified in more
+ * than one span, upload the whole tile in one go instead. */
+#define FULL_TILE_THRESHOLD 12
 
 /* ------------------------------------------------------------------------- */
 
 typedef struct _TidyMemTextureTile
 {
   ClutterGeometry pos; /* actual position in texture */
-  ClutterGeometry modified; /* geometry for the area modified */
+  /* areas modified since the last upload, relative to the tile */
+  ClutterGeometry dirty[MAX_DIRTY_SPANS];
+  gint n_dirty;
   CoglHandle texture;
 } TidyMemTextureTile;
 
+/* How to get a modified area of a tile to GL. */
+typedef enum
+{
+  /* Straight from the memory texture, telling GL the row stride. */
+  UPLOAD_DIRECT,
+  /* Copied into @tile_buffer first with no gaps between the rows. */
+  UPLOAD_PACKED,
+  /* All of the tile at once, because most of it changed anyway. */
+  UPLOAD_FULL_TILE,
+} TidyMemTextureUpload;
+
 struct _TidyMemTexturePrivate
 {
   /* pointer to texture in memory */
   const guchar *texture_ptr;
   /* width and height of the memory texture */
   gint texture_width, texture_height;
-  /* BYTES per pixel */
-  gint texture_bpp;
+  /* BYTES per pixel and per row */
+  gint texture_bpp, texture_rowstride;
+  /* size of the tiles, except the last ones in a row or column */
+  gint tile_width, tile_height;
   CoglPixelFormat texture_format;
 #if EXACT_ROW_LENGTH
   /* Buffer the size of a tile, used to copy the required data in... */
@@ -116,7 +141,7 @@ tidy_mem_texture_paint (ClutterActor *self)
       if (tidy_mem_texture_tile_visible(texture, tile, width, height))
         {
           /* we're visible, so update if modified, and render... */
-          if (tile->modified.width>0 && tile->modified.height>0)
+          if (tile->n_dirty)
             tidy_mem_texture_update_modified(texture, tile);
         }
     }
@@ -177,7 +202,10 @@ tidy_mem_texture_init (TidyMemTexture *self)
   priv->texture_width = 0;
   priv->texture_height = 0;
   priv->texture_bpp = 0;
+  priv->texture_rowstride = 0;
   priv->texture_format = 0;
+  priv->tile_width = 0;
+  priv->tile_height = 0;
   priv->offset_x = 0;
   priv->offset_y = 0;
   priv->scale_x = CFX_ONE;
@@ -269,62 +297,184 @@ tidy_mem_texture_tile_visible(TidyMemTexture *texture,
           y1 <= CLUTTER_INT_TO_FIXED(height));
 }
 
-/* Copies the pixels into a buffer with the correct row stride so
- * we can get the data into OpenGL quickly. */
-static void
-tidy_mem_texture_update_modified(TidyMemTexture *texture,
-                                  TidyMemTextureTile *tile)
+/* Which way to upload @span of a tile. */
+static TidyMemTextureUpload
+tidy_mem_texture_upload_strategy(TidyMemTexture *texture,
+                                 const ClutterGeometry *span)
 {
-  TidyMemTexturePrivate *priv = texture->priv;
-  gint rowstride = priv->texture_width * priv->texture_bpp;
 #if EXACT_ROW_LENGTH
-  gint y;
-  gint rowlength = tile->modified.width * priv->texture_bpp;
-  guchar *ptr_dst = priv->tile_buffer;
+  TidyMemTexturePrivate *priv = texture->priv;
+
+  /* If the rows are back to back in memory, there's nothing to pack. */
+  if (span->width * priv->texture_bpp != priv->texture_rowstride)
+    return UPLOAD_PACKED;
 #endif
+  return UPLOAD_DIRECT;
+}
+
+static void
+tidy_mem_texture_upload_span(TidyMemTexture *texture,
+                             TidyMemTextureTile *tile,
+                             const ClutterGeometry *span)
+{
+  TidyMemTexturePrivate *priv = texture->priv;
   const guchar *ptr_src = &priv->texture_ptr[
-                 (tile->pos.x + tile->modified.x +
-                 (tile->pos.y + tile->modified.y)*priv->texture_width) *
-                 priv->texture_bpp];
+                 (tile->pos.y + span->y) * priv->texture_rowstride +
+                 (tile->pos.x + span->x) * priv->texture_bpp];
+  gint rowstride = priv->texture_rowstride;
 
-#if EXACT_ROW_LENGTH
-  for (y=0;y<tile->modified.height;y++)
+  if (tidy_mem_texture_upload_strategy(texture, span) == UPLOAD_PACKED)
     {
-      memcpy(ptr_dst, ptr_src, rowlength);
-      ptr_src += rowstride;
-      ptr_dst += rowlength;
+#if EXACT_ROW_LENGTH
+      gint y;
+      gint rowlength = span->width * priv->texture_bpp;
+      guchar *ptr_dst = priv->tile_buffer;
+
+      for (y=0;y<span->height;y++)
+        {
+          memcpy(ptr_dst, ptr_src, rowlength);
+          ptr_src += priv->texture_rowstride;
+          ptr_dst += rowlength;
+        }
+      ptr_src = priv->tile_buffer;
+      rowstride = rowlength;
+#endif
     }
 
   cogl_texture_set_region(tile->texture,
                           0, 0,
-                          tile->modified.x, tile->modified.y,
-                          tile->modified.width, tile->modified.height,
-                          tile->modified.width, tile->modified.height,
+                          span->x, span->y,
+                          span->width, span->height,
+                          span->width, span->height,
                           priv->texture_format,
-                          tile->modified.width * priv->texture_bpp,
-                          priv->tile_buffer);
-#else
-  cogl_texture_set_region(tile->texture,
-                            0, 0,
-                            tile->modified.x, tile->modified.y,
-                            tile->modified.width, tile->modified.height,
-                            tile->modified.width, tile->modified.height,
-                            priv->texture_format,
-                            rowstride,
-                            ptr_src);
-#endif
+                          rowstride,
+                          ptr_src);
+}
+
+/* Uploads the modified areas of @tile, or all of it (UPLOAD_FULL_TILE)
+ * if that's most of the tile anyway: one big upload is cheaper than
+ * several which add up to nearly the same. */
+static void
+tidy_mem_texture_update_modified(TidyMemTexture *texture,
+                                 TidyMemTextureTile *tile)
+{
+  TidyMemTextureUpload upload;
+  gint i, area;
+
+  for (i = area = 0; i < tile->n_dirty; i++)
+    area += tile->dirty[i].width * tile->dirty[i].height;
+
+  upload = UPLOAD_DIRECT;
+  if (tile->n_dirty > 1
+      && area * 16 >= tile->pos.width * tile->pos.height * FULL_TILE_THRESHOLD)
+    upload = UPLOAD_FULL_TILE;
+
+  if (upload == UPLOAD_FULL_TILE)
+    {
+      ClutterGeometry all = { 0, 0, tile->pos.width, tile->pos.height };
+      tidy_mem_texture_upload_span(texture, tile, &all);
+    }
+  else
+    for (i = 0; i < tile->n_dirty; i++)
+      tidy_mem_texture_upload_span(texture, tile, &tile->dirty[i]);
+
+  tile->n_dirty = 0;
+}
 
-  /* set modified area to 0 */
-  tile->modified.x = 0;
-  tile->modified.y = 0;
-  tile->modified.width = 0;
-  tile->modified.height = 0;
+/* Union of @a and @b into @a. */
+static void
+tidy_mem_texture_geometry_union(ClutterGeometry *a, const ClutterGeometry *b)
+{
+  gint x2 = MAX(a->x + (gint)a->width,  b->x + (gint)b->width);
+  gint y2 = MAX(a->y + (gint)a->height, b->y + (gint)b->height);
+
+  a->x = MIN(a->x, b->x);
+  a->y = MIN(a->y, b->y);
+  a->width = x2 - a->x;
+  a->height = y2 - a->y;
+}
+
+static gboolean
+tidy_mem_texture_geometry_touch(const ClutterGeometry *a,
+                                const ClutterGeometry *b)
+{
+  return a->x <= b->x + (gint)b->width  && b->x <= a->x + (gint)a->width &&
+         a->y <= b->y + (gint)b->height && b->y <= a->y + (gint)a->height;
+}
+
+/* Add @mod to the modified spans of @tile, merging it with the spans
+ * it touches, or with the one it makes the least difference to if
+ * there are too many. */
+static void
+tidy_mem_texture_tile_add_dirty(TidyMemTextureTile *tile,
+                                const ClutterGeometry *mod)
+{
+  ClutterGeometry span = *mod;
+  gint i;
+
+  for (i = 0; i < tile->n_dirty; )
+    if (tidy_mem_texture_geometry_touch(&tile->dirty[i], &span))
+      { /* take it out and try again with the union */
+        tidy_mem_texture_geometry_union(&span, &tile->dirty[i]);
+        tile->dirty[i] = tile->dirty[--tile->n_dirty];
+        i = 0;
+      }
+    else
+      i++;
+
+  if (tile->n_dirty == MAX_DIRTY_SPANS)
+    {
+      gint best = 0, best_growth = G_MAXINT;
+
+      for (i = 0; i < tile->n_dirty; i++)
+        {
+          ClutterGeometry u = tile->dirty[i];
+          gint growth;
+
+          tidy_mem_texture_geometry_union(&u, &span);
+          growth = u.width * u.height
+            - tile->dirty[i].width * tile->dirty[i].height;
+          if (growth < best_growth)
+            {
+              best = i;
+              best_growth = growth;
+            }
+        }
+      tidy_mem_texture_geometry_union(&tile->dirty[best], &span);
+      return;
+    }
+
+  tile->dirty[tile->n_dirty++] = span;
+}
+
+/* Size of the tiles along a dimension of @size pixels. */
+static gint
+tidy_mem_texture_tile_size(gint size)
+{
+  gint n, tile;
+
+  if (size <= TILE_SIZE_MAX)
+    return size;
+  n = (size + TILE_SIZE_MAX - 1) / TILE_SIZE_MAX;
+  tile = (size + n - 1) / n;
+  tile = (tile + TILE_ALIGN - 1) & ~(TILE_ALIGN - 1);
+  return MIN(tile, TILE_SIZE_MAX);
 }
 
 void tidy_mem_texture_set_data(TidyMemTexture *texture,
                                const guchar *data,
                                gint width, gint height,
                                gint bytes_per_pixel)
+{
+  tidy_mem_texture_set_data_full(texture, data, width, height,
+                                 bytes_per_pixel, width * bytes_per_pixel);
+}
+
+void tidy_mem_texture_set_data_full(TidyMemTexture *texture,
+                                    const guchar *data,
+                                    gint width, gint height,
+                                    gint bytes_per_pixel,
+                                    gint rowstride)
 {
   TidyMemTexturePrivate *priv;
   if (!TIDY_IS_MEM_TEXTURE(texture))
@@ -342,9 +492,12 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
       priv->texture_width = width;
       priv->texture_height = height;
       priv->texture_bpp = bytes_per_pixel;
+      priv->texture_rowstride = rowstride;
       priv->texture_format = 0;
-      tiles_x = (priv->texture_width+TILE_SIZE_X-1) / TILE_SIZE_X;
-      tiles_y = (priv->texture_height+TILE_SIZE_Y-1) / TILE_SIZE_Y;
+      priv->tile_width = tidy_mem_texture_tile_size(width);
+      priv->tile_height = tidy_mem_texture_tile_size(height);
+      tiles_x = (priv->texture_width+priv->tile_width-1) / priv->tile_width;
+      tiles_y = (priv->texture_height+priv->tile_height-1) / priv->tile_height;
       switch (priv->texture_bpp)
         {
           case 1:
@@ -362,7 +515,8 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
         }
 #if EXACT_ROW_LENGTH
       /* allocate tile buffer */
-      priv->tile_buffer = g_malloc(TILE_SIZE_X * TILE_SIZE_Y * priv->texture_bpp);
+      priv->tile_buffer = g_malloc(priv->tile_width * priv->tile_height
+                                   * priv->texture_bpp);
 #endif
       /* allocate tiles */
       for (y=0;y<tiles_y;y++)
@@ -371,10 +525,10 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
             TidyMemTextureTile *tile = g_malloc(sizeof(TidyMemTextureTile));
             priv->tiles = g_list_append(priv->tiles, tile);
             /* set coords */
-            tile->pos.x = x*TILE_SIZE_X;
-            tile->pos.y = y*TILE_SIZE_Y;
-            tile->pos.width = TILE_SIZE_X;
-            tile->pos.height = TILE_SIZE_Y;
+            tile->pos.x = x*priv->tile_width;
+            tile->pos.y = y*priv->tile_height;
+            tile->pos.width = priv->tile_width;
+            tile->pos.height = priv->tile_height;
             /* make texture smaller if it would go over the big texture */
             if (tile->pos.x+tile->pos.width > priv->texture_width)
               tile->pos.width = priv->texture_width - tile->pos.x;
@@ -385,10 +539,11 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
                 tile->pos.width, tile->pos.height, -1 /* no waste */,
                 FALSE, priv->texture_format);
             /* set whole area to be modified */
-            tile->modified.x = 0;
-            tile->modified.y = 0;
-            tile->modified.width = tile->pos.width;
-            tile->modified.height = tile->pos.height;
+            tile->dirty[0].x = 0;
+            tile->dirty[0].y = 0;
+            tile->dirty[0].width = tile->pos.width;
+            tile->dirty[0].height = tile->pos.height;
+            tile->n_dirty = 1;
           }
     }
   else
@@ -397,10 +552,22 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
       priv->texture_width = 0;
       priv->texture_height = 0;
       priv->texture_bpp = 0;
+      priv->texture_rowstride = 0;
       priv->texture_format = 0;
     }
 }
 
+/* Point @texture at @data, which must be laid out the same way as the
+ * current data.  This is for producers flipping between buffers; the
+ * tiles are kept, and only what is damaged afterwards is uploaded. */
+void tidy_mem_texture_swap_data(TidyMemTexture *texture,
+                                const guchar *data)
+{
+  if (!TIDY_IS_MEM_TEXTURE(texture) || !texture->priv->texture_ptr || !data)
+    return;
+  texture->priv->texture_ptr = data;
+}
+
 void tidy_mem_texture_damage(TidyMemTexture *texture,
                              gint x, gint y,
                              gint width, gint height)
@@ -438,31 +605,8 @@ void tidy_mem_texture_damage(TidyMemTexture *texture,
           if (mod.height+mod.y > tile->pos.height)
             mod.height = tile->pos.height - mod.y;
 
-          if (tile->modified.width>0 && tile->modified.height>0)
-            {
-              /* if we already have damage, extend damaged area */
-              gint oldx2, oldy2, newx2, newy2;
-              oldx2 = tile->modified.x + tile->modified.width;
-              oldy2 = tile->modified.y + tile->modified.height;
-              newx2 = mod.x + mod.width;
-              newy2 = mod.y + mod.height;
-
-              if (mod.x < tile->modified.x)
-                tile->modified.x = mod.x;
-              if (mod.y < tile->modified.y)
-                tile->modified.y = mod.y;
-              if (newx2 > oldx2)
-                oldx2 = newx2;
-              if (newy2 > oldy2)
-                oldy2 = newy2;
-              tile->modified.width = oldx2 - tile->modified.x;
-              tile->modified.height = oldy2 - tile->modified.y;
-            }
-          else
-            {
-              /* else just set damaged area */
-              tile->modified = mod;
-            }
+          if (mod.width > 0 && mod.height > 0)
+            tidy_mem_texture_tile_add_dirty(tile, &mod);
 
           /* only redraw if the changed tile is visible */
           if (tidy_mem_texture_tile_visible(texture, tile,
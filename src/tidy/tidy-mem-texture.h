@@ -78,6 +78,13 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
                                const guchar *data,
                                gint width, gint height,
                                gint bytes_per_pixel);
+void tidy_mem_texture_set_data_full(TidyMemTexture *texture,
+                                    const guchar *data,
+                                    gint width, gint height,
+                                    gint bytes_per_pixel,
+                                    gint rowstride);
+void tidy_mem_texture_swap_data(TidyMemTexture *texture,
+                                const guchar *data);
 void tidy_mem_texture_damage(TidyMemTexture *texture,
                              gint x, gint y,
                              gint width, gint height);
@@ -0,0 +1,184 @@
+#include "tidy-offscreen-pool.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cogl/cogl.h>
+
+/* How long a given back buffer is kept for reuse (seconds), and how many
+ * of them at most.  Blurring comes and goes with the task switcher and
+ * dialogs, so keeping them a little while saves reallocating on every
+ * toggle, without holding them for good. */
+#define OFFSCREEN_LINGER    5
+#define OFFSCREEN_MAX_IDLE  4
+
+typedef struct
+{
+  CoglHandle      tex;
+  CoglHandle      fbo;
+  guint           width, height;
+  CoglPixelFormat format;
+  gsize           bytes;
+  gint64          released; /* when it became idle */
+} TidyOffscreen;
+
+static struct
+{
+  /* fbo -> TidyOffscreen */
+  GHashTable *in_use;
+  /* Idle TidyOffscreens, the most recently given back first. */
+  GQueue      idle;
+  guint       trim_id;
+
+  gsize       bytes_in_use, bytes_idle, peak_bytes;
+  guint       peak_in_use;
+  guint       n_acquired, n_reused, n_created;
+} pool;
+
+static gsize
+tidy_offscreen_bytes(guint width, guint height, CoglPixelFormat format)
+{
+  return (gsize)width * height
+    * (format == COGL_PIXEL_FORMAT_RGB_565 ? 2 : 4);
+}
+
+static void
+tidy_offscreen_free(TidyOffscreen *target)
+{
+  cogl_offscreen_unref(target->fbo);
+  cogl_texture_unref(target->tex);
+  g_free(target);
+}
+
+/* Free the idle buffers which have lingered long enough. */
+static void
+tidy_offscreen_pool_trim(void)
+{
+  TidyOffscreen *target;
+  gint64 now;
+
+  now = g_get_monotonic_time();
+  while ((target = g_queue_peek_tail(&pool.idle)) != NULL
+         && (g_queue_get_length(&pool.idle) > OFFSCREEN_MAX_IDLE
+             || now - target->released >= OFFSCREEN_LINGER * G_USEC_PER_SEC))
+    {
+      g_queue_pop_tail(&pool.idle);
+      pool.bytes_idle -= target->bytes;
+      tidy_offscreen_free(target);
+    }
+}
+
+static gboolean
+tidy_offscreen_pool_trim_timeout(gpointer unused)
+{
+  tidy_offscreen_pool_trim();
+  if (g_queue_is_empty(&pool.idle))
+    {
+      pool.trim_id = 0;
+      return FALSE;
+    }
+  return TRUE;
+}
+
+void
+tidy_offscreen_pool_acquire(guint width, guint height, CoglPixelFormat format,
+                            CoglHandle *tex, CoglHandle *fbo)
+{
+  TidyOffscreen *target = NULL;
+  gsize total;
+  GList *li;
+
+  if (!pool.in_use)
+    pool.in_use = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  for (li = pool.idle.head; li; li = li->next)
+    {
+      TidyOffscreen *idle = li->data;
+
+      if (idle->width == width && idle->height == height
+          && idle->format == format)
+        {
+          target = idle;
+          g_queue_delete_link(&pool.idle, li);
+          pool.bytes_idle -= target->bytes;
+          pool.n_reused++;
+          break;
+        }
+    }
+
+  if (!target)
+    {
+      target = g_new0(TidyOffscreen, 1);
+      target->width = width;
+      target->height = height;
+      target->format = format;
+      target->bytes = tidy_offscreen_bytes(width, height, format);
+      target->tex = cogl_texture_new_with_size(width, height, 0,
+                                               FALSE /* mipmap */, format);
+      target->fbo = target->tex
+        ? cogl_offscreen_new_to_texture(target->tex) : COGL_INVALID_HANDLE;
+      if (!target->fbo)
+        {
+          g_warning("couldn't create a %ux%u offscreen buffer", width, height);
+          if (target->tex)
+            cogl_texture_unref(target->tex);
+          g_free(target);
+          *tex = *fbo = COGL_INVALID_HANDLE;
+          return;
+        }
+      pool.n_created++;
+    }
+
+  g_hash_table_insert(pool.in_use, target->fbo, target);
+  pool.n_acquired++;
+  pool.bytes_in_use += target->bytes;
+
+  total = pool.bytes_in_use + pool.bytes_idle;
+  if (pool.peak_bytes < total)
+    pool.peak_bytes = total;
+  if (pool.peak_in_use < g_hash_table_size(pool.in_use))
+    pool.peak_in_use = g_hash_table_size(pool.in_use);
+
+  *tex = target->tex;
+  *fbo = target->fbo;
+}
+
+void
+tidy_offscreen_pool_release(CoglHandle *tex, CoglHandle *fbo)
+{
+  TidyOffscreen *target;
+
+  if (!*fbo)
+    return;
+
+  target = pool.in_use ? g_hash_table_lookup(pool.in_use, *fbo) : NULL;
+  g_return_if_fail(target != NULL);
+
+  g_hash_table_remove(pool.in_use, target->fbo);
+  pool.bytes_in_use -= target->bytes;
+
+  target->released = g_get_monotonic_time();
+  g_queue_push_head(&pool.idle, target);
+  pool.bytes_idle += target->bytes;
+  tidy_offscreen_pool_trim();
+
+  if (!pool.trim_id && !g_queue_is_empty(&pool.idle))
+    pool.trim_id = g_timeout_add_seconds(OFFSCREEN_LINGER,
+                                         tidy_offscreen_pool_trim_timeout,
+                                         NULL);
+
+  *tex = *fbo = COGL_INVALID_HANDLE;
+}
+
+void
+tidy_offscreen_pool_dump_debug_info(void)
+{
+  g_debug("offscreen pool: %u in use (%" G_GSIZE_FORMAT " bytes), "
+          "%u idle (%" G_GSIZE_FORMAT " bytes), peak %u in use, "
+          "%" G_GSIZE_FORMAT " bytes; %u acquired, %u reused, %u created",
+          pool.in_use ? g_hash_table_size(pool.in_use) : 0, pool.bytes_in_use,
+          g_queue_get_length(&pool.idle), pool.bytes_idle,
+          pool.peak_in_use, pool.peak_bytes,
+          pool.n_acquired, pool.n_reused, pool.n_created);
+}
@@ -0,0 +1,26 @@
+#ifndef _TIDY_OFFSCREEN_POOL
+#define _TIDY_OFFSCREEN_POOL
+
+#include <clutter/clutter.h>
+
+/* A pool of texture + offscreen buffer pairs, shared between the effect
+ * groups (blur, desaturation, caching).  A group only borrows its buffers
+ * while the effect is on and gives them back when it has finished, so at
+ * rest none of them hold any video memory.  Buffers of the same size and
+ * format are reused; given back ones linger for a few seconds in case the
+ * effect comes back, then they are freed. */
+
+/* Sets *@tex and *@fbo to a @width x @height texture of @format and an
+ * offscreen buffer rendering to it, or unsets them if that can't be made.
+ * The contents are undefined, the filters are whatever the last user left
+ * them. */
+void tidy_offscreen_pool_acquire(guint width, guint height,
+                                 CoglPixelFormat format,
+                                 CoglHandle *tex, CoglHandle *fbo);
+/* Gives back what tidy_offscreen_pool_acquire() returned and clears
+ * *@tex and *@fbo.  Does nothing if *@fbo is unset. */
+void tidy_offscreen_pool_release(CoglHandle *tex, CoglHandle *fbo);
+
+void tidy_offscreen_pool_dump_debug_info(void);
+
+#endif
@@ -70,3 +70,85 @@ void tidy_util_cogl_pop_offscreen_buffer(void)
   cogl_draw_buffer (obe->fbo ? COGL_OFFSCREEN_BUFFER : COGL_WINDOW_BUFFER,
                     obe->fbo);
 }
+
+/* The code below forces linear sampling on the textures painted between
+ * tidy_util_push_linear_filter() and _pop().  Rather than walking the
+ * actor tree to set and then reset the filter of every texture in it, a
+ * hook on ClutterActor::paint switches the textures actually painted as
+ * they come, and _pop() puts back the ones it switched. */
+/* ------------------------------------------------ */
+typedef struct {
+  CoglHandle tex;
+  COGLenum min_filter, mag_filter;
+} LinearFilterEntry;
+
+static guint linear_filter_depth;
+static gulong linear_filter_hook;
+/* LinearFilterEntries to restore.  Kept between passes, so after the
+ * first capture it doesn't allocate. */
+static GArray *linear_filter_restore;
+/* ------------------------------------------------  */
+
+static gboolean
+tidy_util_linear_filter_hook (GSignalInvocationHint *ihint,
+                              guint n_params, const GValue *params,
+                              gpointer unused)
+{
+  LinearFilterEntry entry;
+  GObject *actor;
+
+  actor = g_value_get_object (&params[0]);
+  if (!CLUTTER_IS_TEXTURE (actor))
+    return TRUE;
+
+  entry.tex = clutter_texture_get_cogl_texture (CLUTTER_TEXTURE (actor));
+  if (entry.tex == COGL_INVALID_HANDLE)
+    return TRUE;
+
+  entry.min_filter = cogl_texture_get_min_filter (entry.tex);
+  entry.mag_filter = cogl_texture_get_mag_filter (entry.tex);
+  if (entry.min_filter == CGL_LINEAR && entry.mag_filter == CGL_LINEAR)
+    /* Already, or painted for the second time. */
+    return TRUE;
+
+  g_array_append_val (linear_filter_restore, entry);
+  cogl_texture_set_filters (entry.tex, CGL_LINEAR, CGL_LINEAR);
+  return TRUE;
+}
+
+void tidy_util_push_linear_filter(void)
+{
+  if (linear_filter_depth++)
+    return;
+
+  if (!linear_filter_restore)
+    linear_filter_restore = g_array_new (FALSE, FALSE,
+                                         sizeof (LinearFilterEntry));
+  linear_filter_hook = g_signal_add_emission_hook (
+                            g_signal_lookup ("paint", CLUTTER_TYPE_ACTOR), 0,
+                            tidy_util_linear_filter_hook, NULL, NULL);
+}
+
+void tidy_util_pop_linear_filter(void)
+{
+  gint i;
+
+  g_assert (linear_filter_depth > 0);
+  if (--linear_filter_depth)
+    return;
+
+  g_signal_remove_emission_hook (g_signal_lookup ("paint", CLUTTER_TYPE_ACTOR),
+                                 linear_filter_hook);
+  linear_filter_hook = 0;
+
+  /* Backwards, in case a texture is in there twice. */
+  for (i = linear_filter_restore->len - 1; i >= 0; i--)
+    {
+      LinearFilterEntry *entry = &g_array_index (linear_filter_restore,
+                                                 LinearFilterEntry, i);
+
+      cogl_texture_set_filters (entry->tex, entry->min_filter,
+                                entry->mag_filter);
+    }
+  g_array_set_size (linear_filter_restore, 0);
+}
@@ -8,4 +8,9 @@
 void tidy_util_cogl_push_offscreen_buffer(CoglHandle fbo);
 void tidy_util_cogl_pop_offscreen_buffer(void);
 
+/* Sample every texture painted in between with linear filtering, eg. when
+ * scaling the children down into an offscreen buffer.  Nestable. */
+void tidy_util_push_linear_filter(void);
+void tidy_util_pop_linear_filter(void);
+
 #endif
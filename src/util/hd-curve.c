@@ -0,0 +1,226 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-curve.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Structure holding a list of keyframes that will be linearly interpolated
+ * between to produce animation*/
+struct _HdKeyFrameList {
+  float *keyframes;
+  int count;
+  int ref_count;
+};
+
+/* Create a keyframe list from a comma-separated list of floating point values */
+HdKeyFrameList *hd_key_frame_list_create(const char *keys)
+{
+  char *key_copy = 0;
+  char *p;
+  int i=0;
+  HdKeyFrameList *k = (HdKeyFrameList*)g_malloc0(sizeof(HdKeyFrameList));
+  k->ref_count = 1;
+  /* Fail nicely by returning a straight ramp */
+  if (!keys || strlen(keys)<=1)
+    goto fail;
+  key_copy = g_strdup(keys);
+  /* Scan for how many elements we need */
+  k->count = 0;
+  for (p=key_copy;*p;p++)
+    if (*p==',') k->count++;
+  if (key_copy[strlen(key_copy)-1]!=',')
+    k->count++;
+  if (k->count<2)
+    goto fail;
+  k->keyframes = (float*)g_malloc0(sizeof(float) * k->count);
+  /* read in individual keys */
+  for (p=key_copy;*p;)
+    {
+      char *comma = p;
+      char old_comma;
+      /* Find comma and replace with string end character */
+      while (*comma && *comma!=',')
+        comma++;
+      old_comma = *comma;
+      *comma = 0;
+      /* Read the data value */
+      k->keyframes[i++] = atof(p);
+      /* Set up for next iteration. If we hit the end, don't skip over it! */
+      if (old_comma)
+        p = comma+1;
+      else
+        p = comma;
+    }
+  k->count = i;
+  g_free(key_copy);
+  return k;
+fail:
+  /* On failure, free memory, and return a simple
+   * linear ramp */
+  if (key_copy) g_free(key_copy);
+  /* k is already allocated */
+  k->count = 2;
+  if (k->keyframes) g_free(k->keyframes);
+  k->keyframes = (float*)g_malloc(sizeof(float) * k->count);
+  k->keyframes[0] = 0.0f;
+  k->keyframes[1] = 1.0f;
+  return k;
+}
+
+HdKeyFrameList *hd_key_frame_list_ref(HdKeyFrameList *k)
+{
+  if (k)
+    k->ref_count++;
+  return k;
+}
+
+void hd_key_frame_list_free(HdKeyFrameList *k)
+{
+  if (k && !--k->ref_count)
+    {
+      g_free(k->keyframes);
+      g_free(k);
+    }
+}
+
+/* As X goes between 0 and 1, interpolate into the HdKeyFrameList */
+float hd_key_frame_interpolate(HdKeyFrameList *k, float x)
+{
+  float v,n;
+  int idx;
+
+  if (!k || k->count < 2)
+    return x;
+
+  v = x * (k->count-1);
+  idx = (int)v;
+  n = v - idx;
+
+  if (idx >= k->count-1)
+    {
+      idx = k->count-2;
+      n = 1;
+    }
+  if (idx<0)
+    {
+      idx = 0;
+      n = 0;
+    }
+  return k->keyframes[idx]*(1-n) + k->keyframes[idx+1]*n;
+}
+
+void
+hd_curve_sample (HdCurve *curve, HdCurveFunc func)
+{
+  int i;
+
+  for (i = 0; i <= HD_CURVE_SAMPLES; i++)
+    curve->samples[i] = func ((float) i / HD_CURVE_SAMPLES);
+}
+
+void
+hd_curve_sample_bezier (HdCurve *curve,
+                        float p0, float p1, float p2, float p3)
+{
+  int i;
+
+  for (i = 0; i <= HD_CURVE_SAMPLES; i++)
+    {
+      float t = (float) i / HD_CURVE_SAMPLES, u = 1 - t;
+
+      /* B(t) = (1-t)^3*P0 + (1-t)^2*t*P1 + (1-t)*t^2*P2 + t^3*P3 */
+      curve->samples[i] = u*u*u*p0 + 3*u*u*t*p1 + 3*u*t*t*p2 + t*t*t*p3;
+    }
+}
+
+/* The curves as they were computed for every frame. */
+static float
+smooth_ramp (float amt)
+{
+  return (1.0f - cos(amt*3.141592)) * 0.5f;
+}
+
+static float
+ease_in (float amt)
+{
+  return 1.0f - cos(amt*3.141592*0.5);
+}
+
+static float
+ease_out (float amt)
+{
+  return cos((1-amt)*3.141592*0.5);
+}
+
+static float
+overshoot (float amt)
+{
+  float smooth_ramp, converge;
+
+  smooth_ramp = 1.0f - cos(amt*3.141592); // 0 <= smooth_ramp <= 2
+  converge = sin(0.5*3.141592*(1-amt)); // 0 <= converve <= 1
+  return (smooth_ramp*0.675)*converge + (1-converge);
+}
+
+static const HdCurve *
+hd_curve_get (HdCurve **curve, HdCurveFunc func)
+{
+  /* Only sampled once, by the main thread. */
+  if (G_UNLIKELY (!*curve))
+    {
+      *curve = g_new (HdCurve, 1);
+      hd_curve_sample (*curve, func);
+    }
+  return *curve;
+}
+
+const HdCurve *
+hd_curve_smooth_ramp (void)
+{
+  static HdCurve *curve;
+  return hd_curve_get (&curve, smooth_ramp);
+}
+
+const HdCurve *
+hd_curve_ease_in (void)
+{
+  static HdCurve *curve;
+  return hd_curve_get (&curve, ease_in);
+}
+
+const HdCurve *
+hd_curve_ease_out (void)
+{
+  static HdCurve *curve;
+  return hd_curve_get (&curve, ease_out);
+}
+
+const HdCurve *
+hd_curve_overshoot (void)
+{
+  static HdCurve *curve;
+  return hd_curve_get (&curve, overshoot);
+}
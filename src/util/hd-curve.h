@@ -0,0 +1,77 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_CURVE_H__
+#define __HD_CURVE_H__
+
+#include <glib.h>
+
+/* Animation curves, sampled once so a frame only looks them up. */
+
+/* Functions for loading and interpolating from a list of keyframes.
+ * The lists are reference counted, hd_key_frame_list_free() drops one. */
+typedef struct _HdKeyFrameList HdKeyFrameList;
+HdKeyFrameList *hd_key_frame_list_create(const char *keys);
+HdKeyFrameList *hd_key_frame_list_ref(HdKeyFrameList *k);
+void hd_key_frame_list_free(HdKeyFrameList *k);
+float hd_key_frame_interpolate(HdKeyFrameList *k, float x);
+
+/* A curve from [0, 1], sampled at HD_CURVE_SAMPLES+1 points and linearly
+ * interpolated in between, which is good to about 1e-5 for the smooth
+ * curves used here. */
+#define HD_CURVE_SAMPLES 256
+
+typedef struct
+{
+  float samples[HD_CURVE_SAMPLES + 1];
+} HdCurve;
+
+typedef float (*HdCurveFunc) (float x);
+
+void hd_curve_sample        (HdCurve *curve, HdCurveFunc func);
+/* The cubic bezier curve defined by (@p0, @p1) and (@p2, @p3). */
+void hd_curve_sample_bezier (HdCurve *curve,
+                             float p0, float p1, float p2, float p3);
+
+/* @x is clamped to [0, 1]. */
+static inline float
+hd_curve_eval (const HdCurve *curve, float x)
+{
+  float v;
+  int i;
+
+  if (!(x > 0))
+    return curve->samples[0];
+  if (x >= 1)
+    return curve->samples[HD_CURVE_SAMPLES];
+
+  v = x * HD_CURVE_SAMPLES;
+  i = (int) v;
+  return curve->samples[i] + (curve->samples[i + 1] - curve->samples[i])
+    * (v - i);
+}
+
+/* The easing curves of hd-transition.c, sampled the first time they're
+ * asked for. */
+const HdCurve *hd_curve_smooth_ramp (void);
+const HdCurve *hd_curve_ease_in     (void);
+const HdCurve *hd_curve_ease_out    (void);
+const HdCurve *hd_curve_overshoot   (void);
+
+#endif /* __HD_CURVE_H__ */
@@ -0,0 +1,353 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-damage.h"
+#include "hd-frame-stats.h"
+#include "hd-util.h"
+#include "hd-transition.h"
+
+#include <gdk/gdk.h>
+
+/* Object data of actors which are rate limited. */
+#define THROTTLE_KEY "hd-damage-throttle"
+
+/* An update held back until @due. */
+typedef struct
+{
+  gint64       due;
+  GdkRectangle area;
+} DeferredDamage;
+
+/* When an actor may be drawn next.  If an update was held back,
+ * @deferred_until is the time it is going to be drawn at, and the
+ * one after that has to wait until @deferred_until + interval. */
+typedef struct
+{
+  gint64 next, deferred_until;
+} Throttle;
+
+static struct
+{
+  /* Stage area to draw at the next tick. */
+  GdkRegion *pending;
+  /* Something has to be redrawn which isn't in @pending. */
+  gboolean   full;
+  /* DeferredDamage:s */
+  GArray    *deferred;
+
+  /* What the last flush damaged, if it's worth painting it rectangle
+   * by rectangle.  Empty if not. */
+  GArray      *frame_rects;
+  GdkRectangle frame_box;
+  /* How many pixels painting @frame_rects saves over @frame_box. */
+  guint        frame_saving;
+
+  /* [damage] frame_ms, max_rects and rect_cost */
+  HdTransitionParam *frame_ms, *max_rects, *rect_cost;
+
+  /* The tick, if scheduled, and when it goes off. */
+  guint      tick_id;
+  gint64     tick_at;
+  gint64     last_flush;
+  /* When the stage was painted last, and whether a redraw we queued
+   * is still waiting for its paint. */
+  gint64     last_paint;
+  gboolean   in_flight;
+
+  guint      n_updates, n_throttled, n_flushes, n_split;
+  guint64    pixels_saved;
+} damage;
+
+static gboolean hd_damage_tick (gpointer unused);
+
+static void
+hd_damage_stage_painted (ClutterActor *stage)
+{
+  damage.last_paint = g_get_monotonic_time ();
+  damage.in_flight = FALSE;
+}
+
+static void
+hd_damage_init (void)
+{
+  if (damage.pending)
+    return;
+
+  damage.pending = gdk_region_new ();
+  damage.deferred = g_array_new (FALSE, FALSE, sizeof (DeferredDamage));
+  damage.frame_rects = g_array_new (FALSE, FALSE, sizeof (GdkRectangle));
+  damage.frame_ms = hd_transition_param_lookup ("damage", "frame_ms");
+  damage.max_rects = hd_transition_param_lookup ("damage", "max_rects");
+  damage.rect_cost = hd_transition_param_lookup ("damage", "rect_cost");
+  g_signal_connect (clutter_stage_get_default (), "paint",
+                    G_CALLBACK (hd_damage_stage_painted), NULL);
+}
+
+/* Make sure there's a tick no later than @due.  If the stage hasn't
+ * been painted for a frame and nothing is waiting to be, that's now;
+ * otherwise it's a frame after the last paint, or after the last flush
+ * while its redraw is still in flight. */
+static void
+hd_damage_schedule (gint64 now, gint64 due)
+{
+  gint64 frame;
+
+  frame = (gint64)MAX (hd_transition_param_get_int (damage.frame_ms, 16), 0)
+    * 1000;
+  due = MAX (due, damage.in_flight ? damage.last_flush + frame
+                                   : damage.last_paint + frame);
+  if (damage.tick_id)
+    {
+      if (damage.tick_at <= due)
+        return;
+      g_source_remove (damage.tick_id);
+    }
+
+  damage.tick_at = due;
+  damage.tick_id = g_timeout_add_full (G_PRIORITY_HIGH_IDLE,
+                                       due > now ? (due - now + 999) / 1000 : 0,
+                                       hd_damage_tick, NULL, NULL);
+}
+
+/* Returns when the update of @actor coming in @now may be drawn. */
+static gint64
+hd_damage_throttle (ClutterActor *actor, gint64 now, guint min_interval_ms)
+{
+  Throttle *throttle;
+  gint64 interval = (gint64)min_interval_ms * 1000;
+
+  if (!(throttle = g_object_get_data (G_OBJECT (actor), THROTTLE_KEY)))
+    {
+      throttle = g_new0 (Throttle, 1);
+      g_object_set_data_full (G_OBJECT (actor), THROTTLE_KEY,
+                              throttle, g_free);
+    }
+
+  if (throttle->deferred_until && now >= throttle->deferred_until)
+    { /* The held back update has been drawn since. */
+      throttle->next = throttle->deferred_until + interval;
+      throttle->deferred_until = 0;
+    }
+
+  if (now >= throttle->next)
+    {
+      throttle->next = now + interval;
+      return now;
+    }
+
+  throttle->deferred_until = throttle->next;
+  return throttle->next;
+}
+
+void
+hd_damage_add_actor_area (ClutterActor *actor, const ClutterGeometry *area,
+                          guint min_interval_ms)
+{
+  ClutterGeometry geo = { 0, 0, 0, 0 };
+  gboolean visible;
+  gint64 now, due;
+
+  hd_damage_init ();
+  if (area)
+    geo = *area;
+  now = g_get_monotonic_time ();
+
+  if (!hd_util_get_actor_bounds (actor, &geo, &visible))
+    {
+      if (!visible)
+        return;
+      damage.n_updates++;
+      damage.full = TRUE;
+      hd_damage_schedule (now, now);
+      return;
+    }
+  if (!visible || !geo.width || !geo.height)
+    return;
+
+  damage.n_updates++;
+  due = min_interval_ms ? hd_damage_throttle (actor, now, min_interval_ms)
+                        : now;
+  if (due > now)
+    {
+      DeferredDamage deferred;
+
+      deferred.due = due;
+      deferred.area.x = geo.x;
+      deferred.area.y = geo.y;
+      deferred.area.width = geo.width;
+      deferred.area.height = geo.height;
+      g_array_append_val (damage.deferred, deferred);
+      damage.n_throttled++;
+    }
+  else
+    gdk_region_union_with_rect (damage.pending,
+                                (GdkRectangle *)(void *)&geo);
+
+  hd_damage_schedule (now, due);
+}
+
+/* Decide whether @pending is cheaper to paint rectangle by rectangle
+ * than as @box.  Each separate rectangle costs a traversal of the scene
+ * and some GL state changes, so it's charged [damage] rect_cost pixels
+ * on top of its area. */
+static void
+hd_damage_plan_frame (GdkRegion *pending, const GdkRectangle *box)
+{
+  GdkRectangle *rects;
+  gint n_rects, max_rects, rect_cost, i;
+  guint area, cost;
+
+  max_rects = hd_transition_param_get_int (damage.max_rects, 4);
+  if (max_rects < 2)
+    return;
+
+  gdk_region_get_rectangles (pending, &rects, &n_rects);
+  if (n_rects < 2 || n_rects > max_rects)
+    {
+      g_free (rects);
+      return;
+    }
+
+  rect_cost = MAX (hd_transition_param_get_int (damage.rect_cost, 4096), 0);
+  for (i = area = 0; i < n_rects; i++)
+    area += rects[i].width * rects[i].height;
+  cost = area + n_rects * rect_cost;
+  if (cost < (guint)(box->width * box->height))
+    {
+      g_array_append_vals (damage.frame_rects, rects, n_rects);
+      damage.frame_box = *box;
+      damage.frame_saving = box->width * box->height - area;
+    }
+  g_free (rects);
+}
+
+gboolean
+hd_damage_get_frame_rects (const GdkRectangle **rects, guint *n_rects,
+                           GdkRectangle *box)
+{
+  if (!damage.frame_rects || !damage.frame_rects->len)
+    return FALSE;
+
+  *rects = &g_array_index (damage.frame_rects, GdkRectangle, 0);
+  *n_rects = damage.frame_rects->len;
+  *box = damage.frame_box;
+  return TRUE;
+}
+
+void
+hd_damage_frame_rects_painted (gboolean split)
+{
+  if (!damage.frame_rects || !damage.frame_rects->len)
+    return;
+
+  if (split)
+    {
+      damage.n_split++;
+      damage.pixels_saved += damage.frame_saving;
+    }
+  g_array_set_size (damage.frame_rects, 0);
+}
+
+void
+hd_damage_flush (void)
+{
+  ClutterActor *stage;
+  gint64 now, next_due;
+  guint i;
+
+  hd_damage_init ();
+  now = g_get_monotonic_time ();
+
+  /* Take the held back updates which are due. */
+  next_due = G_MAXINT64;
+  for (i = 0; i < damage.deferred->len; )
+    {
+      DeferredDamage *deferred = &g_array_index (damage.deferred,
+                                                 DeferredDamage, i);
+      if (deferred->due <= now)
+        {
+          gdk_region_union_with_rect (damage.pending, &deferred->area);
+          g_array_remove_index_fast (damage.deferred, i);
+        }
+      else
+        {
+          next_due = MIN (next_due, deferred->due);
+          i++;
+        }
+    }
+
+  stage = clutter_stage_get_default ();
+  g_array_set_size (damage.frame_rects, 0);
+  if (damage.full)
+    {
+      clutter_actor_queue_redraw (stage);
+      hd_frame_stats_redraw_queued ();
+      damage.in_flight = TRUE;
+      damage.n_flushes++;
+    }
+  else if (!gdk_region_empty (damage.pending))
+    {
+      GdkRectangle box;
+      ClutterGeometry geo;
+
+      gdk_region_get_clipbox (damage.pending, &box);
+      hd_damage_plan_frame (damage.pending, &box);
+
+      /* The stage still swaps the whole box. */
+      geo.x = box.x;
+      geo.y = box.y;
+      geo.width = box.width;
+      geo.height = box.height;
+      clutter_stage_set_damaged_area (stage, geo);
+      clutter_actor_queue_redraw_damage (stage);
+      hd_frame_stats_redraw_queued ();
+      damage.in_flight = TRUE;
+      damage.n_flushes++;
+    }
+
+  gdk_region_destroy (damage.pending);
+  damage.pending = gdk_region_new ();
+  damage.full = FALSE;
+  damage.last_flush = now;
+
+  if (damage.deferred->len)
+    hd_damage_schedule (now, next_due);
+}
+
+static gboolean
+hd_damage_tick (gpointer unused)
+{
+  damage.tick_id = 0;
+  hd_damage_flush ();
+  return FALSE;
+}
+
+void
+hd_damage_dump_debug_info (void)
+{
+  g_debug ("damage: %u updates, %u held back, %u flushes, %u pending, "
+           "%u split frames saved %" G_GUINT64_FORMAT " pixels",
+           damage.n_updates, damage.n_throttled, damage.n_flushes,
+           damage.deferred ? damage.deferred->len : 0,
+           damage.n_split, damage.pixels_saved);
+}
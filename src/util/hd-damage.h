@@ -0,0 +1,54 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_DAMAGE_H__
+#define __HD_DAMAGE_H__
+
+#include <glib.h>
+#include <clutter/clutter.h>
+#include <gdk/gdk.h>
+
+/* Stage damage is collected here and handed to clutter once per frame
+ * tick ([damage] frame_ms), rather than queueing a redraw for every
+ * single update.  When the stage is idle the first update is handed
+ * over right away.  Updates which can't be mapped to a stage rectangle
+ * (because something is rotated) make the next tick redraw everything. */
+
+/* Damage @area of @actor (all of it if @area is NULL or empty).  If
+ * @min_interval_ms is not 0, updates of @actor are drawn at most that
+ * often; the ones coming too early are held back, not dropped. */
+void hd_damage_add_actor_area (ClutterActor *actor,
+                               const ClutterGeometry *area,
+                               guint min_interval_ms);
+
+/* Hand what has been collected to clutter now. */
+void hd_damage_flush (void);
+
+/* Whether the last flush was of a few rectangles far enough apart that
+ * painting them one by one is cheaper than painting their bounding box.
+ * If so, returns the rectangles and the box, in stage coordinates. */
+gboolean hd_damage_get_frame_rects (const GdkRectangle **rects,
+                                    guint *n_rects, GdkRectangle *box);
+/* The stage has painted the frame of the last flush, rectangle by
+ * rectangle if @split.  The rectangles are forgotten either way. */
+void hd_damage_frame_rects_painted (gboolean split);
+
+void hd_damage_dump_debug_info (void);
+
+#endif
@@ -0,0 +1,365 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "hd-dither.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+# define HD_DITHER_HAVE_NEON
+# include <arm_neon.h>
+#elif defined(__SSE2__)
+# define HD_DITHER_HAVE_SSE2
+# include <emmintrin.h>
+#endif
+
+/* The noise tile is filled with the same LFSR sequence the reference
+ * kernel uses, so the noise has the same distribution.  It's 64 pixels
+ * wide, which is a multiple of every vector width we use, so a vector
+ * never wraps around the edge of the tile. */
+#define TILE_SIZE  64
+#define TILE_MASK  (TILE_SIZE - 1)
+
+/* The same noise twice: as planes for the C and NEON kernels, and as
+ * RGBx pixels for SSE2, which can't deinterleave cheaply. */
+static guint8  noise_r[TILE_SIZE * TILE_SIZE];
+static guint8  noise_g[TILE_SIZE * TILE_SIZE];
+static guint8  noise_b[TILE_SIZE * TILE_SIZE];
+static guint32 noise_rgbx[TILE_SIZE * TILE_SIZE];
+
+/* http://en.wikipedia.org/wiki/Linear_feedback_shift_register */
+#define LFSR_NEXT(lfsr) \
+  (((lfsr) >> 1) ^ (guint32)((0 - ((lfsr) & 1u)) & 0xd0000001u))
+
+/* dither 565 - by adding random noise and then truncating
+ * (r>>8)*0xFF makes sure our bottom 8 bits are 0xFF if we
+ * overflow. */
+static inline guint16
+dither_pixel (const guchar *pixel, guint nr, guint ng, guint nb)
+{
+  guint r, g, b;
+
+  r = pixel[0] + nr;
+  r |= (r>>8)*0xFF;
+  g = pixel[1] + ng;
+  g |= (g>>8)*0xFF;
+  b = pixel[2] + nb;
+  b |= (b>>8)*0xFF;
+  return ((r<<8)&0xF800) |
+         ((g<<3)&0x07E0) |
+         ((b>>3)&0x001F);
+}
+
+static void
+init_noise_tile (void)
+{
+  static gsize initialized = 0;
+  guint32 lfsr;
+  gint i;
+
+  /* We may be called from more than one thread at once. */
+  if (!g_once_init_enter (&initialized))
+    return;
+
+  for (i = 0, lfsr = 1; i < TILE_SIZE * TILE_SIZE; i++)
+    {
+      lfsr = LFSR_NEXT (lfsr);
+      noise_r[i] =  lfsr       & 7;
+      noise_g[i] = (lfsr >> 3) & 3;
+      noise_b[i] = (lfsr >> 5) & 7;
+      noise_rgbx[i] = GUINT32_FROM_LE (noise_r[i]
+                                       | (noise_g[i] << 8)
+                                       | (noise_b[i] << 16));
+    }
+
+  g_once_init_leave (&initialized, 1);
+}
+
+static void
+dither_reference (const guchar *src, gint src_stride, gint n_channels,
+                  guint16 *dst, gint dst_stride,
+                  gint width, gint height, gint first_row)
+{
+  guint32 lfsr = 1;
+  gint x, y;
+
+  /* Catch up with the rows before us. */
+  for (x = first_row * width; x > 0; x--)
+    lfsr = LFSR_NEXT (lfsr);
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *pixels = src + y * src_stride;
+      guint16 *out = (guint16 *)((guchar *)dst + y * dst_stride);
+
+      for (x = 0; x < width; x++)
+        {
+          lfsr = LFSR_NEXT (lfsr);
+          out[x] = dither_pixel (pixels, lfsr&7, (lfsr>>3)&3, (lfsr>>5)&7);
+          pixels += n_channels;
+        }
+    }
+}
+
+/* Dither pixels [@x, @width) of a row with the noise tile.  The vector
+ * kernels use this for what doesn't fill a whole vector. */
+static inline void
+dither_row_tiled (const guchar *pixels, gint n_channels, guint16 *out,
+                  gint x, gint width, const guint tile_row)
+{
+  for (; x < width; x++)
+    {
+      guint i = tile_row + (x & TILE_MASK);
+
+      out[x] = dither_pixel (pixels + x * n_channels,
+                             noise_r[i], noise_g[i], noise_b[i]);
+    }
+}
+
+static void
+dither_tiled (const guchar *src, gint src_stride, gint n_channels,
+              guint16 *dst, gint dst_stride,
+              gint width, gint height, gint first_row)
+{
+  gint y;
+
+  for (y = 0; y < height; y++)
+    dither_row_tiled (src + y * src_stride, n_channels,
+                      (guint16 *)((guchar *)dst + y * dst_stride),
+                      0, width, ((first_row + y) & TILE_MASK) * TILE_SIZE);
+}
+
+#ifdef HD_DITHER_HAVE_SSE2
+/* Truncate 4 noisy RGBx pixels to RGB565, leaving them in the low
+ * halves of the 32-bit lanes, sign-extended so that packs doesn't
+ * saturate them. */
+static inline __m128i
+sse2_pack_565 (__m128i v)
+{
+  __m128i r, g, b;
+
+  r = _mm_slli_epi32 (_mm_and_si128 (v, _mm_set1_epi32 (0x0000F8)), 8);
+  g = _mm_srli_epi32 (_mm_and_si128 (v, _mm_set1_epi32 (0x00FC00)), 5);
+  b = _mm_srli_epi32 (_mm_and_si128 (v, _mm_set1_epi32 (0xF80000)), 19);
+  v = _mm_or_si128 (_mm_or_si128 (r, g), b);
+  return _mm_srai_epi32 (_mm_slli_epi32 (v, 16), 16);
+}
+
+/* Load 4 RGB pixels into the RGBx layout.  Reads one byte past the
+ * 4th pixel. */
+static inline __m128i
+sse2_load_rgb (const guchar *p)
+{
+  guint32 px[4];
+
+  memcpy (&px[0], p + 0, 4);
+  memcpy (&px[1], p + 3, 4);
+  memcpy (&px[2], p + 6, 4);
+  memcpy (&px[3], p + 9, 4);
+  return _mm_set_epi32 (px[3], px[2], px[1], px[0]);
+}
+
+static void
+dither_sse2 (const guchar *src, gint src_stride, gint n_channels,
+             guint16 *dst, gint dst_stride,
+             gint width, gint height, gint first_row)
+{
+  gint x, y, vwidth;
+
+  /* The 3-channel loads overread by a byte, make sure it's in the row. */
+  vwidth = n_channels == 4 ? width & ~7 : (width - 1) & ~7;
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *pixels = src + y * src_stride;
+      guint16 *out = (guint16 *)((guchar *)dst + y * dst_stride);
+      const guint tile_row = ((first_row + y) & TILE_MASK) * TILE_SIZE;
+
+      for (x = 0; x < vwidth; x += 8)
+        {
+          const guchar *p = pixels + x * n_channels;
+          const guint32 *noise = &noise_rgbx[tile_row + (x & TILE_MASK)];
+          __m128i lo, hi;
+
+          if (n_channels == 4)
+            {
+              lo = _mm_loadu_si128 ((const __m128i *)p);
+              hi = _mm_loadu_si128 ((const __m128i *)(p + 16));
+            }
+          else
+            {
+              lo = sse2_load_rgb (p);
+              hi = sse2_load_rgb (p + 12);
+            }
+
+          /* Saturating add is exactly the overflow handling of
+           * dither_pixel(). */
+          lo = _mm_adds_epu8 (lo, _mm_loadu_si128 ((const __m128i *)noise));
+          hi = _mm_adds_epu8 (hi,
+                              _mm_loadu_si128 ((const __m128i *)(noise + 4)));
+          _mm_storeu_si128 ((__m128i *)(out + x),
+                            _mm_packs_epi32 (sse2_pack_565 (lo),
+                                             sse2_pack_565 (hi)));
+        }
+
+      dither_row_tiled (pixels, n_channels, out, x, width, tile_row);
+    }
+}
+#endif /* HD_DITHER_HAVE_SSE2 */
+
+#ifdef HD_DITHER_HAVE_NEON
+static inline uint16x8_t
+neon_pack_565 (uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+  uint16x8_t v;
+
+  v = vshll_n_u8 (r, 8);
+  v = vsriq_n_u16 (v, vshll_n_u8 (g, 8), 5);
+  v = vsriq_n_u16 (v, vshll_n_u8 (b, 8), 11);
+  return v;
+}
+
+static void
+dither_neon (const guchar *src, gint src_stride, gint n_channels,
+             guint16 *dst, gint dst_stride,
+             gint width, gint height, gint first_row)
+{
+  gint x, y, vwidth;
+
+  vwidth = width & ~15;
+  for (y = 0; y < height; y++)
+    {
+      const guchar *pixels = src + y * src_stride;
+      guint16 *out = (guint16 *)((guchar *)dst + y * dst_stride);
+      const guint tile_row = ((first_row + y) & TILE_MASK) * TILE_SIZE;
+
+      for (x = 0; x < vwidth; x += 16)
+        {
+          const guint i = tile_row + (x & TILE_MASK);
+          uint8x16_t r, g, b;
+
+          if (n_channels == 4)
+            {
+              uint8x16x4_t px = vld4q_u8 (pixels + x * 4);
+              r = px.val[0];
+              g = px.val[1];
+              b = px.val[2];
+            }
+          else
+            {
+              uint8x16x3_t px = vld3q_u8 (pixels + x * 3);
+              r = px.val[0];
+              g = px.val[1];
+              b = px.val[2];
+            }
+
+          r = vqaddq_u8 (r, vld1q_u8 (&noise_r[i]));
+          g = vqaddq_u8 (g, vld1q_u8 (&noise_g[i]));
+          b = vqaddq_u8 (b, vld1q_u8 (&noise_b[i]));
+
+          vst1q_u16 (out + x, neon_pack_565 (vget_low_u8 (r),
+                                             vget_low_u8 (g),
+                                             vget_low_u8 (b)));
+          vst1q_u16 (out + x + 8, neon_pack_565 (vget_high_u8 (r),
+                                                 vget_high_u8 (g),
+                                                 vget_high_u8 (b)));
+        }
+
+      dither_row_tiled (pixels, n_channels, out, x, width, tile_row);
+    }
+}
+#endif /* HD_DITHER_HAVE_NEON */
+
+gboolean
+hd_dither_kernel_is_available (HdDitherKernel kernel)
+{
+  switch (kernel)
+    {
+      case HD_DITHER_REFERENCE:
+      case HD_DITHER_TILED:
+      case HD_DITHER_BEST:
+        return TRUE;
+#ifdef HD_DITHER_HAVE_SSE2
+      case HD_DITHER_SSE2:
+        return TRUE;
+#endif
+#ifdef HD_DITHER_HAVE_NEON
+      case HD_DITHER_NEON:
+        return TRUE;
+#endif
+      default:
+        return FALSE;
+    }
+}
+
+const gchar *
+hd_dither_kernel_name (HdDitherKernel kernel)
+{
+  static const gchar *names[] = { "reference", "tiled", "sse2", "neon" };
+
+  if (kernel == HD_DITHER_BEST)
+#if defined(HD_DITHER_HAVE_NEON)
+    kernel = HD_DITHER_NEON;
+#elif defined(HD_DITHER_HAVE_SSE2)
+    kernel = HD_DITHER_SSE2;
+#else
+    kernel = HD_DITHER_TILED;
+#endif
+
+  return kernel < G_N_ELEMENTS (names) ? names[kernel] : "unknown";
+}
+
+void
+hd_dither_rgb565_full (HdDitherKernel kernel,
+                       const guchar *src, gint src_stride,
+                       gint n_channels,
+                       guint16 *dst, gint dst_stride,
+                       gint width, gint height,
+                       gint first_row)
+{
+  g_return_if_fail (n_channels == 3 || n_channels == 4);
+  g_return_if_fail (hd_dither_kernel_is_available (kernel));
+
+  init_noise_tile ();
+  switch (kernel)
+    {
+      case HD_DITHER_REFERENCE:
+        dither_reference (src, src_stride, n_channels, dst, dst_stride,
+                          width, height, first_row);
+        break;
+#ifdef HD_DITHER_HAVE_SSE2
+      case HD_DITHER_BEST:
+      case HD_DITHER_SSE2:
+        dither_sse2 (src, src_stride, n_channels, dst, dst_stride,
+                     width, height, first_row);
+        break;
+#endif
+#ifdef HD_DITHER_HAVE_NEON
+      case HD_DITHER_BEST:
+      case HD_DITHER_NEON:
+        dither_neon (src, src_stride, n_channels, dst, dst_stride,
+                     width, height, first_row);
+        break;
+#endif
+      default:
+        dither_tiled (src, src_stride, n_channels, dst, dst_stride,
+                      width, height, first_row);
+        break;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_DITHER_H__
+#define __HD_DITHER_H__
+
+#include <glib.h>
+
+/* Dithering of 8-bit RGB/RGBA images to RGB565, for textures uploaded with
+ * CLUTTER_TEXTURE_FLAG_16_BIT.  Noise is added to each channel before it
+ * is truncated, which hides the banding of smooth gradients. */
+
+typedef enum
+{
+  /* Serial LFSR noise, one pixel at a time.  This is how we used to dither
+   * wallpapers, and the other kernels are checked against it. */
+  HD_DITHER_REFERENCE,
+  /* Noise from a precomputed tile, plain C. */
+  HD_DITHER_TILED,
+  /* The same as HD_DITHER_TILED, but 8 or 16 pixels at a time. */
+  HD_DITHER_SSE2,
+  HD_DITHER_NEON,
+  /* The fastest one available. */
+  HD_DITHER_BEST
+} HdDitherKernel;
+
+gboolean hd_dither_kernel_is_available (HdDitherKernel kernel);
+const gchar *hd_dither_kernel_name (HdDitherKernel kernel);
+
+/* Dither @width x @height pixels of @n_channels (3 or 4, alpha is ignored)
+ * from @src to @dst.  Strides are in bytes.  @first_row is the row of the
+ * whole image @src starts at, so that an image can be dithered in bands
+ * with the same result as in one go (HD_DITHER_REFERENCE has to replay its
+ * noise sequence up to @first_row for this, so don't use it in bands). */
+void hd_dither_rgb565_full (HdDitherKernel kernel,
+                            const guchar *src, gint src_stride,
+                            gint n_channels,
+                            guint16 *dst, gint dst_stride,
+                            gint width, gint height,
+                            gint first_row);
+
+#define hd_dither_rgb565(src, src_stride, n_channels, dst, width, height) \
+  hd_dither_rgb565_full (HD_DITHER_BEST, src, src_stride, n_channels, \
+                         dst, (width) * 2, width, height, 0)
+
+#endif
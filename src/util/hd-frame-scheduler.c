@@ -0,0 +1,322 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-frame-scheduler.h"
+
+/* The frame until hd_frame_scheduler_set_frame_ms() says otherwise. */
+#define DEFAULT_FRAME_MS 16
+
+typedef struct
+{
+  guint          id;
+  /* When it's to be called and how often, in microseconds. */
+  gint64         due, interval;
+  HdFrameFunc    func;
+  gpointer       data;
+  GDestroyNotify notify;
+} FrameCallback;
+
+static struct
+{
+  /* FrameCallback:s in the order they were added. */
+  GList     *callbacks;
+  GSource   *source;
+  gint64   (*clock) (void);
+  guint      last_id;
+
+  /* The length of a frame and a tick of the grid, in microseconds. */
+  gint64     frame, origin;
+  /* The time of the tick being run, if one is. */
+  gint64     tick;
+  gboolean   running;
+  /* What has been removed while running a tick, to be freed after it. */
+  GList     *removed;
+
+  HdFrameSchedulerStats stats;
+} sched;
+
+static gint64
+hd_frame_scheduler_now (void)
+{
+  return sched.clock ? sched.clock () : g_get_monotonic_time ();
+}
+
+/* Returns the first tick at or after @t. */
+static gint64
+hd_frame_scheduler_tick_of (gint64 t)
+{
+  gint64 d = t - sched.origin;
+
+  /* Division rounds towards zero, so a negative @d is rounded up too. */
+  if (d > 0)
+    d += sched.frame - 1;
+  return sched.origin + d / sched.frame * sched.frame;
+}
+
+/* Returns the tick the earliest callback is due at. */
+static gint64
+hd_frame_scheduler_next_tick (void)
+{
+  gint64 due = G_MAXINT64;
+  GList *li;
+
+  for (li = sched.callbacks; li; li = li->next)
+    due = MIN (due, ((FrameCallback *)li->data)->due);
+  return hd_frame_scheduler_tick_of (due);
+}
+
+static FrameCallback *
+hd_frame_scheduler_lookup (guint id)
+{
+  GList *li;
+
+  for (li = sched.callbacks; li; li = li->next)
+    if (((FrameCallback *)li->data)->id == id)
+      return li->data;
+  return NULL;
+}
+
+static gboolean
+hd_frame_scheduler_prepare (GSource *src, gint *timeout)
+{
+  gint64 tick, now;
+
+  if (!sched.callbacks)
+    {
+      *timeout = -1;
+      return FALSE;
+    }
+
+  tick = hd_frame_scheduler_next_tick ();
+  now = hd_frame_scheduler_now ();
+  if (tick <= now)
+    {
+      *timeout = 0;
+      return TRUE;
+    }
+
+  *timeout = (tick - now + 999) / 1000;
+  return FALSE;
+}
+
+static gboolean
+hd_frame_scheduler_check (GSource *src)
+{
+  return sched.callbacks
+    && hd_frame_scheduler_next_tick () <= hd_frame_scheduler_now ();
+}
+
+/* Run everything due by the last tick that has passed. */
+static gboolean
+hd_frame_scheduler_dispatch (GSource *src, GSourceFunc unused, gpointer cbarg)
+{
+  gint64 due, now, current;
+  GList *batch, *li;
+  guint n, skipped;
+
+  due = hd_frame_scheduler_next_tick ();
+  now = hd_frame_scheduler_now ();
+  current = hd_frame_scheduler_tick_of (now);
+  if (current > now)
+    current -= sched.frame;
+  if (current < due)
+    /* Can't happen unless the clock is not monotonic. */
+    current = due;
+
+  /* If we're a frame or more late, the frames in between are not
+   * caught up on, everything is run once for @current. */
+  sched.stats.n_ticks++;
+  sched.stats.lateness_total += now - due;
+  sched.stats.lateness_max = MAX (sched.stats.lateness_max, now - due);
+  if ((skipped = (current - due) / sched.frame) > 0)
+    {
+      sched.stats.n_late++;
+      sched.stats.n_skipped += skipped;
+    }
+
+  batch = NULL;
+  for (li = sched.callbacks; li; li = li->next)
+    if (((FrameCallback *)li->data)->due <= current)
+      batch = g_list_prepend (batch, li->data);
+  batch = g_list_reverse (batch);
+
+  n = 0;
+  sched.tick = current;
+  sched.running = TRUE;
+  for (li = batch; li; li = li->next)
+    {
+      FrameCallback *cb = li->data;
+
+      if (g_list_find (sched.removed, cb))
+        continue;
+
+      /* Reschedule before the call, so the callback may change it. */
+      cb->due += cb->interval ? cb->interval : sched.frame;
+      if (cb->due <= current)
+        cb->due = current + (cb->interval ? cb->interval : sched.frame);
+
+      n++;
+      if (!cb->func (cb->data) && !g_list_find (sched.removed, cb))
+        hd_frame_scheduler_remove (cb->id);
+    }
+  sched.running = FALSE;
+
+  sched.stats.n_calls += n;
+  sched.stats.max_batch = MAX (sched.stats.max_batch, n);
+
+  g_list_free (batch);
+  for (li = sched.removed; li; li = li->next)
+    g_free (li->data);
+  g_list_free (sched.removed);
+  sched.removed = NULL;
+
+  return TRUE;
+}
+
+guint
+hd_frame_scheduler_add (guint interval_ms, HdFrameFunc func, gpointer data,
+                        GDestroyNotify notify)
+{
+  static GSourceFuncs funcs =
+  {
+    hd_frame_scheduler_prepare,
+    hd_frame_scheduler_check,
+    hd_frame_scheduler_dispatch,
+  };
+  FrameCallback *cb;
+
+  g_return_val_if_fail (func != NULL, 0);
+
+  if (!sched.source)
+    {
+      if (!sched.frame)
+        hd_frame_scheduler_set_frame_ms (DEFAULT_FRAME_MS);
+      sched.source = g_source_new (&funcs, sizeof (GSource));
+      /* Like the rotation's timer was, so X events coming in at
+       * G_PRIORITY_DEFAULT don't hold the ticks up. */
+      g_source_set_priority (sched.source, G_PRIORITY_HIGH);
+      g_source_attach (sched.source, NULL);
+    }
+
+  cb = g_new0 (FrameCallback, 1);
+  if (!++sched.last_id)
+    ++sched.last_id;
+  cb->id = sched.last_id;
+  cb->interval = (gint64)interval_ms * 1000;
+  cb->due = hd_frame_scheduler_get_time () + cb->interval;
+  cb->func = func;
+  cb->data = data;
+  cb->notify = notify;
+  sched.callbacks = g_list_append (sched.callbacks, cb);
+
+  return cb->id;
+}
+
+gboolean
+hd_frame_scheduler_remove (guint id)
+{
+  FrameCallback *cb;
+
+  if (!(cb = hd_frame_scheduler_lookup (id)))
+    return FALSE;
+
+  sched.callbacks = g_list_remove (sched.callbacks, cb);
+  if (cb->notify)
+    cb->notify (cb->data);
+
+  /* It may be in the batch being run. */
+  if (sched.running)
+    sched.removed = g_list_prepend (sched.removed, cb);
+  else
+    g_free (cb);
+  return TRUE;
+}
+
+guint
+hd_frame_scheduler_get_remaining (guint id)
+{
+  FrameCallback *cb;
+  gint64 now;
+
+  if (!(cb = hd_frame_scheduler_lookup (id)))
+    return 0;
+
+  now = hd_frame_scheduler_get_time ();
+  return cb->due > now ? (cb->due - now + 999) / 1000 : 0;
+}
+
+void
+hd_frame_scheduler_set_remaining (guint id, guint ms)
+{
+  FrameCallback *cb;
+
+  g_return_if_fail ((cb = hd_frame_scheduler_lookup (id)) != NULL);
+  cb->due = hd_frame_scheduler_get_time () + (gint64)ms * 1000;
+}
+
+gint64
+hd_frame_scheduler_get_time (void)
+{
+  return sched.running ? sched.tick : hd_frame_scheduler_now ();
+}
+
+void
+hd_frame_scheduler_set_frame_ms (guint frame_ms)
+{
+  gint64 frame = (gint64)MAX (frame_ms, 1) * 1000;
+
+  if (frame == sched.frame)
+    return;
+
+  /* Start the new grid from now. */
+  sched.frame = frame;
+  sched.origin = hd_frame_scheduler_get_time ();
+}
+
+void
+hd_frame_scheduler_get_stats (HdFrameSchedulerStats *stats)
+{
+  *stats = sched.stats;
+}
+
+void
+hd_frame_scheduler_dump_debug_info (void)
+{
+  g_debug ("frame scheduler: %u callbacks, frame %" G_GINT64_FORMAT " us; "
+           "%u ticks, %u calls, at most %u a tick; lateness average %"
+           G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us; "
+           "%u ticks late, %u frames skipped",
+           g_list_length (sched.callbacks), sched.frame,
+           sched.stats.n_ticks, sched.stats.n_calls, sched.stats.max_batch,
+           sched.stats.n_ticks
+             ? sched.stats.lateness_total / sched.stats.n_ticks : 0,
+           sched.stats.lateness_max,
+           sched.stats.n_late, sched.stats.n_skipped);
+}
+
+void
+hd_frame_scheduler_set_clock (gint64 (*clock) (void))
+{
+  sched.clock = clock;
+  sched.origin = hd_frame_scheduler_get_time ();
+}
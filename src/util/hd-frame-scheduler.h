@@ -0,0 +1,79 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_FRAME_SCHEDULER_H__
+#define __HD_FRAME_SCHEDULER_H__
+
+#include <glib.h>
+
+/* One timer for the animations we drive ourselves, on the monotonic
+ * clock so setting the time of day doesn't stall or rush them.  Ticks
+ * fall on a grid of frames ([damage] frame_ms), callbacks are run at the
+ * first tick they are due at, and all of those due at the same tick are
+ * run together, so they end up in the same redraw.  How late the ticks
+ * come is recorded for hd_frame_scheduler_dump_debug_info().
+ *
+ * The grid runs free, it isn't locked to the display's refresh.  Clutter
+ * 0.8 waits for the vblank (if at all) inside its redraw and tells us
+ * neither when that was nor when the swap completed; the end of the
+ * stage's paint comes before the swap, so anchoring the grid there
+ * would add the swap's latency to every frame.  A tick can thus be up
+ * to a frame out of phase with the refresh, and the redraw it queues
+ * is still shown at the next vblank the backend waits for. */
+
+/* Like a #GSourceFunc: return %FALSE to be removed. */
+typedef gboolean (*HdFrameFunc) (gpointer data);
+
+typedef struct
+{
+  guint   n_ticks, n_calls, max_batch;
+  /* Ticks which came a frame or more late, and the frames they missed. */
+  guint   n_late, n_skipped;
+  /* Microseconds between when the ticks were due and when they ran. */
+  gint64  lateness_total, lateness_max;
+} HdFrameSchedulerStats;
+
+/* Call @func @interval_ms from now, then every @interval_ms (every frame
+ * if 0) as long as it returns %TRUE.  @notify is called with @data when
+ * it's removed.  Returns the id of the callback, never 0. */
+guint    hd_frame_scheduler_add           (guint interval_ms, HdFrameFunc func,
+                                           gpointer data,
+                                           GDestroyNotify notify);
+/* Returns whether @id was there to remove. */
+gboolean hd_frame_scheduler_remove        (guint id);
+
+/* Milliseconds until @id is called next, and changing that.  Setting 0
+ * makes it run at the next tick. */
+guint    hd_frame_scheduler_get_remaining (guint id);
+void     hd_frame_scheduler_set_remaining (guint id, guint ms);
+
+/* The monotonic time in microseconds, which is the time of the tick
+ * while the callbacks of a tick are being run. */
+gint64   hd_frame_scheduler_get_time      (void);
+
+void     hd_frame_scheduler_set_frame_ms  (guint frame_ms);
+
+void     hd_frame_scheduler_get_stats     (HdFrameSchedulerStats *stats);
+void     hd_frame_scheduler_dump_debug_info (void);
+
+/* For tests: read the time from @clock rather than the monotonic clock.
+ * %NULL restores it. */
+void     hd_frame_scheduler_set_clock     (gint64 (*clock) (void));
+
+#endif
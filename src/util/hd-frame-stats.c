@@ -0,0 +1,406 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-frame-stats.h"
+#include "hd-frame-scheduler.h"
+#include "hd-render-manager.h"
+#include "hd-comp-mgr.h"
+#include "hd-transition.h"
+#include "hd-util.h"
+
+#include <string.h>
+#include <clutter/clutter.h>
+
+/* How many frames are kept: a bit over half a minute of animation. */
+#define FRAME_STATS_SIZE      2048
+
+/* How often the overlay is updated (ms), and over how many frames. */
+#define OVERLAY_INTERVAL      500
+#define OVERLAY_WINDOW        (1 * G_USEC_PER_SEC)
+#define OVERLAY_FONT          "Monospace 12"
+#define OVERLAY_MARGIN        8
+
+typedef struct
+{
+  gint64        at;
+  HDRMStateEnum state;
+  /* Microseconds and pixels.  @interval is since the previous frame
+   * started, if this one was wanted right after it, 0 if not. */
+  guint32       paint, interval, damage;
+  guint         skipped;
+} FrameRecord;
+
+/* The frames of a state, for the report. */
+typedef struct
+{
+  HDRMStateEnum state;
+  GArray       *paint, *interval;
+  guint64       damage;
+  guint         skipped;
+} StateFrames;
+
+static struct
+{
+  FrameRecord   ring[FRAME_STATS_SIZE];
+  /* Where the next frame goes and how many there are. */
+  guint         head, len;
+
+  gint64        paint_start;
+  /* When the last frame started painting, and since when a redraw has
+   * been waiting for the next one, 0 if none has. */
+  gint64        last_paint, pending_since;
+  /* The frames the one being painted was waited for, and the time
+   * since the previous one, if it counts. */
+  guint         skipped;
+  guint32       interval;
+  /* [damage] frame_ms */
+  HdTransitionParam *frame_ms;
+
+  ClutterActor *overlay, *overlay_bg, *overlay_label;
+  guint         overlay_id;
+} stats;
+
+static FrameRecord *
+hd_frame_stats_nth (guint i)
+{
+  return &stats.ring[(stats.head + FRAME_STATS_SIZE - stats.len + i)
+                     % FRAME_STATS_SIZE];
+}
+
+static void
+hd_frame_stats_paint_start (ClutterActor *stage)
+{
+  gint64 frame;
+
+  stats.paint_start = g_get_monotonic_time ();
+
+  /* If the gap since the last frame is longer than a frame and a redraw
+   * was waiting in it, count the frames it waited for. */
+  frame = (gint64)MAX (hd_transition_param_get_int (stats.frame_ms, 16), 1)
+    * 1000;
+  stats.skipped = 0;
+  if (stats.pending_since && stats.paint_start - stats.last_paint > frame)
+    stats.skipped = (stats.paint_start - stats.pending_since) / frame;
+
+  /* The paint time is only how long it took to hand the frame to GL;
+   * how soon the next frame could start shows the GPU and the swap
+   * too.  That's only meaningful if it was wanted a frame after the
+   * last one at the latest, rather than after a pause. */
+  stats.interval = 0;
+  if (stats.last_paint && stats.pending_since
+      && stats.pending_since - stats.last_paint <= frame)
+    stats.interval = MIN (stats.paint_start - stats.last_paint, G_MAXUINT32);
+
+  stats.last_paint = stats.paint_start;
+  /* What's queued while painting is for the next frame. */
+  stats.pending_since = 0;
+}
+
+static void
+hd_frame_stats_paint_end (ClutterActor *stage)
+{
+  FrameRecord *frame;
+  GLint box[4];
+
+  if (!stats.paint_start)
+    return;
+
+  frame = &stats.ring[stats.head];
+  stats.head = (stats.head + 1) % FRAME_STATS_SIZE;
+  if (stats.len < FRAME_STATS_SIZE)
+    stats.len++;
+
+  frame->at = stats.paint_start;
+  frame->paint = g_get_monotonic_time () - stats.paint_start;
+  frame->interval = stats.interval;
+  frame->state = hd_render_manager_get_state ();
+  stats.paint_start = 0;
+
+  /* hd_damage_flush() has the stage scissor what it damaged. */
+  if (glIsEnabled (GL_SCISSOR_TEST))
+    {
+      glGetIntegerv (GL_SCISSOR_BOX, box);
+      frame->damage = box[2] * box[3];
+    }
+  else
+    frame->damage = clutter_actor_get_width (stage)
+      * clutter_actor_get_height (stage);
+
+  frame->skipped = stats.skipped;
+}
+
+void
+hd_frame_stats_redraw_queued (void)
+{
+  if (!stats.pending_since)
+    stats.pending_since = g_get_monotonic_time ();
+}
+
+static gint
+hd_frame_stats_cmp_time (gconstpointer a, gconstpointer b)
+{
+  guint32 pa = *(const guint32 *)a, pb = *(const guint32 *)b;
+
+  return pa < pb ? -1 : pa > pb;
+}
+
+static gint
+hd_frame_stats_cmp_state (gconstpointer a, gconstpointer b)
+{
+  const StateFrames *sa = a, *sb = b;
+
+  return sa->state < sb->state ? -1 : sa->state > sb->state;
+}
+
+/* Returns the @p:th percentile of the sorted @times, in ms, or 0 if
+ * there are none. */
+static gdouble
+hd_frame_stats_percentile (GArray *times, guint p)
+{
+  guint i = (times->len * p + 99) / 100;
+
+  if (!times->len)
+    return 0;
+  return g_array_index (times, guint32, MAX (i, 1) - 1) / 1000.0;
+}
+
+static void
+hd_frame_stats_report_line (GString *report, const gchar *name,
+                            StateFrames *frames)
+{
+  g_array_sort (frames->paint, hd_frame_stats_cmp_time);
+  g_array_sort (frames->interval, hd_frame_stats_cmp_time);
+  g_string_append_printf (report, "%s\t%u\t%.1f\t%.1f\t%.1f\t%.1f\t%"
+                          G_GUINT64_FORMAT "\t%u\t%.1f\t%.1f\t%.1f\n",
+                          name, frames->paint->len,
+                          hd_frame_stats_percentile (frames->paint, 50),
+                          hd_frame_stats_percentile (frames->paint, 95),
+                          hd_frame_stats_percentile (frames->paint, 99),
+                          hd_frame_stats_percentile (frames->paint, 100),
+                          frames->damage / frames->paint->len,
+                          frames->skipped,
+                          hd_frame_stats_percentile (frames->interval, 50),
+                          hd_frame_stats_percentile (frames->interval, 95),
+                          hd_frame_stats_percentile (frames->interval, 100));
+}
+
+gchar *
+hd_frame_stats_report (void)
+{
+  StateFrames all = { HDRM_STATE_UNDEFINED, NULL, NULL, 0, 0 };
+  GArray *states;
+  GString *report;
+  guint i, j;
+
+  report = g_string_new ("state\tframes\tp50\tp95\tp99\tmax\tdamage\t"
+                         "skipped\tinterval_p50\tinterval_p95\t"
+                         "interval_max\n");
+  if (!stats.len)
+    return g_string_free (report, FALSE);
+
+  all.paint = g_array_sized_new (FALSE, FALSE, sizeof (guint32), stats.len);
+  all.interval = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+                                    stats.len);
+  states = g_array_new (FALSE, FALSE, sizeof (StateFrames));
+  for (i = 0; i < stats.len; i++)
+    {
+      FrameRecord *frame = hd_frame_stats_nth (i);
+      StateFrames *frames = NULL;
+
+      for (j = 0; j < states->len; j++)
+        if (g_array_index (states, StateFrames, j).state == frame->state)
+          {
+            frames = &g_array_index (states, StateFrames, j);
+            break;
+          }
+      if (!frames)
+        {
+          StateFrames new_state = { frame->state, NULL, NULL, 0, 0 };
+
+          new_state.paint = g_array_new (FALSE, FALSE, sizeof (guint32));
+          new_state.interval = g_array_new (FALSE, FALSE, sizeof (guint32));
+          g_array_append_val (states, new_state);
+          frames = &g_array_index (states, StateFrames, states->len - 1);
+        }
+
+      g_array_append_val (frames->paint, frame->paint);
+      frames->damage += frame->damage;
+      frames->skipped += frame->skipped;
+      g_array_append_val (all.paint, frame->paint);
+      all.damage += frame->damage;
+      all.skipped += frame->skipped;
+      if (frame->interval)
+        {
+          g_array_append_val (frames->interval, frame->interval);
+          g_array_append_val (all.interval, frame->interval);
+        }
+    }
+
+  g_array_sort (states, hd_frame_stats_cmp_state);
+  for (j = 0; j < states->len; j++)
+    {
+      StateFrames *frames = &g_array_index (states, StateFrames, j);
+
+      hd_frame_stats_report_line (report,
+                                  hd_render_manager_state_str (frames->state),
+                                  frames);
+      g_array_free (frames->paint, TRUE);
+      g_array_free (frames->interval, TRUE);
+    }
+  hd_frame_stats_report_line (report, "all", &all);
+
+  g_array_free (states, TRUE);
+  g_array_free (all.paint, TRUE);
+  g_array_free (all.interval, TRUE);
+  return g_string_free (report, FALSE);
+}
+
+void
+hd_frame_stats_reset (void)
+{
+  stats.head = stats.len = 0;
+}
+
+/* Show the frames of the last OVERLAY_WINDOW.  The overlay only damages
+ * itself, but that makes a (small) frame every OVERLAY_INTERVAL. */
+static gboolean
+hd_frame_stats_overlay_update (gpointer unused)
+{
+  GArray *paint, *interval;
+  gint64 since;
+  guint skipped, i;
+  gchar *text;
+
+  paint = g_array_new (FALSE, FALSE, sizeof (guint32));
+  interval = g_array_new (FALSE, FALSE, sizeof (guint32));
+  since = g_get_monotonic_time () - OVERLAY_WINDOW;
+  for (i = skipped = 0; i < stats.len; i++)
+    {
+      FrameRecord *frame = hd_frame_stats_nth (i);
+
+      if (frame->at < since)
+        continue;
+      g_array_append_val (paint, frame->paint);
+      if (frame->interval)
+        g_array_append_val (interval, frame->interval);
+      skipped += frame->skipped;
+    }
+
+  if (paint->len)
+    {
+      g_array_sort (paint, hd_frame_stats_cmp_time);
+      g_array_sort (interval, hd_frame_stats_cmp_time);
+      text = g_strdup_printf ("%s\n%u fps, %u skipped\n"
+                              "paint p95 %.1f ms, max %.1f ms\n"
+                              "interval p95 %.1f ms, max %.1f ms",
+                              hd_render_manager_get_state_str (),
+                              paint->len, skipped,
+                              hd_frame_stats_percentile (paint, 95),
+                              hd_frame_stats_percentile (paint, 100),
+                              hd_frame_stats_percentile (interval, 95),
+                              hd_frame_stats_percentile (interval, 100));
+    }
+  else
+    text = g_strdup_printf ("%s\nidle", hd_render_manager_get_state_str ());
+  g_array_free (paint, TRUE);
+  g_array_free (interval, TRUE);
+
+  clutter_actor_set_allow_redraw (stats.overlay, FALSE);
+  clutter_label_set_text (CLUTTER_LABEL (stats.overlay_label), text);
+  clutter_actor_set_size (stats.overlay_bg,
+             clutter_actor_get_width (stats.overlay_label)
+               + 2 * OVERLAY_MARGIN,
+             clutter_actor_get_height (stats.overlay_label)
+               + 2 * OVERLAY_MARGIN);
+  clutter_actor_raise_top (stats.overlay);
+  clutter_actor_set_allow_redraw (stats.overlay, TRUE);
+  hd_util_partial_redraw_if_possible (stats.overlay, NULL);
+  g_free (text);
+
+  return TRUE;
+}
+
+void
+hd_frame_stats_set_overlay (gboolean show)
+{
+  static const ClutterColor bg = { 0x00, 0x00, 0x00, 0xa0 };
+  static const ClutterColor fg = { 0xff, 0xff, 0xff, 0xff };
+
+  if (!show == !stats.overlay)
+    return;
+
+  if (!show)
+    {
+      hd_frame_scheduler_remove (stats.overlay_id);
+      stats.overlay_id = 0;
+      clutter_actor_destroy (stats.overlay);
+      stats.overlay = stats.overlay_bg = stats.overlay_label = NULL;
+      return;
+    }
+
+  stats.overlay = clutter_group_new ();
+  clutter_actor_set_name (stats.overlay, "frame stats overlay");
+  stats.overlay_bg = clutter_rectangle_new_with_color (&bg);
+  stats.overlay_label = clutter_label_new_full (OVERLAY_FONT, "", &fg);
+  clutter_actor_set_position (stats.overlay_label,
+                              OVERLAY_MARGIN, OVERLAY_MARGIN);
+  clutter_container_add (CLUTTER_CONTAINER (stats.overlay),
+                         stats.overlay_bg, stats.overlay_label, NULL);
+  clutter_actor_set_position (stats.overlay, 0, HD_COMP_MGR_TOP_MARGIN);
+  clutter_container_add_actor (CLUTTER_CONTAINER (clutter_stage_get_default ()),
+                               stats.overlay);
+
+  hd_frame_stats_overlay_update (NULL);
+  stats.overlay_id = hd_frame_scheduler_add (OVERLAY_INTERVAL,
+                                             hd_frame_stats_overlay_update,
+                                             NULL, NULL);
+}
+
+void
+hd_frame_stats_init (void)
+{
+  ClutterActor *stage = clutter_stage_get_default ();
+
+  stats.frame_ms = hd_transition_param_lookup ("damage", "frame_ms");
+  g_signal_connect (stage, "paint",
+                    G_CALLBACK (hd_frame_stats_paint_start), NULL);
+  g_signal_connect_after (stage, "paint",
+                          G_CALLBACK (hd_frame_stats_paint_end), NULL);
+}
+
+void
+hd_frame_stats_dump_debug_info (void)
+{
+  gchar *report, *line, *next;
+
+  report = hd_frame_stats_report ();
+  for (line = report; *line; line = next)
+    {
+      if ((next = strchr (line, '\n')) != NULL)
+        *next++ = '\0';
+      else
+        next = line + strlen (line);
+      g_debug ("frames: %s", line);
+    }
+  g_free (report);
+}
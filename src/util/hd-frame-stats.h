@@ -0,0 +1,58 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_FRAME_STATS_H__
+#define __HD_FRAME_STATS_H__
+
+#include <glib.h>
+
+/* Frame timing of the compositor.  The last few thousand frames are kept
+ * in a ring: how long the stage took to paint, how long after the
+ * previous frame it started, how much of it was damaged, how many
+ * frames ([damage] frame_ms) a queued redraw waited for it, and which
+ * render manager state we were in.  The paint time is only what it took
+ * to hand the frame to GL, the GPU and the swap show in the interval.  The report breaks them down
+ * by state.  It's available on D-Bus (GetFrameStats of HdHome) and
+ * dumped on SIGUSR1, and an overlay on the stage can show the current
+ * figures. */
+
+/* Start recording the frames of the stage. */
+void   hd_frame_stats_init (void);
+
+/* Forget the frames recorded so far. */
+void   hd_frame_stats_reset (void);
+
+/* A redraw of the stage has been queued.  If the next frame comes more
+ * than a frame after the last one, the frames it waited are skipped. */
+void   hd_frame_stats_redraw_queued (void);
+
+/* A tab separated table with a line for each state the recorded frames
+ * were painted in and one for all of them: the number of frames, the
+ * 50th, 95th and 99th percentile and the longest paint time in ms, the
+ * average damaged area in pixels, the number of skipped frames, and the
+ * 50th and 95th percentile and the longest interval between frames in
+ * ms.  Intervals are only counted for frames which were wanted right
+ * after the previous one, not after a pause. */
+gchar *hd_frame_stats_report (void);
+
+void   hd_frame_stats_set_overlay (gboolean show);
+
+void   hd_frame_stats_dump_debug_info (void);
+
+#endif
@@ -0,0 +1,599 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-pressure.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+/* The PSI trigger window, in us.  Unprivileged processes may only use
+ * multiples of 2 s. */
+#define PSI_WINDOW 2000000
+
+struct _HdPressure
+{
+  HdPressureConfig config;
+  /* Prepended to the paths, "" for the real thing. */
+  gchar           *root;
+  gboolean         real;
+
+  HdPressureSource source;
+  HdPressureLevel  level;
+  HdPressureFunc   func;
+  gpointer         user_data;
+
+  /* These are kept open and read from the start each time. */
+  gint             memory_fd, cpu_fd, loadavg_fd, events_fd, lowmem_fd;
+
+  /* cgroup: the counters of memory.events last seen and when they last
+   * went up (or the level last went down). */
+  guint64          high_events, max_events;
+  gint64           last_event;
+
+  /* lowmem: the thresholds of free pages. */
+  gdouble          lowmem_low, lowmem_high, lowmem_decay;
+
+  gint             inotify_fd;
+  guint            watch_id, recheck_id;
+  /* The source can't wake us up, so it's checked all the time. */
+  gboolean         polled;
+};
+
+void
+hd_pressure_config_init (HdPressureConfig *config)
+{
+  config->source = HD_PRESSURE_SOURCE_AUTO;
+  config->low_on = 10;
+  config->low_off = 5;
+  config->critical_on = 5;
+  config->critical_off = 2;
+  config->cpu_busy = 20;
+  config->load_max = 1.0;
+  config->cgroup_quiet = 5000;
+  config->recheck_interval = 1000;
+}
+
+static gint
+hd_pressure_open (HdPressure *pressure, const gchar *path, gint flags)
+{
+  gchar *fname = g_strconcat (pressure->root, path, NULL);
+  gint fd = open (fname, flags);
+
+  g_free (fname);
+  return fd;
+}
+
+/* Read all of @fd, which is kept open, from the start. */
+static gboolean
+hd_pressure_read (gint fd, gchar *buffer, gsize size)
+{
+  ssize_t n;
+
+  if (fd < 0)
+    return FALSE;
+
+  n = pread (fd, buffer, size - 1, 0);
+  if (n <= 0)
+    return FALSE;
+  buffer[n] = '\0';
+  return TRUE;
+}
+
+static gboolean
+hd_pressure_read_number (HdPressure *pressure, const gchar *path,
+                         gdouble *value)
+{
+  gchar buffer[32];
+  gint fd = hd_pressure_open (pressure, path, O_RDONLY);
+  gboolean ok = hd_pressure_read (fd, buffer, sizeof (buffer));
+
+  if (fd >= 0)
+    close (fd);
+  if (ok)
+    *value = g_ascii_strtod (buffer, NULL);
+  return ok;
+}
+
+/* Returns the avg10 of the @kind ("some" or "full") line of a PSI file. */
+static gdouble
+hd_pressure_parse_avg10 (const gchar *text, const gchar *kind)
+{
+  const gchar *line = text;
+
+  while (line && !g_str_has_prefix (line, kind))
+    if ((line = strchr (line, '\n')) != NULL)
+      line++;
+
+  if (line)
+    {
+      const gchar *avg = strstr (line, "avg10="), *eol = strchr (line, '\n');
+
+      if (avg && (!eol || avg < eol))
+        return g_ascii_strtod (avg + strlen ("avg10="), NULL);
+    }
+
+  return 0;
+}
+
+/* The level to be at for the @low and @critical readings.  The levels we
+ * are at already are left at their lower _off thresholds. */
+static HdPressureLevel
+hd_pressure_level_for (HdPressureLevel level,
+                       gdouble low, gdouble low_on, gdouble low_off,
+                       gdouble critical,
+                       gdouble critical_on, gdouble critical_off)
+{
+  if (critical >= (level >= HD_PRESSURE_CRITICAL ? critical_off
+                                                 : critical_on))
+    return HD_PRESSURE_CRITICAL;
+  if (low >= (level >= HD_PRESSURE_LOW ? low_off : low_on))
+    return HD_PRESSURE_LOW;
+  return HD_PRESSURE_NONE;
+}
+
+static HdPressureLevel
+hd_pressure_psi_level (HdPressure *pressure)
+{
+  HdPressureConfig *c = &pressure->config;
+  gchar buffer[256];
+
+  if (!hd_pressure_read (pressure->memory_fd, buffer, sizeof (buffer)))
+    return pressure->level;
+
+  return hd_pressure_level_for (pressure->level,
+                                hd_pressure_parse_avg10 (buffer, "some"),
+                                c->low_on, c->low_off,
+                                hd_pressure_parse_avg10 (buffer, "full"),
+                                c->critical_on, c->critical_off);
+}
+
+static gboolean
+hd_pressure_read_events (HdPressure *pressure,
+                         guint64 *high, guint64 *max)
+{
+  gchar buffer[256], **lines;
+  guint i;
+
+  if (!hd_pressure_read (pressure->events_fd, buffer, sizeof (buffer)))
+    return FALSE;
+
+  /* The max, oom and oom_kill events all mean we hit the limit. */
+  *high = *max = 0;
+  lines = g_strsplit (buffer, "\n", 0);
+  for (i = 0; lines[i]; i++)
+    {
+      gchar *value = strchr (lines[i], ' ');
+
+      if (!value)
+        continue;
+      *value++ = '\0';
+      if (!strcmp (lines[i], "high"))
+        *high = g_ascii_strtoull (value, NULL, 10);
+      else if (!strcmp (lines[i], "max") || !strcmp (lines[i], "oom")
+               || !strcmp (lines[i], "oom_kill"))
+        *max += g_ascii_strtoull (value, NULL, 10);
+    }
+  g_strfreev (lines);
+
+  return TRUE;
+}
+
+/* The counters only go up, so the level goes down one step at a time
+ * when no new events have come for cgroup_quiet ms. */
+static HdPressureLevel
+hd_pressure_cgroup_level (HdPressure *pressure)
+{
+  HdPressureLevel level = pressure->level;
+  gint64 now = g_get_monotonic_time ();
+  guint64 high, max;
+
+  if (!hd_pressure_read_events (pressure, &high, &max))
+    return level;
+
+  if (max > pressure->max_events)
+    {
+      level = HD_PRESSURE_CRITICAL;
+      pressure->last_event = now;
+    }
+  else if (high > pressure->high_events)
+    {
+      level = MAX (level, HD_PRESSURE_LOW);
+      pressure->last_event = now;
+    }
+  else if (level > HD_PRESSURE_NONE
+           && now - pressure->last_event
+                >= (gint64) pressure->config.cgroup_quiet * 1000)
+    {
+      level--;
+      pressure->last_event = now;
+    }
+
+  pressure->high_events = high;
+  pressure->max_events = max;
+  return level;
+}
+
+static HdPressureLevel
+hd_pressure_lowmem_level (HdPressure *pressure)
+{
+  gchar buffer[32];
+  gdouble shortage;
+
+  if (!hd_pressure_read (pressure->lowmem_fd, buffer, sizeof (buffer)))
+    return pressure->level;
+
+  /* The thresholds are of free pages, bgkill at notify_low and lowmem at
+   * the lower notify_high; the hysteresis is nr_decay_pages, as in the
+   * module itself.  Less free is more pressure. */
+  shortage = -g_ascii_strtod (buffer, NULL);
+  return hd_pressure_level_for (pressure->level,
+                      shortage, -pressure->lowmem_low,
+                      -(pressure->lowmem_low + pressure->lowmem_decay),
+                      shortage, -pressure->lowmem_high,
+                      -(pressure->lowmem_high + pressure->lowmem_decay));
+}
+
+static gboolean
+hd_pressure_recheck (gpointer data)
+{
+  HdPressure *pressure = data;
+
+  hd_pressure_check (pressure);
+  if (pressure->level != HD_PRESSURE_NONE || pressure->polled)
+    return TRUE;
+
+  pressure->recheck_id = 0;
+  return FALSE;
+}
+
+static void
+hd_pressure_set_level (HdPressure *pressure, HdPressureLevel level)
+{
+  gboolean changed = level != pressure->level;
+
+  pressure->level = level;
+
+  /* Only poll while there's pressure, to see it go away. */
+  if ((level != HD_PRESSURE_NONE || pressure->polled)
+      && !pressure->recheck_id)
+    pressure->recheck_id = g_timeout_add (pressure->config.recheck_interval,
+                                          hd_pressure_recheck, pressure);
+
+  if (changed)
+    {
+      g_debug ("%s: memory pressure level %d (%s)", __FUNCTION__, level,
+               hd_pressure_source_name (pressure->source));
+      if (pressure->func)
+        pressure->func (pressure, level, pressure->user_data);
+    }
+}
+
+void
+hd_pressure_check (HdPressure *pressure)
+{
+  HdPressureLevel level = pressure->level;
+
+  switch (pressure->source)
+    {
+    case HD_PRESSURE_SOURCE_PSI:
+      level = hd_pressure_psi_level (pressure);
+      break;
+    case HD_PRESSURE_SOURCE_CGROUP:
+      level = hd_pressure_cgroup_level (pressure);
+      break;
+    case HD_PRESSURE_SOURCE_LOWMEM:
+      level = hd_pressure_lowmem_level (pressure);
+      break;
+    default:
+      break;
+    }
+
+  hd_pressure_set_level (pressure, level);
+}
+
+static gboolean
+hd_pressure_psi_event (GIOChannel *channel, GIOCondition condition,
+                       gpointer data)
+{
+  HdPressure *pressure = data;
+
+  if (condition & G_IO_ERR)
+    {
+      /* The trigger is gone, so fall back to polling. */
+      g_warning ("%s: PSI trigger failed", __FUNCTION__);
+      pressure->watch_id = 0;
+      pressure->polled = TRUE;
+      hd_pressure_check (pressure);
+      return FALSE;
+    }
+
+  hd_pressure_check (pressure);
+  return TRUE;
+}
+
+static gboolean
+hd_pressure_inotify_event (GIOChannel *channel, GIOCondition condition,
+                           gpointer data)
+{
+  HdPressure *pressure = data;
+  gchar buffer[256];
+
+  while (read (pressure->inotify_fd, buffer, sizeof (buffer)) > 0)
+    ;
+
+  hd_pressure_check (pressure);
+  return TRUE;
+}
+
+static void
+hd_pressure_watch (HdPressure *pressure, gint fd, GIOCondition condition,
+                   GIOFunc func)
+{
+  GIOChannel *channel = g_io_channel_unix_new (fd);
+
+  pressure->watch_id = g_io_add_watch (channel, condition, func, pressure);
+  g_io_channel_unref (channel);
+}
+
+static gboolean
+hd_pressure_setup_psi (HdPressure *pressure)
+{
+  HdPressureConfig *c = &pressure->config;
+  gchar trigger[64];
+  guint stall;
+
+  if (pressure->real)
+    pressure->memory_fd = hd_pressure_open (pressure,
+                                            "/proc/pressure/memory",
+                                            O_RDWR | O_NONBLOCK);
+  if (pressure->memory_fd < 0)
+    pressure->memory_fd = hd_pressure_open (pressure,
+                                            "/proc/pressure/memory",
+                                            O_RDONLY);
+  if (pressure->memory_fd < 0)
+    return FALSE;
+
+  if (!pressure->real)
+    return TRUE;
+
+  /* full stalls are some stalls too, so this fires for either level. */
+  stall = (guint) (MIN (c->low_on, c->critical_on) * PSI_WINDOW / 100);
+  stall = CLAMP (stall, 1, PSI_WINDOW);
+  g_snprintf (trigger, sizeof (trigger), "some %u %u", stall, PSI_WINDOW);
+  if (write (pressure->memory_fd, trigger, strlen (trigger) + 1) < 0)
+    {
+      g_debug ("%s: can't set a PSI trigger (%s), polling instead",
+               __FUNCTION__, strerror (errno));
+      pressure->polled = TRUE;
+      return TRUE;
+    }
+
+  hd_pressure_watch (pressure, pressure->memory_fd, G_IO_PRI | G_IO_ERR,
+                     hd_pressure_psi_event);
+  return TRUE;
+}
+
+static gboolean
+hd_pressure_setup_cgroup (HdPressure *pressure)
+{
+  gchar *fname, *contents, **lines, *events = NULL;
+  guint i;
+
+  /* With cgroup v2 there's just the "0::/path" line. */
+  fname = g_strconcat (pressure->root, "/proc/self/cgroup", NULL);
+  if (!g_file_get_contents (fname, &contents, NULL, NULL))
+    {
+      g_free (fname);
+      return FALSE;
+    }
+  g_free (fname);
+
+  lines = g_strsplit (contents, "\n", 0);
+  for (i = 0; lines[i] && !events; i++)
+    if (g_str_has_prefix (lines[i], "0::"))
+      events = g_strconcat ("/sys/fs/cgroup", lines[i] + 3,
+                            "/memory.events", NULL);
+  g_strfreev (lines);
+  g_free (contents);
+  if (!events)
+    return FALSE;
+
+  pressure->events_fd = hd_pressure_open (pressure, events, O_RDONLY);
+  if (pressure->events_fd < 0
+      || !hd_pressure_read_events (pressure, &pressure->high_events,
+                                   &pressure->max_events))
+    {
+      g_free (events);
+      return FALSE;
+    }
+
+  if (pressure->real)
+    {
+      /* The kernel notifies changes of memory.events as modifications. */
+      pressure->inotify_fd = inotify_init1 (IN_NONBLOCK);
+      if (pressure->inotify_fd >= 0
+          && inotify_add_watch (pressure->inotify_fd, events, IN_MODIFY) >= 0)
+        hd_pressure_watch (pressure, pressure->inotify_fd, G_IO_IN,
+                           hd_pressure_inotify_event);
+      else
+        pressure->polled = TRUE;
+    }
+
+  g_free (events);
+  return TRUE;
+}
+
+static gboolean
+hd_pressure_setup_lowmem (HdPressure *pressure)
+{
+  if (!hd_pressure_read_number (pressure,
+                                "/proc/sys/vm/lowmem_notify_low_pages",
+                                &pressure->lowmem_low)
+      || !hd_pressure_read_number (pressure,
+                                   "/proc/sys/vm/lowmem_notify_high_pages",
+                                   &pressure->lowmem_high)
+      || !hd_pressure_read_number (pressure,
+                                   "/proc/sys/vm/lowmem_nr_decay_pages",
+                                   &pressure->lowmem_decay))
+    return FALSE;
+
+  /* Checked when the lowmem signals come. */
+  pressure->lowmem_fd = hd_pressure_open (pressure,
+                                          "/proc/sys/vm/lowmem_free_pages",
+                                          O_RDONLY);
+  return pressure->lowmem_fd >= 0;
+}
+
+HdPressure *
+hd_pressure_new (const gchar *root, const HdPressureConfig *config,
+                 HdPressureFunc func, gpointer user_data)
+{
+  HdPressure *pressure;
+  HdPressureSource source;
+
+  pressure = g_new0 (HdPressure, 1);
+  if (config)
+    pressure->config = *config;
+  else
+    hd_pressure_config_init (&pressure->config);
+  pressure->root = g_strdup (root ? root : "");
+  pressure->real = !root || !*root || !strcmp (root, "/");
+  pressure->func = func;
+  pressure->user_data = user_data;
+  pressure->memory_fd = pressure->events_fd = pressure->lowmem_fd = -1;
+  pressure->inotify_fd = -1;
+  pressure->last_event = g_get_monotonic_time ();
+
+  pressure->cpu_fd = hd_pressure_open (pressure, "/proc/pressure/cpu",
+                                       O_RDONLY);
+  pressure->loadavg_fd = hd_pressure_open (pressure, "/proc/loadavg",
+                                           O_RDONLY);
+
+  source = pressure->config.source;
+  if ((source == HD_PRESSURE_SOURCE_AUTO || source == HD_PRESSURE_SOURCE_PSI)
+      && hd_pressure_setup_psi (pressure))
+    pressure->source = HD_PRESSURE_SOURCE_PSI;
+  else if ((source == HD_PRESSURE_SOURCE_AUTO
+            || source == HD_PRESSURE_SOURCE_CGROUP)
+           && hd_pressure_setup_cgroup (pressure))
+    pressure->source = HD_PRESSURE_SOURCE_CGROUP;
+  else if ((source == HD_PRESSURE_SOURCE_AUTO
+            || source == HD_PRESSURE_SOURCE_LOWMEM)
+           && hd_pressure_setup_lowmem (pressure))
+    pressure->source = HD_PRESSURE_SOURCE_LOWMEM;
+  else
+    pressure->source = HD_PRESSURE_SOURCE_NONE;
+
+  g_debug ("%s: using %s%s", __FUNCTION__,
+           hd_pressure_source_name (pressure->source),
+           pressure->polled ? ", polled" : "");
+
+  hd_pressure_check (pressure);
+  return pressure;
+}
+
+void
+hd_pressure_free (HdPressure *pressure)
+{
+  if (!pressure)
+    return;
+
+  if (pressure->watch_id)
+    g_source_remove (pressure->watch_id);
+  if (pressure->recheck_id)
+    g_source_remove (pressure->recheck_id);
+  if (pressure->memory_fd >= 0)
+    close (pressure->memory_fd);
+  if (pressure->cpu_fd >= 0)
+    close (pressure->cpu_fd);
+  if (pressure->loadavg_fd >= 0)
+    close (pressure->loadavg_fd);
+  if (pressure->events_fd >= 0)
+    close (pressure->events_fd);
+  if (pressure->lowmem_fd >= 0)
+    close (pressure->lowmem_fd);
+  if (pressure->inotify_fd >= 0)
+    close (pressure->inotify_fd);
+  g_free (pressure->root);
+  g_free (pressure);
+}
+
+HdPressureSource
+hd_pressure_get_source (HdPressure *pressure)
+{
+  return pressure->source;
+}
+
+const gchar *
+hd_pressure_source_name (HdPressureSource source)
+{
+  switch (source)
+    {
+    case HD_PRESSURE_SOURCE_AUTO:
+      return "auto";
+    case HD_PRESSURE_SOURCE_PSI:
+      return "psi";
+    case HD_PRESSURE_SOURCE_CGROUP:
+      return "cgroup";
+    case HD_PRESSURE_SOURCE_LOWMEM:
+      return "lowmem";
+    default:
+      return "none";
+    }
+}
+
+HdPressureLevel
+hd_pressure_get_level (HdPressure *pressure)
+{
+  return pressure->level;
+}
+
+gboolean
+hd_pressure_cpu_is_busy (HdPressure *pressure)
+{
+  gchar buffer[256];
+  gdouble load;
+
+  if (hd_pressure_read (pressure->cpu_fd, buffer, sizeof (buffer)))
+    return hd_pressure_parse_avg10 (buffer, "some")
+             >= pressure->config.cpu_busy;
+
+  /* Busy if we don't know. */
+  load = hd_pressure_get_load_average (pressure);
+  return load < 0 || load > pressure->config.load_max;
+}
+
+gdouble
+hd_pressure_get_load_average (HdPressure *pressure)
+{
+  gchar buffer[64];
+
+  if (!hd_pressure_read (pressure->loadavg_fd, buffer, sizeof (buffer)))
+    return -1.0;
+
+  return g_ascii_strtod (buffer, NULL);
+}
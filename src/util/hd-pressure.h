@@ -0,0 +1,105 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_PRESSURE_H__
+#define __HD_PRESSURE_H__
+
+#include <glib.h>
+
+/* An HdPressure tells how short of memory the system is, from whichever
+ * the kernel has of
+ *   - PSI, /proc/pressure/memory: armed with a trigger, so the kernel
+ *     wakes us up when stalls go above the threshold,
+ *   - cgroup v2, memory.events of our cgroup: its high and max counters,
+ *     watched with inotify,
+ *   - Maemo's lowmem module, /proc/sys/vm/lowmem_*: read when asked to,
+ *     since its lowmem_on and bgkill_on D-Bus signals are the events.
+ * The level has hysteresis: it is entered at a higher pressure than it is
+ * left at, and while it is raised the source is checked again every
+ * recheck_interval to see it go down.  At the NONE level nothing polls. */
+
+typedef enum
+{
+  HD_PRESSURE_NONE,
+  /* Running low: hibernate background apps, like bgkill_on. */
+  HD_PRESSURE_LOW,
+  /* Out of memory: don't start anything, like lowmem_on. */
+  HD_PRESSURE_CRITICAL
+} HdPressureLevel;
+
+typedef enum
+{
+  HD_PRESSURE_SOURCE_AUTO,
+  HD_PRESSURE_SOURCE_PSI,
+  HD_PRESSURE_SOURCE_CGROUP,
+  HD_PRESSURE_SOURCE_LOWMEM,
+  /* None found, the level stays NONE. */
+  HD_PRESSURE_SOURCE_NONE
+} HdPressureSource;
+
+typedef struct
+{
+  /* Which source to use, AUTO tries them in the order above. */
+  HdPressureSource source;
+  /* PSI: avg10 percentages of some (for LOW) and full (for CRITICAL)
+   * memory stalls at which a level is entered and left. */
+  gdouble low_on, low_off;
+  gdouble critical_on, critical_off;
+  /* PSI: avg10 percentage of some cpu stall above which the system is too
+   * busy for prestarting.  Without PSI, the load average is compared with
+   * load_max instead. */
+  gdouble cpu_busy;
+  gdouble load_max;
+  /* cgroup: a level is left after this many ms without new events. */
+  guint cgroup_quiet;
+  /* ms between checks while the level is raised. */
+  guint recheck_interval;
+} HdPressureConfig;
+
+typedef struct _HdPressure HdPressure;
+
+typedef void (*HdPressureFunc) (HdPressure *pressure,
+                                HdPressureLevel level,
+                                gpointer user_data);
+
+void             hd_pressure_config_init (HdPressureConfig *config);
+
+/* Start watching the pressure, calling @func when the level changes.
+ * @root is where /proc and /sys are looked up, NULL for /.  Files under
+ * another root are only read, when hd_pressure_check() is called. */
+HdPressure      *hd_pressure_new        (const gchar *root,
+                                         const HdPressureConfig *config,
+                                         HdPressureFunc func,
+                                         gpointer user_data);
+void             hd_pressure_free       (HdPressure *pressure);
+
+HdPressureSource hd_pressure_get_source (HdPressure *pressure);
+const gchar     *hd_pressure_source_name (HdPressureSource source);
+HdPressureLevel  hd_pressure_get_level  (HdPressure *pressure);
+
+/* Read the source now and update the level. */
+void             hd_pressure_check      (HdPressure *pressure);
+
+/* Whether the cpu is too busy to do things in the background. */
+gboolean         hd_pressure_cpu_is_busy (HdPressure *pressure);
+
+/* The 1 minute load average, or a negative value if it's not known. */
+gdouble          hd_pressure_get_load_average (HdPressure *pressure);
+
+#endif /* __HD_PRESSURE_H__ */
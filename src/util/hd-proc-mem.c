@@ -0,0 +1,220 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-proc-mem.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* An app idle for this many seconds scores twice as much... */
+#define IDLE_SCALE 300
+/* ...up to this many times as much. */
+#define IDLE_MAX   4.0
+
+/* Returns the value of the "@key: <n> kB" line of @text, or -1. */
+static gint64
+hd_proc_mem_parse_kb (const gchar *text, const gchar *key)
+{
+  gsize len = strlen (key);
+  const gchar *line = text;
+
+  while (line)
+    {
+      if (!strncmp (line, key, len) && line[len] == ':')
+        return g_ascii_strtoull (line + len + 1, NULL, 10);
+      if ((line = strchr (line, '\n')) != NULL)
+        line++;
+    }
+
+  return -1;
+}
+
+static gchar *
+hd_proc_mem_read_file (const gchar *root, const gchar *path)
+{
+  gchar *fname = g_strconcat (root ? root : "", path, NULL);
+  gchar *contents = NULL;
+
+  g_file_get_contents (fname, &contents, NULL, NULL);
+  g_free (fname);
+  return contents;
+}
+
+gboolean
+hd_proc_mem_read (const gchar *root, GPid pid, HdProcMem *mem)
+{
+  gchar *path, *text;
+  gint64 pss, rss, swap;
+
+  memset (mem, 0, sizeof (*mem));
+  if (pid <= 0)
+    return FALSE;
+
+  path = g_strdup_printf ("/proc/%d/smaps_rollup", pid);
+  text = hd_proc_mem_read_file (root, path);
+  g_free (path);
+  if (text)
+    {
+      rss = hd_proc_mem_parse_kb (text, "Rss");
+      pss = hd_proc_mem_parse_kb (text, "Pss");
+      /* The share of the swap, like the PSS, if the kernel tells it. */
+      if ((swap = hd_proc_mem_parse_kb (text, "SwapPss")) < 0)
+        swap = hd_proc_mem_parse_kb (text, "Swap");
+    }
+  else
+    {
+      path = g_strdup_printf ("/proc/%d/status", pid);
+      text = hd_proc_mem_read_file (root, path);
+      g_free (path);
+      if (!text)
+        return FALSE;
+
+      pss = rss = hd_proc_mem_parse_kb (text, "VmRSS");
+      swap = hd_proc_mem_parse_kb (text, "VmSwap");
+    }
+  g_free (text);
+
+  if (rss < 0)
+    return FALSE;
+
+  mem->rss = rss;
+  mem->pss = pss >= 0 ? pss : rss;
+  mem->swap = MAX (swap, 0);
+  return TRUE;
+}
+
+guint64
+hd_proc_mem_freed (const HdProcMemCandidate *candidate)
+{
+  /* Freeing swap helps less than freeing RAM. */
+  return candidate->mem.pss + candidate->mem.swap / 2;
+}
+
+static gint
+hd_proc_mem_compare_score (gconstpointer a, gconstpointer b)
+{
+  const HdProcMemCandidate *ca = a, *cb = b;
+
+  if (ca->score != cb->score)
+    return ca->score > cb->score ? -1 : 1;
+  /* Like when their memory isn't known. */
+  if (ca->idle != cb->idle)
+    return ca->idle > cb->idle ? -1 : 1;
+  return 0;
+}
+
+static gint
+hd_proc_mem_compare_freed (gconstpointer a, gconstpointer b)
+{
+  guint64 fa = hd_proc_mem_freed (*(HdProcMemCandidate * const *) a);
+  guint64 fb = hd_proc_mem_freed (*(HdProcMemCandidate * const *) b);
+
+  if (fa != fb)
+    return fa > fb ? -1 : 1;
+  return 0;
+}
+
+guint
+hd_proc_mem_choose_victims (HdProcMemCandidate *candidates,
+                            guint n_candidates,
+                            guint64 need)
+{
+  HdProcMemCandidate **by_freed, *sorted;
+  gboolean *chosen;
+  guint i, j, k, n_victims;
+  guint64 sum, left;
+
+  for (i = 0; i < n_candidates; i++)
+    {
+      HdProcMemCandidate *c = &candidates[i];
+      gdouble idle = 1.0 + (gdouble) MAX (c->idle, 0) / IDLE_SCALE;
+
+      c->score = hd_proc_mem_freed (c) * MIN (idle, IDLE_MAX)
+        / MAX (c->cost, 1.0);
+    }
+  qsort (candidates, n_candidates, sizeof (*candidates),
+         hd_proc_mem_compare_score);
+
+  if (!n_candidates || !need)
+    return MIN (n_candidates, 1);
+
+  /* The fewest victims are the k which free the most. */
+  by_freed = g_new (HdProcMemCandidate *, n_candidates);
+  for (i = 0; i < n_candidates; i++)
+    by_freed[i] = &candidates[i];
+  qsort (by_freed, n_candidates, sizeof (*by_freed),
+         hd_proc_mem_compare_freed);
+  for (k = 0, sum = 0; k < n_candidates && sum < need; k++)
+    sum += hd_proc_mem_freed (by_freed[k]);
+  /* Their memory may not be known, or they can't free it all anyway:
+   * take the best scored one and let the next round look again, rather
+   * than hibernating everything at once. */
+  if (sum < need)
+    {
+      g_free (by_freed);
+      return 1;
+    }
+
+  /* Of the sets of k, take the best scored candidate as long as the
+   * others can still make up for what's left. */
+  sorted = g_new (HdProcMemCandidate, n_candidates);
+  chosen = g_new0 (gboolean, n_candidates);
+  n_victims = 0;
+  left = need;
+  while (n_victims < k && left > 0)
+    {
+      for (i = 0; i < n_candidates; i++)
+        {
+          guint64 freed = hd_proc_mem_freed (&candidates[i]);
+          guint slots = k - n_victims - 1;
+
+          if (chosen[i])
+            continue;
+
+          for (j = 0, sum = freed; j < n_candidates && slots > 0; j++)
+            if (by_freed[j] != &candidates[i]
+                && !chosen[by_freed[j] - candidates])
+              {
+                sum += hd_proc_mem_freed (by_freed[j]);
+                slots--;
+              }
+          if (sum >= left)
+            break;
+        }
+      g_assert (i < n_candidates);
+
+      chosen[i] = TRUE;
+      sorted[n_victims++] = candidates[i];
+      left -= MIN (left, hd_proc_mem_freed (&candidates[i]));
+    }
+
+  for (i = 0, j = n_victims; i < n_candidates; i++)
+    if (!chosen[i])
+      sorted[j++] = candidates[i];
+  memcpy (candidates, sorted, n_candidates * sizeof (*candidates));
+
+  g_free (chosen);
+  g_free (sorted);
+  g_free (by_freed);
+  return n_victims;
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_PROC_MEM_H__
+#define __HD_PROC_MEM_H__
+
+#include <glib.h>
+
+/* How much memory processes hold, and which of them to hibernate when
+ * memory runs low.  The reading functions don't touch any global state,
+ * so they can be called from a thread. */
+
+/* All in kB. */
+typedef struct
+{
+  guint64 pss, rss, swap;
+} HdProcMem;
+
+/* Read the memory of @pid from /proc/<pid>/smaps_rollup, or from
+ * /proc/<pid>/status on kernels without it, where PSS is taken to be the
+ * RSS.  @root is prepended to the paths, NULL for /. */
+gboolean hd_proc_mem_read           (const gchar *root, GPid pid,
+                                     HdProcMem *mem);
+
+typedef struct
+{
+  gpointer  data;
+  HdProcMem mem;
+  /* Since the app was last on top, in seconds. */
+  gint64    idle;
+  /* How much it costs to hibernate and wake it up again, 1 and up. */
+  gdouble   cost;
+  /* Set by hd_proc_mem_choose_victims(). */
+  gdouble   score;
+} HdProcMemCandidate;
+
+/* How much would be freed by hibernating @candidate, in kB. */
+guint64  hd_proc_mem_freed          (const HdProcMemCandidate *candidate);
+
+/* Score the @n_candidates and reorder them so the victims come first.
+ * Returns how many there are: the fewest which together free @need kB,
+ * the best scored of those, or the best scored one if @need is 0.
+ * If all of them can't free @need, only the best scored one is. */
+guint    hd_proc_mem_choose_victims (HdProcMemCandidate *candidates,
+                                     guint n_candidates,
+                                     guint64 need);
+
+#endif /* __HD_PROC_MEM_H__ */
@@ -0,0 +1,128 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-startup.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <clutter/clutter.h>
+
+#define MAX_PHASES 32
+
+typedef struct
+{
+  const gchar *name;
+  gint64       at;
+} Phase;
+
+static Phase phases[MAX_PHASES];
+static guint n_phases;
+static gulong first_frame_id;
+
+void
+hd_startup_mark (const gchar *phase)
+{
+  if (n_phases >= MAX_PHASES)
+    return;
+
+  phases[n_phases].name = phase;
+  phases[n_phases].at = g_get_monotonic_time ();
+  n_phases++;
+}
+
+/* Print the summary to @f, or log it if it's NULL. */
+static void
+hd_startup_print (FILE *f)
+{
+  guint i;
+
+  for (i = 0; i < n_phases; i++)
+    {
+      gint64 since_start, took;
+
+      since_start = phases[i].at - phases[0].at;
+      took = i > 0 ? phases[i].at - phases[i-1].at : 0;
+      if (f)
+        fprintf (f, "%s\t%.1f\t%.1f\n", phases[i].name,
+                 since_start / 1000.0, took / 1000.0);
+      else
+        g_debug ("startup: %-16s at %8.1f ms, took %8.1f ms",
+                 phases[i].name, since_start / 1000.0, took / 1000.0);
+    }
+}
+
+static gboolean
+hd_startup_interactive (gpointer unused)
+{
+  const gchar *fname;
+
+  hd_startup_mark ("interactive");
+  hd_startup_print (NULL);
+
+  if ((fname = g_getenv ("HD_STARTUP_LOG")) != NULL)
+    {
+      gchar *tmp;
+      FILE *f;
+
+      /* Write it in one go for those waiting for the file to appear. */
+      tmp = g_strconcat (fname, ".tmp", NULL);
+      if ((f = fopen (tmp, "w")) != NULL)
+        {
+          hd_startup_print (f);
+          if (fclose (f) == 0)
+            rename (tmp, fname);
+        }
+      else
+        g_warning ("%s: %s", tmp, g_strerror (errno));
+      g_free (tmp);
+    }
+
+  return FALSE;
+}
+
+static void
+hd_startup_first_frame (ClutterActor *stage)
+{
+  g_signal_handler_disconnect (stage, first_frame_id);
+  first_frame_id = 0;
+  hd_startup_mark ("first frame");
+
+  /* When nothing else is left to do. */
+  g_idle_add_full (G_PRIORITY_LOW, hd_startup_interactive, NULL, NULL);
+}
+
+void
+hd_startup_run (void)
+{
+  hd_startup_mark ("main loop");
+  first_frame_id = g_signal_connect_after (clutter_stage_get_default (),
+                                           "paint",
+                                           G_CALLBACK (hd_startup_first_frame),
+                                           NULL);
+}
+
+void
+hd_startup_dump_debug_info (void)
+{
+  hd_startup_print (NULL);
+}
@@ -0,0 +1,40 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_STARTUP_H__
+#define __HD_STARTUP_H__
+
+#include <glib.h>
+
+/* Start-up phase tracing.  main() marks the end of each phase with
+ * hd_startup_mark(); the times are kept with the monotonic clock,
+ * relative to the first mark.  hd_startup_run() adds the "first frame"
+ * (the stage has been painted) and "interactive" (the main loop has
+ * gone idle after that) marks.  Then the summary is logged, and it's
+ * written to $HD_STARTUP_LOG too if it's set.  It's also dumped on
+ * SIGUSR1 with the rest of the debug info. */
+
+void hd_startup_mark (const gchar *phase);
+
+/* Call just before entering the main loop. */
+void hd_startup_run (void);
+
+void hd_startup_dump_debug_info (void);
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "hd-transition-params.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+typedef struct
+{
+  gchar          *string;
+  gint            int_value;
+  gdouble         double_value;
+  gboolean        is_int:1;
+  gboolean        is_double:1;
+  HdKeyFrameList *keyframes;
+} Param;
+
+struct _HdTransitionParams
+{
+  /* group -> (key -> Param) */
+  GHashTable *groups;
+};
+
+static void
+param_free (Param *param)
+{
+  hd_key_frame_list_free (param->keyframes);
+  g_free (param->string);
+  g_free (param);
+}
+
+/* Parse @value like g_key_file_get_integer() and _get_double() do. */
+static void
+param_parse (Param *param, const gchar *value)
+{
+  gchar *end;
+  glong l;
+
+  errno = 0;
+  l = strtol (value, &end, 10);
+  if (*value && (!*end || g_ascii_isspace (*end))
+      && errno != ERANGE && l == (gint) l)
+    {
+      param->int_value = l;
+      param->is_int = TRUE;
+    }
+
+  param->double_value = g_ascii_strtod (value, &end);
+  param->is_double = end != value && !*end;
+}
+
+HdTransitionParams *
+hd_transition_params_new (GKeyFile *ini)
+{
+  HdTransitionParams *params = g_new (HdTransitionParams, 1);
+  gchar **groups, **keys;
+  guint i, j;
+
+  params->groups = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify) g_hash_table_destroy);
+
+  groups = g_key_file_get_groups (ini, NULL);
+  for (i = 0; groups[i]; i++)
+    {
+      GHashTable *group;
+
+      if (!(keys = g_key_file_get_keys (ini, groups[i], NULL, NULL)))
+        continue;
+
+      group = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                     (GDestroyNotify) param_free);
+      for (j = 0; keys[j]; j++)
+        {
+          Param *param = g_new0 (Param, 1);
+          gchar *value;
+
+          value = g_key_file_get_value (ini, groups[i], keys[j], NULL);
+          if (value)
+            param_parse (param, value);
+          g_free (value);
+          param->string = g_key_file_get_string (ini, groups[i], keys[j],
+                                                 NULL);
+
+          g_hash_table_replace (group, g_strdup (keys[j]), param);
+        }
+      g_strfreev (keys);
+
+      g_hash_table_replace (params->groups, g_strdup (groups[i]), group);
+    }
+  g_strfreev (groups);
+
+  return params;
+}
+
+void
+hd_transition_params_free (HdTransitionParams *params)
+{
+  if (params)
+    {
+      g_hash_table_destroy (params->groups);
+      g_free (params);
+    }
+}
+
+static Param *
+hd_transition_params_lookup (HdTransitionParams *params,
+                             const gchar *group, const gchar *key)
+{
+  GHashTable *keys = g_hash_table_lookup (params->groups, group);
+
+  return keys ? g_hash_table_lookup (keys, key) : NULL;
+}
+
+gboolean
+hd_transition_params_get_int (HdTransitionParams *params,
+                              const gchar *group, const gchar *key,
+                              gint *value)
+{
+  Param *param = hd_transition_params_lookup (params, group, key);
+
+  if (!param || !param->is_int)
+    return FALSE;
+  *value = param->int_value;
+  return TRUE;
+}
+
+gboolean
+hd_transition_params_get_double (HdTransitionParams *params,
+                                 const gchar *group, const gchar *key,
+                                 gdouble *value)
+{
+  Param *param = hd_transition_params_lookup (params, group, key);
+
+  if (!param || !param->is_double)
+    return FALSE;
+  *value = param->double_value;
+  return TRUE;
+}
+
+const gchar *
+hd_transition_params_get_string (HdTransitionParams *params,
+                                 const gchar *group, const gchar *key)
+{
+  Param *param = hd_transition_params_lookup (params, group, key);
+
+  return param ? param->string : NULL;
+}
+
+HdKeyFrameList *
+hd_transition_params_get_keyframes (HdTransitionParams *params,
+                                    const gchar *group, const gchar *key)
+{
+  Param *param = hd_transition_params_lookup (params, group, key);
+
+  if (!param || !param->string)
+    return NULL;
+  if (!param->keyframes)
+    param->keyframes = hd_key_frame_list_create (param->string);
+  return hd_key_frame_list_ref (param->keyframes);
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_TRANSITION_PARAMS_H__
+#define __HD_TRANSITION_PARAMS_H__
+
+#include <glib.h>
+
+#include "hd-curve.h"
+
+/* The values of transitions.ini, parsed once when it's loaded, so looking
+ * one up doesn't parse strings or allocate GErrors for the missing ones.
+ * Each value is parsed as an int, a double and a string up front, and as
+ * keyframes the first time it's asked for as such. */
+
+typedef struct _HdTransitionParams HdTransitionParams;
+
+HdTransitionParams *hd_transition_params_new  (GKeyFile *ini);
+void                hd_transition_params_free (HdTransitionParams *params);
+
+/* These return FALSE or NULL if the key is missing or isn't of the type,
+ * like g_key_file_get_*() would fail. */
+gboolean     hd_transition_params_get_int       (HdTransitionParams *params,
+                                                 const gchar *group,
+                                                 const gchar *key,
+                                                 gint *value);
+gboolean     hd_transition_params_get_double    (HdTransitionParams *params,
+                                                 const gchar *group,
+                                                 const gchar *key,
+                                                 gdouble *value);
+/* Owned by @params. */
+const gchar *hd_transition_params_get_string    (HdTransitionParams *params,
+                                                 const gchar *group,
+                                                 const gchar *key);
+/* A new reference, to be released with hd_key_frame_list_free(). */
+HdKeyFrameList *
+             hd_transition_params_get_keyframes (HdTransitionParams *params,
+                                                 const gchar *group,
+                                                 const gchar *key);
+
+#endif /* __HD_TRANSITION_PARAMS_H__ */
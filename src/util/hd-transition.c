@@ -47,16 +47,31 @@
 #include "hd-app.h"
 #include "hd-volume-profile.h"
 #include "hd-util.h"
+#include "hd-transition-params.h"
+#include "hd-frame-scheduler.h"
+#include "hd-frame-stats.h"
 #include "hd-dbus.h"
 
 /* The master of puppets */
 #define TRANSITIONS_INI             "/usr/share/hildon-desktop/transitions.ini"
 #define TRANSITIONS_INI_FROM_THEME  "/etc/hildon/theme/transitions.ini"
 
-typedef struct _HDEffectData
+typedef struct _HDEffectData HDEffectData;
+
+/* Sets the effect's actors as they are at @progress, 0..1. */
+typedef void (*HDEffectFrameFunc) (HDEffectData *data, float progress);
+
+struct _HDEffectData
 {
   MBWMCompMgrClientEvent   event;
-  ClutterTimeline          *timeline;
+  /* Run by the frame scheduler for @duration ms from @start (us). */
+  HDEffectFrameFunc         new_frame;
+  guint                     frame_id;
+  gint64                    start;
+  gint                      duration;
+  /* Called with @finished_data when the effect is completed. */
+  GSourceFunc               finished;
+  gpointer                  finished_data;
   MBWMCompMgrClutterClient *cclient;
   ClutterActor             *cclient_actor;
   /* In subview transitions, this is the ORIGINAL (non-subview) view */
@@ -74,24 +89,7 @@ typedef struct _HDEffectData
   /* In Fade effects, final_alpha specifies the alpha value when the
    * window/note if fully faded in. */
   float                     final_alpha;
-} HDEffectData;
-
-/* %HPTimer %GSource state. */
-typedef struct
-{
-  /*
-   * @id:         the %GSource id of the source
-   * @last:       the last time the source was evaluated
-   * @remaining:  at the last evaluation of the source how many
-   *              milisecons were until @expiry
-   * @expiry:     the expiration time in miliseconds this %HPTimer
-   *              was created with
-   */
-  GSource parent;
-  guint id;
-  GTimeVal last;
-  unsigned remaining, expiry;
-} HPTimer;
+};
 
 /* Describes the state of hd_transition_rotating_fsm(). */
 static struct
@@ -161,7 +159,7 @@ static struct
   /* In the WAITING state we have a timer that calls us back a few ms
    * after the last damage event. This is the id, as we need to restart
    * it whenever we get another damage event. */
-  HPTimer *timeout_id;
+  guint timeout_id;
 
   /* This timer counts from when we first entered the WAITING state,
    * so if we are continually getting damage we don't just hang there. */
@@ -186,118 +184,34 @@ static guint Transitions_running;
  * and we can watch it. */
 static gboolean transitions_ini_is_dirty;
 
-/* ------------------------------------------------------------------------- */
-/* ------------------------------------------------------------------------- */
-/* ------------------------------------------------------------------------- */
-
-/* Seeing the time elapsed since @hptimer's @last evaluation update
- * the @remaining number of miliseconds until expiry. */
-static void
-hptimer_calc_remaining(HPTimer *hptimer)
-{
-  guint diff;
-  GTimeVal now;
-
-  /* Don't use g_source_get_current_time()s cached clock,
-   * it may be inaccurate by now. */
-  g_get_current_time (&now);
-
-  /* Yes we don't handle time going back. */
-  diff = (now.tv_sec - hptimer->last.tv_sec) * 1000;
-  if (now.tv_usec < hptimer->last.tv_usec)
-    {
-      diff -= 1000;
-      diff += ((1000000 - hptimer->last.tv_usec) + now.tv_usec) / 1000;
-    } else
-      diff += (now.tv_usec - hptimer->last.tv_usec) / 1000;
-
-  if (hptimer->remaining > diff)
-    hptimer->remaining -= diff;
-  else
-    hptimer->remaining  = 0;
-
-  hptimer->last = now;
-}
-
-static gboolean
-hptimer_source_prepare(GSource *src, gint *timeout)
-{
-  HPTimer *hptimer = (HPTimer *)src;
+/* Incremented every time transitions.ini is (re)loaded. */
+static guint transitions_ini_generation;
 
-  hptimer_calc_remaining (hptimer);
-  return (*timeout = hptimer->remaining) == 0;
-}
-
-static gboolean
-hptimer_source_check(GSource *src)
-{
-  HPTimer *hptimer = (HPTimer *)src;
-
-  hptimer_calc_remaining (hptimer);
-  return hptimer->remaining == 0;
-}
-
-static gboolean
-hptimer_source_dispatch(GSource *src, GSourceFunc cb, gpointer cbarg)
+struct _HdTransitionParam
 {
-  HPTimer *hptimer = (HPTimer *)src;
-
-  hptimer->remaining = hptimer->expiry;
-  return cb (cbarg);
-}
-
-/*
- * Returns a "high performance" timer, which is similar to an ordinary
- * %GTimeoutSource but may be better suited for short @expiry:s in
- * the sub-100th-second range.  You're free to change the %HPTimer's
- * @remaining and @expiry states.
- */
-static HPTimer *
-hptimer_new(unsigned expiry,
-            GSourceFunc cb, gpointer cbarg, GDestroyNotify dtor)
-{
-  static GSourceFuncs hptimer_funcs =
-  {
-    hptimer_source_prepare,
-    hptimer_source_check,
-    hptimer_source_dispatch
-  };
-
-  HPTimer *hptimer;
-  GSource *src;
-  guint id;
-
-  src = g_source_new (&hptimer_funcs, sizeof (*hptimer));
-  g_source_set_callback (src, cb, cbarg, dtor);
-  g_source_set_priority (src, G_PRIORITY_HIGH);
-  id = g_source_attach (src, NULL);
-  g_source_unref (src);
-
-  hptimer = (HPTimer *)src;
-  hptimer->id = id;
-  g_get_current_time (&hptimer->last);
-  hptimer->remaining = hptimer->expiry = expiry;
-
-  return hptimer;
-}
+  gchar    *transition, *key;
+  /* @transitions_ini_generation the values are from. */
+  guint     generation;
+  gboolean  has_int, has_double;
+  gint      int_value;
+  gdouble   double_value;
+};
 
 /* ------------------------------------------------------------------------- */
 /* ------------------------------------------------------------------------- */
 /* ------------------------------------------------------------------------- */
 
+/* These are called for every frame, so they look up the curves sampled
+ * by hd-curve.c rather than calling cos() and sin(). */
+
 /* amt goes from 0->1, and the result goes mostly from 0->1 with a bit of
  * overshoot at the end */
 float
 hd_transition_overshoot(float x)
 {
-  float smooth_ramp, converge;
-  float amt;
   int offset;
   offset = (int)x;
-  amt = x-offset;
-  smooth_ramp = 1.0f - cos(amt*3.141592); // 0 <= smooth_ramp <= 2
-  converge = sin(0.5*3.141592*(1-amt)); // 0 <= converve <= 1
-  return offset + (smooth_ramp*0.675)*converge + (1-converge);
+  return offset + hd_curve_eval(hd_curve_overshoot(), x-offset);
 }
 
 /* amt goes from 0->1, and the result goes from 0->1 smoothly */
@@ -305,7 +219,7 @@ float
 hd_transition_smooth_ramp(float amt)
 {
   if (amt>0 && amt<1)
-    return (1.0f - cos(amt*3.141592)) * 0.5f;
+    return hd_curve_eval(hd_curve_smooth_ramp(), amt);
   return amt;
 }
 
@@ -313,7 +227,7 @@ float
 hd_transition_ease_in(float amt)
 {
   if (amt>0 && amt<1)
-    return (1.0f - cos(amt*3.141592*0.5));
+    return hd_curve_eval(hd_curve_ease_in(), amt);
   return amt;
 }
 
@@ -321,7 +235,7 @@ float
 hd_transition_ease_out(float amt)
 {
   if (amt>0 && amt<1)
-    return cos((1-amt)*3.141592*0.5);
+    return hd_curve_eval(hd_curve_ease_out(), amt);
   return amt;
 }
 
@@ -329,15 +243,14 @@ hd_transition_ease_out(float amt)
 /* ------------------------------------------------------------------------- */
 /* ------------------------------------------------------------------------- */
 
-static ClutterTimeline *
-hd_transition_timeline_new(const gchar *transition,
-                           MBWMCompMgrClientEvent event,
-                           gint default_length)
+static gint
+hd_transition_duration(const gchar *transition,
+                       MBWMCompMgrClientEvent event,
+                       gint default_length)
 {
   const char *key =
     event==MBWMCompMgrClientEventMap ?"duration_in":"duration_out";
-  return clutter_timeline_new_for_duration (
-      hd_transition_get_int(transition, key, default_length) );
+  return hd_transition_get_int(transition, key, default_length);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -374,8 +287,7 @@ on_decor_progress_timeline_new_frame(ClutterTimeline *timeline,
 }
 
 static void
-on_popup_timeline_new_frame(ClutterTimeline *timeline,
-                            gint frame_num, HDEffectData *data)
+on_popup_new_frame(HDEffectData *data, float progress)
 {
   float amt;
   ClutterActor *actor, *filler;
@@ -399,7 +311,7 @@ on_popup_timeline_new_frame(ClutterTimeline *timeline,
   pop_bottom = geo.y+geo.height==hd_comp_mgr_get_current_screen_height();
   if (pop_top && pop_bottom)
     pop_top = FALSE;
-  amt =  (float)clutter_timeline_get_progress(timeline);
+  amt = progress;
   /* reverse if we're removing this */
   if (data->event == MBWMCompMgrClientEventUnmap)
     amt = 1-amt;
@@ -457,8 +369,7 @@ on_popup_timeline_new_frame(ClutterTimeline *timeline,
 }
 
 static void
-on_fade_timeline_new_frame(ClutterTimeline *timeline,
-                            gint frame_num, HDEffectData *data)
+on_fade_new_frame(HDEffectData *data, float progress)
 {
   float amt, ramt;
   gint alpha;
@@ -478,7 +389,7 @@ on_fade_timeline_new_frame(ClutterTimeline *timeline,
       return;
     }
 
-  amt =  (float)clutter_timeline_get_progress(timeline);
+  amt = progress;
   /* reverse if we're removing this */
   if (data->event == MBWMCompMgrClientEventUnmap)
     amt = 1-amt;
@@ -495,8 +406,7 @@ on_fade_timeline_new_frame(ClutterTimeline *timeline,
 }
 
 static void
-on_close_timeline_new_frame(ClutterTimeline *timeline,
-                            gint frame_num, HDEffectData *data)
+on_close_new_frame(HDEffectData *data, float progress)
 {
   float amt;
   ClutterActor *actor;
@@ -518,7 +428,7 @@ on_close_timeline_new_frame(ClutterTimeline *timeline,
       return;
     }
 
-  amt = (float)clutter_timeline_get_progress(timeline);
+  amt = progress;
 
   amtx = 1.6 - amt*2.5; // shrink in x
   amty = 1 - amt*2.5; // shrink in y
@@ -567,22 +477,10 @@ on_close_timeline_new_frame(ClutterTimeline *timeline,
 	clutter_actor_hide( data->particles[i] );
 }
 
-/* Returns the cubic bezier curve at @t defined by
- * (@p0, @p1) and (@p2, @p3). */
-static float __attribute__((const))
-bezier(float t, float p0, float p1, float p2, float p3)
-{
-  /* B(t) = (1-t)^3*P0 + (1-t)^2*t*P1 + (1-t)*t^2*P2 + t^3*P3 */
-  return powf((1-t), 3)*p0
-    + 3*powf((1-t), 2)*t*p1
-    + 3*(1-t)*powf(t, 2)*p2
-    + powf(t, 3)*p3;
-}
-
 static void
-on_notification_timeline_new_frame(ClutterTimeline *timeline,
-                                   gint frame_num, HDEffectData *data)
+on_notification_new_frame(HDEffectData *data, float progress)
 {
+  static HdTransitionParam *is_cool;
   float now;
   ClutterActor *actor;
   guint width, height;
@@ -596,10 +494,12 @@ on_notification_timeline_new_frame(ClutterTimeline *timeline,
                         HD_TITLE_BAR(hd_render_manager_get_title_bar()));
   clutter_actor_get_size(actor, &width, &height);
   clutter_actor_get_position(actor, &px, &py);
-  now = frame_num / (float)clutter_timeline_get_n_frames(timeline);
+  now = progress;
 
+  if (G_UNLIKELY (!is_cool))
+    is_cool = hd_transition_param_lookup("notification", "is_cool");
   if (hd_comp_mgr_is_portrait()
-      && hd_transition_get_int("notification", "is_cool", 0))
+      && hd_transition_param_get_int(is_cool, 0))
     {
       /* In portrait fly from right to left, stay in the corner
        * then fly away, following a bezier curve.  At the start
@@ -621,16 +521,31 @@ on_notification_timeline_new_frame(ClutterTimeline *timeline,
         { -176,   0 },
         { -478, -32 },
         { -478, -88 },
-      }, *curve;
+      };
+      /* The curves sampled the first time they're needed. */
+      static HdCurve *curves;
+      const HdCurve *curve;
+
+      if (G_UNLIKELY (!curves))
+        {
+          curves = g_new (HdCurve, 4);
+          hd_curve_sample_bezier(&curves[0],
+                      cpin[0].x, cpin[1].x, cpin[2].x, cpin[3].x);
+          hd_curve_sample_bezier(&curves[1],
+                      cpin[0].y, cpin[1].y, cpin[2].y, cpin[3].y);
+          hd_curve_sample_bezier(&curves[2],
+                      cpout[0].x, cpout[1].x, cpout[2].x, cpout[3].x);
+          hd_curve_sample_bezier(&curves[3],
+                      cpout[0].y, cpout[1].y, cpout[2].y, cpout[3].y);
+        }
 
       /* Set the position to @curve(@now). */
       now = hd_transition_smooth_ramp(now);
-      curve = data->event == MBWMCompMgrClientEventUnmap ? cpout : cpin;
+      curve = data->event == MBWMCompMgrClientEventUnmap
+        ? &curves[2] : &curves[0];
       clutter_actor_set_anchor_pointu(actor,
-               CLUTTER_FLOAT_TO_FIXED(-bezier(now,
-                        curve[0].x, curve[1].x, curve[2].x, curve[3].x)),
-               CLUTTER_FLOAT_TO_FIXED(-bezier(now,
-                        curve[0].y, curve[1].y, curve[2].y, curve[3].y)));
+               CLUTTER_FLOAT_TO_FIXED(-hd_curve_eval(&curve[0], now)),
+               CLUTTER_FLOAT_TO_FIXED(-hd_curve_eval(&curve[1], now)));
 
       /* We should restore the opacity and scaling of @actor in case
        * we were switched orientation during the transition somehow
@@ -710,11 +625,9 @@ on_notification_timeline_new_frame(ClutterTimeline *timeline,
 }
 
 static void
-on_subview_timeline_new_frame(ClutterTimeline *timeline,
-                              gint frame_num, HDEffectData *data)
+on_subview_new_frame(HDEffectData *data, float progress)
 {
   float amt;
-  gint n_frames;
   ClutterActor *subview_actor = 0, *main_actor = 0;
 
   if (data->cclient)
@@ -722,9 +635,7 @@ on_subview_timeline_new_frame(ClutterTimeline *timeline,
   if (data->cclient2)
     main_actor = data->cclient2_actor;
 
-  n_frames = clutter_timeline_get_n_frames(timeline);
-  amt = frame_num / (float)n_frames;
-  amt = hd_transition_smooth_ramp( amt );
+  amt = hd_transition_smooth_ramp( progress );
   if (data->event == MBWMCompMgrClientEventUnmap)
     amt = 1-amt;
 
@@ -752,7 +663,7 @@ on_subview_timeline_new_frame(ClutterTimeline *timeline,
   }
 
   /* if we're at the last frame, return our actors to the correct places) */
-  if (frame_num == n_frames)
+  if (progress >= 1)
     {
       if (subview_actor)
         {
@@ -771,16 +682,19 @@ on_subview_timeline_new_frame(ClutterTimeline *timeline,
 }
 
 static void
-on_rotate_screen_timeline_new_frame(ClutterTimeline *timeline,
-                                    gint frame_num, HDEffectData *data)
+on_rotate_screen_new_frame(HDEffectData *data, float progress)
 {
+  static HdTransitionParam *zaxisrotation;
   float amt, dim_amt, angle;
-  gint n_frames;
-  gint use_zaxis = hd_transition_get_int ("thp_tweaks", "zaxisrotation", 0);
+  gint use_zaxis;
   ClutterActor *actor;
 
-  n_frames = clutter_timeline_get_n_frames(timeline);
-  amt = frame_num / (float)n_frames;
+  if (G_UNLIKELY (!zaxisrotation))
+    zaxisrotation = hd_transition_param_lookup ("thp_tweaks",
+                                                "zaxisrotation");
+  use_zaxis = hd_transition_param_get_int (zaxisrotation, 0);
+
+  amt = progress;
   // we want to ease in, but speed up as we go - X^3 does this nicely
   amt = amt*amt;
   if (data->event == MBWMCompMgrClientEventUnmap)
@@ -796,7 +710,7 @@ on_rotate_screen_timeline_new_frame(ClutterTimeline *timeline,
   actor = CLUTTER_ACTOR(hd_render_manager_get());
   clutter_actor_set_rotation(actor, use_zaxis ? CLUTTER_Z_AXIS :
       (hd_comp_mgr_is_portrait () ? CLUTTER_Y_AXIS : CLUTTER_X_AXIS),
-      frame_num < n_frames ? angle : 0,
+      progress < 1 ? angle : 0,
       hd_comp_mgr_get_current_screen_width()/2,
       hd_comp_mgr_get_current_screen_height()/2, 0);
 
@@ -838,10 +752,12 @@ on_screen_size_changed (ClutterActor *stage, GParamSpec *unused,
 }
 
 static void
-hd_transition_completed (ClutterTimeline* timeline, HDEffectData *data)
+hd_transition_completed (HDEffectData *data)
 {
   gint i;
   HdCompMgr *hmgr = HD_COMP_MGR (data->hmgr);
+  GSourceFunc finished = data->finished;
+  gpointer finished_data = data->finished_data;
 
   if (data->cclient)
     {
@@ -877,8 +793,8 @@ hd_transition_completed (ClutterTimeline* timeline, HDEffectData *data)
 
 /*   dump_clutter_tree (CLUTTER_CONTAINER (clutter_stage_get_default()), 0); */
 
-  if (timeline)
-    g_object_unref ( timeline );
+  if (data->frame_id)
+    hd_frame_scheduler_remove (data->frame_id);
 
   if (hmgr)
     hd_comp_mgr_set_effect_running(hmgr, FALSE);
@@ -912,6 +828,47 @@ hd_transition_completed (ClutterTimeline* timeline, HDEffectData *data)
 
   if (hmgr)
     hd_comp_mgr_reconsider_compositing (MB_WM_COMP_MGR (hmgr));
+
+  if (finished)
+    finished (finished_data);
+}
+
+/* Runs the frames of an effect on the scheduler's clock, so they're
+ * painted with the rest of the frame's animations. */
+static gboolean
+hd_transition_frame (gpointer user_data)
+{
+  HDEffectData *data = user_data;
+  gint64 elapsed = hd_frame_scheduler_get_time () - data->start;
+  float progress;
+
+  progress = data->duration > 0
+    ? elapsed / (data->duration * 1000.0f) : 1;
+  if (progress >= 1)
+    {
+      data->new_frame (data, 1);
+      hd_frame_stats_redraw_queued ();
+      data->frame_id = 0;
+      hd_transition_completed (data);
+      return FALSE;
+    }
+
+  data->new_frame (data, progress);
+  hd_frame_stats_redraw_queued ();
+  return TRUE;
+}
+
+/* Start calling @new_frame every frame for @duration ms, then
+ * hd_transition_completed(). */
+static void
+hd_transition_start (HDEffectData *data, HDEffectFrameFunc new_frame,
+                     gint duration)
+{
+  data->new_frame = new_frame;
+  data->duration = duration;
+  data->start = hd_frame_scheduler_get_time ();
+  data->frame_id = hd_frame_scheduler_add (0, hd_transition_frame,
+                                           data, NULL);
 }
 
 void
@@ -940,11 +897,6 @@ hd_transition_popup(HdCompMgr                  *mgr,
   data->cclient = mb_wm_object_ref (MB_WM_OBJECT (cclient));
   data->cclient_actor = g_object_ref (actor);
   data->hmgr = HD_COMP_MGR (mgr);
-  data->timeline = hd_transition_timeline_new("popup", event, 250);
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_popup_timeline_new_frame), data);
-  g_signal_connect (data->timeline, "completed",
-                        G_CALLBACK (hd_transition_completed), data);
   data->geo = geo;
   Transitions_running += data->fixup_visibilities = TRUE;
 
@@ -976,8 +928,9 @@ hd_transition_popup(HdCompMgr                  *mgr,
                               &col);
 
   /* first call to stop flicker */
-  on_popup_timeline_new_frame(data->timeline, 0, data);
-  clutter_timeline_start (data->timeline);
+  on_popup_new_frame(data, 0);
+  hd_transition_start (data, on_popup_new_frame,
+                       hd_transition_duration("popup", event, 250));
 }
 
 /* For banners, information notes and confirmation notes. */
@@ -997,7 +950,6 @@ hd_transition_fade(HdCompMgr                  *mgr,
   data->cclient_actor = g_object_ref (
       mb_wm_comp_mgr_clutter_client_get_actor( data->cclient ) );
   data->hmgr = HD_COMP_MGR (mgr);
-  data->timeline = hd_transition_timeline_new("fade", event, 250);
   Transitions_running += data->fixup_visibilities = TRUE;
 
   if (HD_IS_BANNER_NOTE(c))
@@ -1016,19 +968,15 @@ hd_transition_fade(HdCompMgr                  *mgr,
     /* Leave @data->geo 0, we needn't move the actor around. */
     data->final_alpha = 1;
 
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_fade_timeline_new_frame), data);
-  g_signal_connect (data->timeline, "completed",
-                        G_CALLBACK (hd_transition_completed), data);
-
   mb_wm_comp_mgr_clutter_client_set_flags (cclient,
                               MBWMCompMgrClutterClientDontUpdate |
                               MBWMCompMgrClutterClientEffectRunning);
   hd_comp_mgr_set_effect_running(mgr, TRUE);
 
   /* first call to stop flicker */
-  on_fade_timeline_new_frame(data->timeline, 0, data);
-  clutter_timeline_start (data->timeline);
+  on_fade_new_frame(data, 0);
+  hd_transition_start (data, on_fade_new_frame,
+                       hd_transition_duration("fade", event, 250));
 }
 void
 hd_transition_fade_out_loading_screen(ClutterActor *loading_image)
@@ -1046,14 +994,12 @@ hd_transition_fade_out_loading_screen(ClutterActor *loading_image)
     data->event = MBWMCompMgrClientEventUnmap;
     data->cclient_actor = g_object_ref ( loading_image );
     data->hmgr = 0;
-    data->timeline = clutter_timeline_new_for_duration ( duration );
     data->final_alpha = 1;
     /* the delay before we start to fade out. We implement this by setting
      * the final_alpha value to something *past* opaque */
     fade_delay = hd_transition_get_int("launcher_launch", "delay", 150);
     if (fade_delay>0)
       {
-        gint duration = clutter_timeline_get_duration(data->timeline);
         if (fade_delay < duration) {
           data->final_alpha = 1 + fade_delay/(float)(duration-fade_delay);
           // safety in case strange values get put in
@@ -1062,16 +1008,12 @@ hd_transition_fade_out_loading_screen(ClutterActor *loading_image)
         }
       }
 
-    g_signal_connect (data->timeline, "new-frame",
-                          G_CALLBACK (on_fade_timeline_new_frame), data);
-    g_signal_connect (data->timeline, "completed",
-                          G_CALLBACK (hd_transition_completed), data);
     clutter_container_add_actor (
                  hd_render_manager_get_front_group(),
                  loading_image);
     /* first call to stop flicker */
-    on_fade_timeline_new_frame(data->timeline, 0, data);
-    clutter_timeline_start (data->timeline);
+    on_fade_new_frame(data, 0);
+    hd_transition_start (data, on_fade_new_frame, duration);
 }
 
 void
@@ -1128,14 +1070,8 @@ hd_transition_close_app (HdCompMgr                  *mgr,
   data->cclient = mb_wm_object_ref (MB_WM_OBJECT (cclient));
   data->cclient_actor = g_object_ref (actor);
   data->hmgr = HD_COMP_MGR (mgr);
-  data->timeline = clutter_timeline_new_for_duration (
-                    hd_transition_get_int("app_close", "duration", 500));
-  g_signal_connect (data->timeline, "new-frame",
-                    G_CALLBACK (on_close_timeline_new_frame), data);
   g_signal_connect (clutter_stage_get_default (), "notify::allocation",
                     G_CALLBACK (on_screen_size_changed), data);
-  g_signal_connect (data->timeline, "completed",
-                    G_CALLBACK (hd_transition_completed), data);
   data->geo = geo;
 
   mb_wm_comp_mgr_clutter_client_set_flags (cclient,
@@ -1163,7 +1099,8 @@ hd_transition_close_app (HdCompMgr                  *mgr,
     }
 
   hd_comp_mgr_set_effect_running(mgr, TRUE);
-  clutter_timeline_start (data->timeline);
+  hd_transition_start (data, on_close_new_frame,
+                       hd_transition_get_int("app_close", "duration", 500));
 
   hd_transition_play_sound (HDCM_WINDOW_CLOSED_SOUND);
 }
@@ -1188,12 +1125,6 @@ hd_transition_notification(HdCompMgr                  *mgr,
   data->cclient_actor = g_object_ref (
       mb_wm_comp_mgr_clutter_client_get_actor( data->cclient ) );
   data->hmgr = HD_COMP_MGR (mgr);
-  data->timeline = hd_transition_timeline_new("notification", event, 500);
-
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_notification_timeline_new_frame), data);
-  g_signal_connect (data->timeline, "completed",
-                        G_CALLBACK (hd_transition_completed), data);
 
   mb_wm_comp_mgr_clutter_client_set_flags (cclient,
                               MBWMCompMgrClutterClientDontUpdate |
@@ -1201,12 +1132,13 @@ hd_transition_notification(HdCompMgr                  *mgr,
   hd_comp_mgr_set_effect_running(mgr, TRUE);
 
   /* first call to stop flicker */
-  on_notification_timeline_new_frame(data->timeline, 0, data);
+  on_notification_new_frame(data, 0);
   /* Show the actor and add it to the front group */
   clutter_actor_show(data->cclient_actor);
   hd_render_manager_add_to_front_group(data->cclient_actor);
-  /* Finally start the timeline... */
-  clutter_timeline_start (data->timeline);
+  /* Finally start the animation... */
+  hd_transition_start (data, on_notification_new_frame,
+                       hd_transition_duration("notification", event, 500));
 }
 
 void
@@ -1325,12 +1257,6 @@ hd_transition_subview(HdCompMgr                  *mgr,
       mb_wm_comp_mgr_clutter_client_get_actor( data->cclient2 ) );
   data->hmgr = HD_COMP_MGR (mgr);
   Transitions_running += data->fixup_visibilities = TRUE;
-  data->timeline = hd_transition_timeline_new("subview", event, 250);
-
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_subview_timeline_new_frame), data);
-  g_signal_connect (data->timeline, "completed",
-                        G_CALLBACK (hd_transition_completed), data);
 
   mb_wm_comp_mgr_clutter_client_set_flags (cclient_subview,
                               MBWMCompMgrClutterClientDontUpdate |
@@ -1344,8 +1270,9 @@ hd_transition_subview(HdCompMgr                  *mgr,
   HD_COMP_MGR_CLIENT (cclient_subview)->effect  = data;
 
   /* first call to stop flicker */
-  on_subview_timeline_new_frame(data->timeline, 0, data);
-  clutter_timeline_start (data->timeline);
+  on_subview_new_frame(data, 0);
+  hd_transition_start (data, on_subview_new_frame,
+                       hd_transition_duration("subview", event, 250));
 }
 
 /* Stop any currently active transition on the given client (assuming the
@@ -1362,13 +1289,10 @@ hd_transition_stop(HdCompMgr                  *mgr,
 
   if ((data = HD_COMP_MGR_CLIENT (cclient)->effect))
     {
-      gint n_frames = clutter_timeline_get_n_frames(data->timeline);
-      clutter_timeline_stop(data->timeline);
       /* Make sure we update to the final state for this transition */
-      g_signal_emit_by_name (data->timeline, "new-frame",
-                             n_frames, NULL);
+      data->new_frame (data, 1);
       /* Call end-of-transition handler */
-      hd_transition_completed(data->timeline, data);
+      hd_transition_completed(data);
     }
 }
 
@@ -1378,7 +1302,7 @@ hd_transition_stop(HdCompMgr                  *mgr,
 static void
 hd_transition_fade_and_rotate(gboolean first_part,
                               gboolean goto_portrait,
-                              GCallback finished_callback,
+                              GSourceFunc finished_callback,
                               gpointer finished_callback_data)
 {
   ClutterColor black = {0x00, 0x00, 0x00, 0xFF};
@@ -1386,15 +1310,8 @@ hd_transition_fade_and_rotate(gboolean first_part,
   HDEffectData *data = g_new0 (HDEffectData, 1);
   data->event = first_part ? MBWMCompMgrClientEventMap :
                              MBWMCompMgrClientEventUnmap;
-  data->timeline = hd_transition_timeline_new("rotate", data->event, 300);
-
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_rotate_screen_timeline_new_frame), data);
-  g_signal_connect (data->timeline, "completed",
-                         G_CALLBACK (hd_transition_completed), data);
-  if (finished_callback)
-    g_signal_connect_swapped (data->timeline, "completed",
-                          G_CALLBACK (finished_callback), finished_callback_data);
+  data->finished = finished_callback;
+  data->finished_data = finished_callback_data;
 
   data->angle = hd_transition_get_double("rotate", "angle", 40);
   /* Set the direction of movement - we want to rotate backwards if we
@@ -1435,8 +1352,9 @@ hd_transition_fade_and_rotate(gboolean first_part,
     }
 
   /* stop flicker by calling the first frame directly */
-  on_rotate_screen_timeline_new_frame(data->timeline, 0, data);
-  clutter_timeline_start (data->timeline);
+  on_rotate_screen_new_frame(data, 0);
+  hd_transition_start (data, on_rotate_screen_new_frame,
+                       hd_transition_duration("rotate", data->event, 300));
 }
 
 /* Process %_MAEMO_ROTATION_PATIENCE requests. */
@@ -1459,7 +1377,8 @@ patience (XClientMessageEvent *event, void *unused)
           max  = hd_transition_get_int("rotate", "damage_timeout_max", 1000);
           max -= g_timer_elapsed(Orientation_change.timer, NULL) * 1000.0;
           if (max > 0)
-            Orientation_change.timeout_id->remaining = max;
+            hd_frame_scheduler_set_remaining(Orientation_change.timeout_id,
+                                             max);
         }
       if (Orientation_change.phase <= WAIT_FOR_DAMAGES)
         Orientation_change.patience_requests++;
@@ -1470,10 +1389,17 @@ patience (XClientMessageEvent *event, void *unused)
         Orientation_change.patience_requests--;
       if (!Orientation_change.patience_requests
           && Orientation_change.timeout_id)
-        Orientation_change.timeout_id->remaining = 0;
+        hd_frame_scheduler_set_remaining(Orientation_change.timeout_id, 0);
     }
 }
 
+/* Forget the WAIT_FOR_DAMAGES timer when it has gone off. */
+static void
+hd_transition_rotating_timeout_removed(gpointer unused)
+{
+  Orientation_change.timeout_id = 0;
+}
+
 static gboolean
 hd_transition_rotating_fsm(void)
 {
@@ -1539,7 +1465,7 @@ hd_transition_rotating_fsm(void)
             Orientation_change.phase = FADE_OUT;
             hd_transition_fade_and_rotate(
                             TRUE, Orientation_change.direction == GOTO_PORTRAIT,
-                            G_CALLBACK(hd_transition_rotating_fsm), NULL);
+                            (GSourceFunc)hd_transition_rotating_fsm, NULL);
             break;
           }
         else
@@ -1636,14 +1562,13 @@ trans_start_error:
             hd_util_root_window_configured(Orientation_change.wm);
 
             g_assert(!Orientation_change.timeout_id);
-            Orientation_change.timeout_id = hptimer_new(
+            Orientation_change.timeout_id = hd_frame_scheduler_add(
                   Orientation_change.patience_requests
                     ? hd_transition_get_int("rotate", "damage_timeout_max",
                                             1000)
                     : hd_transition_get_int("rotate", "damage_timeout", 50),
-                  (GSourceFunc)hd_transition_rotating_fsm,
-                  &Orientation_change.timeout_id,
-                  (GDestroyNotify)g_nullify_pointer);
+                  (HdFrameFunc)hd_transition_rotating_fsm, NULL,
+                  hd_transition_rotating_timeout_removed);
             g_timer_start(Orientation_change.timer);
             Orientation_change.phase = WAIT_FOR_DAMAGES;
           }
@@ -1665,7 +1590,7 @@ trans_start_error:
                 clutter_actor_show(CLUTTER_ACTOR(hd_render_manager_get()));
                 hd_transition_fade_and_rotate(
                         FALSE, Orientation_change.direction == GOTO_PORTRAIT,
-                        G_CALLBACK(hd_transition_rotating_fsm), NULL);
+                        (GSourceFunc)hd_transition_rotating_fsm, NULL);
                 /* Fix NB#117109 by re-evaluating what is blurred and what isn't */
                 hd_render_manager_restack();
               }
@@ -1842,13 +1767,13 @@ hd_transition_rotate_ignore_damage()
 
           remaining = hd_transition_get_int("rotate", "damage_timeout_plus",
                                             50);
-          if (Orientation_change.timeout_id->remaining < remaining)
-            Orientation_change.timeout_id->remaining = remaining;
-          if (Orientation_change.timeout_id->remaining > max)
-            Orientation_change.timeout_id->remaining = max;
+          remaining = MAX(remaining, hd_frame_scheduler_get_remaining(
+                                          Orientation_change.timeout_id));
+          hd_frame_scheduler_set_remaining(Orientation_change.timeout_id,
+                                           MIN(remaining, max));
         }
       else
-        Orientation_change.timeout_id->remaining = 0;
+        hd_frame_scheduler_set_remaining(Orientation_change.timeout_id, 0);
 
       return TRUE;
     }
@@ -1961,10 +1886,11 @@ transitions_ini_changed(GIOChannel *chnl, GIOCondition cond, gpointer unused)
   return TRUE;
 }
 
-static GKeyFile *
-hd_transition_get_keyfile(void)
+/* Returns transitions.ini parsed, reloading it if it has changed. */
+static HdTransitionParams *
+hd_transition_get_params(void)
 {
-  static GKeyFile *transitions_ini;
+  static HdTransitionParams *transitions_ini;
   static GIOChannel *transitions_ini_watcher;
   GError *error;
   GKeyFile *ini;
@@ -1996,8 +1922,19 @@ hd_transition_get_keyfile(void)
 
   /* Use the new @transitions_ini. */
   if (transitions_ini)
-    g_key_file_free(transitions_ini);
-  transitions_ini = ini;
+    hd_transition_params_free(transitions_ini);
+  transitions_ini = hd_transition_params_new(ini);
+  g_key_file_free(ini);
+  transitions_ini_generation++;
+
+  /* Tick the frame scheduler as often as the damage is flushed. */
+  {
+    gint frame_ms = 16;
+
+    hd_transition_params_get_int(transitions_ini, "damage", "frame_ms",
+                                 &frame_ms);
+    hd_frame_scheduler_set_frame_ms(frame_ms);
+  }
 
   if (!transitions_ini_watcher || transitions_ini_is_dirty > TRUE)
     {
@@ -2045,23 +1982,13 @@ gint
 hd_transition_get_int(const gchar *transition, const char *key,
                       gint default_val)
 {
+  HdTransitionParams *params;
   gint value;
-  GError *error;
-  GKeyFile *ini;
 
-  if (!(ini = hd_transition_get_keyfile()))
+  if (!(params = hd_transition_get_params())
+      || !hd_transition_params_get_int(params, transition, key, &value))
     return default_val;
 
-  error = NULL;
-  value = g_key_file_get_integer(ini, transition, key, &error);
-  if (error)
-    {
-      g_debug("couldn't read int %s::%s from transitions.ini: %s",
-                transition, key, error->message);
-      g_error_free(error);
-      return default_val;
-    }
-
   return value;
 }
 
@@ -2069,23 +1996,13 @@ gdouble
 hd_transition_get_double(const gchar *transition,
                          const char *key, gdouble default_val)
 {
+  HdTransitionParams *params;
   gdouble value;
-  GError *error;
-  GKeyFile *ini;
 
-  if (!(ini = hd_transition_get_keyfile()))
+  if (!(params = hd_transition_get_params())
+      || !hd_transition_params_get_double(params, transition, key, &value))
     return default_val;
 
-  error = NULL;
-  value = g_key_file_get_double (ini, transition, key, &error);
-  if (error)
-    {
-      g_debug("couldn't read double %s::%s from transitions.ini: %s",
-                transition, key, error->message);
-      g_error_free(error);
-      return default_val;
-    }
-
   return value;
 }
 
@@ -2094,41 +2011,93 @@ gchar *
 hd_transition_get_string(const gchar *transition, const char *key,
                       gchar *default_val)
 {
-  gchar *value;
-  GError *error;
-  GKeyFile *ini;
-
-  if (!(ini = hd_transition_get_keyfile())) {
-    /* It sould be a newly allocated string.
-     * Fixes BMO #12722: hildon-desktop crashes on malformed transitions.ini.
-     */
-    gchar *new_val = g_strdup(default_val);
-    return new_val;
-  }
+  HdTransitionParams *params;
+  const gchar *value;
 
-  error = NULL;
-  value = g_key_file_get_string (ini, transition, key, &error);
-  if (error)
-    {
-      g_debug("couldn't read string %s::%s from transitions.ini: %s",
-                transition, key, error->message);
-      g_error_free(error);
-      return g_strdup(default_val);
-    }
+  /* It sould be a newly allocated string.
+   * Fixes BMO #12722: hildon-desktop crashes on malformed transitions.ini.
+   */
+  if (!(params = hd_transition_get_params())
+      || !(value = hd_transition_params_get_string(params, transition, key)))
+    return g_strdup(default_val);
 
-  return value;
+  return g_strdup(value);
 }
 
+/* The keyframes are parsed once per load of transitions.ini and shared,
+ * release them with hd_key_frame_list_free(). */
 HdKeyFrameList *
 hd_transition_get_keyframes(const gchar *transition, const char *key,
                             gchar *default_val)
 {
-  char *keyframetext = hd_transition_get_string(transition, key, default_val);
-  HdKeyFrameList *keyframes = hd_key_frame_list_create(keyframetext);
-  g_free(keyframetext);
+  HdTransitionParams *params;
+  HdKeyFrameList *keyframes;
+
+  if (!(params = hd_transition_get_params())
+      || !(keyframes = hd_transition_params_get_keyframes(params,
+                                                          transition, key)))
+    keyframes = hd_key_frame_list_create(default_val);
   return keyframes;
 }
 
+HdTransitionParam *
+hd_transition_param_lookup(const gchar *transition, const char *key)
+{
+  static GHashTable *interned;
+  HdTransitionParam *param;
+  gchar *name;
+
+  if (!interned)
+    interned = g_hash_table_new (g_str_hash, g_str_equal);
+
+  name = g_strconcat (transition, "/", key, NULL);
+  if ((param = g_hash_table_lookup (interned, name)) != NULL)
+    {
+      g_free (name);
+      return param;
+    }
+
+  param = g_new0 (HdTransitionParam, 1);
+  param->transition = g_strdup (transition);
+  param->key = g_strdup (key);
+  g_hash_table_insert (interned, name, param);
+  return param;
+}
+
+/* Reread @param if transitions.ini has been reloaded since. */
+static HdTransitionParam *
+hd_transition_param_resolve(HdTransitionParam *param)
+{
+  HdTransitionParams *params = hd_transition_get_params();
+
+  if (!params || param->generation == transitions_ini_generation)
+    return param;
+
+  param->generation = transitions_ini_generation;
+  param->has_int = hd_transition_params_get_int(params, param->transition,
+                                                param->key,
+                                                &param->int_value);
+  param->has_double = hd_transition_params_get_double(params,
+                                                      param->transition,
+                                                      param->key,
+                                                      &param->double_value);
+  return param;
+}
+
+gint
+hd_transition_param_get_int(HdTransitionParam *param, gint default_val)
+{
+  hd_transition_param_resolve(param);
+  return param->has_int ? param->int_value : default_val;
+}
+
+gdouble
+hd_transition_param_get_double(HdTransitionParam *param, gdouble default_val)
+{
+  hd_transition_param_resolve(param);
+  return param->has_double ? param->double_value : default_val;
+}
+
 void
 hd_transition_play_tactile(gboolean is_map, MBWMClientType c_type)
 {
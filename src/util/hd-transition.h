@@ -119,6 +119,22 @@ HdKeyFrameList *
 hd_transition_get_keyframes(const gchar *transition, const char *key,
                             gchar *default_val);
 
+/* A setting of transitions.ini looked up once, for the callers which
+ * read it every frame or every damage event.  The handle stays valid
+ * for good and is resolved again when transitions.ini is reloaded, so
+ * reading it doesn't hash the group and the key. */
+typedef struct _HdTransitionParam HdTransitionParam;
+
+HdTransitionParam *
+hd_transition_param_lookup(const gchar *transition, const char *key);
+
+gint
+hd_transition_param_get_int(HdTransitionParam *param, gint default_val);
+
+gdouble
+hd_transition_param_get_double(HdTransitionParam *param,
+                               gdouble default_val);
+
 void
 hd_transition_set_file_changed(void);
 
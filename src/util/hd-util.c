@@ -14,6 +14,7 @@
 #include "hd-transition.h"
 #include "hd-render-manager.h"
 #include "hd-xinput.h"
+#include "hd-damage.h"
 
 #include <gdk/gdk.h>
 
@@ -674,7 +675,7 @@ hd_util_click (const MBWindowManagerClient *c)
  * use the full bounds of the actor. Otherwise we translate the bounds given
  * in geo (eg. for updating an area of an actor). Returns false if it failed
  * (because the actor or its parents were rotated) */
-static gboolean
+gboolean
 hd_util_get_actor_bounds(ClutterActor *actor, ClutterGeometry *geo, gboolean *is_visible)
 {
   gdouble x, y;
@@ -753,25 +754,7 @@ hd_util_get_actor_bounds(ClutterActor *actor, ClutterGeometry *geo, gboolean *is
 void
 hd_util_partial_redraw_if_possible(ClutterActor *actor, ClutterGeometry *bounds)
 {
-  ClutterGeometry area = {0,0,0,0};
-  ClutterActor *stage = clutter_stage_get_default();
-  gboolean visible, valid;
-
-  if (bounds)
-    area = *bounds;
-
-  valid = hd_util_get_actor_bounds(actor, &area, &visible);
-  if (!visible) return;
-  if (valid)
-    {
-      /* Queue a redraw, but without updating the whole area */
-      clutter_stage_set_damaged_area(stage, area);
-      clutter_actor_queue_redraw_damage(stage);
-    }
-  else
-    {
-      clutter_actor_queue_redraw(stage);
-    }
+  hd_damage_add_actor_area(actor, bounds, 0);
 }
 
 /* Check to see whether clients above this one totally obscure it */
@@ -808,103 +791,6 @@ gboolean hd_util_client_obscured(MBWindowManagerClient *client)
   return empty;
 }
 
-
-/* Structure holding a list of keyframes that will be linearly interpolated
- * between to produce animation*/
-struct _HdKeyFrameList {
-  float *keyframes;
-  int count;
-};
-
-/* Create a keyframe list from a comma-separated list of floating point values */
-HdKeyFrameList *hd_key_frame_list_create(const char *keys)
-{
-  char *key_copy = 0;
-  char *p;
-  int i=0;
-  HdKeyFrameList *k = (HdKeyFrameList*)g_malloc0(sizeof(HdKeyFrameList));
-  /* Fail nicely by returning a straight ramp */
-  if (!keys || strlen(keys)<=1)
-    goto fail;
-  key_copy = g_strdup(keys);
-  /* Scan for how many elements we need */
-  k->count = 0;
-  for (p=key_copy;*p;p++)
-    if (*p==',') k->count++;
-  if (key_copy[strlen(key_copy)-1]!=',')
-    k->count++;
-  if (k->count<2)
-    goto fail;
-  k->keyframes = (float*)g_malloc0(sizeof(float) * k->count);
-  /* read in individual keys */
-  for (p=key_copy;*p;)
-    {
-      char *comma = p;
-      char old_comma;
-      /* Find comma and replace with string end character */
-      while (*comma && *comma!=',')
-        comma++;
-      old_comma = *comma;
-      *comma = 0;
-      /* Read the data value */
-      k->keyframes[i++] = atof(p);
-      /* Set up for next iteration. If we hit the end, don't skip over it! */
-      if (old_comma)
-        p = comma+1;
-      else
-        p = comma;
-    }
-  k->count = i;
-  g_free(key_copy);
-  return k;
-fail:
-  /* On failure, free memory, and return a simple
-   * linear ramp */
-  if (key_copy) g_free(key_copy);
-  /* k is already allocated */
-  k->count = 2;
-  if (k->keyframes) g_free(k->keyframes);
-  k->keyframes = (float*)g_malloc(sizeof(float) * k->count);
-  k->keyframes[0] = 0.0f;
-  k->keyframes[1] = 1.0f;
-  return k;
-}
-
-void hd_key_frame_list_free(HdKeyFrameList *k)
-{
-  if (k)
-    {
-      g_free(k->keyframes);
-      g_free(k);
-    }
-}
-
-/* As X goes between 0 and 1, interpolate into the HdKeyFrameList */
-float hd_key_frame_interpolate(HdKeyFrameList *k, float x)
-{
-  float v,n;
-  int idx;
-
-  if (!k || k->count < 2)
-    return x;
-
-  v = x * (k->count-1);
-  idx = (int)v;
-  n = v - idx;
-
-  if (idx >= k->count-1)
-    {
-      idx = k->count-2;
-      n = 1;
-    }
-  if (idx<0)
-    {
-      idx = 0;
-      n = 0;
-    }
-  return k->keyframes[idx]*(1-n) + k->keyframes[idx+1]*n;
-}
-
 void
 hd_util_display_portraitness_init(MBWindowManager *wm)
 {
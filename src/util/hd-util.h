@@ -10,6 +10,7 @@
 #include <clutter/clutter.h>
 
 #include "mb/hd-atoms.h"
+#include "util/hd-curve.h"
 
 void * hd_util_get_win_prop_data_and_validate (Display   *xpdy,
 					       Window     xwin,
@@ -37,17 +38,14 @@ gboolean hd_util_client_has_video_overlay(MBWindowManagerClient *client);
 
 void hd_util_click (const MBWindowManagerClient *c);
 
+gboolean
+hd_util_get_actor_bounds(ClutterActor *actor, ClutterGeometry *geo,
+                         gboolean *is_visible);
 void
 hd_util_partial_redraw_if_possible(ClutterActor *actor, ClutterGeometry *bounds);
 
 gboolean hd_util_client_obscured(MBWindowManagerClient *client);
 
-/* Functions for loading and interpolating from a list of keyframes */
-typedef struct _HdKeyFrameList HdKeyFrameList;
-HdKeyFrameList *hd_key_frame_list_create(const char *keys);
-void hd_key_frame_list_free(HdKeyFrameList *k);
-float hd_key_frame_interpolate(HdKeyFrameList *k, float x);
-
 void hd_util_display_portraitness_init(MBWindowManager *wm);
 
 /* Display width, accounting for initial rotation */
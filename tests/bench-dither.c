@@ -0,0 +1,59 @@
+/* Microbenchmark for the dithering kernels of src/util/hd-dither.c.
+ * Dithers a wallpaper-sized image with every kernel available and prints
+ * the time per image.  Usage: bench-dither [iterations] */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hd-dither.h"
+
+#define WIDTH  800
+#define HEIGHT 480
+
+int
+main (int argc, char **argv)
+{
+  HdDitherKernel kernel;
+  gint iterations, n_channels, i;
+  guint16 *out;
+  guchar *src;
+
+  iterations = argc > 1 ? atoi (argv[1]) : 50;
+  if (iterations <= 0)
+    iterations = 50;
+
+  src = g_malloc (WIDTH * HEIGHT * 4);
+  for (i = 0; i < WIDTH * HEIGHT * 4; i++)
+    src[i] = g_random_int_range (0, 256);
+  out = g_new (guint16, WIDTH * HEIGHT);
+
+  for (n_channels = 3; n_channels <= 4; n_channels++)
+    for (kernel = HD_DITHER_REFERENCE; kernel < HD_DITHER_BEST; kernel++)
+      {
+        gint64 start, elapsed;
+
+        if (!hd_dither_kernel_is_available (kernel))
+          continue;
+
+        /* Warm up, this also builds the noise tile. */
+        hd_dither_rgb565_full (kernel, src, WIDTH * n_channels, n_channels,
+                               out, WIDTH * 2, WIDTH, HEIGHT, 0);
+
+        start = g_get_monotonic_time ();
+        for (i = 0; i < iterations; i++)
+          hd_dither_rgb565_full (kernel, src, WIDTH * n_channels, n_channels,
+                                 out, WIDTH * 2, WIDTH, HEIGHT, 0);
+        elapsed = g_get_monotonic_time () - start;
+
+        printf ("%dx%d, %d channels, %-9s: %8.3f ms/image, %7.1f Mpixel/s\n",
+                WIDTH, HEIGHT, n_channels, hd_dither_kernel_name (kernel),
+                elapsed / 1000.0 / iterations,
+                (gdouble)WIDTH * HEIGHT * iterations / MAX (elapsed, 1));
+      }
+
+  g_free (out);
+  g_free (src);
+
+  return 0;
+}
@@ -0,0 +1,133 @@
+#!/bin/sh
+# Frame time benchmark: starts hildon-desktop on a fresh Xvfb, runs some
+# scripted scenarios and reports the frame time percentiles of each
+# render manager state in them, as hildon-desktop's GetFrameStats D-Bus
+# method gives them (see src/util/hd-frame-stats.h).  Times are in ms,
+# damage is the average painted area in pixels.
+#
+# Usage: bench-frames.sh [cycles] [baseline] [hildon-desktop]
+#
+# If a baseline (the output of an earlier run) is given, states whose
+# paint or interval p95 got more than 20% (and 1 ms) worse are listed
+# and the exit status is 1.
+
+cycles=${1:-10}
+baseline=$2
+hd=${3:-hildon-desktop}
+display=:${BENCH_DISPLAY:-78}
+timeout=60
+
+HOME_DEST=com.nokia.HildonDesktop.Home
+HOME_PATH=/com/nokia/HildonDesktop/Home
+
+dir=`mktemp -d /tmp/bench-frames.XXXXXX` || exit 1
+trap 'kill $pid $xvfb $DBUS_SESSION_BUS_PID 2>/dev/null; rm -rf "$dir"' EXIT
+
+home_call()
+{
+  method=$1
+  shift
+  dbus-send --session --print-reply=literal --dest=$HOME_DEST $HOME_PATH \
+    $HOME_DEST.$method "$@" | sed 's/^ *//'
+}
+
+# What the task navigator's "set_state" signal takes, see hd-dbus.c.
+set_state()
+{
+  dbus-send --session --type=signal /com/nokia/hildon_desktop \
+    com.nokia.hildon_desktop.set_state int32:$1
+}
+
+STATE_HOME=1
+STATE_TASK_NAV=64
+STATE_LAUNCHER=128
+
+# Each scenario is a function; add new ones to $scenarios.
+scenario_idle()
+{
+  sleep 2
+}
+
+scenario_task_switcher()
+{
+  i=0
+  while [ $i -lt $cycles ]; do
+    set_state $STATE_TASK_NAV; sleep 1
+    set_state $STATE_HOME; sleep 1
+    i=$((i + 1))
+  done
+}
+
+scenario_launcher()
+{
+  i=0
+  while [ $i -lt $cycles ]; do
+    set_state $STATE_LAUNCHER; sleep 1
+    set_state $STATE_HOME; sleep 1
+    i=$((i + 1))
+  done
+}
+
+scenarios=${BENCH_SCENARIOS:-"idle task_switcher launcher"}
+
+Xvfb $display -screen 0 800x480x16 -nolisten tcp >/dev/null 2>&1 &
+xvfb=$!
+n=0
+until DISPLAY=$display xdpyinfo >/dev/null 2>&1; do
+  n=$((n + 1))
+  if [ $n -gt 100 ]; then
+    echo "Xvfb didn't start" >&2
+    exit 1
+  fi
+  sleep 0.1
+done
+
+eval `dbus-launch --sh-syntax`
+export DISPLAY=$display
+HD_STARTUP_LOG=$dir/startup "$hd" >$dir/out 2>&1 &
+pid=$!
+
+n=0
+until [ -f $dir/startup ]; do
+  n=$((n + 1))
+  if [ $n -gt $((timeout * 100)) ] || ! kill -0 $pid 2>/dev/null; then
+    echo "$hd didn't get interactive, see below" >&2
+    tail $dir/out >&2
+    exit 1
+  fi
+  sleep 0.01
+done
+
+printf 'scenario\tstate\tframes\tp50\tp95\tp99\tmax\tdamage\tskipped\t' \
+  > $dir/report
+printf 'interval_p50\tinterval_p95\tinterval_max\n' >> $dir/report
+for s in $scenarios; do
+  set_state $STATE_HOME
+  sleep 1
+  home_call ResetFrameStats >/dev/null
+  scenario_$s
+  # Drop the header and prefix the lines with the scenario.
+  home_call GetFrameStats | sed -e '1d' -e '/^$/d' -e "s/^/$s	/" \
+    >> $dir/report
+done
+
+cat $dir/report
+[ -n "$baseline" ] || exit 0
+
+awk -F '\t' '
+  function worse_than(what, now, was) {
+    if (now > was * 1.2 && now > was + 1) {
+      printf "%s p95 of %s in %s: %.1f ms, was %.1f ms\n", what, $2, $1,
+             now, was
+      worse = 1
+    }
+  }
+  FNR == 1 { next }
+  NR == FNR { p95[$1 FS $2] = $5; ip95[$1 FS $2] = $11; next }
+  ($1 FS $2) in p95 {
+    worse_than("paint", $5, p95[$1 FS $2])
+    # Baselines from before the intervals were reported do not have them.
+    if (ip95[$1 FS $2] != "")
+      worse_than("interval", $11, ip95[$1 FS $2])
+  }
+  END { exit worse }' "$baseline" $dir/report
@@ -0,0 +1,80 @@
+#!/bin/sh
+# Cold start benchmark: starts hildon-desktop on a fresh Xvfb N times
+# and reports how long each start-up phase (see src/util/hd-startup.h)
+# took, including the time to the first frame and to interactive.
+#
+# Usage: bench-startup.sh [runs] [hildon-desktop]
+
+runs=${1:-10}
+hd=${2:-hildon-desktop}
+display=:${BENCH_DISPLAY:-77}
+timeout=60
+
+dir=`mktemp -d /tmp/bench-startup.XXXXXX` || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+now_ms()
+{
+  echo $((`date +%s%N` / 1000000))
+}
+
+i=1
+while [ $i -le $runs ]; do
+  Xvfb $display -screen 0 800x480x16 -nolisten tcp >/dev/null 2>&1 &
+  xvfb=$!
+  # Wait for the server.
+  n=0
+  until DISPLAY=$display xdpyinfo >/dev/null 2>&1; do
+    n=$((n + 1))
+    if [ $n -gt 100 ]; then
+      echo "Xvfb didn't start" >&2
+      kill $xvfb
+      exit 1
+    fi
+    sleep 0.1
+  done
+
+  log=$dir/run$i
+  started=`now_ms`
+  DISPLAY=$display HD_STARTUP_LOG=$log "$hd" >$dir/out$i 2>&1 &
+  pid=$!
+
+  n=0
+  until [ -f $log ]; do
+    n=$((n + 1))
+    if [ $n -gt $((timeout * 100)) ] || ! kill -0 $pid 2>/dev/null; then
+      echo "run $i: $hd didn't get interactive, see below" >&2
+      tail $dir/out$i >&2
+      kill $pid $xvfb 2>/dev/null
+      exit 1
+    fi
+    sleep 0.01
+  done
+  # From exec, as seen from the outside.
+  printf 'wall clock\t%s\t0\n' $((`now_ms` - started)) >> $log
+
+  kill $pid
+  wait $pid 2>/dev/null
+  kill $xvfb
+  wait $xvfb 2>/dev/null
+  i=$((i + 1))
+done
+
+# Every run lists the same phases in the same order.
+cat $dir/run* | awk -F '\t' -v runs=$runs '
+  !($1 in n) { order[++nphases] = $1 }
+  {
+    n[$1]++; sum[$1] += $2; took[$1] += $3
+    if (n[$1] == 1 || $2 < min[$1]) min[$1] = $2
+    if ($2 > max[$1]) max[$1] = $2
+  }
+  END {
+    printf "%d runs, ms from the start of main() (wall clock: from exec)\n", runs
+    printf "%-16s %9s %9s %9s %9s\n", "phase", "mean", "min", "max", "took"
+    for (i = 1; i <= nphases; i++)
+      {
+        p = order[i]
+        printf "%-16s %9.1f %9.1f %9.1f %9.1f\n", p, sum[p] / n[p],
+               min[p], max[p], took[p] / n[p]
+      }
+  }'
@@ -0,0 +1,180 @@
+/* Microbenchmark for what a transition frame costs to look up: the
+ * transitions.ini values through GKeyFile against the table of
+ * src/util/hd-transition-params.c, and the easing and bezier curves
+ * computed against sampled by src/util/hd-curve.c.
+ * Usage: bench-transitions [iterations] [transitions.ini] */
+
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hd-curve.h"
+#include "hd-transition-params.h"
+
+static const gchar sample_ini[] =
+  "[notification]\n"
+  "duration = 600\n"
+  "[rotate]\n"
+  "angle = 40\n"
+  "damage_timeout = 50\n"
+  "[launcher_in]\n"
+  "sequenced = 1\n"
+  "keyframes = 0,0.1,0.3,0.6,0.9,1.05,1\n";
+
+/* What a frame looks up: a present int, a double and a missing key. */
+static const struct
+{
+  const gchar *group, *key;
+} lookups[] =
+{
+  { "rotate", "damage_timeout" },
+  { "rotate", "angle" },
+  { "notification", "is_cool" },
+};
+
+static volatile gdouble sink;
+
+static void
+report (const gchar *what, gint64 elapsed, gint iterations)
+{
+  printf ("%-32s: %8.1f ns/frame\n", what,
+          elapsed * 1000.0 / iterations);
+}
+
+static gint
+keyfile_get_int (GKeyFile *ini, const gchar *group, const gchar *key,
+                 gint default_val)
+{
+  GError *error = NULL;
+  gint value = g_key_file_get_integer (ini, group, key, &error);
+
+  if (error)
+    {
+      g_error_free (error);
+      return default_val;
+    }
+  return value;
+}
+
+static float
+bezier (float t, float p0, float p1, float p2, float p3)
+{
+  return powf((1-t), 3)*p0
+    + 3*powf((1-t), 2)*t*p1
+    + 3*(1-t)*powf(t, 2)*p2
+    + powf(t, 3)*p3;
+}
+
+int
+main (int argc, char **argv)
+{
+  HdTransitionParams *params;
+  HdKeyFrameList *keyframes;
+  HdCurve curve;
+  GKeyFile *ini;
+  gint iterations, i, j;
+  gint64 start;
+  gboolean loaded;
+
+  iterations = argc > 1 ? atoi (argv[1]) : 1000000;
+  if (iterations <= 0)
+    iterations = 1000000;
+
+  ini = g_key_file_new ();
+  loaded = argc > 2
+    ? g_key_file_load_from_file (ini, argv[2], 0, NULL)
+    : g_key_file_load_from_data (ini, sample_ini, -1, 0, NULL);
+  if (!loaded)
+    {
+      printf ("can't load %s\n", argc > 2 ? argv[2] : "the sample");
+      return 1;
+    }
+  params = hd_transition_params_new (ini);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    for (j = 0; j < G_N_ELEMENTS (lookups); j++)
+      sink += keyfile_get_int (ini, lookups[j].group, lookups[j].key, 0);
+  report ("GKeyFile lookups", g_get_monotonic_time () - start, iterations);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    for (j = 0; j < G_N_ELEMENTS (lookups); j++)
+      {
+        gint value = 0;
+
+        hd_transition_params_get_int (params, lookups[j].group,
+                                      lookups[j].key, &value);
+        sink += value;
+      }
+  report ("compiled lookups", g_get_monotonic_time () - start, iterations);
+
+  /* The keyframes, as the launcher grid gets them for a transition. */
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    {
+      gchar *text = g_key_file_get_string (ini, "launcher_in", "keyframes",
+                                           NULL);
+
+      keyframes = hd_key_frame_list_create (text);
+      sink += hd_key_frame_interpolate (keyframes, 0.5);
+      hd_key_frame_list_free (keyframes);
+      g_free (text);
+    }
+  report ("keyframes parsed", g_get_monotonic_time () - start, iterations);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    {
+      keyframes = hd_transition_params_get_keyframes (params, "launcher_in",
+                                                      "keyframes");
+      sink += hd_key_frame_interpolate (keyframes, 0.5);
+      hd_key_frame_list_free (keyframes);
+    }
+  report ("keyframes compiled", g_get_monotonic_time () - start, iterations);
+
+  /* The notification's curve: a smooth ramp into a bezier. */
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    {
+      float t = (float) i / iterations;
+
+      t = (1.0f - cos (t * 3.141592)) * 0.5f;
+      sink += bezier (t, 185, 185, 112, -32);
+    }
+  report ("curves computed", g_get_monotonic_time () - start, iterations);
+
+  hd_curve_sample_bezier (&curve, 185, 185, 112, -32);
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    {
+      float t = (float) i / iterations;
+
+      t = hd_curve_eval (hd_curve_smooth_ramp (), t);
+      sink += hd_curve_eval (&curve, t);
+    }
+  report ("curves sampled", g_get_monotonic_time () - start, iterations);
+
+  /* And how far the samples are off. */
+  {
+    float error = 0;
+
+    for (i = 0; i <= 10000; i++)
+      {
+        float t = i / 10000.0f;
+        float computed = bezier ((1.0f - cos (t * 3.141592)) * 0.5f,
+                                 185, 185, 112, -32);
+        float sampled = hd_curve_eval (&curve,
+                            hd_curve_eval (hd_curve_smooth_ramp (), t));
+
+        error = MAX (error, fabsf (computed - sampled));
+      }
+    printf ("%-32s: %8.4f px\n", "largest error of the samples", error);
+  }
+
+  hd_transition_params_free (params);
+  g_key_file_free (ini);
+
+  return 0;
+}
@@ -0,0 +1,408 @@
+/* Runs the dual filter blur shaders of src/tidy/tidy-blur-dual-filter.h
+ * through GLES2 offscreen (eg. Mesa's llvmpipe with
+ * EGL_PLATFORM=surfaceless) and checks what they render against a
+ * reference computed here.  Also checks that the pyramid blurs about as
+ * much as the step blur would for the radius.
+ * Exits with non-zero status on failure. */
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tidy-blur-dual-filter.h"
+
+/* The size of the half size texture the pyramid starts from. */
+#define WIDTH   96
+#define HEIGHT  64
+
+/* Rounding to 8 bits after each pass and the filtering precision of the
+ * driver; anything much beyond this is a wrong tap or weight. */
+#define TOLERANCE (3.0 / 255)
+
+/* Passes tex_coord -+ (blurx, blury) like the blur group's. */
+static const char vertex_shader[] =
+  "attribute vec4 vertex_attrib;\n"
+  "attribute vec4 tex_coord_attrib;\n"
+  "uniform mediump float blurx;\n"
+  "uniform mediump float blury;\n"
+  "varying mediump vec2 tex_coord;\n"
+  "varying mediump vec2 tex_coord_a;\n"
+  "varying mediump vec2 tex_coord_b;\n"
+  "void main (void) {\n"
+  "  gl_Position = vertex_attrib;\n"
+  "  tex_coord = tex_coord_attrib.st;\n"
+  "  tex_coord_a = tex_coord - vec2(blurx, blury);\n"
+  "  tex_coord_b = tex_coord + vec2(blurx, blury);\n"
+  "}\n";
+
+typedef struct
+{
+  int w, h;
+  double *p; /* one channel is enough to check the kernels */
+} Image;
+
+typedef struct
+{
+  GLuint tex, fbo;
+  int w, h;
+} Target;
+
+static int ok = 1;
+
+static Image
+image_new (int w, int h)
+{
+  Image image;
+
+  image.w = w;
+  image.h = h;
+  image.p = calloc (w * h, sizeof (double));
+  return image;
+}
+
+/* GL_CLAMP_TO_EDGE */
+static double
+texel (const Image *image, int x, int y)
+{
+  x = x < 0 ? 0 : x >= image->w ? image->w - 1 : x;
+  y = y < 0 ? 0 : y >= image->h ? image->h - 1 : y;
+  return image->p[y * image->w + x];
+}
+
+/* GL_LINEAR */
+static double
+sample (const Image *image, double u, double v)
+{
+  double x = u * image->w - 0.5, y = v * image->h - 0.5;
+  int x0 = floor (x), y0 = floor (y);
+  double fx = x - x0, fy = y - y0;
+
+  return (texel (image, x0, y0) * (1 - fx) + texel (image, x0+1, y0) * fx)
+         * (1 - fy)
+    + (texel (image, x0, y0+1) * (1 - fx) + texel (image, x0+1, y0+1) * fx)
+         * fy;
+}
+
+/* What the shaders compute, @quantize to 8 bits like the textures do. */
+static Image
+reference_pass (const Image *src, int w, int h, int down, float offset,
+                int quantize)
+{
+  Image dst = image_new (w, h);
+  double hx, hy;
+  int x, y;
+
+  hx = (down ? offset : offset / 2) / src->w;
+  hy = (down ? offset : offset / 2) / src->h;
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+      {
+        double u = (x + 0.5) / w, v = (y + 0.5) / h, c;
+
+        if (down)
+          c = sample (src, u, v) * 0.5
+            + (sample (src, u-hx, v-hy) + sample (src, u-hx, v+hy)
+               + sample (src, u+hx, v+hy) + sample (src, u+hx, v-hy)) * 0.125;
+        else
+          c = (sample (src, u-hx, v-hy) + sample (src, u-hx, v+hy)
+               + sample (src, u+hx, v+hy) + sample (src, u+hx, v-hy)) / 6
+            + (sample (src, u-2*hx, v) + sample (src, u+2*hx, v)
+               + sample (src, u, v-2*hy) + sample (src, u, v+2*hy)) / 12;
+        dst.p[y * w + x] = quantize ? floor (c * 255 + 0.5) / 255 : c;
+      }
+  return dst;
+}
+
+static Image
+reference_blur (const Image *src, int levels, float offset, int quantize)
+{
+  Image level[TIDY_BLUR_DUAL_FILTER_LEVELS + 1];
+  int i;
+
+  level[0] = *src;
+  for (i = 1; i <= levels; i++)
+    level[i] = reference_pass (&level[i-1], level[i-1].w / 2,
+                               level[i-1].h / 2, 1, offset, quantize);
+  for (i = levels; i > 0; i--)
+    {
+      Image up = reference_pass (&level[i], level[i-1].w, level[i-1].h,
+                                 0, offset, quantize);
+
+      free (level[i].p);
+      if (i > 1)
+        free (level[i-1].p);
+      level[i-1] = up;
+    }
+  return level[0];
+}
+
+/* How far the blur spreads a dot, in texels^2 along x, averaged over
+ * a few positions because it depends on where the dot is in a texel of
+ * the smaller levels. */
+static double
+reference_variance (int levels, float offset)
+{
+  double total = 0;
+  int n;
+
+  for (n = 0; n < 8; n++)
+    {
+      Image dot = image_new (128, 128), blurred;
+      double sum = 0, mean = 0, variance = 0;
+      int x, y;
+
+      dot.p[(64 + n) * dot.w + 64 + n] = 1;
+      blurred = reference_blur (&dot, levels, offset, 0);
+      for (y = 0; y < blurred.h; y++)
+        for (x = 0; x < blurred.w; x++)
+          {
+            sum += blurred.p[y * blurred.w + x];
+            mean += blurred.p[y * blurred.w + x] * x;
+          }
+      mean /= sum;
+      for (y = 0; y < blurred.h; y++)
+        for (x = 0; x < blurred.w; x++)
+          variance += blurred.p[y * blurred.w + x] * (x - mean) * (x - mean);
+      total += variance / sum;
+      free (dot.p);
+      free (blurred.p);
+    }
+  return total / n;
+}
+
+static int
+gl_init (void)
+{
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+  static const EGLint context_attribs[] =
+    { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+  EGLDisplay display;
+  EGLContext context;
+
+  get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+    eglGetProcAddress ("eglGetPlatformDisplayEXT");
+  display = get_platform_display
+    ? get_platform_display (EGL_PLATFORM_SURFACELESS_MESA,
+                            EGL_DEFAULT_DISPLAY, NULL)
+    : eglGetDisplay (EGL_DEFAULT_DISPLAY);
+  if (display == EGL_NO_DISPLAY || !eglInitialize (display, NULL, NULL))
+    return 0;
+
+  eglBindAPI (EGL_OPENGL_ES_API);
+  context = eglCreateContext (display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT,
+                              context_attribs);
+  if (context == EGL_NO_CONTEXT
+      || !eglMakeCurrent (display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    return 0;
+
+  printf ("renderer: %s\n", glGetString (GL_RENDERER));
+  return 1;
+}
+
+static GLuint
+program_new (const char *fragment_source)
+{
+  const char *sources[] = { vertex_shader, fragment_source };
+  GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+  GLuint program = glCreateProgram ();
+  GLint status;
+  int i;
+
+  for (i = 0; i < 2; i++)
+    {
+      GLuint shader = glCreateShader (types[i]);
+
+      glShaderSource (shader, 1, &sources[i], NULL);
+      glCompileShader (shader);
+      glGetShaderiv (shader, GL_COMPILE_STATUS, &status);
+      if (!status)
+        {
+          char log[1024];
+
+          glGetShaderInfoLog (shader, sizeof (log), NULL, log);
+          printf ("FAIL: shader doesn't compile: %s\n", log);
+          exit (1);
+        }
+      glAttachShader (program, shader);
+    }
+  glBindAttribLocation (program, 0, "vertex_attrib");
+  glBindAttribLocation (program, 1, "tex_coord_attrib");
+  glLinkProgram (program);
+  glGetProgramiv (program, GL_LINK_STATUS, &status);
+  if (!status)
+    {
+      printf ("FAIL: shaders don't link\n");
+      exit (1);
+    }
+  return program;
+}
+
+static Target
+target_new (int w, int h, const unsigned char *pixels)
+{
+  Target target;
+
+  target.w = w;
+  target.h = h;
+  glGenTextures (1, &target.tex);
+  glBindTexture (GL_TEXTURE_2D, target.tex);
+  glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA,
+                GL_UNSIGNED_BYTE, pixels);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  glGenFramebuffers (1, &target.fbo);
+  glBindFramebuffer (GL_FRAMEBUFFER, target.fbo);
+  glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                          GL_TEXTURE_2D, target.tex, 0);
+  if (glCheckFramebufferStatus (GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+      printf ("FAIL: incomplete framebuffer\n");
+      exit (1);
+    }
+  return target;
+}
+
+static void
+gl_pass (GLuint program, const Target *src, const Target *dst, float blur)
+{
+  static const GLfloat quad[] = { -1, -1, 0, 0,   1, -1, 1, 0,
+                                  -1,  1, 0, 1,   1,  1, 1, 1 };
+
+  glBindFramebuffer (GL_FRAMEBUFFER, dst->fbo);
+  glViewport (0, 0, dst->w, dst->h);
+  glUseProgram (program);
+  glUniform1f (glGetUniformLocation (program, "blurx"), blur / src->w);
+  glUniform1f (glGetUniformLocation (program, "blury"), blur / src->h);
+  glBindTexture (GL_TEXTURE_2D, src->tex);
+  glVertexAttribPointer (0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof (GLfloat), quad);
+  glVertexAttribPointer (1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof (GLfloat),
+                         quad + 2);
+  glEnableVertexAttribArray (0);
+  glEnableVertexAttribArray (1);
+  glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
+}
+
+/* The pyramid like TidyBlurGroup builds it, into @level[0]. */
+static void
+gl_blur (GLuint down, GLuint up, Target *level, int levels, float offset)
+{
+  int i;
+
+  for (i = 1; i <= levels; i++)
+    gl_pass (down, &level[i-1], &level[i], offset);
+  for (i = levels; i > 0; i--)
+    gl_pass (up, &level[i], i > 1 ? &level[i-1] : &level[levels+1],
+             offset / 2);
+}
+
+static void
+check_shaders (int radius, GLuint down, GLuint up, const Image *source,
+               const unsigned char *pixels)
+{
+  Target level[TIDY_BLUR_DUAL_FILTER_LEVELS + 2];
+  unsigned char *out;
+  Image expected;
+  double error = 0;
+  float offset;
+  int levels, i;
+
+  tidy_blur_dual_filter_params (radius, &levels, &offset);
+
+  level[0] = target_new (WIDTH, HEIGHT, pixels);
+  for (i = 1; i <= levels; i++)
+    level[i] = target_new (level[i-1].w / 2, level[i-1].h / 2, NULL);
+  /* The result, tex_b to tex_a of the blur group. */
+  level[levels+1] = target_new (WIDTH, HEIGHT, NULL);
+
+  gl_blur (down, up, level, levels, offset);
+
+  out = malloc (WIDTH * HEIGHT * 4);
+  glBindFramebuffer (GL_FRAMEBUFFER, level[levels+1].fbo);
+  glReadPixels (0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, out);
+
+  expected = reference_blur (source, levels, offset, 1);
+  for (i = 0; i < WIDTH * HEIGHT; i++)
+    error = fmax (error, fabs (out[i * 4] / 255.0 - expected.p[i]));
+
+  printf ("radius %2d: %d levels, offset %.2f: largest error %.4f\n",
+          radius, levels, offset, error);
+  if (error > TOLERANCE || glGetError () != GL_NO_ERROR)
+    {
+      printf ("FAIL: radius %d renders wrong\n", radius);
+      ok = 0;
+    }
+
+  for (i = 0; i <= levels + 1; i++)
+    {
+      glDeleteFramebuffers (1, &level[i].fbo);
+      glDeleteTextures (1, &level[i].tex);
+    }
+  free (expected.p);
+  free (out);
+}
+
+/* The step blur spreads by 1/2 texel^2 a step. */
+static void
+check_spread (int radius)
+{
+  double variance, step_variance = radius * 0.5;
+  float offset;
+  int levels;
+
+  tidy_blur_dual_filter_params (radius, &levels, &offset);
+  variance = reference_variance (levels, offset);
+  printf ("radius %2d: %d levels, offset %.2f: variance %.2f, steps %.2f\n",
+          radius, levels, offset, variance, step_variance);
+  if (fabs (variance - step_variance) > step_variance * 0.25)
+    {
+      printf ("FAIL: radius %d blurs too differently\n", radius);
+      ok = 0;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int spread_radii[] = { 4, 8, 12, 16, 24, 32, 48, 64 };
+  static const int radii[] = { 4, 12, 16, 32, 64 };
+  unsigned char *pixels;
+  Image source;
+  GLuint down, up;
+  unsigned i;
+
+  for (i = 0; i < sizeof (spread_radii) / sizeof (spread_radii[0]); i++)
+    check_spread (spread_radii[i]);
+
+  if (!gl_init ())
+    {
+      printf ("FAIL: no GLES2 context\n");
+      return 1;
+    }
+  down = program_new (TIDY_BLUR_DUAL_FILTER_DOWN_FRAGMENT_SHADER);
+  up = program_new (TIDY_BLUR_DUAL_FILTER_UP_FRAGMENT_SHADER);
+
+  /* Noise with some edges in it. */
+  srand (1);
+  source = image_new (WIDTH, HEIGHT);
+  pixels = calloc (WIDTH * HEIGHT, 4);
+  for (i = 0; i < WIDTH * HEIGHT; i++)
+    {
+      int x = i % WIDTH, y = i / WIDTH;
+
+      pixels[i * 4] = ((x / 8 + y / 8) & 1) * 160 + rand () % 96;
+      pixels[i * 4 + 3] = 255;
+      source.p[i] = pixels[i * 4] / 255.0;
+    }
+
+  for (i = 0; i < sizeof (radii) / sizeof (radii[0]); i++)
+    check_shaders (radii[i], down, up, &source, pixels);
+
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+/* Checks that the dithering kernels of src/util/hd-dither.c agree: the
+ * vector kernels must give exactly what the tiled C kernel gives, and the
+ * tiled kernel must err the same way the reference LFSR dither does.
+ * Exits with non-zero status on failure. */
+
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hd-dither.h"
+
+/* Odd sizes to exercise the scalar tails of the vector kernels. */
+#define WIDTH  403
+#define HEIGHT 241
+
+/* Error statistics of one channel. */
+typedef struct
+{
+  gdouble mean, stddev;
+  /* Histogram of the error, -8..+8 */
+  gdouble hist[17];
+} ErrorStats;
+
+static guchar *
+make_image (gint n_channels, gint *stride)
+{
+  guchar *pixels;
+  gint x, y;
+
+  /* Gradients are what dithering is for; add some (deterministic) noise
+   * so that every input value occurs at every noise value. */
+  *stride = WIDTH * n_channels + 5;
+  pixels = g_malloc (*stride * HEIGHT);
+  for (y = 0; y < HEIGHT; y++)
+    for (x = 0; x < WIDTH; x++)
+      {
+        guchar *p = pixels + y * *stride + x * n_channels;
+
+        p[0] = (x * 255) / (WIDTH - 1);
+        p[1] = (y * 255) / (HEIGHT - 1);
+        p[2] = (x + y + ((x * 7919 + y * 104729) >> 3)) & 0xFF;
+        if (n_channels == 4)
+          p[3] = x ^ y;
+      }
+
+  return pixels;
+}
+
+static void
+error_stats (const guchar *src, gint stride, gint n_channels,
+             const guint16 *dst, ErrorStats stats[3])
+{
+  static const gint shift[3] = { 11, 5, 0 }, bits[3] = { 5, 6, 5 };
+  gdouble n = WIDTH * HEIGHT;
+  gint x, y, c;
+
+  memset (stats, 0, sizeof (ErrorStats) * 3);
+  for (y = 0; y < HEIGHT; y++)
+    for (x = 0; x < WIDTH; x++)
+      for (c = 0; c < 3; c++)
+        {
+          gint v, err;
+
+          /* Expand back to 8 bits, the way the GPU does. */
+          v = (dst[y * WIDTH + x] >> shift[c]) & ((1 << bits[c]) - 1);
+          v = (v << (8 - bits[c])) | (v >> (2 * bits[c] - 8));
+          err = v - src[y * stride + x * n_channels + c];
+
+          stats[c].mean   += err;
+          stats[c].stddev += err * err;
+          stats[c].hist[CLAMP (err, -8, 8) + 8]++;
+        }
+
+  for (c = 0; c < 3; c++)
+    {
+      gint i;
+
+      stats[c].mean /= n;
+      stats[c].stddev = sqrt (stats[c].stddev / n
+                              - stats[c].mean * stats[c].mean);
+      for (i = 0; i < G_N_ELEMENTS (stats[c].hist); i++)
+        stats[c].hist[i] /= n;
+    }
+}
+
+static gboolean
+check_kernels (gint n_channels)
+{
+  HdDitherKernel kernel;
+  ErrorStats ref[3], tiled[3];
+  guint16 *ref_out, *tiled_out, *out;
+  guchar *src;
+  gint stride, c, i;
+  gboolean ok = TRUE;
+
+  src = make_image (n_channels, &stride);
+  ref_out = g_new (guint16, WIDTH * HEIGHT);
+  tiled_out = g_new (guint16, WIDTH * HEIGHT);
+  out = g_new (guint16, WIDTH * HEIGHT);
+
+  hd_dither_rgb565_full (HD_DITHER_REFERENCE, src, stride, n_channels,
+                         ref_out, WIDTH * 2, WIDTH, HEIGHT, 0);
+  hd_dither_rgb565_full (HD_DITHER_TILED, src, stride, n_channels,
+                         tiled_out, WIDTH * 2, WIDTH, HEIGHT, 0);
+
+  /* The error of each channel should be distributed the same way. */
+  error_stats (src, stride, n_channels, ref_out, ref);
+  error_stats (src, stride, n_channels, tiled_out, tiled);
+  for (c = 0; c < 3; c++)
+    {
+      gdouble diff = 0;
+
+      for (i = 0; i < G_N_ELEMENTS (ref[c].hist); i++)
+        diff += fabs (ref[c].hist[i] - tiled[c].hist[i]);
+
+      printf ("%d channels, channel %d: reference %.3f+-%.3f, "
+              "tiled %.3f+-%.3f, histogram difference %.4f\n",
+              n_channels, c, ref[c].mean, ref[c].stddev,
+              tiled[c].mean, tiled[c].stddev, diff);
+      if (fabs (ref[c].mean - tiled[c].mean) > 0.1
+          || fabs (ref[c].stddev - tiled[c].stddev) > 0.1
+          || diff > 0.03)
+        {
+          printf ("FAIL: tiled error distribution differs\n");
+          ok = FALSE;
+        }
+    }
+
+  /* Dithering in bands must not change anything. */
+  for (i = 0; i < HEIGHT; i += 37)
+    hd_dither_rgb565_full (HD_DITHER_TILED, src + i * stride, stride,
+                           n_channels, out + i * WIDTH, WIDTH * 2,
+                           WIDTH, MIN (37, HEIGHT - i), i);
+  if (memcmp (out, tiled_out, WIDTH * HEIGHT * 2))
+    {
+      printf ("FAIL: banded tiled output differs\n");
+      ok = FALSE;
+    }
+
+  for (kernel = HD_DITHER_SSE2; kernel <= HD_DITHER_BEST; kernel++)
+    {
+      if (!hd_dither_kernel_is_available (kernel))
+        continue;
+
+      memset (out, 0, WIDTH * HEIGHT * 2);
+      hd_dither_rgb565_full (kernel, src, stride, n_channels,
+                             out, WIDTH * 2, WIDTH, HEIGHT, 0);
+      if (memcmp (out, tiled_out, WIDTH * HEIGHT * 2))
+        {
+          printf ("FAIL: %d channels, %s output differs from tiled\n",
+                  n_channels, hd_dither_kernel_name (kernel));
+          ok = FALSE;
+        }
+      else
+        printf ("%d channels, %s: identical to tiled\n",
+                n_channels, hd_dither_kernel_name (kernel));
+    }
+
+  g_free (out);
+  g_free (tiled_out);
+  g_free (ref_out);
+  g_free (src);
+
+  return ok;
+}
+
+int
+main (int argc, char **argv)
+{
+  gboolean ok;
+
+  ok  = check_kernels (3);
+  ok &= check_kernels (4);
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+/* Drives src/util/hd-frame-scheduler.c with a fake monotonic clock and
+ * checks that the callbacks fall on the frame grid, that those due at the
+ * same tick are run together and that a stall is not caught up on.  Then
+ * runs it on the real clock while setting the time of day back and
+ * forward, by wrapping gettimeofday(), and checks the frames keep coming.
+ * Exits with non-zero status on failure. */
+
+#include <glib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "hd-frame-scheduler.h"
+
+#define FRAME 16000
+
+typedef struct
+{
+  const gchar *name;
+  guint        calls;
+  gint64       last;
+  gboolean     keep;
+} Probe;
+
+static gboolean ok = TRUE;
+static gint64 fake_now, origin;
+
+/* Added to the time of day. */
+static gint64 wall_offset;
+
+int
+gettimeofday (struct timeval *tv, void *tz)
+{
+  struct timespec ts;
+  gint64 t;
+
+  clock_gettime (CLOCK_REALTIME, &ts);
+  t = (gint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 + wall_offset;
+  tv->tv_sec = t / 1000000;
+  tv->tv_usec = t % 1000000;
+  return 0;
+}
+
+static void
+check (gboolean cond, const gchar *what)
+{
+  if (!cond)
+    {
+      printf ("FAIL: %s\n", what);
+      ok = FALSE;
+    }
+}
+
+static gint64
+fake_clock (void)
+{
+  return fake_now;
+}
+
+static gboolean
+probe (gpointer data)
+{
+  Probe *p = data;
+
+  p->calls++;
+  p->last = hd_frame_scheduler_get_time ();
+  if ((p->last - origin) % FRAME)
+    {
+      printf ("FAIL: %s called off the grid at %" G_GINT64_FORMAT " us\n",
+              p->name, p->last - origin);
+      ok = FALSE;
+    }
+  return p->keep;
+}
+
+/* Move the fake clock forward by @us and run whatever is due. */
+static void
+advance (gint64 us)
+{
+  fake_now += us;
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+}
+
+static void
+test_fake_clock (void)
+{
+  Probe a = { "every frame", 0, 0, TRUE };
+  Probe b = { "every 32 ms", 0, 0, TRUE };
+  Probe c = { "once at 50 ms", 0, 0, FALSE };
+  Probe d = { "postponed", 0, 0, FALSE };
+  HdFrameSchedulerStats stats;
+  guint ida, idb, idd;
+  gint64 due;
+  gint i;
+
+  fake_now = origin = 1000000;
+  hd_frame_scheduler_set_clock (fake_clock);
+  hd_frame_scheduler_set_frame_ms (FRAME / 1000);
+
+  /* At 0, 16, ..., 96 ms; 32, 64, 96 and 64. */
+  ida = hd_frame_scheduler_add (0, probe, &a, NULL);
+  idb = hd_frame_scheduler_add (32, probe, &b, NULL);
+  hd_frame_scheduler_add (50, probe, &c, NULL);
+  for (i = 0; i <= 100; i++)
+    advance (i ? 1000 : 0);
+
+  hd_frame_scheduler_get_stats (&stats);
+  check (a.calls == 7, "every frame: 7 calls in 100 ms");
+  check (b.calls == 3, "every 32 ms: 3 calls in 100 ms");
+  check (c.calls == 1 && c.last == origin + 4 * FRAME,
+         "once at 50 ms: called at the tick at 64 ms");
+  check (stats.n_ticks == 7, "the others are run at ticks of the first");
+  check (stats.max_batch == 3, "three run together at 64 ms");
+  check (stats.n_late == 0 && stats.lateness_max < 1000, "no tick late");
+
+  /* Stall for 200 ms: one tick, not one for each missed frame. */
+  advance (200000);
+  hd_frame_scheduler_get_stats (&stats);
+  check (a.calls == 8, "a stall runs every frame once");
+  check (stats.n_late == 1 && stats.n_skipped >= 11,
+         "the frames skipped in a stall are counted");
+  advance (FRAME);
+  check (a.calls == 9 && a.last == origin + 19 * FRAME,
+         "back on the grid after a stall");
+  hd_frame_scheduler_remove (ida);
+  hd_frame_scheduler_remove (idb);
+
+  /* What hd_transition_rotate_ignore_damage() does: keep pushing the
+   * timeout back, then let it go off. */
+  idd = hd_frame_scheduler_add (50, probe, &d, NULL);
+  for (i = 0; i < 40; i++)
+    {
+      hd_frame_scheduler_set_remaining (idd, 30);
+      due = fake_now + 30000;
+      advance (1000);
+    }
+  check (d.calls == 0 && hd_frame_scheduler_get_remaining (idd) == 29,
+         "postponed while pushed back");
+  for (i = 0; i < 50; i++)
+    advance (1000);
+  check (d.calls == 1
+           && d.last == origin + (due - origin + FRAME - 1) / FRAME * FRAME,
+         "postponed: called at the first tick after its time");
+  check (!hd_frame_scheduler_remove (idd), "a one-shot is removed after");
+
+  hd_frame_scheduler_set_clock (NULL);
+}
+
+typedef struct
+{
+  GMainLoop *loop;
+  guint      frames;
+  gint64     last, longest, wall_step;
+} WallClockRun;
+
+static gboolean
+wall_clock_frame (gpointer data)
+{
+  WallClockRun *run = data;
+  struct timespec ts;
+  gint64 now, wall;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  now = (gint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  if (run->last)
+    run->longest = MAX (run->longest, now - run->last);
+  run->last = now;
+
+  /* Set the clock back by an hour, then forward by a day. */
+  wall = g_get_real_time ();
+  if (run->frames == 10)
+    wall_offset -= 3600 * G_GINT64_CONSTANT (1000000);
+  else if (run->frames == 20)
+    wall_offset += 24 * 3600 * G_GINT64_CONSTANT (1000000);
+  if (run->frames == 10)
+    run->wall_step = g_get_real_time () - wall;
+
+  if (++run->frames < 30)
+    return TRUE;
+  g_main_loop_quit (run->loop);
+  return FALSE;
+}
+
+/* In case the frames stop coming.  Removed by test_wall_clock(). */
+static gboolean
+wall_clock_give_up (gpointer data)
+{
+  g_main_loop_quit (((WallClockRun *)data)->loop);
+  return TRUE;
+}
+
+static void
+test_wall_clock (void)
+{
+  WallClockRun run = { NULL, 0, 0, 0, 0 };
+  gint64 start;
+  guint id, give_up;
+
+  hd_frame_scheduler_set_frame_ms (FRAME / 1000);
+  run.loop = g_main_loop_new (NULL, FALSE);
+  id = hd_frame_scheduler_add (0, wall_clock_frame, &run, NULL);
+  give_up = g_timeout_add (5000, wall_clock_give_up, &run);
+
+  start = g_get_monotonic_time ();
+  g_main_loop_run (run.loop);
+  start = g_get_monotonic_time () - start;
+  hd_frame_scheduler_remove (id);
+  g_source_remove (give_up);
+
+  if (run.wall_step > -3000 * G_GINT64_CONSTANT (1000000))
+    printf ("SKIP: couldn't set the time of day back\n");
+  check (run.frames == 30, "wall clock: all frames run");
+  check (run.longest < 100000, "wall clock: no frame held up");
+  check (start < 2 * 30 * FRAME, "wall clock: frames not slowed down");
+
+  g_main_loop_unref (run.loop);
+  wall_offset = 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  test_fake_clock ();
+  test_wall_clock ();
+
+  if (ok)
+    printf ("PASS\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/* Drives the memory pressure levels of src/util/hd-pressure.c from fake
+ * PSI, cgroup and lowmem files in a temporary directory, and checks the
+ * levels and their hysteresis.  Exits with non-zero status on failure. */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hd-pressure.h"
+
+static gchar *root;
+static gboolean ok = TRUE;
+static gint n_changes;
+
+/* Rewrite the file in place: HdPressure keeps it open. */
+static void
+write_file (const gchar *path, const gchar *contents)
+{
+  gchar *fname = g_strconcat (root, path, NULL);
+  gchar *dir = g_path_get_dirname (fname);
+  gint fd;
+
+  g_mkdir_with_parents (dir, 0755);
+  fd = open (fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || write (fd, contents, strlen (contents)) < 0)
+    {
+      printf ("FAIL: can't write %s\n", fname);
+      ok = FALSE;
+    }
+  if (fd >= 0)
+    close (fd);
+  g_free (dir);
+  g_free (fname);
+}
+
+static void
+remove_file (const gchar *path)
+{
+  gchar *fname = g_strconcat (root, path, NULL);
+
+  g_unlink (fname);
+  g_free (fname);
+}
+
+static void
+write_psi (gdouble some, gdouble full)
+{
+  gchar *contents;
+
+  contents = g_strdup_printf (
+      "some avg10=%.2f avg60=0.00 avg300=0.00 total=0\n"
+      "full avg10=%.2f avg60=0.00 avg300=0.00 total=0\n", some, full);
+  write_file ("/proc/pressure/memory", contents);
+  g_free (contents);
+}
+
+static void
+write_events (guint high, guint max)
+{
+  gchar *contents;
+
+  contents = g_strdup_printf ("low 0\nhigh %u\nmax %u\noom 0\noom_kill 0\n",
+                              high, max);
+  write_file ("/sys/fs/cgroup/test.slice/memory.events", contents);
+  g_free (contents);
+}
+
+static void
+level_changed (HdPressure *pressure, HdPressureLevel level, gpointer data)
+{
+  n_changes++;
+}
+
+static void
+expect (HdPressure *pressure, const gchar *what, HdPressureLevel level)
+{
+  hd_pressure_check (pressure);
+  if (hd_pressure_get_level (pressure) != level)
+    {
+      printf ("FAIL: %s: %s: level %d, expected %d\n",
+              hd_pressure_source_name (hd_pressure_get_source (pressure)),
+              what, hd_pressure_get_level (pressure), level);
+      ok = FALSE;
+    }
+}
+
+static HdPressure *
+new_pressure (HdPressureSource expected)
+{
+  HdPressureConfig config;
+  HdPressure *pressure;
+
+  hd_pressure_config_init (&config);
+  /* So the cgroup levels go down at the next check. */
+  config.cgroup_quiet = 0;
+  pressure = hd_pressure_new (root, &config, level_changed, NULL);
+  if (hd_pressure_get_source (pressure) != expected)
+    {
+      printf ("FAIL: source is %s, expected %s\n",
+              hd_pressure_source_name (hd_pressure_get_source (pressure)),
+              hd_pressure_source_name (expected));
+      ok = FALSE;
+    }
+  n_changes = 0;
+
+  return pressure;
+}
+
+static void
+check_psi (void)
+{
+  HdPressure *pressure;
+
+  write_psi (0, 0);
+  write_file ("/proc/pressure/cpu",
+              "some avg10=30.00 avg60=0.00 avg300=0.00 total=0\n");
+  pressure = new_pressure (HD_PRESSURE_SOURCE_PSI);
+
+  expect (pressure, "idle", HD_PRESSURE_NONE);
+  write_psi (7, 0);
+  expect (pressure, "below low_on", HD_PRESSURE_NONE);
+  write_psi (12, 0);
+  expect (pressure, "above low_on", HD_PRESSURE_LOW);
+  write_psi (7, 0);
+  expect (pressure, "between low_off and low_on", HD_PRESSURE_LOW);
+  write_psi (20, 6);
+  expect (pressure, "above critical_on", HD_PRESSURE_CRITICAL);
+  write_psi (20, 3);
+  expect (pressure, "between critical_off and critical_on",
+          HD_PRESSURE_CRITICAL);
+  write_psi (20, 1);
+  expect (pressure, "below critical_off", HD_PRESSURE_LOW);
+  write_psi (3, 0);
+  expect (pressure, "below low_off", HD_PRESSURE_NONE);
+  if (n_changes != 4)
+    {
+      printf ("FAIL: psi: %d changes, expected 4\n", n_changes);
+      ok = FALSE;
+    }
+
+  if (!hd_pressure_cpu_is_busy (pressure))
+    {
+      printf ("FAIL: psi: cpu isn't busy\n");
+      ok = FALSE;
+    }
+
+  hd_pressure_free (pressure);
+  remove_file ("/proc/pressure/memory");
+  remove_file ("/proc/pressure/cpu");
+}
+
+static void
+check_cgroup (void)
+{
+  HdPressure *pressure;
+
+  write_file ("/proc/self/cgroup", "0::/test.slice\n");
+  write_events (3, 1);
+  pressure = new_pressure (HD_PRESSURE_SOURCE_CGROUP);
+
+  /* Only new events count. */
+  expect (pressure, "old events", HD_PRESSURE_NONE);
+  write_events (4, 1);
+  expect (pressure, "high", HD_PRESSURE_LOW);
+  write_events (5, 2);
+  expect (pressure, "max", HD_PRESSURE_CRITICAL);
+  expect (pressure, "quiet", HD_PRESSURE_LOW);
+  expect (pressure, "still quiet", HD_PRESSURE_NONE);
+
+  hd_pressure_free (pressure);
+  remove_file ("/proc/self/cgroup");
+}
+
+static void
+check_lowmem (void)
+{
+  HdPressure *pressure;
+
+  write_file ("/proc/sys/vm/lowmem_notify_low_pages", "1000\n");
+  write_file ("/proc/sys/vm/lowmem_notify_high_pages", "500\n");
+  write_file ("/proc/sys/vm/lowmem_nr_decay_pages", "100\n");
+  write_file ("/proc/sys/vm/lowmem_free_pages", "5000\n");
+  write_file ("/proc/loadavg", "0.50 0.40 0.30 1/100 1234\n");
+  pressure = new_pressure (HD_PRESSURE_SOURCE_LOWMEM);
+
+  expect (pressure, "plenty free", HD_PRESSURE_NONE);
+  write_file ("/proc/sys/vm/lowmem_free_pages", "900\n");
+  expect (pressure, "below notify_low", HD_PRESSURE_LOW);
+  write_file ("/proc/sys/vm/lowmem_free_pages", "1050\n");
+  expect (pressure, "within decay of notify_low", HD_PRESSURE_LOW);
+  write_file ("/proc/sys/vm/lowmem_free_pages", "400\n");
+  expect (pressure, "below notify_high", HD_PRESSURE_CRITICAL);
+  write_file ("/proc/sys/vm/lowmem_free_pages", "2000\n");
+  expect (pressure, "plenty free again", HD_PRESSURE_NONE);
+
+  /* Without PSI, it's the load average. */
+  if (hd_pressure_get_load_average (pressure) != 0.5
+      || hd_pressure_cpu_is_busy (pressure))
+    {
+      printf ("FAIL: lowmem: load average %.2f\n",
+              hd_pressure_get_load_average (pressure));
+      ok = FALSE;
+    }
+
+  hd_pressure_free (pressure);
+}
+
+int
+main (int argc, char **argv)
+{
+  gchar *cmd;
+
+  root = g_build_filename (g_get_tmp_dir (), "test-pressure.XXXXXX", NULL);
+  if (!mkdtemp (root))
+    {
+      printf ("FAIL: can't make %s\n", root);
+      return 1;
+    }
+
+  check_psi ();
+  check_cgroup ();
+  check_lowmem ();
+
+  cmd = g_strdup_printf ("rm -rf '%s'", root);
+  if (system (cmd))
+    printf ("can't remove %s\n", root);
+  g_free (cmd);
+  g_free (root);
+
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+/* Reads process memory from a fake /proc tree with src/util/hd-proc-mem.c
+ * and checks which apps it picks for hibernation.  Exits with non-zero
+ * status on failure. */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hd-proc-mem.h"
+
+static gchar *root;
+static gboolean ok = TRUE;
+
+static void
+write_file (const gchar *path, const gchar *contents)
+{
+  gchar *fname = g_strconcat (root, path, NULL);
+  gchar *dir = g_path_get_dirname (fname);
+
+  g_mkdir_with_parents (dir, 0755);
+  if (!g_file_set_contents (fname, contents, -1, NULL))
+    {
+      printf ("FAIL: can't write %s\n", fname);
+      ok = FALSE;
+    }
+  g_free (dir);
+  g_free (fname);
+}
+
+static void
+check_read (void)
+{
+  HdProcMem mem;
+
+  write_file ("/proc/100/smaps_rollup",
+              "00400000-7fff0000 ---p 00000000 00:00 0  [rollup]\n"
+              "Rss:              153600 kB\n"
+              "Pss:              150000 kB\n"
+              "Pss_Anon:         120000 kB\n"
+              "Swap:               8000 kB\n"
+              "SwapPss:            6000 kB\n");
+  if (!hd_proc_mem_read (root, 100, &mem)
+      || mem.rss != 153600 || mem.pss != 150000 || mem.swap != 6000)
+    {
+      printf ("FAIL: smaps_rollup: rss %u pss %u swap %u\n",
+              (guint) mem.rss, (guint) mem.pss, (guint) mem.swap);
+      ok = FALSE;
+    }
+
+  /* Old kernels only have the status. */
+  write_file ("/proc/101/status",
+              "Name:\tosso-notes\n"
+              "VmRSS:\t    5120 kB\n"
+              "VmSwap:\t     100 kB\n");
+  if (!hd_proc_mem_read (root, 101, &mem)
+      || mem.rss != 5120 || mem.pss != 5120 || mem.swap != 100)
+    {
+      printf ("FAIL: status: rss %u pss %u swap %u\n",
+              (guint) mem.rss, (guint) mem.pss, (guint) mem.swap);
+      ok = FALSE;
+    }
+
+  if (hd_proc_mem_read (root, 102, &mem))
+    {
+      printf ("FAIL: read a process which doesn't exist\n");
+      ok = FALSE;
+    }
+}
+
+static void
+candidate (HdProcMemCandidate *c, const gchar *name, guint64 pss,
+           gint64 idle, gdouble cost)
+{
+  memset (c, 0, sizeof (*c));
+  c->data = (gpointer) name;
+  c->mem.pss = c->mem.rss = pss;
+  c->idle = idle;
+  c->cost = cost;
+}
+
+static void
+expect_victims (const gchar *what, HdProcMemCandidate *c, guint n,
+                guint64 need, const gchar *expected)
+{
+  GString *victims = g_string_new (NULL);
+  guint i, n_victims = hd_proc_mem_choose_victims (c, n, need);
+
+  for (i = 0; i < n_victims; i++)
+    g_string_append_printf (victims, "%s%s", i ? " " : "",
+                            (const gchar *) c[i].data);
+  if (strcmp (victims->str, expected))
+    {
+      printf ("FAIL: %s: victims \"%s\", expected \"%s\"\n",
+              what, victims->str, expected);
+      ok = FALSE;
+    }
+  g_string_free (victims, TRUE);
+}
+
+static void
+check_victims (void)
+{
+  HdProcMemCandidate c[4];
+
+  /* The browser, though it was used more recently than the small app. */
+  candidate (&c[0], "notes", 5000, 600, 1);
+  candidate (&c[1], "browser", 150000, 60, 1);
+  expect_victims ("one victim", c, 2, 0, "browser");
+
+  /* Unless the browser is about to be used again. */
+  candidate (&c[0], "notes", 5000, 600, 1);
+  candidate (&c[1], "browser", 150000, 0, 100);
+  expect_victims ("costly browser", c, 2, 0, "notes");
+
+  /* The fewest apps, best scored first. */
+  candidate (&c[0], "a", 60000, 3600, 1);
+  candidate (&c[1], "b", 50000, 3600, 1);
+  candidate (&c[2], "c", 150000, 0, 2);
+  candidate (&c[3], "d", 10000, 3600, 1);
+  expect_victims ("one is enough", c, 4, 100000, "c");
+  expect_victims ("two are needed", c, 4, 200000, "a c");
+  /* Only the best scored one, the next round looks again. */
+  expect_victims ("not enough", c, 4, 300000, "a");
+  expect_victims ("no candidates", c, 0, 1000, "");
+}
+
+int
+main (int argc, char **argv)
+{
+  gchar *cmd;
+
+  root = g_build_filename (g_get_tmp_dir (), "test-proc-mem.XXXXXX", NULL);
+  if (!mkdtemp (root))
+    {
+      printf ("FAIL: can't make %s\n", root);
+      return 1;
+    }
+
+  check_read ();
+  check_victims ();
+
+  cmd = g_strdup_printf ("rm -rf '%s'", root);
+  if (system (cmd))
+    printf ("can't remove %s\n", root);
+  g_free (cmd);
+  g_free (root);
+
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
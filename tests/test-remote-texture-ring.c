@@ -0,0 +1,365 @@
+/* Exercises the buffer ring transport of remote textures
+ * (src/mb/hd-remote-texture-ring.h).
+ *
+ * test-remote-texture-ring --local [frames]
+ *   Runs a producer and a consumer thread on a ring in this process and
+ *   checks that the consumer never gets a half-drawn frame and that the
+ *   frames it gets are never older than the one before.  Exits with
+ *   non-zero status on failure.
+ *
+ * test-remote-texture-ring [frames] [n_buffers]
+ *   Produces an animation for a running hildon-desktop (eg. under Xvfb)
+ *   through a remote texture window parented to a window of its own. */
+
+#define _GNU_SOURCE /* memfd_create() */
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <glib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hd-remote-texture-ring.h"
+
+#define WIDTH  320
+#define HEIGHT 240
+#define BPP    4
+
+static HdRemoteTextureRing *
+ring_new (void *mem, guint n_buffers)
+{
+  HdRemoteTextureRing *ring = mem;
+  guint i;
+
+  memset (ring, 0, sizeof (*ring));
+  ring->magic = HD_REMOTE_TEXTURE_RING_MAGIC;
+  ring->version = HD_REMOTE_TEXTURE_RING_VERSION;
+  ring->width = WIDTH;
+  ring->height = HEIGHT;
+  ring->bpp = BPP;
+  ring->rowstride = WIDTH * BPP;
+  ring->n_buffers = n_buffers;
+  for (i = 0; i < n_buffers; i++)
+    ring->offset[i] = getpagesize () + i * ring->rowstride * HEIGHT;
+  ring->latest = ring->reading = n_buffers;
+
+  return ring;
+}
+
+static gsize
+ring_size (guint n_buffers)
+{
+  return getpagesize () + n_buffers * WIDTH * BPP * HEIGHT;
+}
+
+/* Fill buffer @b with @tag, except for a 16 pixel wide bar of ~@tag
+ * which moves along with @frame. */
+static void
+draw_frame (HdRemoteTextureRing *ring, int b, guint32 tag, guint frame)
+{
+  guint32 *row;
+  guint x, y;
+
+  for (y = 0; y < HEIGHT; y++)
+    {
+      row = (guint32 *)((guchar *)ring + ring->offset[b]
+                        + y * ring->rowstride);
+      for (x = 0; x < WIDTH; x++)
+        row[x] = (x + frame) % WIDTH < 16 ? ~tag : tag;
+      /* Give the other side a chance to run in the middle of it
+       * even on a single CPU. */
+      if (!(y % 32))
+        g_thread_yield ();
+    }
+}
+
+/* --local */
+
+typedef struct
+{
+  HdRemoteTextureRing *ring;
+  guint                frames;
+  volatile gint        done;
+  guint                skipped, torn, stale, consumed;
+} Local;
+
+static gpointer
+local_producer (gpointer data)
+{
+  Local *local = data;
+  guint frame;
+
+  for (frame = 0; frame < local->frames; )
+    {
+      guint32 seq;
+      int b;
+
+      if ((b = hd_remote_texture_ring_begin_frame (local->ring)) < 0)
+        {
+          local->skipped++;
+          g_thread_yield ();
+          continue;
+        }
+
+      /* We don't know the sequence number before publishing, but it's
+       * going to be the newest one + 2. */
+      seq = local->ring->latest < local->ring->n_buffers
+        ? local->ring->seq[local->ring->latest] + 2 : 2;
+      draw_frame (local->ring, b, seq, frame);
+      if (hd_remote_texture_ring_end_frame (local->ring, b) != seq)
+        g_error ("unexpected sequence number");
+      frame++;
+    }
+
+  g_atomic_int_set (&local->done, 1);
+  return NULL;
+}
+
+/* Check that every pixel of buffer @b is @tag or ~@tag. */
+static gboolean
+frame_is_whole (HdRemoteTextureRing *ring, int b, guint32 tag)
+{
+  guint x, y;
+
+  for (y = 0; y < HEIGHT; y++)
+    {
+      const guint32 *row = (const guint32 *)((guchar *)ring + ring->offset[b]
+                                             + y * ring->rowstride);
+      for (x = 0; x < WIDTH; x++)
+        if (row[x] != tag && row[x] != ~tag)
+          return FALSE;
+      if (!(y % 32))
+        g_thread_yield ();
+    }
+
+  return TRUE;
+}
+
+static gpointer
+local_consumer (gpointer data)
+{
+  Local *local = data;
+  guint32 current = local->ring->n_buffers, last_seq = 0;
+
+  while (!g_atomic_int_get (&local->done))
+    {
+      guint32 seq;
+      int b;
+
+      if ((b = hd_remote_texture_ring_acquire (local->ring,
+                                               local->ring->n_buffers,
+                                               current, &seq)) < 0)
+        {
+          g_thread_yield ();
+          continue;
+        }
+
+      current = b;
+      local->consumed++;
+      if (seq <= last_seq)
+        local->stale++;
+      last_seq = seq;
+
+      /* Upload it, slowly, while the producer keeps drawing. */
+      if (!frame_is_whole (local->ring, b, seq)
+          || !frame_is_whole (local->ring, b, seq))
+        local->torn++;
+    }
+
+  return NULL;
+}
+
+static gboolean
+run_local (guint frames)
+{
+  gboolean ok = TRUE;
+  guint n_buffers;
+
+  for (n_buffers = 2; n_buffers <= HD_REMOTE_TEXTURE_RING_MAX_BUFFERS;
+       n_buffers++)
+    {
+      GThread *producer, *consumer;
+      Local local;
+      void *mem;
+
+      memset (&local, 0, sizeof (local));
+      mem = g_malloc0 (ring_size (n_buffers));
+      local.ring = ring_new (mem, n_buffers);
+      local.frames = frames;
+
+      consumer = g_thread_new ("consumer", local_consumer, &local);
+      producer = g_thread_new ("producer", local_producer, &local);
+      g_thread_join (producer);
+      g_thread_join (consumer);
+
+      printf ("%u buffers: %u frames produced, %u times no buffer free, "
+              "%u consumed, %u torn, %u stale\n", n_buffers, frames,
+              local.skipped, local.consumed, local.torn, local.stale);
+      if (local.torn || local.stale || !local.consumed)
+        ok = FALSE;
+
+      g_free (mem);
+    }
+
+  return ok;
+}
+
+/* Against hildon-desktop */
+
+static void
+send_message (Display *dpy, Window w, const char *type,
+              long l0, long l1, long l2, long l3, long l4)
+{
+  XEvent ev;
+
+  memset (&ev, 0, sizeof (ev));
+  ev.xclient.type = ClientMessage;
+  ev.xclient.window = w;
+  ev.xclient.message_type = XInternAtom (dpy, type, False);
+  ev.xclient.format = 32;
+  ev.xclient.data.l[0] = l0;
+  ev.xclient.data.l[1] = l1;
+  ev.xclient.data.l[2] = l2;
+  ev.xclient.data.l[3] = l3;
+  ev.xclient.data.l[4] = l4;
+  XSendEvent (dpy, w, False, NoEventMask, &ev);
+}
+
+static Window
+create_window (Display *dpy, const char *type)
+{
+  Atom w_type, value;
+  Window w;
+
+  w = XCreateSimpleWindow (dpy, DefaultRootWindow (dpy), 0, 0,
+                           WIDTH, HEIGHT, 0, 0, 0);
+  w_type = XInternAtom (dpy, "_NET_WM_WINDOW_TYPE", False);
+  value = XInternAtom (dpy, type, False);
+  XChangeProperty (dpy, w, w_type, XA_ATOM, 32, PropModeReplace,
+                   (unsigned char *)&value, 1);
+  XSelectInput (dpy, w, PropertyChangeMask);
+  XMapWindow (dpy, w);
+
+  return w;
+}
+
+/* Wait until hildon-desktop has set _HILDON_TEXTURE_CLIENT_READY on @w. */
+static void
+wait_until_ready (Display *dpy, Window w)
+{
+  Atom ready = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_READY", False);
+
+  for (;;)
+    {
+      Atom type;
+      int format;
+      unsigned long n, left;
+      unsigned char *data = NULL;
+      XEvent ev;
+
+      if (XGetWindowProperty (dpy, w, ready, 0, 1, False, AnyPropertyType,
+                              &type, &format, &n, &left, &data) == Success
+          && type != None)
+        {
+          XFree (data);
+          return;
+        }
+
+      XWindowEvent (dpy, w, PropertyChangeMask, &ev);
+    }
+}
+
+static gboolean
+run_remote (guint frames, guint n_buffers)
+{
+  HdRemoteTextureRing *ring;
+  Window parent, w;
+  guint frame, skipped;
+  Display *dpy;
+  gsize size;
+  void *mem;
+  int fd;
+
+  if (!(dpy = XOpenDisplay (NULL)))
+    {
+      fprintf (stderr, "cannot open display\n");
+      return FALSE;
+    }
+
+  parent = create_window (dpy, "_NET_WM_WINDOW_TYPE_NORMAL");
+  w = create_window (dpy, "_HILDON_WM_WINDOW_TYPE_REMOTE_TEXTURE");
+  wait_until_ready (dpy, w);
+
+  size = ring_size (n_buffers);
+  if ((fd = memfd_create ("hildon-remote-texture", MFD_ALLOW_SEALING)) < 0
+      || ftruncate (fd, size) < 0
+      || fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) < 0
+      || (mem = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd, 0)) == MAP_FAILED)
+    {
+      perror ("ring");
+      return FALSE;
+    }
+  ring = ring_new (mem, n_buffers);
+
+  send_message (dpy, w, "_HILDON_TEXTURE_CLIENT_MESSAGE_SHM_RING",
+                getpid (), fd, WIDTH, HEIGHT, BPP);
+  send_message (dpy, w, "_HILDON_TEXTURE_CLIENT_MESSAGE_POSITION",
+                0, 0, WIDTH, HEIGHT, 0);
+  send_message (dpy, w, "_HILDON_TEXTURE_CLIENT_MESSAGE_PARENT",
+                parent, 0, 0, 0, 0);
+  send_message (dpy, w, "_HILDON_TEXTURE_CLIENT_MESSAGE_SHOW",
+                1, 255, 0, 0, 0);
+
+  for (frame = skipped = 0; frame < frames; )
+    {
+      guint32 seq;
+      int b;
+
+      if ((b = hd_remote_texture_ring_begin_frame (ring)) < 0)
+        {
+          skipped++;
+          g_usleep (1000);
+          continue;
+        }
+
+      draw_frame (ring, b, 0xff000000 | (frame * 0x010203), frame);
+      seq = hd_remote_texture_ring_end_frame (ring, b);
+      /* Everything changes, the colour fades. */
+      send_message (dpy, w, "_HILDON_TEXTURE_CLIENT_MESSAGE_BUFFER_READY",
+                    seq, 0, 0, WIDTH, HEIGHT);
+      XFlush (dpy);
+      frame++;
+      g_usleep (1000000 / 60);
+    }
+
+  printf ("%u frames in %u buffers, %u times no buffer free\n",
+          frames, n_buffers, skipped);
+
+  close (fd);
+  munmap (mem, size);
+  XCloseDisplay (dpy);
+
+  return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  gboolean ok;
+
+  if (argc > 1 && !strcmp (argv[1], "--local"))
+    ok = run_local (argc > 2 ? atoi (argv[2]) : 20000);
+  else
+    ok = run_remote (argc > 1 ? atoi (argv[1]) : 600,
+                     CLAMP (argc > 2 ? atoi (argv[2]) : 3, 2,
+                            HD_REMOTE_TEXTURE_RING_MAX_BUFFERS));
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+
+  return ok ? 0 : 1;
+}